@@ -0,0 +1,65 @@
+// Append-only file write and replay rates.
+//
+//   bench_aof [commands] [path]
+#include "redis/aof.hpp"
+#include "redis/database.hpp"
+#include "redis/protocol.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Commands per append, like one busy event loop iteration
+    constexpr size_t BATCH = 64;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::string path = argc > 2 ? argv[2] : "bench_aof.aof";
+    std::filesystem::remove(path);
+
+    {
+        redis::AppendOnlyFile aof(path, redis::FsyncPolicy::NO);
+        std::string batch;
+        char key[32];
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            std::snprintf(key, sizeof(key), "key:%08zu", i);
+            std::string value = "value:" + std::to_string(i);
+            redis::Protocol::appendCommand(batch, std::array{std::string_view("SET"), std::string_view(key),
+                                                             std::string_view(value)});
+            if ((i + 1) % BATCH == 0) {
+                aof.append(batch);
+                batch.clear();
+            }
+        }
+        aof.append(batch);
+        double elapsed = seconds(start);
+        std::printf("append  %zu commands  %8.3f s  %12.0f commands/s  %6.1f MB\n", count, elapsed,
+                    count / elapsed, std::filesystem::file_size(path) / 1e6);
+    }
+
+    // Parsing alone, then parsing and executing
+    auto start = std::chrono::steady_clock::now();
+    size_t parsed = redis::AppendOnlyFile::replay(path, [](redis::CommandArgsSpan) {});
+    double elapsed = seconds(start);
+    std::printf("parse   %zu commands  %8.3f s  %12.0f commands/s\n", parsed, elapsed, parsed / elapsed);
+
+    redis::Database db;
+    start = std::chrono::steady_clock::now();
+    size_t replayed = redis::AppendOnlyFile::replay(path, [&db](redis::CommandArgsSpan args) {
+        db.executeCommand(args);
+    });
+    elapsed = seconds(start);
+    std::printf("replay  %zu commands  %8.3f s  %12.0f commands/s\n", replayed, elapsed, replayed / elapsed);
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Compares Dict with the std::unordered_map that Storage used before it.
+//
+//   bench_dict [keys]
+//
+// Reports the average time per operation and, for inserts, the slowest single
+// insert, which is where a rehash of the whole table shows up.
+#include "redis/dict.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <malloc.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+
+    using StdMap = std::unordered_map<std::string, std::string, KeyHash, std::equal_to<>>;
+
+    struct Result {
+        double insert_ns;
+        double max_insert_us;
+        double hit_ns;
+        double miss_ns;
+        double erase_ns;
+    };
+
+    double nsPerOp(Clock::duration elapsed, size_t ops) {
+        return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(ops);
+    }
+
+    template <typename Insert, typename Find, typename Erase>
+    Result run(const std::vector<std::string>& keys, const std::vector<std::string>& missing,
+               Insert insert, Find find, Erase erase) {
+        Result result{};
+        Clock::duration slowest{};
+        auto start = Clock::now();
+        for (const auto& key : keys) {
+            auto before = Clock::now();
+            insert(key);
+            slowest = std::max(slowest, Clock::now() - before);
+        }
+        result.insert_ns = nsPerOp(Clock::now() - start, keys.size());
+        result.max_insert_us = std::chrono::duration<double, std::micro>(slowest).count();
+
+        size_t found = 0;
+        start = Clock::now();
+        for (const auto& key : keys) {
+            found += find(key);
+        }
+        result.hit_ns = nsPerOp(Clock::now() - start, keys.size());
+
+        start = Clock::now();
+        for (const auto& key : missing) {
+            found += find(key);
+        }
+        result.miss_ns = nsPerOp(Clock::now() - start, missing.size());
+
+        start = Clock::now();
+        for (const auto& key : keys) {
+            erase(key);
+        }
+        result.erase_ns = nsPerOp(Clock::now() - start, keys.size());
+
+        if (found != keys.size()) {
+            std::fprintf(stderr, "lookup mismatch: %zu of %zu\n", found, keys.size());
+            std::exit(1);
+        }
+        return result;
+    }
+
+    void print(const char* name, const Result& result) {
+        std::printf("%-20s %10.1f %14.1f %10.1f %10.1f %10.1f\n", name, result.insert_ns,
+                    result.max_insert_us, result.hit_ns, result.miss_ns, result.erase_ns);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::vector<std::string> keys;
+    std::vector<std::string> missing;
+    keys.reserve(count);
+    missing.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back("key:" + std::to_string(i * 2654435761ULL % (count * 4)));
+        missing.push_back("missing:" + std::to_string(i));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    // Shuffle deterministically so lookups do not follow insertion order
+    for (size_t i = keys.size(); i > 1; i--) {
+        std::swap(keys[i - 1], keys[(i * 6364136223846793005ULL + 1442695040888963407ULL) % i]);
+    }
+
+    std::printf("%zu keys\n", keys.size());
+    std::printf("%-20s %10s %14s %10s %10s %10s\n", "", "insert ns", "max insert us", "hit ns", "miss ns", "erase ns");
+
+    {
+        StdMap map;
+        print("std::unordered_map", run(keys, missing,
+            [&](const std::string& key) { map.emplace(key, "value"); },
+            [&](const std::string& key) { return map.find(std::string_view(key)) != map.end(); },
+            [&](const std::string& key) { map.erase(map.find(std::string_view(key))); }));
+    }
+    // Return the map's freed nodes now rather than inside the first timed
+    // allocation of the next run
+    malloc_trim(0);
+    {
+        redis::Dict<std::string> dict;
+        print("redis::Dict", run(keys, missing,
+            [&](const std::string& key) { dict.tryEmplace(key, "value"); },
+            [&](const std::string& key) { return dict.find(key) != nullptr; },
+            [&](const std::string& key) { dict.erase(key); }));
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Cost of a disabled log statement in the I/O path.
+//
+//   bench_log [events]
+//
+// Times the accept log of the epoll loop with the statement disabled, as it
+// is in production, three ways: a plain spdlog call, which evaluates its
+// arguments before checking the level; REDIS_LOG with the level disabled at
+// run time, which checks it first; and REDIS_LOG below the compile-time
+// level, which leaves nothing behind.
+#define REDIS_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#include "redis/log.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Keep the compiler from dropping or merging the iterations
+    void barrier() {
+        asm volatile("" ::: "memory");
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t events = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000000;
+    redis::log::setLevel(spdlog::level::warn);
+    in_addr address{};
+    address.s_addr = htonl(INADDR_LOOPBACK);
+    int socket = 42;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events; i++) {
+        barrier();
+    }
+    double empty = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events; i++) {
+        spdlog::info("Accepted connection from {}, socket {}", inet_ntoa(address), socket);
+        barrier();
+    }
+    double plain = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events; i++) {
+        REDIS_INFO("Accepted connection from {}, socket {}", inet_ntoa(address), socket);
+        barrier();
+    }
+    double gated = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events; i++) {
+        REDIS_DEBUG("Accepted connection from {}, socket {}", inet_ntoa(address), socket);
+        barrier();
+    }
+    double compiled_out = seconds(start);
+
+    double per_event = 1e9 / static_cast<double>(events);
+    std::printf("%zu events, level warn\n", events);
+    std::printf("%-28s %8.2fns per event\n", "empty loop", empty * per_event);
+    std::printf("%-28s %8.2fns per event\n", "spdlog::info()", plain * per_event);
+    std::printf("%-28s %8.2fns per event\n", "REDIS_INFO(), run-time off", gated * per_event);
+    std::printf("%-28s %8.2fns per event\n", "REDIS_DEBUG(), compiled out", compiled_out * per_event);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Heap bytes per key of the keyspace layouts, for keys like "key:00000001"
+// and short values.
+//
+//   bench_memory [keys]
+//
+// Compares the original std::unordered_map of std::string to a variant, the
+// same entries in a Dict, and Storage with its compact objects. Then the heap
+// bytes per element of a list of the same values, as a std::list of
+// std::string and as a QuickList. Last the heap bytes per hash of user profiles
+// of 10 short fields, as a std::unordered_map and as a packed and a table Hash.
+#include "redis/dict.hpp"
+#include "redis/hash.hpp"
+#include "redis/memory.hpp"
+#include "redis/quicklist.hpp"
+#include "redis/storage.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <malloc.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace {
+    using Value = std::variant<std::string>;
+
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+
+    // malloc's bytes in use plus the slab runs of the keyspace allocator
+    size_t heapInUse() {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd + redis::memory::stats().slabs;
+    }
+
+    std::string key(size_t i) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "key:%08zu", i);
+        return buffer;
+    }
+
+    std::string value(size_t i, bool integers) {
+        return integers ? std::to_string(i) : "value:" + std::to_string(i);
+    }
+
+    // Fields of a user profile and their values for user `i`
+    std::vector<std::pair<std::string, std::string>> profile(size_t i) {
+        std::string id = std::to_string(i);
+        return {
+            {"name", "user" + id},
+            {"email", "user" + id + "@example.com"},
+            {"age", std::to_string(20 + i % 50)},
+            {"country", "FR"},
+            {"city", "Paris"},
+            {"visits", std::to_string(i % 1000)},
+            {"plan", "free"},
+            {"created", std::to_string(1700000000 + i)},
+            {"verified", "1"},
+            {"theme", "dark"},
+        };
+    }
+
+    template <typename Fill>
+    void measure(const char* name, size_t count, Fill fill) {
+        malloc_trim(0);
+        size_t before = heapInUse();
+        // The container lives inside fill() until the measurement is taken
+        fill([&] {
+            size_t used = heapInUse() - before;
+            std::printf("%-28s %10.1f\n", name, static_cast<double>(used) / static_cast<double>(count));
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::printf("%zu keys, bytes per key\n", count);
+
+    for (bool integers : {false, true}) {
+        std::printf("\n%s values\n", integers ? "integer" : "short string");
+        measure("std::unordered_map", count, [&](auto report) {
+            std::unordered_map<std::string, Value, KeyHash, std::equal_to<>> map;
+            for (size_t i = 0; i < count; i++) {
+                map.emplace(key(i), value(i, integers));
+            }
+            report();
+        });
+        measure("Dict<std::variant>", count, [&](auto report) {
+            redis::Dict<Value> dict;
+            for (size_t i = 0; i < count; i++) {
+                dict.tryEmplace(key(i), value(i, integers));
+            }
+            report();
+        });
+        measure("Storage", count, [&](auto report) {
+            redis::Storage storage;
+            for (size_t i = 0; i < count; i++) {
+                storage.set(key(i), value(i, integers));
+            }
+            report();
+        });
+    }
+
+    std::printf("\n%zu list elements, bytes per element\n", count);
+    measure("std::list<std::string>", count, [&](auto report) {
+        std::list<std::string> list;
+        for (size_t i = 0; i < count; i++) {
+            list.push_back(value(i, false));
+        }
+        report();
+    });
+    measure("QuickList", count, [&](auto report) {
+        redis::QuickList list;
+        for (size_t i = 0; i < count; i++) {
+            list.push(redis::ListEnd::TAIL, value(i, false));
+        }
+        report();
+    });
+
+    size_t hashes = count / 10;
+    std::printf("\n%zu hashes of 10 fields, bytes per hash\n", hashes);
+    measure("std::unordered_map", hashes, [&](auto report) {
+        std::vector<std::unordered_map<std::string, std::string>> maps(hashes);
+        for (size_t i = 0; i < hashes; i++) {
+            for (auto& [field, value] : profile(i)) {
+                maps[i].emplace(std::move(field), std::move(value));
+            }
+        }
+        report();
+    });
+    for (bool packed : {true, false}) {
+        redis::HashLimits limits;
+        if (!packed) {
+            limits.max_packed_entries = 0;
+        }
+        measure(packed ? "Hash (packed)" : "Hash (table)", hashes, [&](auto report) {
+            std::vector<redis::Hash> all(hashes);
+            for (size_t i = 0; i < hashes; i++) {
+                for (const auto& [field, value] : profile(i)) {
+                    all[i].set(field, value, limits);
+                }
+            }
+            report();
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Multi-key lookups with and without prefetching.
+//
+//   bench_mget [keys] [batch]
+//
+// Fills a Storage with `keys` string keys, then reads random batches of
+// `batch` keys one get() at a time, as GET would, and with getMany(), as MGET
+// does, which hashes a window of keys and prefetches their slots before
+// looking any of them up. The gap grows with the keyspace, once the tables
+// no longer fit in the cache.
+#include "redis/storage.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t batch = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    std::vector<std::string> names;
+    names.reserve(keys);
+    redis::Storage storage;
+    for (size_t i = 0; i < keys; i++) {
+        names.push_back("key:" + std::to_string(i));
+        storage.set(names.back(), "value:" + std::to_string(i));
+    }
+
+    // The same random batches for both, every key present
+    std::mt19937_64 rng(1);
+    const size_t batches = std::max<size_t>(1, 10000000 / batch / 10);
+    std::vector<std::string_view> lookups(batches * batch);
+    for (std::string_view& lookup : lookups) {
+        lookup = names[rng() % keys];
+    }
+
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < batches; b++) {
+        for (std::string_view key : std::span(lookups).subspan(b * batch, batch)) {
+            bytes += storage.get(key)->value().view().size();
+        }
+    }
+    double single = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < batches; b++) {
+        storage.getMany(std::span(lookups).subspan(b * batch, batch),
+                        [&bytes](const std::optional<redis::StringValue>& value) { bytes += value->view().size(); });
+    }
+    double batched = seconds(start);
+
+    double per_key = 1e9 / static_cast<double>(lookups.size());
+    std::printf("%zu keys, batches of %zu\n", keys, batch);
+    std::printf("%-24s %10.1fns per key\n", "get() one by one", single * per_key);
+    std::printf("%-24s %10.1fns per key\n", "getMany() prefetched", batched * per_key);
+    return bytes == 0 ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+// Snapshot save and load rates.
+//
+//   bench_rdb [keys] [path]
+#include "redis/rdb.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::string path = argc > 2 ? argv[2] : "bench_rdb.rdb";
+
+    {
+        redis::Storage storage;
+        char key[32];
+        for (size_t i = 0; i < count; i++) {
+            std::snprintf(key, sizeof(key), "key:%08zu", i);
+            // Half integers, half short strings
+            storage.set(key, i % 2 == 0 ? std::to_string(i) : "value:" + std::to_string(i));
+        }
+        auto start = std::chrono::steady_clock::now();
+        redis::Rdb::save(path, {&storage});
+        double elapsed = seconds(start);
+        std::printf("save  %zu keys  %8.3f s  %12.0f keys/s  %6.1f MB\n", count, elapsed, count / elapsed,
+                    std::filesystem::file_size(path) / 1e6);
+    }
+
+    redis::Storage storage;
+    auto start = std::chrono::steady_clock::now();
+    size_t loaded = redis::Rdb::load(path, {&storage}, [](std::string_view) { return size_t(0); });
+    double elapsed = seconds(start);
+    std::printf("load  %zu keys  %8.3f s  %12.0f keys/s\n", loaded, elapsed, loaded / elapsed);
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Intersection rates of integer sets, like tag queries over ids.
+//
+//   bench_set [elements]
+//
+// For pairs of sets of 16-bit, 32-bit and 64-bit ids, balanced and skewed in
+// size, times IntSet::intersect against std::set_intersection over sorted
+// vectors and against SINTER of the same members in table-encoded Sets.
+#include "redis/set.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Nanoseconds per run of `fn`, repeated for at least 0.2s
+    template <typename Fn>
+    double time(Fn fn) {
+        size_t runs = 0;
+        auto start = std::chrono::steady_clock::now();
+        do {
+            fn();
+            runs++;
+        } while (seconds(start) < 0.2);
+        return seconds(start) * 1e9 / static_cast<double>(runs);
+    }
+
+    // `count` sorted distinct ids from `base`, `spread` apart on average
+    std::vector<int64_t> ids(std::mt19937_64& rng, size_t count, int64_t base, size_t spread) {
+        std::vector<int64_t> values;
+        values.reserve(count);
+        int64_t value = base;
+        while (values.size() < count) {
+            value += 1 + static_cast<int64_t>(rng() % (2 * spread - 1));
+            values.push_back(value);
+        }
+        return values;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+    std::mt19937_64 rng(1);
+    std::printf("%-30s %12s %12s %12s\n", "sets", "IntSet", "vector", "table");
+
+    struct Case {
+        const char* name;
+        int64_t base;
+        size_t small;
+        size_t large;
+    };
+    const Case cases[] = {
+        // Ids below 32768
+        {"16-bit, balanced", 0, std::min<size_t>(count, 15000), std::min<size_t>(count, 15000)},
+        {"32-bit, balanced", 1 << 20, count, count},
+        {"64-bit, balanced", int64_t(1) << 40, count, count},
+        {"32-bit, 1:100", 1 << 20, count / 100, count},
+    };
+    for (const Case& c : cases) {
+        if (c.small == 0) {
+            continue;
+        }
+        // Both sets cover the same range of ids
+        auto small_ids = ids(rng, c.small, c.base, 2 * c.large / c.small);
+        auto large_ids = ids(rng, c.large, c.base, 2);
+        redis::IntSet small_ints;
+        redis::IntSet large_ints;
+        redis::Set small_table;
+        redis::Set large_table;
+        for (int64_t id : small_ids) {
+            small_ints.insert(id);
+            small_table.add(std::to_string(id), 0);
+        }
+        for (int64_t id : large_ids) {
+            large_ints.insert(id);
+            large_table.add(std::to_string(id), 0);
+        }
+
+        std::vector<int64_t> result;
+        result.reserve(c.small);
+        double intset = time([&] {
+            result.clear();
+            small_ints.intersect(large_ints, result);
+        });
+        size_t matches = result.size();
+        double vector = time([&] {
+            result.clear();
+            std::set_intersection(small_ids.begin(), small_ids.end(), large_ids.begin(), large_ids.end(),
+                                  std::back_inserter(result));
+        });
+        const redis::Set* tables[] = {&small_table, &large_table};
+        size_t table_matches = 0;
+        double table = time([&] {
+            table_matches = 0;
+            redis::Set::intersect(tables, [&](std::string_view) { table_matches++; });
+        });
+        if (result.size() != matches || table_matches != matches) {
+            std::fprintf(stderr, "mismatched results for %s\n", c.name);
+            return 1;
+        }
+        std::printf("%-30s %10.1fus %10.1fus %10.1fus\n", c.name, intset / 1000, vector / 1000, table / 1000);
+    }
+    return 0;
+}
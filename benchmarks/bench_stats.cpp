@@ -0,0 +1,84 @@
+// Cost of the per-command statistics.
+//
+//   bench_stats [commands]
+//
+// Times what every command pays for INFO commandstats and LATENCY
+// HISTOGRAM: two readCycles() and a CommandStats::record(), alone and as
+// part of GET through Database::executeCommand(), next to the lookup the
+// command does. In a batch, as the commands of one read run, the clock is
+// read once per command.
+#include "redis/command_stats.hpp"
+#include "redis/database.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t commands = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    redis::Database database;
+    const size_t keys = 1000;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < keys; i++) {
+        names.push_back("key:" + std::to_string(i));
+        database.storage().set(names.back(), "value");
+    }
+    size_t get = static_cast<size_t>(redis::Database::command("GET") - redis::Database::commandTable().data());
+
+    // The clock alone: a few ns on bare metal, more where a hypervisor
+    // traps it
+    uint64_t cycles = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < commands; i++) {
+        uint64_t begin = redis::readCycles();
+        cycles += redis::readCycles() - begin;
+    }
+    double clock = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < commands; i++) {
+        uint64_t begin = redis::readCycles();
+        database.stats().record(get, redis::readCycles() - begin, false);
+    }
+    double recording = seconds(start);
+
+    size_t bytes = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < commands; i++) {
+        bytes += database.storage().get(names[i % keys])->value().view().size();
+    }
+    double lookup = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < commands; i++) {
+        std::string_view args[] = {"GET", names[i % keys]};
+        bytes += database.executeCommand(args).size();
+    }
+    double executed = seconds(start);
+
+    database.clock().beginBatch();
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < commands; i++) {
+        std::string_view args[] = {"GET", names[i % keys]};
+        bytes += database.executeCommand(args).size();
+    }
+    double batched = seconds(start);
+    database.clock().endBatch();
+
+    double per_command = 1e9 / static_cast<double>(commands);
+    std::printf("%zu commands\n", commands);
+    std::printf("%-28s %10.1fns per command\n", "readCycles() x2", clock * per_command);
+    std::printf("%-28s %10.1fns per command\n", "readCycles() x2 + record()", recording * per_command);
+    std::printf("%-28s %10.1fns per command\n", "Storage::get()", lookup * per_command);
+    std::printf("%-28s %10.1fns per command\n", "GET through executeCommand()", executed * per_command);
+    std::printf("%-28s %10.1fns per command\n", "GET in a batch", batched * per_command);
+    return bytes == 0 || cycles == 0 ? 1 : 0;
+}
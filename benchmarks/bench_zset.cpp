@@ -0,0 +1,106 @@
+// Leaderboard update and query rates of sorted sets.
+//
+//   bench_zset [players]
+//
+// Fills a leaderboard of `players` members, then times score updates, rank
+// lookups and top-10 pages at random ranks against a std::set of
+// (score, member) pairs with a std::unordered_map from member to score, the
+// usual hand-rolled leaderboard. std::set has no ranks, so its rank lookups
+// and pages walk from the start.
+#include "redis/zset.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    double seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Nanoseconds per call of `fn`, over `count` calls
+    template <typename Fn>
+    double time(size_t count, Fn fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return seconds(start) * 1e9 / static_cast<double>(count);
+    }
+
+    struct Board {
+        std::set<std::pair<double, std::string>> order;
+        std::unordered_map<std::string, double> scores;
+
+        void add(const std::string& member, double score) {
+            auto [it, inserted] = scores.try_emplace(member, score);
+            if (!inserted) {
+                order.erase({it->second, member});
+                it->second = score;
+            }
+            order.emplace(score, member);
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    size_t players = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::mt19937_64 rng(1);
+    std::vector<std::string> members;
+    members.reserve(players);
+    for (size_t i = 0; i < players; i++) {
+        members.push_back("player:" + std::to_string(i));
+    }
+    auto score = [&rng] { return static_cast<double>(rng() % 1000000); };
+    auto player = [&rng, players] { return static_cast<size_t>(rng() % players); };
+
+    redis::ZSet zset;
+    Board board;
+    const redis::ZSetLimits limits;
+    double zset_fill = time(players, [&](size_t i) { zset.add(members[i], score(), limits); });
+    double board_fill = time(players, [&](size_t i) { board.add(members[i], score()); });
+
+    const size_t updates = std::min<size_t>(players, 1000000);
+    double zset_update = time(updates, [&](size_t) { zset.add(members[player()], score(), limits); });
+    double board_update = time(updates, [&](size_t) { board.add(members[player()], score()); });
+
+    // Walking std::set is O(n), so only a few walks on its side
+    const size_t lookups = std::min<size_t>(players, 100000);
+    const size_t walks = 20;
+    size_t checksum = 0;
+    double zset_rank = time(lookups, [&](size_t) { checksum += zset.rank(members[player()]).value(); });
+    double board_rank = time(walks, [&](size_t) {
+        const std::string& member = members[player()];
+        auto it = board.order.find({board.scores.at(member), member});
+        checksum += static_cast<size_t>(std::distance(board.order.begin(), it));
+    });
+
+    // ZRANGE start start+9
+    double zset_page = time(lookups, [&](size_t) {
+        size_t start = player() % (players > 10 ? players - 10 : 1);
+        zset.forRange(start, std::min(start + 9, players - 1),
+                      [&](std::string_view member, double) { checksum += member.size(); });
+    });
+    double board_page = time(walks, [&](size_t) {
+        size_t start = player() % (players > 10 ? players - 10 : 1);
+        auto it = std::next(board.order.begin(), static_cast<std::ptrdiff_t>(start));
+        for (size_t i = 0; i < 10 && it != board.order.end(); i++, ++it) {
+            checksum += it->second.size();
+        }
+    });
+
+    std::printf("%-24s %12s %12s\n", "leaderboard", "ZSet", "std::set");
+    std::printf("%-24s %10.0fns %10.0fns\n", "add", zset_fill, board_fill);
+    std::printf("%-24s %10.0fns %10.0fns\n", "update score", zset_update, board_update);
+    std::printf("%-24s %10.0fns %10.0fns\n", "rank", zset_rank, board_rank);
+    std::printf("%-24s %10.0fns %10.0fns\n", "top-10 page at a rank", zset_page, board_page);
+    std::printf("%-24s %10.1fMB\n", "ZSet memory", static_cast<double>(zset.memoryUsage()) / (1 << 20));
+    return checksum == 0 ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "storage.hpp"
+#include "types.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+namespace redis {
+
+// When the append-only file is flushed to disk
+enum class FsyncPolicy {
+    ALWAYS,    // after every batch, before its replies are sent
+    EVERYSEC,  // once a second, by a background thread
+    NO,        // whenever the kernel writes it back
+};
+
+// Log of the commands that modified the keyspace, in RESP, shared by every
+// event loop. Each loop appends the commands of one iteration as a single
+// batch; O_APPEND keeps the batches of different loops whole.
+class AppendOnlyFile {
+public:
+    AppendOnlyFile(const std::string& path, FsyncPolicy policy);
+    ~AppendOnlyFile();
+
+    AppendOnlyFile(const AppendOnlyFile&) = delete;
+    AppendOnlyFile& operator=(const AppendOnlyFile&) = delete;
+
+    // Append a batch of commands with one write(). Safe to call from any
+    // thread. Throws std::runtime_error if the write fails.
+    void append(std::string_view batch);
+
+    // Rewriting. After startRewrite() appended batches are also kept in
+    // memory, while a child writes the keyspace to rewritePath(child) with
+    // writeCommands(). finishRewrite() adds the kept batches to that file and
+    // renames it over the log; abortRewrite() drops them and the file.
+    void startRewrite();
+    void finishRewrite(pid_t child);
+    void abortRewrite(pid_t child);
+    std::string rewritePath(pid_t child) const;
+
+    // Write the keys of every shard to `path` as the shortest commands that
+    // recreate them
+    static void writeCommands(const std::string& path, const std::vector<Storage*>& shards);
+
+    // Call `fn` with every command in the log at `path`. A command cut short
+    // at the end, as a crash in the middle of a write leaves it, is dropped
+    // and the file truncated before it. Returns the number of commands, 0 if
+    // there is no file. Throws std::runtime_error if the file is malformed.
+    static size_t replay(const std::string& path, const std::function<void(CommandArgsSpan)>& fn);
+
+private:
+    std::string path_;
+    FsyncPolicy policy_;
+    // Guards the descriptor, which a rewrite replaces, and the rewrite buffer
+    std::mutex mutex_;
+    int fd_;
+    bool rewriting_;
+    std::string rewrite_buffer_;
+
+    // Written since the last fsync, for EVERYSEC
+    std::atomic<bool> dirty_;
+    bool stopping_;
+    std::condition_variable stop_;
+    std::thread sync_thread_;
+
+    void syncEverySecond();
+};
+
+} // namespace redis
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace redis {
+
+// Contiguous, growable receive buffer. Bytes are read from the socket straight
+// into the free space at the tail and consumed from the head, so a command
+// stays in place until it has been parsed and executed.
+class InputBuffer {
+public:
+    static constexpr size_t INITIAL_CAPACITY = 16 * 1024;
+    // An idle buffer larger than this is released back to the initial size
+    static constexpr size_t MAX_IDLE_CAPACITY = 1024 * 1024;
+    // Size of the on-stack spill area used by readFrom()
+    static constexpr size_t SPILL_SIZE = 64 * 1024;
+
+    InputBuffer();
+
+    // Bytes received but not yet consumed
+    std::string_view readable() const;
+    size_t size() const;
+    size_t capacity() const;
+
+    // Drop `n` bytes from the head
+    void consume(size_t n);
+
+    // Make room for at least `n` readable bytes in total, so a frame of known
+    // size is received into one region without being moved again
+    void reserve(size_t n);
+
+    void append(std::string_view data);
+
+    // Read once from `fd` with readv() into the free tail space and an on-stack
+    // spill area, growing the buffer only by what was actually received.
+    // Returns the result of readv().
+    ssize_t readFrom(int fd);
+
+private:
+    std::unique_ptr<char[]> data_;
+    size_t capacity_;
+    size_t read_pos_;
+    size_t write_pos_;
+
+    void ensureWritable(size_t n);
+};
+
+// Chunked send buffer. Small replies are coalesced into shared chunks and large
+// replies are queued as chunks of their own without copying; flushTo() sends
+// as many chunks as possible with a single writev(). Queued bytes never move
+// until they are consumed, so they may be handed to an asynchronous send.
+class OutputBuffer {
+public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    // Maximum number of chunks handed to one writev()
+    static constexpr size_t MAX_IOV = 64;
+
+    void append(std::string&& data);
+    void append(std::string_view data);
+
+    bool empty() const;
+    // Bytes queued but not yet sent
+    size_t size() const;
+
+    // Write queued bytes to `fd` until everything is sent or the socket would
+    // block. A short write keeps the unsent tail at the head of the queue.
+    // Returns false if the socket would block, throws on other errors.
+    bool flushTo(int fd);
+
+    // Describe up to `max_iov` queued chunks, starting at the first unsent byte.
+    // Returns the number of entries filled.
+    size_t gather(iovec* iov, size_t max_iov);
+    // Drop `n` bytes that have been sent
+    void consume(size_t n);
+
+private:
+    std::deque<std::string> chunks_;
+    // Bytes of the front chunk already sent
+    size_t front_offset_ = 0;
+    size_t size_ = 0;
+    // Recycled coalescing chunk, so a steady stream of replies does not allocate
+    std::string spare_;
+
+    std::string& appendableChunk(size_t n);
+};
+
+} // namespace redis
@@ -1,37 +1,77 @@
 #pragma once
 
 #include <string>
-#include <sstream>
 #include <atomic>
-#include <queue>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include "buffer.hpp"
+#include "protocol.hpp"
 #include "types.hpp"
 
 namespace redis {
 
 // Forward declaration
-class Database;
+class EventLoop;
 
 // Client connection handler
 class ClientConnection {
 public:
-    ClientConnection(int socket_fd, Database& db);
+    ClientConnection(int socket_fd, EventLoop& loop, uint64_t id);
     ~ClientConnection();
     
+    // Read everything available from the socket and execute the commands
+    // (readiness-based backends). The loop sends the replies at the end of
+    // its iteration, unless they pile up past a high-water mark first.
     void handle();
+    // Execute the commands in `data`, which the backend has already received
+    // (completion-based backends); replies are left in output(). While the
+    // output is full the data is only queued, and receiving nothing runs
+    // what was queued.
+    void receive(std::string_view data);
+    OutputBuffer& output();
+    // Whether replies have piled up past the high-water mark, so that the
+    // backend should stop reading until the client drains them
+    bool outputFull() const;
     void close();
     bool isActive() const;
     bool hasPendingData() const;
+    void sendResponse();
+    // True once a protocol error has been answered and every queued reply
+    // has been sent; the backend then closes the connection
+    bool readyToClose() const;
+
+    int socket() const;
+    // Unique among the connections of one event loop, unlike the socket
+    // descriptor which is reused after close
+    uint64_t id() const;
+
+    // Reserve the position of a reply that another shard will produce. Replies
+    // are sent in the order their commands arrived, so later replies wait
+    // behind a reserved one until it is delivered.
+    uint64_t reserveReply();
+    void deliverReply(uint64_t slot, std::string reply);
     
 private:
     int socket_fd_;
-    std::stringstream buffer_;
-    Database& database_;
+    uint64_t id_;
+    InputBuffer input_;
+    RequestParser parser_;
+    EventLoop& loop_;
     std::atomic<bool> active_;
-    std::queue<std::string> response_queue_;
+    OutputBuffer output_;
+    // Replies queued behind a reserved slot; the front is slot first_deferred_slot_
+    std::deque<std::optional<std::string>> deferred_replies_;
+    uint64_t first_deferred_slot_;
+    // Set on a protocol error: the rest of the input is ignored and the
+    // connection is closed after the error reply
+    bool close_after_reply_;
     
-    std::string readRequest();
-    void sendResponse();
+    bool readRequest();
+    // Execute the complete commands in the input, leaving the rest queued
+    // once the output is full if `until_output_full`
+    void processInput(bool until_output_full = false);
+    void appendReply(std::string reply);
 };
 
 } // namespace redis
-
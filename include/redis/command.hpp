@@ -1,36 +1,150 @@
 #pragma once
 
 #include "types.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <vector>
-#include <unordered_map>
-#include <functional>
+#include <string_view>
 
 namespace redis {
 
-// Command parser and router
-class Command {
+class Storage;
+
+// How the replies of a multi-key command that was split across shards are
+// combined into the reply sent to the client
+enum class ReplyMerge {
+    NONE,   // the command cannot span shards
+    SUM,    // integer replies are added up
+    OK,     // every part replies +OK
+    ARRAY,  // arrays of bulk strings, one element per key, put back in key order
+    CONCAT, // arrays joined in shard order
+    ANY,    // one of the non-null bulk strings, picked at random
+};
+
+// Position of a command's keys, as in Redis' command table: keys are at
+// first, first + step, ... up to last, where a negative last counts from the
+// end of the arguments. first == 0 means the command takes no keys; with a
+// merge other than NONE such a command acts on the whole keyspace and runs
+// on every shard.
+struct KeySpec {
+    int first;
+    int last;
+    int step;
+    ReplyMerge merge;
+};
+
+// Runs a command on a shard's keyspace, given the arguments after the name
+using CommandHandler = std::string (*)(const CommandArgsSpan& args, Storage& storage);
+
+// An entry of the command table: what dispatch, the append-only file,
+// sharding and statistics need to know about a command
+struct Command {
+    enum Flag : uint32_t {
+        WRITE = 1 << 0,     // may modify the keyspace
+        READONLY = 1 << 1,  // never modifies the keyspace
+        FAST = 1 << 2,      // O(1) or O(log n), Redis' @fast
+        SERVER = 1 << 3,    // run by the event loop, not on a keyspace
+        DENYOOM = 1 << 4,   // may use more memory: evicts first, refused if over maxmemory
+    };
+
+    // Upper case; clients may send any case
+    std::string_view name;
+    // nullptr for SERVER commands
+    CommandHandler handler;
+    // Number of arguments including the name, or -n for at least n
+    int arity;
+    uint32_t flags;
+    KeySpec keys;
+
+    bool has(Flag flag) const {
+        return (flags & flag) != 0;
+    }
+
+    // Whether `count` arguments, the name included, satisfy the arity
+    bool acceptsArgs(size_t count) const {
+        return arity >= 0 ? count == static_cast<size_t>(arity) : count >= static_cast<size_t>(-arity);
+    }
+};
+
+// Hash of a command name with ASCII letters folded to upper case, so that
+// "get" and "GET" land in the same slot
+constexpr uint64_t hashCommandName(std::string_view name, uint64_t seed) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    for (char c : name) {
+        hash = (hash ^ (static_cast<uint8_t>(c) & 0xdf)) * 0x100000001b3ULL;
+    }
+    return hash * 0x9e3779b97f4a7c15ULL;
+}
+
+// Slot of a hash in a table of `slots` slots, a power of two: the top bits,
+// the best mixed ones
+constexpr size_t commandSlot(uint64_t hash, size_t slots) {
+    return static_cast<size_t>(hash >> (64 - std::countr_zero(slots)));
+}
+
+// The command at `slots[hash of name]`, if its name matches ignoring case
+const Command* findCommand(std::span<const Command> commands, std::span<const uint8_t> slots, uint64_t seed,
+                           std::string_view name);
+
+// A perfect hash table of commands built at compile time: a seed is searched
+// for that sends every name to a slot of its own, so a lookup is one hash of
+// the name and one comparison, with no allocation and no probing.
+template <size_t N>
+class CommandTable {
+    static constexpr uint8_t EMPTY = 0xff;
+    static constexpr size_t SLOTS = std::bit_ceil(std::max<size_t>(N * N / 8, 2 * N));
+    static_assert(N < EMPTY, "slots hold command indexes as bytes");
+
 public:
-    using CommandHandler = std::function<std::string(const CommandArgs&)>;
-    
-    Command();
-    ~Command();
-    
-    // Parse command string into command name and arguments
-    static std::pair<std::string, CommandArgs> parse(const std::string& input);
-    
-    // Register a command handler
-    void registerHandler(const std::string& command, CommandHandler handler);
-    
-    // Execute a command
-    std::string execute(const std::string& command, const CommandArgs& args);
-    
-    // Check if command exists
-    bool exists(const std::string& command) const;
-    
+    consteval explicit CommandTable(const std::array<Command, N>& commands) : commands_(commands), seed_(0), slots_{} {
+        for (const Command& command : commands_) {
+            if (std::ranges::any_of(command.name, [](char c) { return c >= 'a' && c <= 'z'; })) {
+                throw std::logic_error("command names must be upper case");
+            }
+        }
+        // With N * N / 8 or more slots a seed succeeds with probability
+        // about e^-4, so a few dozen seeds are tried
+        for (;; seed_++) {
+            slots_.fill(EMPTY);
+            size_t placed = 0;
+            for (; placed < N; placed++) {
+                uint8_t& slot = slots_[slotOf(commands_[placed].name)];
+                if (slot != EMPTY) {
+                    if (commands_[slot].name == commands_[placed].name) {
+                        throw std::logic_error("duplicate command name");
+                    }
+                    break;
+                }
+                slot = static_cast<uint8_t>(placed);
+            }
+            if (placed == N) {
+                return;
+            }
+        }
+    }
+
+    // The command named `name` in any case, or nullptr if there is none
+    const Command* find(std::string_view name) const {
+        return findCommand(commands_, slots_, seed_, name);
+    }
+
+    std::span<const Command> commands() const {
+        return commands_;
+    }
+
 private:
-    std::unordered_map<std::string, CommandHandler> handlers_;
+    std::array<Command, N> commands_;
+    uint64_t seed_;
+    std::array<uint8_t, SLOTS> slots_;
+
+    constexpr size_t slotOf(std::string_view name) const {
+        return commandSlot(hashCommandName(name, seed_), SLOTS);
+    }
 };
 
 } // namespace redis
-
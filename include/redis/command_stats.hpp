@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace redis {
+
+// A timestamp for timing commands: the TSC on x86-64, read in a few
+// nanoseconds, the steady clock elsewhere. Differences convert to
+// nanoseconds with nanosPerCycle().
+inline uint64_t readCycles() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Nanoseconds per readCycles() tick, measured against the steady clock on
+// first use. Assumes an invariant TSC, as every x86-64 CPU of the last decade
+// has.
+double nanosPerCycle();
+
+// Times the commands of one thread. Within a batch of commands that run back
+// to back, the end of one command is the start of the next, so a command
+// costs one readCycles() instead of two; where a hypervisor traps the TSC the
+// clock is most of what the statistics cost. Parsing the next command counts
+// in its time; handing a command to another shard interrupts the batch, so
+// that the next local command is timed from its own start.
+class CommandClock {
+public:
+    uint64_t start() {
+        return last_ != 0 ? last_ : readCycles();
+    }
+
+    // Ticks since `start`
+    uint64_t stop(uint64_t start) {
+        uint64_t end = readCycles();
+        if (batch_) {
+            last_ = end;
+        }
+        return end - start;
+    }
+
+    void beginBatch() {
+        batch_ = true;
+    }
+
+    void endBatch() {
+        batch_ = false;
+        last_ = 0;
+    }
+
+    // Something that is not part of the next command ran since the last one
+    void interrupt() {
+        last_ = 0;
+    }
+
+private:
+    bool batch_ = false;
+    // End of the last command of the batch, 0 if none
+    uint64_t last_ = 0;
+};
+
+// Counters written by one thread and read by any: a relaxed load and store
+// rather than an atomic increment, so an update costs what a plain one does
+inline void bump(std::atomic<uint64_t>& counter, uint64_t delta = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// Latency histogram in the style of HdrHistogram: every power of two of
+// nanoseconds is split into SUB_BUCKETS linear buckets, so a value is known
+// within 1/SUB_BUCKETS of itself at any magnitude, and recording one is a
+// few shifts. Recorded by one thread, read by any.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+    // Values of 2^MAX_BITS ns (about 69 s) and more share the last bucket
+    static constexpr unsigned MAX_BITS = 36;
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+    static size_t bucketOf(uint64_t nanos) {
+        nanos = std::min<uint64_t>(nanos, (uint64_t(1) << MAX_BITS) - 1);
+        unsigned shift = std::max<unsigned>(std::bit_width(nanos), SUB_BITS + 1) - (SUB_BITS + 1);
+        return (size_t(shift) << SUB_BITS) + static_cast<size_t>(nanos >> shift);
+    }
+
+    // The smallest value above those of `bucket`
+    static uint64_t bucketLimit(size_t bucket) {
+        unsigned shift = bucket < 2 * SUB_BUCKETS ? 0 : static_cast<unsigned>(bucket >> SUB_BITS) - 1;
+        return (static_cast<uint64_t>(bucket - (size_t(shift) << SUB_BITS)) + 1) << shift;
+    }
+
+    void record(uint64_t nanos) {
+        bump(counts_[bucketOf(nanos)]);
+    }
+
+    uint64_t count(size_t bucket) const {
+        return counts_[bucket].load(std::memory_order_relaxed);
+    }
+
+    uint64_t total() const;
+    // Add the counts of `other`, which may be recording meanwhile
+    void merge(const LatencyHistogram& other);
+    void reset();
+    // The bucket limit below which `percent` of the values fall, 0 if there
+    // are none
+    uint64_t percentile(double percent) const;
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+};
+
+// Calls, time and latency of every command of the command table, indexed by
+// the command's position in the table. Each Database keeps its own, written
+// by its thread only; INFO adds up those of every shard.
+class CommandStats {
+public:
+    struct Entry {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanos{0};
+        // Refused before running: wrong number of arguments, over maxmemory
+        std::atomic<uint64_t> rejected{0};
+        // Ran and replied with an error
+        std::atomic<uint64_t> failed{0};
+        LatencyHistogram latency;
+    };
+
+    explicit CommandStats(size_t commands);
+
+    // Count a call of command `index` that took `cycles` readCycles() ticks.
+    // Returns the duration in nanoseconds.
+    uint64_t record(size_t index, uint64_t cycles, bool failed) {
+        Entry& entry = entries_[index];
+        auto nanos = static_cast<uint64_t>(static_cast<double>(cycles) * nanos_per_cycle_);
+        bump(entry.calls);
+        bump(entry.nanos, nanos);
+        entry.latency.record(nanos);
+        if (failed) {
+            bump(entry.failed);
+        }
+        return nanos;
+    }
+
+    void reject(size_t index) {
+        bump(entries_[index].rejected);
+    }
+
+    const Entry& operator[](size_t index) const {
+        return entries_[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    // Calls of every command
+    uint64_t totalCalls() const;
+    // Add the counters of `other`, which may be recording meanwhile
+    void merge(const CommandStats& other);
+    // Zero every counter. Only safe while the writing thread is not running
+    // commands.
+    void reset();
+
+private:
+    std::unique_ptr<Entry[]> entries_;
+    size_t size_;
+    double nanos_per_cycle_;
+};
+
+} // namespace redis
@@ -1,8 +1,17 @@
 #pragma once
 
+#include "command.hpp"
+#include "command_stats.hpp"
+#include "latency_monitor.hpp"
+#include "slow_log.hpp"
 #include "storage.hpp"
 #include "types.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 
 namespace redis {
 
@@ -12,11 +21,81 @@ public:
     Database();
     ~Database();
     
-    // Execute a command and return response
-    std::string executeCommand(const CommandArgs& args);
+    // Execute a command and return response. The name is matched ignoring
+    // case. A DENYOOM command first evicts keys if memory use is over
+    // maxmemory, and is refused if it stays over.
+    std::string executeCommand(CommandArgsSpan args);
+
+    // Once enabled, every command that modifies the keyspace is appended to
+    // appendLog() in RESP, for the event loop to write to the append-only
+    // file. Relative expire times are recorded as absolute ones. When this
+    // database is shard `shard` of `shards`, FLUSHALL and FLUSHDB are
+    // logged as FLUSH_SHARD: every shard flushes at its own time, so writes
+    // to other shards may be logged before and after it.
+    void enableAppendLog(size_t shard = 0, size_t shards = 1);
+
+    // Logged instead of FLUSHALL by each shard of several:
+    // FLUSHSHARD <shard> <shards> deletes the keys that belong to `shard`
+    // when the keyspace is split into `shards`. Not a client command.
+    static constexpr std::string_view FLUSH_SHARD = "FLUSHSHARD";
+    std::string& appendLog();
+
+    // Remove expired keys within `budget`, see Storage::activeExpireCycle()
+    size_t activeExpireCycle(std::chrono::microseconds budget);
+    // Advance resizes of the keyspace tables, see Storage::incrementalRehash()
+    void incrementalRehash(std::chrono::microseconds budget);
+    // Move objects out of sparse slab runs, see Storage::activeDefragCycle()
+    size_t activeDefragCycle(std::chrono::microseconds interval);
+
+    // The keyspace, for loading and saving snapshots
+    Storage& storage();
+
+    // The command table entry named `name` in any case, or nullptr if the
+    // command is unknown
+    static const Command* command(std::string_view name);
+    // The command table, in the order CommandStats indexes it
+    static std::span<const Command> commandTable();
+
+    // Calls, time and latency of the commands this shard ran, readable from
+    // any thread. SERVER commands are recorded by the event loop that ran
+    // them.
+    CommandStats& stats();
+    const CommandStats& stats() const;
+    // Keys evicted to stay under maxmemory
+    uint64_t evictedKeys() const;
+    // Zero the statistics. Only on the shard's thread, between commands.
+    void resetStats();
+    // Times the commands of this shard. The event loop opens a batch around
+    // the commands of one read.
+    CommandClock& clock();
+    // Count a call of `command` that took `cycles` readCycles() ticks, and
+    // log it to the slow log and the latency monitor if it was slow enough
+    void recordCall(const Command& command, CommandArgsSpan args, uint64_t cycles, bool failed);
+
+    // The commands that ran for longer than the slow log threshold. Only
+    // read on the shard's thread, or while it is paused.
+    SlowLog& slowLog();
+    void setSlowLogSettings(const SlowLogSettings& settings);
+    // Where slow commands are reported as "command" and "fast-command"
+    // events; none by default
+    void setLatencyMonitor(LatencyMonitor* monitor);
     
 private:
     Storage storage_;
+    bool append_log_enabled_;
+    std::string append_log_;
+    // Which shard this is, for FLUSH_SHARD
+    size_t shard_;
+    size_t shards_;
+    CommandStats stats_;
+    CommandClock clock_;
+    std::atomic<uint64_t> evicted_keys_;
+    SlowLog slow_log_;
+    // Slow log threshold, UINT64_MAX when the log is disabled
+    uint64_t slow_log_nanos_;
+    LatencyMonitor* latency_monitor_;
+
+    void propagate(const Command& command, CommandArgsSpan args);
 };
 
 } // namespace redis
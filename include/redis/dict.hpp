@@ -0,0 +1,641 @@
+#pragma once
+
+#include "memory.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace redis {
+
+namespace dict_detail {
+    // Control byte of a slot. A full slot has the high bit set and holds the
+    // low 7 bits of its key's hash, so most mismatches are rejected without
+    // touching the key. EMPTY is zero, so a new table is zeroed memory the
+    // kernel hands out lazily rather than a multi-megabyte memset.
+    constexpr int8_t EMPTY = 0;
+    constexpr int8_t DELETED = 1;
+    constexpr size_t GROUP_SIZE = 16;
+
+    inline int8_t fullTag(size_t hash) {
+        return static_cast<int8_t>(0x80 | (hash & 0x7f));
+    }
+
+    // The control bytes of 16 consecutive slots, matched all at once. Bit i of
+    // a result is set if slot i matches.
+    class Group {
+    public:
+        explicit Group(const int8_t* ctrl) {
+#if defined(__SSE2__)
+            ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+            std::memcpy(ctrl_, ctrl, GROUP_SIZE);
+#endif
+        }
+
+        uint32_t match(int8_t tag) const {
+#if defined(__SSE2__)
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(tag))));
+#else
+            return matchIf([tag](int8_t c) { return c == tag; });
+#endif
+        }
+
+        uint32_t matchEmpty() const {
+            return match(EMPTY);
+        }
+
+        uint32_t matchFull() const {
+#if defined(__SSE2__)
+            // The sign bits are exactly the full slots
+            return static_cast<uint32_t>(_mm_movemask_epi8(ctrl_));
+#else
+            return matchIf([](int8_t c) { return c < 0; });
+#endif
+        }
+
+        uint32_t matchFree() const {
+            return ~matchFull() & 0xffff;
+        }
+
+    private:
+#if defined(__SSE2__)
+        __m128i ctrl_;
+#else
+        int8_t ctrl_[GROUP_SIZE];
+
+        template <typename Predicate>
+        uint32_t matchIf(Predicate predicate) const {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < GROUP_SIZE; i++) {
+                bits |= static_cast<uint32_t>(predicate(ctrl_[i])) << i;
+            }
+            return bits;
+        }
+#endif
+    };
+
+    inline uint64_t reverseBits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+        v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+        v = ((v >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((v & 0x0f0f0f0f0f0f0f0fULL) << 4);
+        return std::byteswap(v);
+    }
+}
+
+// Default entry of a Dict: the key is copied into a std::string next to the
+// value. Traits for other layouts provide the same members; an entry may also
+// hold its key inside the value, e.g. behind a pointer.
+template <typename V>
+struct DictTraits {
+    struct Entry {
+        std::string key;
+        V value;
+
+        template <typename... Args>
+        explicit Entry(std::string_view k, Args&&... args)
+            : key(k), value(std::forward<Args>(args)...) {}
+    };
+
+    static std::string_view key(const Entry& entry) {
+        return entry.key;
+    }
+
+    static V& value(Entry& entry) {
+        return entry.value;
+    }
+};
+
+// Hash table from string keys to V, looked up by string_view.
+//
+// Open addressing in the style of Swiss tables: slots come in groups of 16
+// with one control byte each, probed a group at a time with SIMD compares.
+// Like Redis' dict it resizes incrementally: a resize allocates the new table
+// and every insert or erase then moves one group of the old one, while
+// lookups check both. No operation pays for the whole table at once.
+//
+// Entries move when the table is modified, so pointers returned by find() and
+// tryEmplace() are valid until the next insert, erase or rehashStep().
+template <typename V, typename Traits = DictTraits<V>>
+class Dict {
+public:
+    using Entry = typename Traits::Entry;
+
+    Dict() = default;
+    ~Dict() {
+        clear();
+    }
+
+    Dict(const Dict&) = delete;
+    Dict& operator=(const Dict&) = delete;
+
+    Dict(Dict&& other) noexcept {
+        swap(other);
+    }
+
+    Dict& operator=(Dict&& other) noexcept {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(Dict& other) noexcept {
+        std::swap(tables_, other.tables_);
+        std::swap(rehash_group_, other.rehash_group_);
+    }
+
+    V* find(std::string_view key) {
+        return find(key, hashOf(key));
+    }
+
+    const V* find(std::string_view key) const {
+        return const_cast<Dict*>(this)->find(key);
+    }
+
+    // Batch lookups: hash() a batch of keys and prefetch() each hash before
+    // calling find() with it, so that the cache misses of the keys overlap
+    // instead of following one another
+    static size_t hash(std::string_view key) {
+        return hashOf(key);
+    }
+
+    // Start loading the control bytes and slots a find() of `hash` probes
+    // first. Only a hint: the dict may change before the find().
+    void prefetch(size_t hash) const {
+        for (const Table& table : tables_) {
+            if (table.size == 0) {
+                continue;
+            }
+            size_t base = ((hash >> 7) & (table.capacity / dict_detail::GROUP_SIZE - 1)) * dict_detail::GROUP_SIZE;
+            __builtin_prefetch(table.ctrl + base);
+            __builtin_prefetch(table.slots + base);
+        }
+    }
+
+    // find() of a key whose hash() is already known
+    V* find(std::string_view key, size_t hash) {
+        for (Table& table : tables_) {
+            size_t slot = table.find(key, hash);
+            if (slot != NPOS) {
+                return &Traits::value(table.slots[slot]);
+            }
+        }
+        return nullptr;
+    }
+
+    bool contains(std::string_view key) const {
+        return find(key) != nullptr;
+    }
+
+    // Insert the key with a value built from `args` unless it is present.
+    // Returns the value and whether it was inserted.
+    template <typename... Args>
+    std::pair<V*, bool> tryEmplace(std::string_view key, Args&&... args) {
+        if (isRehashing()) {
+            rehashStep();
+        }
+        size_t hash = hashOf(key);
+        for (Table& table : tables_) {
+            size_t slot = table.find(key, hash);
+            if (slot != NPOS) {
+                return {&Traits::value(table.slots[slot]), false};
+            }
+        }
+
+        Table* target = &tables_[isRehashing() ? 1 : 0];
+        size_t slot = target->findFree(hash);
+        if (slot == NPOS || (target->ctrl[slot] == dict_detail::EMPTY && target->growth_left == 0)) {
+            resize(size());
+            target = &tables_[isRehashing() ? 1 : 0];
+            slot = target->findFree(hash);
+        }
+        target->emplaceAt(slot, hash, key, std::forward<Args>(args)...);
+        return {&Traits::value(target->slots[slot]), true};
+    }
+
+    bool erase(std::string_view key) {
+        if (isRehashing()) {
+            rehashStep();
+        }
+        size_t hash = hashOf(key);
+        for (Table& table : tables_) {
+            size_t slot = table.find(key, hash);
+            if (slot != NPOS) {
+                table.eraseAt(slot);
+                shrinkIfNeeded();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // erase() that hands the value over instead of destroying it, nullopt if
+    // the key is absent
+    std::optional<V> take(std::string_view key) {
+        if (isRehashing()) {
+            rehashStep();
+        }
+        size_t hash = hashOf(key);
+        for (Table& table : tables_) {
+            size_t slot = table.find(key, hash);
+            if (slot != NPOS) {
+                std::optional<V> value(std::move(Traits::value(table.slots[slot])));
+                table.eraseAt(slot);
+                shrinkIfNeeded();
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    size_t size() const {
+        return tables_[0].size + tables_[1].size;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Slots allocated across both tables
+    size_t capacity() const {
+        return tables_[0].capacity + tables_[1].capacity;
+    }
+
+    // Bytes of the tables themselves: slots and control bytes, not what the
+    // entries point to
+    size_t memoryUsage() const {
+        return capacity() * (sizeof(Entry) + 1);
+    }
+
+    // Size an empty dict for `count` entries, so that filling it, e.g. while
+    // loading a snapshot, never resizes. Does nothing if the dict has a table.
+    void reserve(size_t count) {
+        if (capacity() != 0) {
+            return;
+        }
+        size_t slot_count = dict_detail::GROUP_SIZE;
+        while (slot_count * MAX_LOAD_NUM / MAX_LOAD_DEN < count) {
+            slot_count *= 2;
+        }
+        tables_[0].allocate(slot_count);
+    }
+
+    void clear() {
+        tables_[0].release();
+        tables_[1].release();
+        rehash_group_ = 0;
+    }
+
+    bool isRehashing() const {
+        return tables_[1].capacity != 0;
+    }
+
+    // Move `groups` groups of the old table into the new one. Returns false
+    // once there is nothing left to move.
+    bool rehashStep(size_t groups = 1) {
+        if (!isRehashing()) {
+            return false;
+        }
+        Table& from = tables_[0];
+        Table& to = tables_[1];
+        size_t total_groups = from.capacity / dict_detail::GROUP_SIZE;
+        for (; groups > 0 && rehash_group_ < total_groups; groups--, rehash_group_++) {
+            size_t base = rehash_group_ * dict_detail::GROUP_SIZE;
+            dict_detail::Group group(from.ctrl + base);
+            for (uint32_t full = group.matchFull(); full != 0; full &= full - 1) {
+                size_t slot = base + std::countr_zero(full);
+                Entry& entry = from.slots[slot];
+                size_t hash = hashOf(Traits::key(entry));
+                to.emplaceAt(to.findFree(hash), hash, std::move(entry));
+                std::destroy_at(&entry);
+                // A tombstone, not EMPTY: lookups of keys displaced into later
+                // groups still have to probe past this one
+                from.ctrl[slot] = dict_detail::DELETED;
+                from.size--;
+            }
+        }
+        if (rehash_group_ < total_groups) {
+            return true;
+        }
+        from.release();
+        std::swap(tables_[0], tables_[1]);
+        rehash_group_ = 0;
+        return false;
+    }
+
+    // Call `fn(key, value)` for every entry. `fn` must not modify the dict.
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        for (Table& table : tables_) {
+            for (size_t group = 0; group < table.capacity / dict_detail::GROUP_SIZE; group++) {
+                table.visitGroup(group, fn);
+            }
+        }
+    }
+
+    // Visit the entries of one cursor position and return the next cursor, 0
+    // when the scan is complete. Like Redis' dictScan the cursor counts groups
+    // with its bits reversed, so positions already visited stay visited when
+    // the table doubles or halves. A position stands for the entries whose
+    // home group it is, wherever probing placed them, so an entry present
+    // for the whole scan is reported at least once even across resizes; it
+    // may be reported twice. `fn` must not modify the dict.
+    template <typename Fn>
+    size_t scan(size_t cursor, Fn&& fn) {
+        if (empty()) {
+            return 0;
+        }
+        if (!isRehashing()) {
+            size_t mask = tables_[0].capacity / dict_detail::GROUP_SIZE - 1;
+            tables_[0].visitHome(cursor & mask, fn);
+            return nextCursor(cursor, mask);
+        }
+        Table* small = &tables_[0];
+        Table* large = &tables_[1];
+        if (small->capacity > large->capacity) {
+            std::swap(small, large);
+        }
+        size_t small_mask = small->capacity / dict_detail::GROUP_SIZE - 1;
+        size_t large_mask = large->capacity / dict_detail::GROUP_SIZE - 1;
+        small->visitHome(cursor & small_mask, fn);
+        // Then every group of the larger table that expands the small one
+        do {
+            large->visitHome(cursor & large_mask, fn);
+            cursor = nextCursor(cursor, large_mask);
+        } while (cursor & (small_mask ^ large_mask));
+        return cursor;
+    }
+
+    // A key picked using the bits of `random`, nullopt if the dict is empty.
+    // As with Redis' dictGetRandomKey, keys after runs of empty groups are
+    // somewhat more likely than others.
+    std::optional<std::string_view> randomKey(uint64_t random) const {
+        if (empty()) {
+            return std::nullopt;
+        }
+        // While rehashing, each table in proportion to its entries
+        const Table& table = random % size() < tables_[0].size ? tables_[0] : tables_[1];
+        size_t mask = table.capacity / dict_detail::GROUP_SIZE - 1;
+        size_t group = (random >> 24) & mask;
+        for (;; group = (group + 1) & mask) {
+            uint32_t full = dict_detail::Group(table.ctrl + group * dict_detail::GROUP_SIZE).matchFull();
+            if (full == 0) {
+                continue;
+            }
+            for (size_t skip = (random >> 16) % std::popcount(full); skip > 0; skip--) {
+                full &= full - 1;
+            }
+            return Traits::key(table.slots[group * dict_detail::GROUP_SIZE + std::countr_zero(full)]);
+        }
+    }
+
+    // Call `fn(key, value)` for up to `count` entries of consecutive slots
+    // from one picked using the bits of `random`, as Redis' dictGetSomeKeys:
+    // a cheap sample for eviction rather than a uniform one. `fn` must not
+    // modify the dict.
+    template <typename Fn>
+    void sample(uint64_t random, size_t count, Fn&& fn) {
+        if (empty()) {
+            return;
+        }
+        Table& table = random % size() < tables_[0].size ? tables_[0] : tables_[1];
+        size_t groups = table.capacity / dict_detail::GROUP_SIZE;
+        size_t start = (random >> 24) & (table.capacity - 1);
+        size_t group = start / dict_detail::GROUP_SIZE;
+        uint32_t offset = start % dict_detail::GROUP_SIZE;
+        // The first group is visited again at the end for the slots before
+        // the start
+        for (size_t visited = 0; visited <= groups && count > 0; visited++, group = (group + 1) % groups) {
+            size_t base = group * dict_detail::GROUP_SIZE;
+            uint32_t full = dict_detail::Group(table.ctrl + base).matchFull();
+            if (visited == 0) {
+                full &= ~0u << offset;
+            } else if (visited == groups) {
+                full &= (1u << offset) - 1;
+            }
+            for (; full != 0 && count > 0; full &= full - 1, count--) {
+                Entry& entry = table.slots[base + std::countr_zero(full)];
+                fn(Traits::key(entry), Traits::value(entry));
+            }
+        }
+    }
+
+private:
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+    // Resizes start when 7/8 of the slots are taken
+    static constexpr size_t MAX_LOAD_NUM = 7;
+    static constexpr size_t MAX_LOAD_DEN = 8;
+
+    struct Table {
+        int8_t* ctrl = nullptr;
+        Entry* slots = nullptr;
+        size_t capacity = 0;
+        size_t size = 0;
+        // EMPTY slots that may still be filled before the load limit
+        size_t growth_left = 0;
+
+        Table() = default;
+        Table(Table&& other) noexcept { *this = std::move(other); }
+        Table& operator=(Table&& other) noexcept {
+            std::swap(ctrl, other.ctrl);
+            std::swap(slots, other.slots);
+            std::swap(capacity, other.capacity);
+            std::swap(size, other.size);
+            std::swap(growth_left, other.growth_left);
+            return *this;
+        }
+        ~Table() { release(); }
+
+        void allocate(size_t slot_count) {
+            ctrl = static_cast<int8_t*>(memory::allocateZeroed(slot_count));
+            slots = static_cast<Entry*>(memory::allocate(slot_count * sizeof(Entry)));
+            capacity = slot_count;
+            size = 0;
+            growth_left = slot_count * MAX_LOAD_NUM / MAX_LOAD_DEN;
+        }
+
+        void release() {
+            if (slots == nullptr) {
+                return;
+            }
+            // A table drained by a rehash has nothing left to destroy
+            for (size_t group = 0; size != 0 && group < capacity / dict_detail::GROUP_SIZE; group++) {
+                size_t base = group * dict_detail::GROUP_SIZE;
+                dict_detail::Group control(ctrl + base);
+                for (uint32_t full = control.matchFull(); full != 0; full &= full - 1) {
+                    std::destroy_at(&slots[base + std::countr_zero(full)]);
+                    size--;
+                }
+            }
+            memory::release(slots);
+            memory::release(ctrl);
+            slots = nullptr;
+            ctrl = nullptr;
+            capacity = size = growth_left = 0;
+        }
+
+        // Probe from the key's home group; a group with an EMPTY slot ends the
+        // probe sequence, because inserts never skip a free slot
+        size_t find(std::string_view key, size_t hash) const {
+            if (size == 0) {
+                return NPOS;
+            }
+            size_t mask = capacity / dict_detail::GROUP_SIZE - 1;
+            size_t group = (hash >> 7) & mask;
+            int8_t tag = dict_detail::fullTag(hash);
+            for (size_t probe = 0; probe <= mask; probe++) {
+                size_t base = group * dict_detail::GROUP_SIZE;
+                dict_detail::Group control(ctrl + base);
+                for (uint32_t match = control.match(tag); match != 0; match &= match - 1) {
+                    size_t slot = base + std::countr_zero(match);
+                    if (Traits::key(slots[slot]) == key) {
+                        return slot;
+                    }
+                }
+                if (control.matchEmpty() != 0) {
+                    return NPOS;
+                }
+                group = (group + 1) & mask;
+            }
+            return NPOS;
+        }
+
+        size_t findFree(size_t hash) const {
+            if (capacity == 0) {
+                return NPOS;
+            }
+            size_t mask = capacity / dict_detail::GROUP_SIZE - 1;
+            size_t group = (hash >> 7) & mask;
+            for (size_t probe = 0; probe <= mask; probe++) {
+                uint32_t free = dict_detail::Group(ctrl + group * dict_detail::GROUP_SIZE).matchFree();
+                if (free != 0) {
+                    return group * dict_detail::GROUP_SIZE + std::countr_zero(free);
+                }
+                group = (group + 1) & mask;
+            }
+            return NPOS;
+        }
+
+        template <typename... Args>
+        void emplaceAt(size_t slot, size_t hash, Args&&... args) {
+            std::construct_at(&slots[slot], std::forward<Args>(args)...);
+            if (ctrl[slot] == dict_detail::EMPTY) {
+                growth_left--;
+            }
+            ctrl[slot] = dict_detail::fullTag(hash);
+            size++;
+        }
+
+        void eraseAt(size_t slot) {
+            std::destroy_at(&slots[slot]);
+            size--;
+            // A group that still has an EMPTY slot has never been probed past,
+            // so the slot can become EMPTY again instead of a tombstone
+            size_t base = slot - slot % dict_detail::GROUP_SIZE;
+            if (dict_detail::Group(ctrl + base).matchEmpty() != 0) {
+                ctrl[slot] = dict_detail::EMPTY;
+                growth_left++;
+            } else {
+                ctrl[slot] = dict_detail::DELETED;
+            }
+        }
+
+        // Visit the entries whose home group is `group`: probing places them
+        // from there up to the first group with an EMPTY slot
+        template <typename Fn>
+        void visitHome(size_t group, Fn& fn) {
+            size_t mask = capacity / dict_detail::GROUP_SIZE - 1;
+            for (size_t probe = group, count = 0; count <= mask; probe = (probe + 1) & mask, count++) {
+                size_t base = probe * dict_detail::GROUP_SIZE;
+                dict_detail::Group control(ctrl + base);
+                for (uint32_t full = control.matchFull(); full != 0; full &= full - 1) {
+                    Entry& entry = slots[base + std::countr_zero(full)];
+                    if (((hashOf(Traits::key(entry)) >> 7) & mask) == group) {
+                        fn(Traits::key(entry), Traits::value(entry));
+                    }
+                }
+                if (control.matchEmpty() != 0) {
+                    return;
+                }
+            }
+        }
+
+        template <typename Fn>
+        void visitGroup(size_t group, Fn& fn) {
+            size_t base = group * dict_detail::GROUP_SIZE;
+            dict_detail::Group control(ctrl + base);
+            for (uint32_t full = control.matchFull(); full != 0; full &= full - 1) {
+                Entry& entry = slots[base + std::countr_zero(full)];
+                fn(Traits::key(entry), Traits::value(entry));
+            }
+        }
+    };
+
+    Table tables_[2];
+    // Next group of tables_[0] to move while rehashing
+    size_t rehash_group_ = 0;
+
+    static size_t hashOf(std::string_view key) {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    static size_t nextCursor(size_t cursor, size_t mask) {
+        cursor |= ~mask;
+        cursor = dict_detail::reverseBits(cursor);
+        cursor++;
+        return dict_detail::reverseBits(cursor);
+    }
+
+    // Smallest table that holds `count` entries at half the maximum load, so
+    // a resize leaves room for the inserts made while it is in progress. A
+    // full table doubles.
+    static size_t capacityFor(size_t count) {
+        size_t capacity = dict_detail::GROUP_SIZE;
+        while (capacity * MAX_LOAD_NUM / MAX_LOAD_DEN < count * 2) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void resize(size_t count) {
+        if (tables_[0].capacity == 0) {
+            tables_[0].allocate(capacityFor(count));
+            return;
+        }
+        // Rare: the previous resize has not finished. Complete it first.
+        while (rehashStep(SIZE_MAX)) {
+        }
+        tables_[1].allocate(capacityFor(count));
+        rehash_group_ = 0;
+        rehashStep();
+    }
+
+    void shrinkIfNeeded() {
+        const Table& table = tables_[0];
+        if (isRehashing() || table.capacity <= dict_detail::GROUP_SIZE) {
+            return;
+        }
+        if (table.size == 0) {
+            clear();
+        } else if (table.size * MAX_LOAD_DEN < table.capacity) {
+            resize(table.size);
+        }
+    }
+};
+
+} // namespace redis
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "event_loop.hpp"
+#include <unordered_set>
+#include <vector>
+
+namespace redis {
+
+// Event loop on edge-triggered epoll and nonblocking read/write
+class EpollEventLoop : public EventLoop {
+public:
+    EpollEventLoop(size_t index, const std::vector<std::unique_ptr<EventLoop>>& shards, Persistence& persistence);
+    ~EpollEventLoop() override;
+
+    void listen(const std::string& host, int port) override;
+    void run(const std::atomic<bool>& running, int stop_fd) override;
+
+protected:
+    void flush(int client_socket, ClientConnection& connection) override;
+    std::string_view backendName() const override;
+
+private:
+    int epoll_fd_;
+    // Connections with replies to send at the end of the iteration, after the
+    // append-only file has been written. May hold duplicates.
+    std::vector<int> pending_writes_;
+    // Connections registered for EPOLLOUT because a send came up short
+    std::unordered_set<int> watching_writes_;
+
+    void acceptConnections();
+    void handleClient(int client_socket);
+    void sendPendingWrites();
+    void watchWrites(int client_socket, bool watch);
+};
+
+} // namespace redis
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "client_connection.hpp"
+#include "command_stats.hpp"
+#include "latency_monitor.hpp"
+#include "database.hpp"
+#include "mailbox.hpp"
+#include "persistence.hpp"
+#include "types.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+namespace redis {
+
+// Network backend the event loops are built on
+enum class Backend {
+    EPOLL,
+    IO_URING,
+};
+
+// A single-threaded event loop that owns its listening socket, its client
+// connections and one shard of the keyspace. With several loops every key
+// belongs to exactly one shard; commands on keys of another shard are
+// forwarded to its loop through a lock-free mailbox. Subclasses provide the
+// network I/O.
+class EventLoop {
+public:
+    EventLoop(size_t index, const std::vector<std::unique_ptr<EventLoop>>& shards, Persistence& persistence);
+    virtual ~EventLoop();
+
+    static std::unique_ptr<EventLoop> create(Backend backend, size_t index,
+                                             const std::vector<std::unique_ptr<EventLoop>>& shards,
+                                             Persistence& persistence);
+
+    // Create the listening socket (SO_REUSEPORT, so every loop can bind the
+    // same port) and whatever the backend needs to watch it
+    virtual void listen(const std::string& host, int port) = 0;
+
+    // Run until `running` is cleared. `stop_fd` becomes readable on shutdown.
+    virtual void run(const std::atomic<bool>& running, int stop_fd) = 0;
+
+    // Queue a task to run on this loop's thread. Safe to call from any thread.
+    void post(std::function<void()> task);
+
+    // Execute a command received by one of this loop's connections. Returns the
+    // reply if it was produced locally. Otherwise the command has been forwarded
+    // to the shards owning its keys and the reply is delivered to the connection
+    // once they answer.
+    std::optional<std::string> execute(ClientConnection& connection, CommandArgsSpan args);
+
+    Database& database();
+
+    // Where this loop reports iterations, cron jobs and commands that took
+    // longer than its threshold, and that LATENCY LATEST and HISTORY read.
+    // Call before run().
+    void setLatencyMonitor(LatencyMonitor* monitor);
+
+    // Shard that owns `key` among `shards` shards
+    static size_t shardOf(std::string_view key, size_t shards);
+
+    // The parts of a multi-key command, one per shard holding some of its
+    // keys (empty for the others). Each part is the command with that
+    // shard's key groups only.
+    static std::vector<CommandArgs> splitByShard(const KeySpec& spec, CommandArgsSpan args, size_t shards);
+
+    // Write the commands this loop executed since the last call to the
+    // append-only file, then release the replies other loops are waiting for.
+    // Runs at the end of every iteration, before any reply is sent.
+    void flushAppendOnly();
+
+protected:
+    // The backends wait at most this long (ms) so that cron() runs on time
+    static constexpr int CRON_INTERVAL_MS = 100;
+
+    size_t index_;
+    const std::vector<std::unique_ptr<EventLoop>>& shards_;
+    int server_socket_;
+    // Readable while tasks are waiting in the mailbox
+    int wakeup_fd_;
+    std::unordered_map<int, std::unique_ptr<ClientConnection>> connections_;
+    // Connections accepted and closed so far, read by INFO on any loop
+    std::atomic<uint64_t> next_connection_id_;
+    std::atomic<uint64_t> closed_connections_;
+    int port_;
+
+    // Also remembers the port for INFO
+    int listenSocket(const std::string& host, int port);
+    static void setNonBlocking(int socket_fd);
+
+    // Run the tasks posted by other loops once wakeup_fd_ is readable
+    void runTasks();
+
+    // Periodic work, called after every wait: once per CRON_INTERVAL_MS runs
+    // the active expire cycle, the incremental rehash and the active defrag
+    // of this loop's shard and reaps a finished BGSAVE or BGREWRITEAOF child
+    void cron();
+
+    // Called by the backends once the wait for I/O returns and once the
+    // iteration is over, to report iterations that kept the loop's clients
+    // waiting as "event-loop" events
+    void iterationStarted();
+    void iterationFinished();
+
+    // Send what a connection has queued once the commands of this iteration
+    // are in the append-only file
+    virtual void flush(int client_socket, ClientConnection& connection) = 0;
+
+    // multiplexing_api of INFO
+    virtual std::string_view backendName() const = 0;
+
+private:
+    // Cron runs over which instantaneous_ops_per_sec is averaged, as in Redis
+    static constexpr size_t OPS_SAMPLES = 16;
+
+    // Set by producers that already signalled wakeup_fd_, so a burst of posts
+    // costs one eventfd write
+    std::atomic<bool> wakeup_pending_;
+    Mailbox mailbox_;
+    Database database_;
+    std::chrono::steady_clock::time_point last_cron_;
+    // Commands per second over each of the last OPS_SAMPLES cron runs
+    std::array<uint64_t, OPS_SAMPLES> ops_samples_;
+    size_t ops_sample_;
+    uint64_t last_calls_;
+    std::atomic<uint64_t> ops_per_sec_;
+    LatencyMonitor* latency_monitor_;
+    // When the current iteration started, if the monitor is enabled
+    std::chrono::steady_clock::time_point iteration_start_;
+    Persistence& persistence_;
+    // BGSAVE or BGREWRITEAOF child started by this loop, or -1
+    enum class ChildJob {
+        SAVE,
+        REWRITE,
+    };
+    pid_t child_;
+    ChildJob child_job_;
+    // Replies to other loops held back until the commands they answer are in
+    // the append-only file
+    std::vector<std::pair<EventLoop*, Mailbox::Task>> held_replies_;
+
+    void deliver(int client_socket, uint64_t connection_id, uint64_t slot, std::string reply);
+    size_t shardOf(std::string_view key) const;
+
+    // Post a reply task to the loop that forwarded a command, once the
+    // append-only file holds the command
+    void replyTo(EventLoop* origin, Mailbox::Task task);
+
+    // The SERVER commands of the table: SAVE, BGSAVE, LASTSAVE and
+    // BGREWRITEAOF, which act on every shard, INFO, CONFIG, SLOWLOG and
+    // LATENCY.
+    // Their calls count in this loop's command statistics.
+    // Returns the reply, or std::nullopt if the command went to every shard
+    // and the reply is delivered once they answer.
+    std::optional<std::string> executeServerCommand(ClientConnection& connection, const Command& command,
+                                                    CommandArgsSpan args);
+    std::optional<std::string> runServerCommand(ClientConnection& connection, const Command& command,
+                                                CommandArgsSpan args);
+    // INFO [section ...]: server, clients, memory and stats by default,
+    // commandstats and latencystats on request, process-wide
+    std::string info(CommandArgsSpan args);
+    // CONFIG RESETSTAT, run by every shard on its own thread
+    std::optional<std::string> config(ClientConnection& connection, CommandArgsSpan args);
+    // SLOWLOG GET [count] | LEN | RESET, over the slow logs of every shard,
+    // each read or reset by its own loop
+    std::optional<std::string> slowLog(ClientConnection& connection, CommandArgsSpan args);
+    // LATENCY HISTOGRAM [command ...] | LATEST | HISTORY event |
+    // RESET [event ...]
+    std::string latency(CommandArgsSpan args);
+    // Run `job`, reporting it to the latency monitor as `event` if slow
+    void monitored(std::string_view event, const std::function<void()>& job);
+    // The command statistics of every shard added up
+    CommandStats commandStats() const;
+    // Record the rate of commands since the last cron run
+    void sampleOps(std::chrono::steady_clock::time_point now);
+    std::string save();
+    std::string backgroundSave();
+    std::string rewriteAppendOnly();
+    // Fork a child that runs `job` and exits with status 0 unless it throws.
+    // `prepare` runs just before the fork, with every shard paused. Returns
+    // the child's pid or -1.
+    pid_t forkChild(const std::function<void()>& prepare, const std::function<void()>& job);
+    // Handle the exit of the child, waiting for it if `block` is set
+    void reapChild(bool block = false);
+    // Run `fn` while every other loop is parked in a task, so that no shard
+    // changes under it and a fork() sees every shard in a consistent state.
+    // Returns false without running `fn` if another loop is pausing the
+    // shards: each would wait for the other to park.
+    [[nodiscard]] bool withShardsPaused(const std::function<void()>& fn);
+    std::vector<Storage*> storages() const;
+    void forward(ClientConnection& connection, size_t shard, CommandArgsSpan args);
+    // Run `parts[shard]` on every shard with a non-empty part, then reply with
+    // `merge` of the replies, indexed by shard (empty for shards without a
+    // part)
+    using MergeFn = std::function<std::string(const std::vector<std::string>& replies)>;
+    void fanOut(ClientConnection& connection, std::vector<CommandArgs> parts, MergeFn merge);
+    // Run `tasks[shard]` on the thread of every shard with a task, then reply
+    // with `merge` of their results, indexed by shard (empty for shards
+    // without a task)
+    using ShardTask = std::function<std::string(EventLoop& shard)>;
+    void fanOut(ClientConnection& connection, std::vector<ShardTask> tasks, MergeFn merge);
+    // SCAN over every shard, one after another
+    std::optional<std::string> scan(ClientConnection& connection, CommandArgsSpan args);
+};
+
+} // namespace redis
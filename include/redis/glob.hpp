@@ -0,0 +1,48 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// A glob-style pattern as KEYS and SCAN MATCH take it: `*` matches any run of
+// bytes, `?` any one byte, `[abc]`, `[a-z]` and `[^a-z]` a byte of a class,
+// and `\` escapes the next byte. The pattern is compiled once into literal
+// runs, classes and wildcards, so that matching many keys does not parse it
+// again; patterns that are a literal, a prefix or `*` match without the
+// general matcher.
+class GlobPattern {
+public:
+    explicit GlobPattern(std::string_view pattern);
+
+    bool matches(std::string_view text) const;
+
+    // Whether every text matches, as for "*"
+    bool matchesAll() const {
+        return kind_ == Kind::ALL;
+    }
+
+private:
+    enum class Kind : uint8_t { ALL, LITERAL, PREFIX, GENERAL };
+
+    struct Token {
+        enum Type : uint8_t { LITERAL, ANY, STAR, CLASS };
+        Type type;
+        // LITERAL: bytes of literals_; CLASS: index into classes_
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    Kind kind_;
+    std::vector<Token> tokens_;
+    // Unescaped bytes of the literal tokens
+    std::string literals_;
+    std::vector<std::bitset<256>> classes_;
+
+    void addLiteral(char c);
+};
+
+} // namespace redis
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "dict.hpp"
+#include "object.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace redis {
+
+// When a hash leaves the packed encoding for a table, as Redis'
+// hash-max-listpack-entries and hash-max-listpack-value
+struct HashLimits {
+    size_t max_packed_entries = 128;
+    size_t max_packed_value = 64;
+};
+
+// A hash of fields to string values. Small hashes are packed: the fields and
+// values back to back in one buffer, each a varint length and its bytes, and
+// found by a linear scan. A hash that grows past its HashLimits converts to a
+// table of one Object per field, and stays one.
+class Hash {
+public:
+    Hash();
+    ~Hash();
+
+    Hash(const Hash&) = delete;
+    Hash& operator=(const Hash&) = delete;
+
+    size_t size() const;
+
+    bool packed() const {
+        return table_ == nullptr;
+    }
+
+    std::optional<StringValue> get(std::string_view field) const;
+    // Set a field, converting to a table first if the hash outgrows `limits`.
+    // Returns true if the field is new.
+    bool set(std::string_view field, std::string_view value, const HashLimits& limits);
+    bool erase(std::string_view field);
+
+    // Call `fn(field, value)` for every field. The value is only valid during
+    // the call.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (table_ != nullptr) {
+            table_->forEach([&fn](std::string_view field, const Object::Ptr& value) {
+                fn(field, value->string().view());
+            });
+            return;
+        }
+        const char* entry = packed_;
+        const char* end = packed_ + packed_size_;
+        while (entry < end) {
+            std::string_view field = readString(entry);
+            std::string_view value = readString(entry);
+            fn(field, value);
+        }
+    }
+
+    // Bytes allocated for the fields and values
+    size_t memoryUsage() const;
+
+private:
+    // Table entries are a single pointer; the field is the object's key
+    struct FieldTraits {
+        struct Entry {
+            Object::Ptr object;
+            Entry(std::string_view, Object::Ptr&& o) : object(std::move(o)) {}
+        };
+        static std::string_view key(const Entry& entry) { return entry.object->key(); }
+        static Object::Ptr& value(Entry& entry) { return entry.object; }
+    };
+    using Table = Dict<Object::Ptr, FieldTraits>;
+
+    char* packed_;
+    uint32_t packed_size_;
+    uint32_t packed_capacity_;
+    // Fields of the packed encoding
+    uint32_t packed_count_;
+    // Set once the hash is converted; mutable for forEach(), which does not
+    // modify it
+    mutable std::unique_ptr<Table> table_;
+
+    // Read a varint-prefixed string at `entry` and advance past it
+    static std::string_view readString(const char*& entry);
+    // Start of the packed entry of `field`, or nullptr
+    const char* findPacked(std::string_view field) const;
+    // Replace `size` bytes at `offset` of the packed buffer with
+    // `replacement` uninitialized bytes and return where they start
+    char* splicePacked(size_t offset, size_t size, size_t replacement);
+    void convert();
+};
+
+} // namespace redis
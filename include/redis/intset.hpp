@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace redis {
+
+// A set of integers kept as a sorted array in one allocation, every element
+// the same width: 2, 4 or 8 bytes, the smallest that fits all of them. The
+// array is widened when an element needs more and never narrowed. Lookups
+// are binary searches and inserts move the elements after the new one.
+class IntSet {
+public:
+    IntSet();
+    ~IntSet();
+
+    IntSet(const IntSet&) = delete;
+    IntSet& operator=(const IntSet&) = delete;
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Bytes per element
+    size_t width() const {
+        return width_;
+    }
+
+    bool contains(int64_t value) const;
+    // Return true if the value is new
+    bool insert(int64_t value);
+    bool erase(int64_t value);
+    // Remove every element and release the array
+    void clear();
+    // The element at `index` in ascending order
+    int64_t at(size_t index) const;
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i < size_; i++) {
+            fn(at(i));
+        }
+    }
+
+    // Append the elements of both sets to `out` in ascending order
+    void intersect(const IntSet& other, std::vector<int64_t>& out) const;
+    // Append the elements of `sorted`, ascending without duplicates, that are
+    // in the set to `out` in ascending order
+    void intersect(std::span<const int64_t> sorted, std::vector<int64_t>& out) const;
+
+    // Bytes allocated for the elements
+    size_t memoryUsage() const;
+
+private:
+    char* data_;
+    uint32_t size_;
+    uint32_t capacity_;
+    uint8_t width_;
+
+    // Index of the first element not less than `value`, found in a set that
+    // is known to have a width of at least the value's
+    size_t lowerBound(int64_t value) const;
+    // Rewrite the elements with `width` bytes each
+    void widen(size_t width);
+    void reserve(size_t count);
+};
+
+} // namespace redis
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <linux/io_uring.h>
+
+namespace redis {
+
+// Minimal io_uring wrapper on the raw system calls: one submission/completion
+// ring pair plus one group of provided buffers that multishot receives pick
+// their buffers from. Not thread-safe; it belongs to one event loop.
+class IoUring {
+public:
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Get a zeroed submission entry, submitting queued ones until a slot is
+    // free if the ring is full
+    io_uring_sqe* getSqe();
+    // Whether the next getSqe() has to submit first
+    bool submissionQueueFull();
+
+    // Submit queued entries and wait up to `timeout_ms` for a completion, all
+    // in one io_uring_enter()
+    void submitAndWait(int timeout_ms);
+
+    // Call `handler` for every available completion and release them, the
+    // ones set aside by getSqe() first. Completions of buffer hand-backs are
+    // consumed here.
+    template <typename Handler>
+    size_t forEachCompletion(Handler&& handler);
+
+    // Provide `count` buffers of `size` bytes as buffer group `group` for
+    // IOSQE_BUFFER_SELECT receives
+    void setupBuffers(uint16_t group, unsigned count, unsigned size);
+    std::string_view buffer(uint16_t id, size_t length) const;
+    // Hand a buffer back to the kernel once its data has been consumed. The
+    // request rides along with the next submission.
+    void recycleBuffer(uint16_t id);
+
+private:
+    int ring_fd_;
+    io_uring_params params_;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned sq_mask_;
+    unsigned sqe_tail_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+    // Completions taken off a full completion queue so that submissions can go on
+    std::deque<io_uring_cqe> set_aside_;
+
+    std::unique_ptr<char[]> buffers_;
+    uint16_t buffer_group_;
+    unsigned buffer_size_;
+
+    unsigned pendingSubmissions();
+    void setCompletionsAside();
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size);
+    void provideBuffers(uint16_t first_id, unsigned count);
+
+    // user_data of buffer hand-backs; the loop's own tags never have it
+    static constexpr uint64_t PROVIDE_BUFFERS_TAG = ~uint64_t(0);
+};
+
+template <typename Handler>
+size_t IoUring::forEachCompletion(Handler&& handler) {
+    size_t count = 0;
+    for (;;) {
+        io_uring_cqe cqe;
+        unsigned head = *cq_head_;
+        if (!set_aside_.empty()) {
+            cqe = set_aside_.front();
+            set_aside_.pop_front();
+        } else if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            // Released before the handler runs: its submissions may set the
+            // following completions aside
+            cqe = cqes_[head & cq_mask_];
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        } else {
+            break;
+        }
+        if (cqe.user_data != PROVIDE_BUFFERS_TAG) {
+            handler(cqe);
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // namespace redis
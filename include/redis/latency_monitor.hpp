@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// Redis' latency monitor: events that took at least a threshold, such as a
+// slow command or an iteration of an event loop that kept its clients
+// waiting, with the worst of every second kept for the last HISTORY seconds
+// they occurred in. Shared by the event loops, as LazyFree is; recording
+// takes a lock, but only events over the threshold are recorded.
+class LatencyMonitor {
+public:
+    static constexpr size_t HISTORY = 160;
+
+    struct Sample {
+        int64_t time;
+        uint64_t millis;
+    };
+
+    struct Event {
+        std::string name;
+        // Ring of samples, the newest just before `next`
+        std::array<Sample, HISTORY> samples{};
+        size_t next = 0;
+        size_t length = 0;
+        uint64_t max = 0;
+
+        const Sample& latest() const {
+            return samples[(next + HISTORY - 1) % HISTORY];
+        }
+    };
+
+    LatencyMonitor();
+
+    LatencyMonitor(const LatencyMonitor&) = delete;
+    LatencyMonitor& operator=(const LatencyMonitor&) = delete;
+
+    // Events taking at least `threshold` are recorded; 0 disables the monitor
+    void setThreshold(std::chrono::milliseconds threshold);
+    std::chrono::milliseconds threshold() const;
+
+    bool enabled() const {
+        return threshold_ms_.load(std::memory_order_relaxed) > 0;
+    }
+
+    // Whether an event that took `duration` is to be recorded
+    bool exceeds(std::chrono::nanoseconds duration) const {
+        int64_t threshold = threshold_ms_.load(std::memory_order_relaxed);
+        return threshold > 0 && duration >= std::chrono::milliseconds(threshold);
+    }
+
+    // Record `event` if it took at least the threshold. Safe to call from any
+    // thread.
+    void record(std::string_view event, std::chrono::nanoseconds duration);
+
+    // A copy of the events recorded so far
+    std::vector<Event> events() const;
+    // Forget the events named, or every event if none is. Returns how many
+    // were forgotten.
+    size_t reset(std::span<const std::string_view> names = {});
+
+private:
+    mutable std::mutex mutex_;
+    std::atomic<int64_t> threshold_ms_;
+    std::vector<Event> events_;
+};
+
+} // namespace redis
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "memory.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace redis {
+
+// A background thread that frees what the event loops hand it: the values of
+// big deleted keys and whole keyspaces dropped by FLUSHALL ASYNC, whose
+// destruction could stall every client of a loop for seconds. Shared by the
+// event loops, as Redis' lazyfree thread.
+class LazyFree {
+public:
+    LazyFree();
+    // Frees whatever is still pending before returning
+    ~LazyFree();
+
+    LazyFree(const LazyFree&) = delete;
+    LazyFree& operator=(const LazyFree&) = delete;
+
+    // Take ownership of `garbage` and destroy it on the background thread,
+    // counting the memory released to the caller's memory::Account. Safe to
+    // call from any thread. Whatever `garbage` owns must be safe to free from
+    // another thread.
+    template <typename T>
+    void free(T garbage) {
+        push([garbage = std::move(garbage), account = memory::currentAccount()]() mutable {
+            memory::AccountScope scope(account);
+            T dropped = std::move(garbage);
+        });
+    }
+
+    // Items handed over and not freed yet
+    size_t pending() const;
+    // Wait until everything handed over so far is freed
+    void drain();
+
+private:
+    using Job = std::move_only_function<void()>;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<Job> jobs_;
+    // Jobs taken off the queue and still running
+    size_t running_;
+    bool stopping_;
+    std::thread thread_;
+
+    void push(Job job);
+    void run();
+};
+
+} // namespace redis
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+// Logging of the server, a thin layer over spdlog's default logger.
+//
+// Statements below REDIS_LOG_ACTIVE_LEVEL, one of spdlog's SPDLOG_LEVEL_*
+// values, are compiled out along with their arguments: debug and up by
+// default, info and up when NDEBUG is defined, as in release builds. The
+// others check the level set at run time (--loglevel, setLevel()) before
+// evaluating their arguments, so a disabled statement costs a load and a
+// branch.
+#ifndef REDIS_LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define REDIS_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define REDIS_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define REDIS_LOG(level, ...)                                              \
+    do {                                                                   \
+        if constexpr (static_cast<int>(level) >= REDIS_LOG_ACTIVE_LEVEL) { \
+            if (redis::log::enabled(level)) {                              \
+                spdlog::log(level, __VA_ARGS__);                           \
+            }                                                              \
+        }                                                                  \
+    } while (false)
+
+#define REDIS_TRACE(...) REDIS_LOG(spdlog::level::trace, __VA_ARGS__)
+#define REDIS_DEBUG(...) REDIS_LOG(spdlog::level::debug, __VA_ARGS__)
+#define REDIS_INFO(...) REDIS_LOG(spdlog::level::info, __VA_ARGS__)
+#define REDIS_WARN(...) REDIS_LOG(spdlog::level::warn, __VA_ARGS__)
+#define REDIS_ERROR(...) REDIS_LOG(spdlog::level::err, __VA_ARGS__)
+
+namespace redis::log {
+
+// The run-time level, mirrored from spdlog's so that checking it is a load
+// rather than a call into its registry
+inline std::atomic<int> active_level{SPDLOG_LEVEL_INFO};
+
+inline bool enabled(spdlog::level::level_enum level) {
+    return static_cast<int>(level) >= active_level.load(std::memory_order_relaxed);
+}
+
+// Set the run-time level of the default logger. Use instead of
+// spdlog::set_level(), which would leave enabled() behind.
+void setLevel(spdlog::level::level_enum level);
+
+// The level of a --loglevel name: Redis' debug, verbose, notice, warning
+// and nothing, or one of spdlog's level names
+std::optional<spdlog::level::level_enum> parseLevel(std::string_view name);
+
+} // namespace redis::log
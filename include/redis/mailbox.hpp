@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+namespace redis {
+
+// Lock-free multi-producer single-consumer task queue (Vyukov's intrusive MPSC
+// queue). Any thread may push without blocking other producers; only the
+// owning event loop runs the tasks.
+class Mailbox {
+public:
+    using Task = std::function<void()>;
+
+    Mailbox();
+    ~Mailbox();
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    // Enqueue a task. Safe to call from any thread.
+    void push(Task task);
+
+    // Run every task that has been completely enqueued so far. Must only be
+    // called from the consumer thread. Returns the number of tasks run.
+    size_t drain();
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        Task task;
+    };
+
+    // Producers append at head_, the consumer pops from tail_
+    std::atomic<Node*> head_;
+    Node* tail_;
+    Node stub_;
+
+    void pushNode(Node* node);
+    Node* pop();
+};
+
+} // namespace redis
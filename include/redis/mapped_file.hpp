@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace redis {
+
+// Read-only mapping of a whole file, for decoders that read it once from
+// front to back
+class MappedFile {
+public:
+    // Map the file at `path`. Returns nullptr if it does not exist; throws
+    // std::runtime_error on other errors.
+    static std::unique_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const {
+        return std::string_view(static_cast<const char*>(data_), size_);
+    }
+
+private:
+    void* data_;
+    size_t size_;
+
+    MappedFile(void* data, size_t size);
+};
+
+} // namespace redis
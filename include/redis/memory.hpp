@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Allocation of the keyspace: objects, their values and the tables holding
+// them. As with Redis' zmalloc every allocation is counted, so that used() is
+// the memory maxmemory is checked against. Failures throw std::bad_alloc.
+// Memory may be released by another thread than the one that allocated it.
+//
+// Allocations up to MAX_SMALL bytes come from a slab allocator: sizes are
+// rounded up to a size class, and every class carves its allocations out of
+// 64 KiB runs of its own, so that keys of similar sizes pack together and a
+// run emptied by deletions goes back to the system whole. Each thread keeps
+// a small cache of free allocations per class, so most allocations and
+// releases take no lock. Larger allocations go to malloc.
+namespace redis::memory {
+
+// Largest size served by the slab allocator
+constexpr size_t MAX_SMALL = 1024;
+
+void* allocate(size_t size);
+// allocate() of zeroed memory
+void* allocateZeroed(size_t size);
+// As realloc(); `pointer` may be nullptr
+void* reallocate(void* pointer, size_t size);
+// As free(); `pointer` may be nullptr
+void release(void* pointer);
+// Bytes usable at `pointer`, its size class for small allocations
+size_t usableSize(const void* pointer);
+
+// Move a small allocation out of a run that is emptier than the average run
+// of its class and into a fuller one, as Redis' active defrag does with
+// jemalloc's defrag hint, so that sparse runs drain and are returned. Returns
+// the new address, with the contents copied and `pointer` released, or
+// nullptr if the allocation is better left where it is.
+void* defragment(void* pointer);
+
+// Bytes allocated and not released yet across threads, as the allocator
+// rounds them
+size_t used();
+// Bytes of the runs holding small allocations plus the large allocations:
+// what used() costs once the free space inside runs is counted
+size_t active();
+
+// The part of used() that belongs to one owner, such as the keyspace of one
+// shard: what the threads counting to it allocate, less what they release.
+// Memory allocated under one account and released under another or none
+// leaves the first one too high.
+struct Account {
+    // Negative while more is released under the account than allocated
+    std::atomic<int64_t> bytes{0};
+
+    size_t used() const;
+};
+
+// Count what the calling thread allocates and releases to `account` as well,
+// nullptr for none, until the scope ends
+class AccountScope {
+public:
+    explicit AccountScope(Account* account);
+    ~AccountScope();
+
+    AccountScope(const AccountScope&) = delete;
+    AccountScope& operator=(const AccountScope&) = delete;
+
+private:
+    Account* previous_;
+};
+
+// The account the calling thread counts to, nullptr for none
+Account* currentAccount();
+
+struct Stats {
+    size_t allocated;  // used()
+    size_t active;     // active()
+    size_t slabs;      // the part of active() in runs
+    size_t resident;   // resident set size of the process
+    uint64_t defrag_hits;   // allocations moved by defragment()
+    uint64_t defrag_misses; // allocations defragment() left in place
+};
+Stats stats();
+
+} // namespace redis::memory
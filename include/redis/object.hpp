@@ -0,0 +1,163 @@
+#pragma once
+
+#include "quicklist.hpp"
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace redis {
+
+class Hash;
+class Set;
+class ZSet;
+
+// The integer `value` spells, if it is the canonical decimal form of one:
+// "+1", "01" or "-0" are not
+std::optional<int64_t> canonicalInteger(std::string_view value);
+
+// How an object stores its value
+enum class Encoding : uint8_t {
+    INT,        // a string that is a canonical int64, kept as the integer
+    EMBSTR,     // a short string stored inline after the header
+    RAW,        // a large string in its own heap allocation
+    QUICKLIST,  // a list, its QuickList header stored inline
+    HASH,       // a hash, its Hash header stored inline
+    SET,        // a set, its Set header stored inline
+    ZSET,       // a sorted set, its ZSet header stored inline
+};
+
+// A string value read from storage. Integer-encoded values are rendered on
+// read: small ones point into a shared pool of decimal strings, others are
+// written to the value's own buffer.
+class StringValue {
+public:
+    explicit StringValue(std::string_view view);
+    explicit StringValue(int64_t value);
+    StringValue(const StringValue& other);
+    StringValue& operator=(const StringValue& other);
+
+    std::string_view view() const {
+        return view_;
+    }
+
+    bool operator==(std::string_view other) const {
+        return view_ == other;
+    }
+
+private:
+    std::string_view view_;
+    // Long enough for INT64_MIN
+    char digits_[20];
+};
+
+// A key and its value in one allocation: an 8-byte header, the value payload
+// and the key bytes. Integers and strings up to EMBED_LIMIT bytes are stored
+// inline; larger strings go to a separate buffer, which APPEND and SETRANGE
+// grow in place. Collections keep the header
+// of their QuickList, Hash, Set or ZSet in the payload and their elements
+// outside.
+class Object {
+public:
+    static constexpr size_t EMBED_LIMIT = 64;
+    // Integers rendered once and shared by every read
+    static constexpr int64_t SHARED_INTEGERS = 10000;
+
+    struct Deleter {
+        void operator()(Object* object) const;
+    };
+    using Ptr = std::unique_ptr<Object, Deleter>;
+
+    // Create a string object, choosing the most compact encoding for `value`
+    static Ptr createString(std::string_view key, std::string_view value);
+    // Create an INT-encoded string object
+    static Ptr createInteger(std::string_view key, int64_t value);
+    // Create an empty list object
+    static Ptr createList(std::string_view key);
+    // Create an empty hash object
+    static Ptr createHash(std::string_view key);
+    // Create an empty set object
+    static Ptr createSet(std::string_view key);
+    // Create an empty sorted set object
+    static Ptr createZSet(std::string_view key);
+
+    ValueType type() const {
+        return static_cast<ValueType>(type_);
+    }
+
+    Encoding encoding() const {
+        return encoding_;
+    }
+
+    // Access clock of LRU and LFU eviction, as Redis' lru field: the last
+    // access time for LRU, an access frequency and the time it last decayed
+    // for LFU. Kept up to date by the storage.
+    uint16_t access() const {
+        return access_;
+    }
+
+    void setAccess(uint16_t access) {
+        access_ = access;
+    }
+
+    std::string_view key() const;
+    StringValue string() const;
+    // The value of an INT-encoded object
+    int64_t integer() const;
+    // Replace the value of an INT-encoded object in place
+    void setInteger(int64_t value);
+    // Resize the buffer of a RAW-encoded object to `size` bytes, zeroing the
+    // new ones, and return the bytes for writing. The capacity at least
+    // doubles when it grows, so that repeated appends are amortized O(1).
+    std::span<char> resizeRaw(size_t size);
+    // The elements of a list object
+    QuickList& list();
+    const QuickList& list() const;
+    // The fields of a hash object
+    Hash& hash();
+    const Hash& hash() const;
+    // The members of a set object
+    Set& set();
+    const Set& set() const;
+    // The members of a sorted set object
+    ZSet& zset();
+    const ZSet& zset() const;
+
+    // Bytes allocated for the object, including a separate value buffer or
+    // the elements of a list, hash, set or sorted set
+    size_t memoryUsage() const;
+    // Rough cost of freeing the object, as Redis' lazyfreeGetFreeEffort: 1
+    // for strings and packed encodings, one per element otherwise
+    size_t freeEffort() const;
+
+    // Move the object, and the buffer of a RAW string, out of sparse slab
+    // runs where memory::defragment() suggests it. Returns whether the object
+    // itself moved: other pointers to it are then dangling.
+    static bool defragment(Ptr& object);
+
+private:
+    uint8_t type_;
+    Encoding encoding_;
+    uint16_t access_;
+    uint32_t key_size_;
+
+    Object(ValueType type, Encoding encoding, size_t key_size);
+
+    // The value payload starts right after the header
+    char* payload() {
+        return reinterpret_cast<char*>(this + 1);
+    }
+    const char* payload() const {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+    size_t payloadSize() const;
+
+    static Ptr allocate(ValueType type, Encoding encoding, std::string_view key, size_t payload_size);
+};
+
+static_assert(sizeof(Object) == 8);
+
+} // namespace redis
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "aof.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace redis {
+
+// Persistence settings and state shared by the event loops of a server
+struct Persistence {
+    // Snapshot written by SAVE and BGSAVE and loaded at startup
+    std::string rdb_path = "dump.rdb";
+    // With appendonly the log at aof_path is replayed at startup instead of
+    // the snapshot, and every loop appends to `aof` once it is open
+    bool appendonly = false;
+    std::string aof_path = "appendonly.aof";
+    FsyncPolicy fsync = FsyncPolicy::EVERYSEC;
+    std::unique_ptr<AppendOnlyFile> aof;
+    // Set while SAVE, BGSAVE or BGREWRITEAOF runs; only one may run at a time
+    std::atomic<bool> saving{false};
+    // Unix time in seconds of the last successful save, for LASTSAVE
+    std::atomic<int64_t> last_save{0};
+};
+
+} // namespace redis
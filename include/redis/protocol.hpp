@@ -1,13 +1,68 @@
 #pragma once
 
 #include "types.hpp"
+#include <cstdint>
 #include <expected>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 namespace redis {
 
+// Incremental RESP request parser. It keeps its place inside a partially
+// received frame, so feeding it a large command in many small reads costs
+// O(bytes) instead of rescanning the frame on every read.
+class RequestParser {
+public:
+    // Largest bulk string accepted, like proto-max-bulk-len in Redis
+    static constexpr int64_t MAX_BULK_LENGTH = 512 * 1024 * 1024;
+    // Largest number of arguments accepted in one command
+    static constexpr int64_t MAX_MULTIBULK_LENGTH = 1024 * 1024;
+
+    // Parse the next command from the front of `input`, which must start at the
+    // first byte not consumed by a previous command. Returns std::nullopt if
+    // `input` only holds part of a frame; call again with the same bytes plus
+    // whatever arrived since. On success `input` is advanced past the frame and
+    // the returned arguments view into the consumed bytes. The span itself is
+    // reused and stays valid only until the next call.
+    std::expected<std::optional<CommandArgsSpan>, std::string> next(std::string_view& input);
+
+    // Error describing the frame left unfinished in `input` when no more
+    // data will arrive
+    std::string truncatedError(std::string_view input) const;
+
+    // Bytes the current frame is known to need, counted from its first byte,
+    // or 0 while that is not known yet. Lets the caller size its receive
+    // buffer for a large bulk string before the body arrives.
+    size_t frameSizeHint() const;
+
+    // Drop any partially parsed frame
+    void reset();
+
+private:
+    enum class State {
+        ARRAY_HEADER,
+        BULK_HEADER,
+        BULK_BODY,
+    };
+
+    State state_ = State::ARRAY_HEADER;
+    // Offset of the next unparsed byte, relative to the start of the frame
+    size_t pos_ = 0;
+    // Offset where the search for the next CRLF resumes
+    size_t scan_ = 0;
+    int64_t remaining_args_ = 0;
+    int64_t bulk_length_ = 0;
+    // Arguments of the current frame as (offset, length) pairs. Offsets are used
+    // instead of views because the buffer may move between reads.
+    std::vector<std::pair<size_t, size_t>> arg_offsets_;
+    CommandArgs args_;
+
+    std::optional<std::string_view> readLine(std::string_view input);
+};
+
 // RESP (Redis Serialization Protocol) handler
 class Protocol {
 public:
@@ -15,16 +70,22 @@ public:
     static std::expected<std::vector<CommandArgs>, std::string> parseCommand(const std::string& data);
     
     // Serialize response to RESP format
-    static std::string serializeSimpleString(const std::string& str);
-    static std::string serializeError(const std::string& error);
+    static std::string serializeSimpleString(std::string_view str);
+    static std::string serializeError(std::string_view error);
     static std::string serializeInteger(int64_t value);
-    static std::string serializeBulkString(const std::string& str);
+    static std::string serializeBulkString(std::string_view str);
     static std::string serializeNullBulkString();
     static std::string serializeArray(const std::vector<std::string>& elements);
     static std::string serializeNullArray();
+    // Append to a reply being built, so that an array is written without
+    // first collecting its elements
+    static void appendArrayHeader(std::string& out, size_t size);
+    static void appendBulkString(std::string& out, std::string_view str);
+    // Append a command to `out` as a RESP array of bulk strings, the form it
+    // takes on the wire and in the append-only file
+    static void appendCommand(std::string& out, CommandArgsSpan args);
     // Generic serialize based on response type
     static std::string serialize(const std::string& response, ResponseType type);
 };
 
 } // namespace redis
-
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace redis {
+
+// End of a list that an operation acts on
+enum class ListEnd {
+    HEAD,
+    TAIL,
+};
+
+// A list stored as a doubly linked list of nodes, each one allocation holding
+// up to NODE_MAX_BYTES of packed entries. An entry is its length as a varint,
+// the bytes, and the size of those two as a reversed varint so that a node can
+// be walked from either end: a short element costs two bytes over its data.
+// Every node keeps free space at both ends, so pushes and pops at either end
+// of the list do not move the other entries.
+class QuickList {
+public:
+    // A node is not extended past this size; a larger element gets a node of
+    // its own
+    static constexpr size_t NODE_MAX_BYTES = 8192;
+
+    QuickList();
+    ~QuickList();
+
+    QuickList(const QuickList&) = delete;
+    QuickList& operator=(const QuickList&) = delete;
+
+    size_t size() const {
+        return count_;
+    }
+
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    void push(ListEnd end, std::string_view value);
+    // Remove and return the element at `end`. The list must not be empty.
+    std::string pop(ListEnd end);
+
+    // Element at `index`, counting from the tail when negative
+    std::optional<std::string_view> index(int64_t index) const;
+
+    // Call `fn(element)` for the elements from `start` to `stop` inclusive,
+    // which must be valid positions with start <= stop
+    template <typename Fn>
+    void forRange(size_t start, size_t stop, Fn&& fn) const {
+        size_t offset = start;
+        const Node* node = nodeAt(offset);
+        const char* entry = node->data() + node->begin;
+        for (size_t remaining = stop - start + 1; remaining > 0; remaining--) {
+            while (offset > 0) {
+                entry = skip(entry);
+                offset--;
+            }
+            if (entry == node->data() + node->end) {
+                node = node->next;
+                entry = node->data() + node->begin;
+            }
+            fn(element(entry));
+            entry = skip(entry);
+        }
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (count_ > 0) {
+            forRange(0, count_ - 1, fn);
+        }
+    }
+
+    // Remove `count` elements from `end`
+    void remove(ListEnd end, size_t count);
+
+    // Positions from `start` to `stop` as given to LRANGE and LTRIM: negative
+    // ones count from the tail and the range is clamped to the list. nullopt
+    // if no element is in it.
+    std::optional<std::pair<size_t, size_t>> range(int64_t start, int64_t stop) const;
+
+    // Bytes allocated for the nodes
+    size_t memoryUsage() const;
+
+private:
+    struct Node {
+        Node* prev;
+        Node* next;
+        // Entries occupy [begin, end) of the capacity bytes after the header
+        uint32_t begin;
+        uint32_t end;
+        uint32_t count;
+        uint32_t capacity;
+
+        char* data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+        const char* data() const {
+            return reinterpret_cast<const char*>(this + 1);
+        }
+        size_t used() const {
+            return end - begin;
+        }
+    };
+
+    Node* head_;
+    Node* tail_;
+    size_t count_;
+
+    static std::string_view element(const char* entry);
+    static const char* skip(const char* entry);
+    // Start of the entry that ends at `entry_end`
+    static const char* skipBack(const char* entry_end);
+    static size_t entrySize(size_t length);
+    static void writeEntry(char* out, std::string_view value);
+
+    static Node* allocateNode(size_t capacity);
+    // Make room for `size` more bytes at `end` of the node, moving its
+    // entries or reallocating it. Returns the node's new address.
+    Node* reserve(Node* node, ListEnd end, size_t size);
+    void unlink(Node* node);
+    // The node holding element `offset`; on return `offset` is its position
+    // within that node
+    const Node* nodeAt(size_t& offset) const;
+};
+
+} // namespace redis
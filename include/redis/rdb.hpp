@@ -0,0 +1,36 @@
+#pragma once
+
+#include "storage.hpp"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+
+// Binary snapshot of the keyspace, in the spirit of Redis' RDB files.
+//
+//   "DRDB" <version u8> <key count varint>
+//   records: [EXPIRE_MS <int64 LE>] STRING <key> <value> | INT <key> <zigzag varint>
+//   EOF <CRC-64 of everything before the checksum, u64 LE>
+//
+// Strings are a varint length followed by the bytes. The key count is a hint
+// for sizing the tables, not a promise.
+class Rdb {
+public:
+    // Write the keys of every shard to `path`. The file is written next to it
+    // under a temporary name, synced and renamed over it, so a crash leaves
+    // the previous snapshot intact. Throws std::runtime_error on I/O errors.
+    static void save(const std::string& path, const std::vector<Storage*>& shards);
+
+    // Load the snapshot at `path`, inserting every key into the shard
+    // `shard_of` picks for it. Keys whose expire time has passed are skipped.
+    // The file is mapped into memory and decoded in one pass. Returns the
+    // number of keys loaded, 0 if there is no file. Throws std::runtime_error
+    // if the file is corrupt.
+    static size_t load(const std::string& path, const std::vector<Storage*>& shards,
+                       const std::function<size_t(std::string_view key)>& shard_of);
+};
+
+} // namespace redis
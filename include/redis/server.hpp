@@ -1,20 +1,51 @@
 #pragma once
 
-#include "database.hpp"
-#include "client_connection.hpp"
-#include "protocol.hpp"
+#include "event_loop.hpp"
+#include "hash.hpp"
+#include "latency_monitor.hpp"
+#include "lazy_free.hpp"
+#include "zset.hpp"
 #include <string>
 #include <thread>
 #include <atomic>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 namespace redis {
 
 // Redis server
 class Server {
 public:
-    Server(const std::string& host = "127.0.0.1", int port = 6379);
+    // With more than one thread every thread runs its own event loop and owns
+    // one shard of the keyspace. The snapshot at `rdb_path` is loaded on start
+    // and written by SAVE and BGSAVE.
+    Server(const std::string& host = "127.0.0.1", int port = 6379, size_t threads = 1,
+           Backend backend = Backend::EPOLL, const std::string& rdb_path = "dump.rdb");
+
+    // Log every modification to the append-only file at `path` and rebuild
+    // the keyspace from it on start instead of from the snapshot. Call before
+    // start().
+    void enableAppendOnly(const std::string& path, FsyncPolicy fsync);
+    // When hashes convert from the packed encoding to a table. Call before
+    // start().
+    void setHashLimits(const HashLimits& limits);
+    // Members up to which sets of integers are kept as intsets. Call before
+    // start().
+    void setMaxIntsetEntries(size_t entries);
+    // When sorted sets convert from the packed encoding to a skiplist. Call
+    // before start().
+    void setZSetLimits(const ZSetLimits& limits);
+    // Memory use past which writes evict keys, across shards: each shard
+    // keeps its own keys within an equal part. Call before start().
+    void setMemoryLimits(const MemoryLimits& limits);
+    // When the shards defragment their keyspace in the background. Call
+    // before start().
+    void setDefragSettings(const DefragSettings& settings);
+    // Which commands go to the SLOWLOG of every shard. Call before start().
+    void setSlowLogSettings(const SlowLogSettings& settings);
+    // Events taking at least `threshold` are reported to LATENCY LATEST and
+    // HISTORY; 0 disables the latency monitor
+    void setLatencyMonitorThreshold(std::chrono::milliseconds threshold);
     ~Server();
     
     // Start the server
@@ -29,19 +60,39 @@ public:
     // Get server address and port
     std::string getHost() const;
     int getPort() const;
+    size_t getThreads() const;
+    Backend getBackend() const;
     
 private:
     std::string host_;
     int port_;
-    int server_socket_;
-    int epoll_fd_;
+    size_t threads_;
+    Backend backend_;
+    Persistence persistence_;
+    HashLimits hash_limits_;
+    size_t max_intset_entries_;
+    ZSetLimits zset_limits_;
+    MemoryLimits memory_limits_;
+    DefragSettings defrag_settings_;
+    SlowLogSettings slow_log_settings_;
+    LatencyMonitor latency_monitor_;
+    // Readable once stop() has been called; wakes every event loop
+    int stop_fd_;
     std::atomic<bool> running_;
-    std::unordered_map<int, std::unique_ptr<ClientConnection>> connections_;
-    Database database_;
-    
-    void acceptConnections();
-    void handleClient(int client_socket);
+    // Declared before the shards, so that it outlives their storages
+    LazyFree lazy_free_;
+    std::vector<std::unique_ptr<EventLoop>> shards_;
+
+    // Fill the shards from the append-only file or the snapshot
+    void loadData();
+    size_t loadSnapshot();
+    size_t replayAppendOnly();
+    // Whether every key of the command belongs to `shard`
+    bool onShard(const KeySpec& spec, CommandArgsSpan args, size_t shard) const;
+    // Replay Database::FLUSH_SHARD: delete the keys of `shard` of `shards`,
+    // which were split differently if the thread count has changed
+    void flushShard(size_t shard, size_t shards);
+    std::vector<Storage*> storages() const;
 };
 
 } // namespace redis
-
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "dict.hpp"
+#include "intset.hpp"
+#include "object.hpp"
+#include <charconv>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace redis {
+
+// A set of strings. While every member is an integer and there are at most
+// `max_intset_entries` of them, as Redis' set-max-intset-entries, the set is
+// an IntSet. Past that it converts to a table of one Object per member, and
+// stays one.
+class Set {
+public:
+    static constexpr size_t DEFAULT_MAX_INTSET_ENTRIES = 512;
+
+    Set();
+    ~Set();
+
+    Set(const Set&) = delete;
+    Set& operator=(const Set&) = delete;
+
+    size_t size() const;
+
+    bool intset() const {
+        return table_ == nullptr;
+    }
+
+    bool contains(std::string_view member) const;
+    // Add a member, converting to a table first if the set outgrows the
+    // intset. Returns true if the member is new.
+    bool add(std::string_view member, size_t max_intset_entries);
+    bool remove(std::string_view member);
+
+    // Call `fn(member)` for every member, in ascending order for an intset.
+    // The member is only valid during the call.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (table_ != nullptr) {
+            table_->forEach([&fn](std::string_view member, const Object::Ptr&) { fn(member); });
+            return;
+        }
+        char digits[20];
+        ints_.forEach([&](int64_t value) {
+            auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            fn(std::string_view(digits, end - digits));
+        });
+    }
+
+    // Bytes allocated for the members
+    size_t memoryUsage() const;
+
+    // Call `fn(member)` for every member of the intersection, union or
+    // difference of `sets` as SINTER, SUNION and SDIFF: the members of all
+    // of them, of any of them, or of the first and none of the others. A
+    // null set is an empty one.
+    using MemberFn = std::function<void(std::string_view)>;
+    static void intersect(std::span<const Set* const> sets, const MemberFn& fn);
+    static void unite(std::span<const Set* const> sets, const MemberFn& fn);
+    static void difference(std::span<const Set* const> sets, const MemberFn& fn);
+
+private:
+    // Table entries are a single pointer; the member is the object's key
+    struct MemberTraits {
+        struct Entry {
+            Object::Ptr object;
+            Entry(std::string_view, Object::Ptr&& o) : object(std::move(o)) {}
+        };
+        static std::string_view key(const Entry& entry) { return entry.object->key(); }
+        static Object::Ptr& value(Entry& entry) { return entry.object; }
+    };
+    using Table = Dict<Object::Ptr, MemberTraits>;
+
+    IntSet ints_;
+    // Set once the set is converted; mutable for forEach(), which does not
+    // modify it
+    mutable std::unique_ptr<Table> table_;
+
+    void convert();
+};
+
+} // namespace redis
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "types.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace redis {
+
+// When commands go to the slow log
+struct SlowLogSettings {
+    // Commands taking at least this long (µs) are logged; negative disables
+    // the log, 0 logs every command
+    int64_t log_slower_than = 10000;
+    // Entries kept, the oldest dropped first
+    size_t max_length = 128;
+};
+
+// Redis' SLOWLOG: the last commands that ran for longer than a threshold,
+// with their arguments, in a ring of fixed size. Entries keep at most
+// MAX_ARGS arguments of at most MAX_ARG_BYTES each, copied into buffers
+// that are reused once the ring has wrapped, so logging a command does not
+// allocate in the steady state. Each shard keeps its own, written and read
+// by its thread only.
+class SlowLog {
+public:
+    static constexpr size_t MAX_ARGS = 32;
+    static constexpr size_t MAX_ARG_BYTES = 128;
+
+    struct Entry {
+        // Unique across shards and increasing, so that the entries of every
+        // shard sort in the order they were logged
+        uint64_t id = 0;
+        int64_t time = 0;
+        uint64_t micros = 0;
+        // Arguments of the command, and how many of them are kept: all of
+        // them up to MAX_ARGS, MAX_ARGS - 1 otherwise
+        size_t argc = 0;
+        size_t kept = 0;
+        // The kept arguments cut at MAX_ARG_BYTES, back to back, and the
+        // length of each before the cut
+        std::string bytes;
+        std::array<size_t, MAX_ARGS> sizes{};
+    };
+
+    explicit SlowLog(size_t max_length = SlowLogSettings{}.max_length);
+
+    // Log `args`, which took `micros` to run
+    void add(CommandArgsSpan args, uint64_t micros);
+
+    size_t length() const;
+    // The entry logged `age` entries before the newest one
+    const Entry& operator[](size_t age) const;
+    void reset();
+    // Drops the oldest entries past `max_length`
+    void setMaxLength(size_t max_length);
+
+    // Append the reply SLOWLOG GET gives for `entry`: its id, time, duration
+    // and arguments, the cut ones marked as Redis does, then the client
+    // address and name, which are not tracked and left empty
+    static void appendReply(std::string& out, const Entry& entry);
+
+private:
+    std::vector<Entry> entries_;
+    // Where the next entry goes
+    size_t next_;
+    size_t length_;
+};
+
+} // namespace redis
@@ -1,36 +1,359 @@
 #pragma once
 
+#include "dict.hpp"
+#include "hash.hpp"
+#include "set.hpp"
+#include "zset.hpp"
+#include "object.hpp"
 #include "types.hpp"
+#include <chrono>
+#include <cstdint>
 #include <expected>
+#include <functional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <memory>
 #include <optional>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace redis {
 
-// Forward declarations
-class RedisString;
+class LazyFree;
+
+// The keys evicted when memory use is over maxmemory, Redis'
+// maxmemory-policy
+enum class EvictionPolicy {
+    NOEVICTION,   // none: writes that may use more memory are refused
+    ALLKEYS_LRU,  // the least recently used keys
+    ALLKEYS_LFU,  // the least frequently used keys
+    VOLATILE_TTL, // the keys with an expire time that expire the soonest
+};
+
+struct MemoryLimits {
+    // Keyspace bytes of all shards, as memory::used() counts them, past
+    // which writes evict keys; 0 for no limit
+    size_t max_memory = 0;
+    EvictionPolicy policy = EvictionPolicy::NOEVICTION;
+    // Keys sampled per eviction, Redis' maxmemory-samples
+    size_t samples = 5;
+    // Shards sharing max_memory. Each of several gets an equal part of it
+    // and evicts its own keys to stay under that, going by the memory
+    // counted to its account.
+    size_t shards = 1;
+};
+
+// When active defragmentation runs and how hard, as Redis' activedefrag
+// settings. Fragmentation is what the allocator holds beyond the bytes in
+// use, see memory::active().
+struct DefragSettings {
+    bool enabled = false;
+    // Nothing is moved below both of these: wasted bytes, and percent of the
+    // bytes in use
+    size_t ignore_bytes = 100 << 20;
+    size_t threshold_lower = 10;
+    // Fragmentation percent from which the most effort is spent
+    size_t threshold_upper = 100;
+    // Percent of the cron interval spent at threshold_lower and at
+    // threshold_upper, in between in proportion
+    size_t cycle_min = 1;
+    size_t cycle_max = 25;
+};
 
 // Storage engine for Redis data structures
 class Storage {
 public:
     Storage();
     ~Storage();
+
+    // Error returned for a key that holds a value of another type
+    static constexpr std::string_view WRONGTYPE = "WRONGTYPE Operation against a key holding the wrong kind of value";
     
-    // String operations
-    void set(const std::string& key, const std::string& value);
-    std::expected<std::optional<std::string>, std::string> get(const std::string& key);
-    bool del(const std::string& key);
-    bool exists(const std::string& key);
+    // Milliseconds since the Unix epoch, the unit of absolute expire times
+    static int64_t now();
+
+    // String operations. Keys and values are copied only when stored; the
+    // value returned by get() is valid until the next modification of the
+    // storage. set() drops any expire time the key had unless `expire_at` gives
+    // a new one.
+    void set(std::string_view key, std::string_view value, std::optional<int64_t> expire_at = std::nullopt);
+    std::expected<std::optional<StringValue>, std::string> get(std::string_view key);
+    bool del(std::string_view key);
+    bool exists(std::string_view key);
+
+    // Counters and in-place string edits. A missing key starts as 0 or the
+    // empty string; an existing key keeps its expire time. increment() adds
+    // to an INT-encoded value in place and returns the new value.
+    std::expected<int64_t, std::string> increment(std::string_view key, int64_t delta);
+    // Add a float and return the new value as stored and replied: up to 17
+    // decimals, trailing zeros dropped
+    std::expected<std::string, std::string> incrementFloat(std::string_view key, long double delta);
+    // Return the new length of the string
+    std::expected<size_t, std::string> append(std::string_view key, std::string_view value);
+    // Overwrite the string from `offset`, padding it with zero bytes up to
+    // there. An empty `value` changes nothing. Returns the new length.
+    std::expected<size_t, std::string> setRange(std::string_view key, size_t offset, std::string_view value);
+
+    // Batch operations of multi-key commands. The keys are hashed and their
+    // table slots prefetched a window at a time before any of them is looked
+    // up, so that the cache misses of a batch overlap. getMany() calls
+    // `fn(value)` for each key in order, with nullopt for missing keys and
+    // keys of another type, as MGET replies.
+    void getMany(CommandArgsSpan keys, const std::function<void(const std::optional<StringValue>&)>& fn);
+    // set() each key/value pair without an expire time. With
+    // `only_if_none_exist` nothing is set if any of the keys exists. Returns
+    // whether the keys were set.
+    bool setMany(CommandArgsSpan key_values, bool only_if_none_exist = false);
+    // Number of keys deleted or existing; a key given twice counts twice.
+    // Deleted values that are costly to free, see LAZY_FREE_THRESHOLD, are
+    // left to the lazy free thread, if there is one.
+    size_t delMany(CommandArgsSpan keys);
+    size_t existsMany(CommandArgsSpan keys);
+
+    // List operations. A push creates the list and a list is deleted with its
+    // last element. push() returns the new length.
+    std::expected<size_t, std::string> push(std::string_view key, ListEnd end, CommandArgsSpan values);
+    // Remove up to `count` elements from `end`, none if the key does not exist
+    std::expected<std::vector<std::string>, std::string> pop(std::string_view key, ListEnd end, size_t count);
+    // Keep only the elements in QuickList::range(start, stop)
+    std::expected<void, std::string> trim(std::string_view key, int64_t start, int64_t stop);
+    // A list for reading, nullptr if the key does not exist. Valid until the
+    // next modification of the storage.
+    std::expected<const QuickList*, std::string> list(std::string_view key);
+
+    // Hash operations. A hash is created by its first field and deleted with
+    // its last one. hashSet() takes field/value pairs and returns the number
+    // of new fields.
+    std::expected<size_t, std::string> hashSet(std::string_view key, CommandArgsSpan field_values);
+    std::expected<size_t, std::string> hashDelete(std::string_view key, CommandArgsSpan fields);
+    // Add `delta` to an integer field, created as 0 if missing. Returns the
+    // new value.
+    std::expected<int64_t, std::string> hashIncrement(std::string_view key, std::string_view field, int64_t delta);
+    // A hash for reading, nullptr if the key does not exist. Valid until the
+    // next modification of the storage.
+    std::expected<const Hash*, std::string> hash(std::string_view key);
+    // Encoding limits of the hashes created or grown from now on
+    void setHashLimits(const HashLimits& limits);
+    const HashLimits& hashLimits() const;
+
+    // Set operations. A set is created by its first member and deleted with
+    // its last one. Return the number of members added or removed.
+    std::expected<size_t, std::string> setAdd(std::string_view key, CommandArgsSpan members);
+    std::expected<size_t, std::string> setRemove(std::string_view key, CommandArgsSpan members);
+    // A set for reading, nullptr if the key does not exist. Valid until the
+    // next modification of the storage.
+    std::expected<const Set*, std::string> getSet(std::string_view key);
+    // Members up to which sets of integers created or grown from now on stay
+    // intsets
+    void setMaxIntsetEntries(size_t entries);
+    size_t maxIntsetEntries() const;
+
+    // Sorted set operations. A sorted set is created by its first member and
+    // deleted with its last one. zsetAdd() takes score/member pairs; with NX
+    // it only adds new members, with XX it only updates existing ones.
+    enum class ZAddCondition { ALWAYS, NX, XX };
+    struct ZAddResult {
+        size_t added;
+        // Members added or given a new score
+        size_t changed;
+    };
+    std::expected<ZAddResult, std::string> zsetAdd(std::string_view key,
+                                                   std::span<const std::pair<double, std::string_view>> entries,
+                                                   ZAddCondition condition);
+    std::expected<size_t, std::string> zsetRemove(std::string_view key, CommandArgsSpan members);
+    // Add `delta` to a member's score, created as 0 if missing. Returns the
+    // new score.
+    std::expected<double, std::string> zsetIncrement(std::string_view key, std::string_view member, double delta);
+    // A sorted set for reading, nullptr if the key does not exist. Valid
+    // until the next modification of the storage.
+    std::expected<const ZSet*, std::string> zset(std::string_view key);
+    // Encoding limits of the sorted sets created or grown from now on
+    void setZSetLimits(const ZSetLimits& limits);
+    const ZSetLimits& zsetLimits() const;
+
+    // Expiry. Expired keys are removed when they are looked up and by the
+    // active expire cycle. An expire time in the past deletes the key.
+    // Return false if the key does not exist.
+    bool expireAt(std::string_view key, int64_t when);
+    bool persist(std::string_view key);
+    // Remaining time to live in milliseconds, -1 if the key has no expire
+    // time, -2 if it does not exist
+    int64_t ttl(std::string_view key);
+    // Absolute expire time of a live key, nullopt if it has none
+    std::optional<int64_t> expireTime(std::string_view key);
+
+    // Number of modifications made by commands so far. Removals of expired
+    // keys do not count: they follow from the expire times already recorded.
+    uint64_t changes() const;
+
+    // Sample keys with an expire time and remove the expired ones, until a
+    // sample finds few expired keys or `budget` is used up. Returns the number
+    // of removed keys.
+    size_t activeExpireCycle(std::chrono::microseconds budget);
+
+    // Spend up to `budget` moving entries of tables that are being resized,
+    // so an idle shard still finishes its resizes
+    void incrementalRehash(std::chrono::microseconds budget);
+
+    // Once fragmentation is past the DefragSettings thresholds, spend a share
+    // of `interval` moving objects out of sparse slab runs, resuming the
+    // keyspace walk where the last call stopped. Returns the number of
+    // objects moved.
+    size_t activeDefragCycle(std::chrono::microseconds interval);
+    void setDefragSettings(const DefragSettings& settings);
+    const DefragSettings& defragSettings() const;
+
+    // Bytes used by a key: its object plus its share of the hash tables, as
+    // reported by MEMORY USAGE
+    std::optional<size_t> memoryUsage(std::string_view key);
+
+    // Keyspace iteration, as SCAN and KEYS use it. scan() visits keys from
+    // `cursor` until about `count` of them have been seen, calls
+    // `fn(key, type)` for each live one and returns the cursor to continue
+    // from, 0 once the scan is complete. A key present for the whole scan is
+    // reported at least once, even if the keyspace resizes in between; a key
+    // may be reported twice. `fn` must not modify the storage.
+    size_t scan(size_t cursor, size_t count, const std::function<void(std::string_view key, ValueType type)>& fn);
+    // A live key picked at random, nullopt if there is none
+    std::optional<std::string> randomKey();
+
+    // Snapshot support. forEach() calls `fn(object, expire_at)` for every key,
+    // expired or not; expire_at is 0 for keys without an expire time. `fn`
+    // must not modify the storage.
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        data_.forEach([&](std::string_view key, Object::Ptr& object) {
+            const Expire* expire = expires_.empty() ? nullptr : expires_.find(key);
+            fn(*object, expire != nullptr ? expire->when : int64_t(0));
+        });
+    }
+    // Insert a loaded object unless its key exists. Returns false if it did.
+    bool restore(Object::Ptr object, std::optional<int64_t> expire_at);
+    // Size the keyspace for `count` keys before a load
+    void reserve(size_t count);
+
+    // Eviction. LRU and LFU are approximated as in Redis: each object keeps
+    // a 16-bit access clock, and every eviction samples a few keys into a
+    // pool of the best candidates seen so far and evicts the best one.
+    void setMemoryLimits(const MemoryLimits& limits);
+    const MemoryLimits& memoryLimits() const;
+    // Evict keys until memory use is within max_memory, or within this
+    // shard's part of it, calling `fn(key)` before each one is removed.
+    // Returns false if memory use is still over with nothing left to evict.
+    // Evictions count as changes: unlike expiry they do not follow from
+    // anything recorded.
+    bool evict(const std::function<void(std::string_view key)>& fn);
+    // Where the memory of this storage's keys is counted. The thread that
+    // changes the storage has to count to it, see memory::AccountScope.
+    memory::Account& account();
+    // Advance the access clock to `now`, in milliseconds since the epoch.
+    // Called by the cron, so that lookups do not read the time.
+    void refreshClock(int64_t now);
 
     // Utility operations
     size_t size() const;
+    size_t expiresSize() const;
     void clear();
-    
+    // clear() in O(1): the tables are handed whole to the lazy free thread,
+    // if there is one
+    void clearAsync();
+
+    // Values whose Object::freeEffort() is above this are freed by the lazy
+    // free thread when deleted, as in Redis
+    static constexpr size_t LAZY_FREE_THRESHOLD = 64;
+    // Where deleted values and flushed keyspaces are freed, still counted to
+    // account(); nullptr frees them on the calling thread. Must outlive the
+    // storage.
+    void setLazyFree(LazyFree* lazy_free);
+
 private:
-    std::unordered_map<std::string, RedisValue> data_;
-    ValueType getValueType(const std::string& key) const;
+    // Keyspace entries are a single pointer; the key lives in the object
+    struct ObjectTraits {
+        struct Entry {
+            Object::Ptr object;
+            Entry(std::string_view, Object::Ptr&& o) : object(std::move(o)) {}
+        };
+        static std::string_view key(const Entry& entry) { return entry.object->key(); }
+        static Object::Ptr& value(Entry& entry) { return entry.object; }
+    };
+
+    // Expire times of the keys that have one, so keys without a TTL pay
+    // nothing. The key is borrowed from the object it belongs to.
+    struct Expire {
+        const Object* object;
+        int64_t when;
+    };
+    struct ExpireTraits {
+        struct Entry {
+            Expire expire;
+            Entry(std::string_view, const Object* object, int64_t when) : expire{object, when} {}
+        };
+        static std::string_view key(const Entry& entry) { return entry.expire.object->key(); }
+        static Expire& value(Entry& entry) { return entry.expire; }
+    };
+
+    Dict<Object::Ptr, ObjectTraits> data_;
+    Dict<Expire, ExpireTraits> expires_;
+    // Scan cursor of expires_ where the next active expire cycle resumes
+    size_t expire_cursor_;
+    DefragSettings defrag_settings_;
+    // Scan cursor of data_ where the next active defrag cycle resumes
+    size_t defrag_cursor_;
+    uint64_t changes_;
+    HashLimits hash_limits_;
+    size_t max_intset_entries_;
+    ZSetLimits zset_limits_;
+    std::mt19937_64 random_;
+    LazyFree* lazy_free_;
+    MemoryLimits memory_limits_;
+    memory::Account account_;
+    // Seconds since the epoch at the last refreshClock()
+    int64_t clock_;
+    // A key worth evicting and how much: the idle time for LRU, the lack of
+    // accesses for LFU, the nearness of the expire time for VOLATILE_TTL
+    struct EvictionCandidate {
+        std::string key;
+        uint64_t score;
+    };
+    // The best candidates sampled so far, by ascending score
+    std::vector<EvictionCandidate> eviction_pool_;
+
+    // Find a live key, removing it first if it has expired
+    Object::Ptr* find(std::string_view key);
+    // find() of a key whose Dict::hash() is already known
+    Object::Ptr* find(std::string_view key, size_t hash);
+    // Call `fn(position, hash)` for the keys at positions 0, step, ... of
+    // `keys`, with their hashes computed and their slots prefetched ahead
+    template <typename Fn>
+    void forEachPrefetched(CommandArgsSpan keys, size_t step, Fn&& fn);
+    void erase(std::string_view key);
+    // erase() of a key deleted by a command, leaving a costly value to the
+    // lazy free thread
+    void unlink(std::string_view key);
+    // The object at `key` if it holds a `type` value: nullptr if the key does
+    // not exist, WRONGTYPE if it holds another type
+    std::expected<Object*, std::string> find(std::string_view key, ValueType type);
+    // The object at `key`, created by `create` if the key does not exist
+    std::expected<Object*, std::string> findOrCreate(std::string_view key, ValueType type,
+                                                     Object::Ptr (*create)(std::string_view));
+    // Insert the object of a new key
+    Object* insert(std::string_view key, Object::Ptr object);
+    // Replace a key's object, keeping the expire time pointing at it
+    void replace(Object::Ptr& slot, Object::Ptr object);
+    // Start the access clock of a new object, and advance it on access
+    void stamp(Object& object);
+    void touch(Object& object);
+    // The LFU counter of an object, decayed by the minutes since its last
+    // decay
+    uint8_t frequency(const Object& object) const;
+    // Sample keys into the eviction pool and take the best one still there
+    std::optional<std::string> evictionCandidate();
+    // Write `value` at `offset` of the string at `slot`, growing it to at
+    // least `offset + value.size()` bytes: in place in a RAW buffer, else by
+    // replacing the object with the re-encoded result
+    void writeString(Object::Ptr& slot, size_t offset, std::string_view value);
 };
 
 } // namespace redis
@@ -2,8 +2,8 @@
 
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <variant>
 
 namespace redis {
 
@@ -13,17 +13,14 @@ enum class ValueType {
     LIST,
     SET,
     HASH,
+    ZSET,
     NONE
 };
 
-// Redis value variant
-using RedisValue = std::variant<
-    std::string
->;
-
-// Command arguments
-using CommandArgs = std::vector<std::string>;
-using CommandArgsSpan = std::span<const std::string>;
+// Command arguments. Arguments are views into the connection's input buffer
+// and are only valid until the next read from the socket.
+using CommandArgs = std::vector<std::string_view>;
+using CommandArgsSpan = std::span<const std::string_view>;
 
 // Response types
 enum class ResponseType {
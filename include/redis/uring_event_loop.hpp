@@ -0,0 +1,80 @@
+#pragma once
+
+#include "event_loop.hpp"
+#include "io_uring.hpp"
+#include <memory>
+#include <sys/socket.h>
+#include <unordered_map>
+
+namespace redis {
+
+// Event loop on io_uring. Connections are accepted with one multishot accept,
+// each connection receives through a multishot recv that picks buffers from a
+// registered buffer ring, and replies go out as one vectored sendmsg per
+// flush. All submissions of a loop iteration and the wait for completions
+// share a single io_uring_enter(), so under pipelined load a request costs
+// well below one system call.
+class UringEventLoop : public EventLoop {
+public:
+    static constexpr unsigned RING_ENTRIES = 4096;
+    static constexpr unsigned RECV_BUFFERS = 256;
+    static constexpr unsigned RECV_BUFFER_SIZE = 16 * 1024;
+
+    UringEventLoop(size_t index, const std::vector<std::unique_ptr<EventLoop>>& shards, Persistence& persistence);
+    ~UringEventLoop() override;
+
+    void listen(const std::string& host, int port) override;
+    void run(const std::atomic<bool>& running, int stop_fd) override;
+
+protected:
+    void flush(int client_socket, ClientConnection& connection) override;
+    std::string_view backendName() const override;
+
+private:
+    enum class Operation : uint8_t {
+        ACCEPT,
+        RECV,
+        SEND,
+        WAKEUP,
+        STOP,
+        CANCEL,
+    };
+
+    // A sendmsg in flight reads its message header and iovecs from here
+    struct SendState {
+        msghdr message;
+        iovec iov[OutputBuffer::MAX_IOV];
+        bool in_flight = false;
+    };
+
+    // A connection closed while a send was in flight, kept alive until the
+    // kernel is done with its output buffer
+    struct ClosingConnection {
+        std::unique_ptr<ClientConnection> connection;
+        std::unique_ptr<SendState> send;
+    };
+
+    std::unique_ptr<IoUring> ring_;
+    std::unordered_map<int, std::unique_ptr<SendState>> sends_;
+    std::unordered_map<uint64_t, ClosingConnection> closing_;
+    // Multishot receives that have not completed for good
+    size_t receiving_ = 0;
+    // Connections that stopped receiving until their replies drain, and
+    // whether their receive has completed for good since
+    std::unordered_map<int, bool> paused_;
+
+    void armAccept();
+    void armRecv(int client_socket, uint64_t connection_id);
+    void armPoll(int fd, Operation operation);
+    void pauseRecv(int client_socket, ClientConnection& connection, bool ended);
+    void resumeRecv(int client_socket, ClientConnection& connection);
+    void cancelRequests();
+    void handleCompletion(const io_uring_cqe& cqe);
+    void onAccept(int result, uint32_t flags);
+    void onRecv(int client_socket, uint32_t id_bits, int result, uint32_t flags);
+    void onSend(int client_socket, uint32_t id_bits, int result);
+    void closeConnection(int client_socket);
+    ClientConnection* findConnection(int client_socket, uint32_t id_bits);
+};
+
+} // namespace redis
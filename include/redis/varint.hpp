@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+namespace redis {
+
+// LEB128 lengths of the packed encodings: 7 bits per byte, low bits first,
+// the high bit set on every byte but the last
+namespace varint {
+
+inline size_t size(size_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+inline char* write(char* out, size_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+inline const char* read(const char* in, size_t& value) {
+    value = 0;
+    for (int shift = 0;; shift += 7) {
+        auto byte = static_cast<unsigned char>(*in++);
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return in;
+        }
+    }
+}
+
+} // namespace varint
+
+} // namespace redis
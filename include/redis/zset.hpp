@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace redis {
+
+// When a sorted set leaves the packed encoding for a skiplist, as Redis'
+// zset-max-listpack-entries and zset-max-listpack-value
+struct ZSetLimits {
+    size_t max_packed_entries = 128;
+    size_t max_packed_value = 64;
+};
+
+// Scores from `min` to `max`, either end excluded as with ZRANGEBYSCORE's
+// "(" prefix
+struct ScoreRange {
+    double min;
+    double max;
+    bool min_exclusive = false;
+    bool max_exclusive = false;
+
+    bool aboveMin(double score) const {
+        return min_exclusive ? score > min : score >= min;
+    }
+
+    bool belowMax(double score) const {
+        return max_exclusive ? score < max : score <= max;
+    }
+};
+
+// The shortest text that reads back as `score`, as replies and rewrites
+// write it: "1.5", "3", "-inf". Returns a view of `buffer`.
+std::string_view formatScore(double score, std::array<char, 32>& buffer);
+
+// A set of members ordered by score, then by member bytes for equal scores.
+// Small sorted sets are packed: the entries in order in one buffer, each an
+// 8-byte score, a varint length and the member, searched linearly. Past its
+// ZSetLimits a sorted set converts to a skiplist whose links count the
+// entries they skip, for ranks and rank ranges in O(log n), with a Dict from
+// member to node for scores in O(1). It stays a skiplist.
+class ZSet {
+public:
+    using EntryFn = std::function<void(std::string_view member, double score)>;
+
+    ZSet();
+    ~ZSet();
+
+    ZSet(const ZSet&) = delete;
+    ZSet& operator=(const ZSet&) = delete;
+
+    size_t size() const;
+
+    bool packed() const {
+        return skiplist_ == nullptr;
+    }
+
+    std::optional<double> score(std::string_view member) const;
+    // Set the score of a member, converting to a skiplist first if the set
+    // outgrows `limits`. Returns true if the member is new.
+    bool add(std::string_view member, double score, const ZSetLimits& limits);
+    bool remove(std::string_view member);
+    // Position of a member in ascending order, from 0
+    std::optional<size_t> rank(std::string_view member) const;
+
+    // Positions from `start` to `stop` inclusive, counting from the end when
+    // negative, clamped to the set; nullopt if the range is empty
+    std::optional<std::pair<size_t, size_t>> range(int64_t start, int64_t stop) const;
+    // Call `fn(member, score)` for the positions from `start` to `stop`
+    // inclusive, which must be valid positions with start <= stop
+    void forRange(size_t start, size_t stop, const EntryFn& fn) const;
+    // Call `fn(member, score)` in ascending order for the members with scores
+    // in `range`, skipping the first `offset` of them and stopping after
+    // `count`
+    void forScoreRange(const ScoreRange& range, size_t offset, size_t count, const EntryFn& fn) const;
+    void forEach(const EntryFn& fn) const;
+
+    // Bytes allocated for the members and their index
+    size_t memoryUsage() const;
+
+private:
+    class SkipList;
+
+    char* packed_;
+    uint32_t packed_size_;
+    uint32_t packed_capacity_;
+    // Entries of the packed encoding
+    uint32_t packed_count_;
+    // Set once the set is converted
+    std::unique_ptr<SkipList> skiplist_;
+
+    // Start of the packed entry of `member` and its position, or nullptr
+    const char* findPacked(std::string_view member, size_t* position = nullptr) const;
+    // Replace `size` bytes at `offset` of the packed buffer with
+    // `replacement` uninitialized bytes and return where they start
+    char* splicePacked(size_t offset, size_t size, size_t replacement);
+    void insertPacked(std::string_view member, double score);
+    void removePacked(const char* entry);
+    void convert();
+};
+
+} // namespace redis
@@ -0,0 +1,281 @@
+#include "redis/aof.hpp"
+#include "redis/hash.hpp"
+#include "redis/log.hpp"
+#include "redis/set.hpp"
+#include "redis/zset.hpp"
+#include "redis/mapped_file.hpp"
+#include "redis/protocol.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // Bytes buffered before a write() while rewriting
+    constexpr size_t WRITE_BUFFER_SIZE = 1 << 16;
+    // Elements per command when a rewrite recreates a collection
+    constexpr size_t ITEMS_PER_COMMAND = 64;
+
+    // Appends the commands that recreate a collection of `items` items, each
+    // `width` arguments: `command key item...` with up to ITEMS_PER_COMMAND
+    // items per command. The caller appends each item after calling item().
+    class CollectionWriter {
+    public:
+        CollectionWriter(std::string& out, std::string_view command, std::string_view key, size_t items,
+                         size_t width)
+            : out_(out), command_(command), key_(key), remaining_(items), width_(width), left_(0) {}
+
+        void item() {
+            if (left_ == 0) {
+                left_ = std::min(remaining_, ITEMS_PER_COMMAND);
+                remaining_ -= left_;
+                redis::Protocol::appendArrayHeader(out_, 2 + left_ * width_);
+                redis::Protocol::appendBulkString(out_, command_);
+                redis::Protocol::appendBulkString(out_, key_);
+            }
+            left_--;
+        }
+
+    private:
+        std::string& out_;
+        std::string_view command_;
+        std::string_view key_;
+        size_t remaining_;
+        size_t width_;
+        // Items still to come in the current command
+        size_t left_;
+    };
+
+    int openForAppend(const std::string& path) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            throw std::runtime_error(std::format("Failed to open {}: {}", path, strerror(errno)));
+        }
+        return fd;
+    }
+
+    void writeAll(int fd, std::string_view data) {
+        while (!data.empty()) {
+            ssize_t written = ::write(fd, data.data(), data.size());
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::format("Failed to write append-only file: {}", strerror(errno)));
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+    }
+}
+
+namespace redis {
+
+AppendOnlyFile::AppendOnlyFile(const std::string& path, FsyncPolicy policy)
+    : path_(path), policy_(policy), fd_(openForAppend(path)), rewriting_(false), dirty_(false),
+      stopping_(false) {
+    if (policy_ == FsyncPolicy::EVERYSEC) {
+        sync_thread_ = std::thread(&AppendOnlyFile::syncEverySecond, this);
+    }
+}
+
+AppendOnlyFile::~AppendOnlyFile() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    stop_.notify_one();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
+    }
+    if (policy_ != FsyncPolicy::NO) {
+        ::fdatasync(fd_);
+    }
+    ::close(fd_);
+}
+
+void AppendOnlyFile::append(std::string_view batch) {
+    std::lock_guard lock(mutex_);
+    writeAll(fd_, batch);
+    if (rewriting_) {
+        rewrite_buffer_.append(batch);
+    }
+    if (policy_ == FsyncPolicy::ALWAYS) {
+        if (::fdatasync(fd_) == -1) {
+            throw std::runtime_error(std::format("Failed to sync append-only file: {}", strerror(errno)));
+        }
+    } else if (policy_ == FsyncPolicy::EVERYSEC) {
+        dirty_.store(true, std::memory_order_relaxed);
+    }
+}
+
+void AppendOnlyFile::syncEverySecond() {
+    std::unique_lock lock(mutex_);
+    while (!stop_.wait_for(lock, std::chrono::seconds(1), [this] { return stopping_; })) {
+        if (!dirty_.exchange(false, std::memory_order_relaxed)) {
+            continue;
+        }
+        // Sync a duplicate outside the lock, so appends go on meanwhile and a
+        // rewrite may replace fd_
+        int fd = ::dup(fd_);
+        lock.unlock();
+        if (fd != -1) {
+            if (::fdatasync(fd) == -1) {
+                REDIS_ERROR("Failed to sync append-only file: {}", strerror(errno));
+            }
+            ::close(fd);
+        }
+        lock.lock();
+    }
+}
+
+void AppendOnlyFile::startRewrite() {
+    std::lock_guard lock(mutex_);
+    rewriting_ = true;
+    rewrite_buffer_.clear();
+}
+
+std::string AppendOnlyFile::rewritePath(pid_t child) const {
+    return std::format("{}.rewrite-{}", path_, child);
+}
+
+void AppendOnlyFile::finishRewrite(pid_t child) {
+    std::string temp_path = rewritePath(child);
+    std::lock_guard lock(mutex_);
+    rewriting_ = false;
+    try {
+        // Commands that arrived while the child was writing
+        int fd = openForAppend(temp_path);
+        try {
+            writeAll(fd, rewrite_buffer_);
+            if (::fsync(fd) == -1) {
+                throw std::runtime_error(std::format("Failed to sync {}: {}", temp_path, strerror(errno)));
+            }
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::rename(temp_path.c_str(), path_.c_str()) == -1) {
+            ::close(fd);
+            throw std::runtime_error(std::format("Failed to rename {}: {}", temp_path, strerror(errno)));
+        }
+        ::close(fd_);
+        fd_ = fd;
+    } catch (...) {
+        rewrite_buffer_.clear();
+        ::unlink(temp_path.c_str());
+        throw;
+    }
+    rewrite_buffer_.clear();
+    rewrite_buffer_.shrink_to_fit();
+}
+
+void AppendOnlyFile::abortRewrite(pid_t child) {
+    std::lock_guard lock(mutex_);
+    rewriting_ = false;
+    rewrite_buffer_.clear();
+    rewrite_buffer_.shrink_to_fit();
+    ::unlink(rewritePath(child).c_str());
+}
+
+void AppendOnlyFile::writeCommands(const std::string& path, const std::vector<Storage*>& shards) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error(std::format("Failed to create {}: {}", path, strerror(errno)));
+    }
+    try {
+        std::string buffer;
+        buffer.reserve(WRITE_BUFFER_SIZE);
+        for (Storage* shard : shards) {
+            shard->forEach([&](const Object& object, int64_t expire_at) {
+                if (object.type() == ValueType::ZSET) {
+                    CollectionWriter writer(buffer, "ZADD", object.key(), object.zset().size(), 2);
+                    object.zset().forEach([&](std::string_view member, double score) {
+                        std::array<char, 32> text;
+                        writer.item();
+                        Protocol::appendBulkString(buffer, formatScore(score, text));
+                        Protocol::appendBulkString(buffer, member);
+                    });
+                } else if (object.type() == ValueType::SET) {
+                    CollectionWriter writer(buffer, "SADD", object.key(), object.set().size(), 1);
+                    object.set().forEach([&](std::string_view member) {
+                        writer.item();
+                        Protocol::appendBulkString(buffer, member);
+                    });
+                } else if (object.type() == ValueType::HASH) {
+                    CollectionWriter writer(buffer, "HSET", object.key(), object.hash().size(), 2);
+                    object.hash().forEach([&](std::string_view field, std::string_view value) {
+                        writer.item();
+                        Protocol::appendBulkString(buffer, field);
+                        Protocol::appendBulkString(buffer, value);
+                    });
+                } else if (object.type() == ValueType::LIST) {
+                    CollectionWriter writer(buffer, "RPUSH", object.key(), object.list().size(), 1);
+                    object.list().forEach([&](std::string_view value) {
+                        writer.item();
+                        Protocol::appendBulkString(buffer, value);
+                    });
+                } else {
+                    StringValue value = object.string();
+                    Protocol::appendCommand(buffer, std::array{std::string_view("SET"), object.key(), value.view()});
+                }
+                if (expire_at != 0) {
+                    std::string timestamp = std::to_string(expire_at);
+                    Protocol::appendCommand(buffer, std::array{std::string_view("PEXPIREAT"), object.key(),
+                                                               std::string_view(timestamp)});
+                }
+                if (buffer.size() >= WRITE_BUFFER_SIZE) {
+                    writeAll(fd, buffer);
+                    buffer.clear();
+                }
+            });
+        }
+        writeAll(fd, buffer);
+        if (::fsync(fd) == -1) {
+            throw std::runtime_error(std::format("Failed to sync {}: {}", path, strerror(errno)));
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(path.c_str());
+        throw;
+    }
+    ::close(fd);
+}
+
+size_t AppendOnlyFile::replay(const std::string& path, const std::function<void(CommandArgsSpan)>& fn) {
+    auto file = MappedFile::open(path);
+    if (file == nullptr) {
+        return 0;
+    }
+    std::string_view data = file->view();
+    std::string_view pending = data;
+    RequestParser parser;
+    size_t commands = 0;
+    while (!pending.empty()) {
+        auto command = parser.next(pending);
+        if (!command.has_value()) {
+            throw std::runtime_error(std::format("Bad file format reading the append only file {} at offset {}: {}",
+                                                 path, data.size() - pending.size(), command.error()));
+        }
+        if (!command->has_value()) {
+            break;
+        }
+        fn(command->value());
+        commands++;
+    }
+
+    if (!pending.empty()) {
+        auto valid = static_cast<off_t>(data.size() - pending.size());
+        REDIS_WARN("{} ends with an incomplete command, truncating it to {} bytes", path, valid);
+        if (::truncate(path.c_str(), valid) == -1) {
+            throw std::runtime_error(std::format("Failed to truncate {}: {}", path, strerror(errno)));
+        }
+    }
+    return commands;
+}
+
+} // namespace redis
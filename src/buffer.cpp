@@ -0,0 +1,182 @@
+#include "redis/buffer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <sys/uio.h>
+
+namespace redis {
+
+InputBuffer::InputBuffer()
+    : data_(std::make_unique_for_overwrite<char[]>(INITIAL_CAPACITY)),
+      capacity_(INITIAL_CAPACITY), read_pos_(0), write_pos_(0) {
+}
+
+std::string_view InputBuffer::readable() const {
+    return std::string_view(data_.get() + read_pos_, write_pos_ - read_pos_);
+}
+
+size_t InputBuffer::size() const {
+    return write_pos_ - read_pos_;
+}
+
+size_t InputBuffer::capacity() const {
+    return capacity_;
+}
+
+void InputBuffer::consume(size_t n) {
+    read_pos_ += std::min(n, size());
+    if (read_pos_ != write_pos_) {
+        return;
+    }
+    read_pos_ = 0;
+    write_pos_ = 0;
+    if (capacity_ > MAX_IDLE_CAPACITY) {
+        data_ = std::make_unique_for_overwrite<char[]>(INITIAL_CAPACITY);
+        capacity_ = INITIAL_CAPACITY;
+    }
+}
+
+void InputBuffer::reserve(size_t n) {
+    if (n > size()) {
+        ensureWritable(n - size());
+    }
+}
+
+void InputBuffer::append(std::string_view data) {
+    ensureWritable(data.size());
+    std::memcpy(data_.get() + write_pos_, data.data(), data.size());
+    write_pos_ += data.size();
+}
+
+ssize_t InputBuffer::readFrom(int fd) {
+    char spill[SPILL_SIZE];
+    size_t writable = capacity_ - write_pos_;
+    iovec iov[2];
+    iov[0].iov_base = data_.get() + write_pos_;
+    iov[0].iov_len = writable;
+    iov[1].iov_base = spill;
+    iov[1].iov_len = sizeof(spill);
+
+    ssize_t bytes_read = ::readv(fd, iov, 2);
+    if (bytes_read <= 0) {
+        return bytes_read;
+    }
+    if (static_cast<size_t>(bytes_read) <= writable) {
+        write_pos_ += bytes_read;
+    } else {
+        write_pos_ = capacity_;
+        append(std::string_view(spill, bytes_read - writable));
+    }
+    return bytes_read;
+}
+
+void InputBuffer::ensureWritable(size_t n) {
+    if (capacity_ - write_pos_ >= n) {
+        return;
+    }
+    size_t live = size();
+    // Slide the live bytes to the front only when they are no larger than the
+    // dead prefix, so every byte is moved O(1) times on average
+    if (read_pos_ + (capacity_ - write_pos_) >= n && live <= read_pos_) {
+        std::memmove(data_.get(), data_.get() + read_pos_, live);
+    } else {
+        size_t new_capacity = std::max(capacity_ * 2, live + n);
+        auto new_data = std::make_unique_for_overwrite<char[]>(new_capacity);
+        std::memcpy(new_data.get(), data_.get() + read_pos_, live);
+        data_ = std::move(new_data);
+        capacity_ = new_capacity;
+    }
+    read_pos_ = 0;
+    write_pos_ = live;
+}
+
+void OutputBuffer::append(std::string&& data) {
+    if (data.size() < CHUNK_SIZE) {
+        append(std::string_view(data));
+        return;
+    }
+    size_ += data.size();
+    chunks_.push_back(std::move(data));
+}
+
+void OutputBuffer::append(std::string_view data) {
+    if (data.empty()) {
+        return;
+    }
+    appendableChunk(data.size()).append(data);
+    size_ += data.size();
+}
+
+bool OutputBuffer::empty() const {
+    return size_ == 0;
+}
+
+size_t OutputBuffer::size() const {
+    return size_;
+}
+
+bool OutputBuffer::flushTo(int fd) {
+    iovec iov[MAX_IOV];
+    while (!chunks_.empty()) {
+        size_t count = gather(iov, MAX_IOV);
+        ssize_t written = ::writev(fd, iov, static_cast<int>(count));
+        if (written == -1) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                return false;
+            }
+            throw std::runtime_error(std::format("Failed to write to socket: {}", strerror(errno)));
+        }
+        consume(written);
+    }
+    return true;
+}
+
+size_t OutputBuffer::gather(iovec* iov, size_t max_iov) {
+    size_t count = 0;
+    for (auto it = chunks_.begin(); it != chunks_.end() && count < max_iov; ++it, ++count) {
+        size_t offset = count == 0 ? front_offset_ : 0;
+        iov[count].iov_base = it->data() + offset;
+        iov[count].iov_len = it->size() - offset;
+    }
+    return count;
+}
+
+std::string& OutputBuffer::appendableChunk(size_t n) {
+    if (!chunks_.empty()) {
+        // Large replies are at least CHUNK_SIZE long, so this never appends
+        // behind one and copies it. Appending to a partially sent front chunk
+        // is fine: the sent prefix stays where it is.
+        auto& back = chunks_.back();
+        if (back.size() + n <= CHUNK_SIZE) {
+            return back;
+        }
+    }
+    std::string chunk = std::move(spare_);
+    spare_ = std::string();
+    chunk.clear();
+    chunk.reserve(CHUNK_SIZE);
+    chunks_.push_back(std::move(chunk));
+    return chunks_.back();
+}
+
+void OutputBuffer::consume(size_t n) {
+    size_ -= n;
+    while (n > 0) {
+        auto& front = chunks_.front();
+        size_t remaining = front.size() - front_offset_;
+        if (n < remaining) {
+            front_offset_ += n;
+            return;
+        }
+        n -= remaining;
+        front_offset_ = 0;
+        if (front.capacity() < 2 * CHUNK_SIZE && spare_.capacity() == 0) {
+            spare_ = std::move(front);
+        }
+        chunks_.pop_front();
+    }
+}
+
+} // namespace redis
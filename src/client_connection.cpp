@@ -1,18 +1,23 @@
 #include "redis/client_connection.hpp"
-#include "redis/database.hpp"
+#include "redis/event_loop.hpp"
+#include "redis/log.hpp"
 #include "redis/protocol.hpp"
 #include <format>
 #include <unistd.h>
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
-#include <spdlog/spdlog.h>
+// Once this many reply bytes are queued, the connection stops reading new
+// commands until the client has drained them
+const constexpr size_t OUTPUT_HIGH_WATER = 1024 * 1024;
 
 namespace redis {
 
 // ClientConnection implementation
-ClientConnection::ClientConnection(int socket_fd, Database& db)
-    : socket_fd_(socket_fd), database_(db), active_(true) {
+ClientConnection::ClientConnection(int socket_fd, EventLoop& loop, uint64_t id)
+    : socket_fd_(socket_fd), id_(id), loop_(loop), active_(true), first_deferred_slot_(0),
+      close_after_reply_(false) {
 }
 
 ClientConnection::~ClientConnection() {
@@ -20,20 +25,68 @@ ClientConnection::~ClientConnection() {
 }
 
 void ClientConnection::handle() {
-    auto request = readRequest();
-    spdlog::debug("Received request: {}", request);
-    auto commands = Protocol::parseCommand(request);
-    if (!active_) {
+    // Commands are executed after every read, so a long pipeline does not pile
+    // up in the input buffer before the first of them is processed
+    while (!close_after_reply_ && readRequest()) {
+        processInput();
+        if (!outputFull()) {
+            continue;
+        }
+        // Replies may only leave once their commands are in the append-only file
+        loop_.flushAppendOnly();
+        if (!output_.flushTo(socket_fd_)) {
+            // The rest of the input is read once the socket is writable again
+            break;
+        }
+    }
+}
+
+void ClientConnection::receive(std::string_view data) {
+    if (close_after_reply_) {
         return;
     }
-    if (!commands.has_value()) {
-        response_queue_.push(Protocol::serializeError(commands.error()));
-    } else {
-        for (const auto& command : commands.value()) {
-            response_queue_.push(database_.executeCommand(command));
+    input_.append(data);
+    processInput(true);
+}
+
+OutputBuffer& ClientConnection::output() {
+    return output_;
+}
+
+bool ClientConnection::outputFull() const {
+    return output_.size() >= OUTPUT_HIGH_WATER;
+}
+
+void ClientConnection::processInput(bool until_output_full) {
+    std::string_view pending = input_.readable();
+    REDIS_DEBUG("Received request: {}", pending);
+    // The commands of this read run back to back and share their timestamps
+    CommandClock& clock = loop_.database().clock();
+    clock.beginBatch();
+    while (!pending.empty() && !(until_output_full && outputFull())) {
+        auto command = parser_.next(pending);
+        if (!command.has_value()) {
+            // The stream cannot be resynchronized after a malformed frame
+            appendReply(Protocol::serializeError(command.error()));
+            parser_.reset();
+            close_after_reply_ = true;
+            pending = {};
+            break;
+        }
+        if (!command->has_value()) {
+            break;
+        }
+        auto reply = loop_.execute(*this, command->value());
+        if (reply.has_value()) {
+            appendReply(std::move(reply.value()));
         }
     }
-    sendResponse();
+    clock.endBatch();
+    input_.consume(input_.size() - pending.size());
+    // Grow towards the announced frame size only as fast as its bytes arrive,
+    // so a client cannot make the server allocate a body it never sends
+    input_.reserve(std::min(parser_.frameSizeHint(),
+                            std::max(2 * input_.size(), InputBuffer::INITIAL_CAPACITY)));
 }
 
 void ClientConnection::close() {
@@ -47,55 +100,74 @@ bool ClientConnection::isActive() const {
     return active_;
 }
 
-std::string ClientConnection::readRequest() {
-    static char buffer[1024];
-    while (true) {
-        ssize_t bytes_read = ::read(socket_fd_, buffer, sizeof(buffer));
-        if (bytes_read == -1) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                spdlog::debug("Finished reading from socket {}", socket_fd_);
-                break;
-            }
-            if (errno == ECONNRESET) {
-                spdlog::debug("Client socket {} closed by peer", socket_fd_);
-                close();
-                break;
-            }
-            throw std::runtime_error(std::format("Failed to read from socket: {}", strerror(errno)));
-        } else if (bytes_read == 0) {
-            spdlog::debug("Client socket {} closed by peer", socket_fd_);
+int ClientConnection::socket() const {
+    return socket_fd_;
+}
+
+uint64_t ClientConnection::id() const {
+    return id_;
+}
+
+uint64_t ClientConnection::reserveReply() {
+    deferred_replies_.emplace_back(std::nullopt);
+    return first_deferred_slot_ + deferred_replies_.size() - 1;
+}
+
+void ClientConnection::deliverReply(uint64_t slot, std::string reply) {
+    deferred_replies_[slot - first_deferred_slot_] = std::move(reply);
+    while (!deferred_replies_.empty() && deferred_replies_.front().has_value()) {
+        output_.append(std::move(deferred_replies_.front().value()));
+        deferred_replies_.pop_front();
+        first_deferred_slot_++;
+    }
+}
+
+void ClientConnection::appendReply(std::string reply) {
+    if (deferred_replies_.empty()) {
+        output_.append(std::move(reply));
+    } else {
+        deferred_replies_.emplace_back(std::move(reply));
+    }
+}
+
+bool ClientConnection::readRequest() {
+    ssize_t bytes_read = input_.readFrom(socket_fd_);
+    if (bytes_read == -1) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN) {
+            REDIS_DEBUG("Finished reading from socket {}", socket_fd_);
+            return false;
+        }
+        if (errno == ECONNRESET) {
+            REDIS_DEBUG("Client socket {} closed by peer", socket_fd_);
             close();
-            break;
+            return false;
         }
-        spdlog::debug("Read {} bytes from socket {}", bytes_read, socket_fd_);
-        buffer_.write(buffer, bytes_read);
+        throw std::runtime_error(std::format("Failed to read from socket: {}", strerror(errno)));
+    } else if (bytes_read == 0) {
+        REDIS_DEBUG("Client socket {} closed by peer", socket_fd_);
+        close();
+        return false;
     }
-    auto result = buffer_.str();
-    buffer_.str("");
-    buffer_.clear();
-    return result;
+    REDIS_DEBUG("Read {} bytes from socket {}", bytes_read, socket_fd_);
+    return true;
 }
 
 void ClientConnection::sendResponse() {
-    while (!response_queue_.empty()) {
-        auto& reply = response_queue_.front();
-        spdlog::debug("Sending response: {}", reply);
-        auto result = ::write(socket_fd_, reply.c_str(), reply.length());
-        if (result == -1) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                spdlog::debug("Socket {} is not ready for writing", socket_fd_);
-                break;
-            }
-            throw std::runtime_error(std::format("Failed to write to socket: {}", strerror(errno)));
-        }
-        spdlog::debug("Wrote {} bytes to socket {}", result, socket_fd_);
-        response_queue_.pop();
+    if (output_.empty()) {
+        return;
+    }
+    REDIS_DEBUG("Sending {} bytes to socket {}", output_.size(), socket_fd_);
+    if (!output_.flushTo(socket_fd_)) {
+        REDIS_DEBUG("Socket {} is not ready for writing, {} bytes pending", socket_fd_, output_.size());
     }
 }
 
 bool ClientConnection::hasPendingData() const {
-    return !response_queue_.empty();
+    return !output_.empty();
 }
 
-} // namespace redis
+bool ClientConnection::readyToClose() const {
+    return close_after_reply_ && output_.empty() && deferred_replies_.empty();
+}
 
+} // namespace redis
@@ -1,34 +1,21 @@
 #include "redis/command.hpp"
 #include <algorithm>
-#include <sstream>
+#include <cctype>
 
 namespace redis {
 
-Command::Command() {
-    // TODO: Register default command handlers
-}
-
-Command::~Command() {
-}
-
-std::pair<std::string, CommandArgs> Command::parse(const std::string& input) {
-    // TODO: Implement command parsing
-    return {"", {}};
-}
-
-void Command::registerHandler(const std::string& command, CommandHandler handler) {
-    // TODO: Implement handler registration
-}
-
-std::string Command::execute(const std::string& command, const CommandArgs& args) {
-    // TODO: Implement command execution
-    return "";
-}
-
-bool Command::exists(const std::string& command) const {
-    // TODO: Implement command existence check
-    return false;
+const Command* findCommand(std::span<const Command> commands, std::span<const uint8_t> slots, uint64_t seed,
+                           std::string_view name) {
+    uint8_t index = slots[commandSlot(hashCommandName(name, seed), slots.size())];
+    if (index >= commands.size()) {
+        return nullptr;
+    }
+    const Command& command = commands[index];
+    // Table names are upper case, so only `name` needs folding
+    bool matches = std::ranges::equal(command.name, name, [](char upper, char c) {
+        return upper == static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    });
+    return matches ? &command : nullptr;
 }
 
 } // namespace redis
-
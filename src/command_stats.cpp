@@ -0,0 +1,91 @@
+#include "redis/command_stats.hpp"
+#include <cmath>
+#include <thread>
+
+namespace redis {
+
+double nanosPerCycle() {
+    static const double ratio = [] {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t first = readCycles();
+        // Long enough for the clock reads to be a small part of it
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        uint64_t cycles = readCycles() - first;
+        auto nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return cycles == 0 ? 1.0 : nanos / static_cast<double>(cycles);
+    }();
+    return ratio;
+}
+
+uint64_t LatencyHistogram::total() const {
+    uint64_t sum = 0;
+    for (const auto& count : counts_) {
+        sum += count.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        bump(counts_[bucket], other.count(bucket));
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const {
+    uint64_t values = total();
+    if (values == 0) {
+        return 0;
+    }
+    auto rank = static_cast<uint64_t>(std::ceil(percent / 100 * static_cast<double>(values)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += count(bucket);
+        if (seen >= std::max<uint64_t>(rank, 1)) {
+            return bucketLimit(bucket);
+        }
+    }
+    return bucketLimit(BUCKETS - 1);
+}
+
+CommandStats::CommandStats(size_t commands)
+    : entries_(std::make_unique<Entry[]>(commands)), size_(commands), nanos_per_cycle_(nanosPerCycle()) {
+}
+
+uint64_t CommandStats::totalCalls() const {
+    uint64_t calls = 0;
+    for (size_t i = 0; i < size_; i++) {
+        calls += entries_[i].calls.load(std::memory_order_relaxed);
+    }
+    return calls;
+}
+
+void CommandStats::merge(const CommandStats& other) {
+    for (size_t i = 0; i < std::min(size_, other.size_); i++) {
+        Entry& entry = entries_[i];
+        const Entry& added = other.entries_[i];
+        bump(entry.calls, added.calls.load(std::memory_order_relaxed));
+        bump(entry.nanos, added.nanos.load(std::memory_order_relaxed));
+        bump(entry.rejected, added.rejected.load(std::memory_order_relaxed));
+        bump(entry.failed, added.failed.load(std::memory_order_relaxed));
+        entry.latency.merge(added.latency);
+    }
+}
+
+void CommandStats::reset() {
+    for (size_t i = 0; i < size_; i++) {
+        Entry& entry = entries_[i];
+        entry.calls.store(0, std::memory_order_relaxed);
+        entry.nanos.store(0, std::memory_order_relaxed);
+        entry.rejected.store(0, std::memory_order_relaxed);
+        entry.failed.store(0, std::memory_order_relaxed);
+        entry.latency.reset();
+    }
+}
+
+} // namespace redis
@@ -1,66 +1,911 @@
 #include "redis/database.hpp"
+#include "redis/glob.hpp"
 #include "redis/protocol.hpp"
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
 #include <format>
-#include <functional>
-#include <ranges>
+#include <limits>
+#include <optional>
 
 namespace redis {
 
 namespace {
-    using CommandHandler = std::function<std::string(const CommandArgsSpan&, redis::Storage&)>;
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return std::ranges::equal(a, b, [](char x, char y) {
+            return std::toupper(static_cast<unsigned char>(x)) == std::toupper(static_cast<unsigned char>(y));
+        });
+    }
+
+    std::optional<int64_t> parseInteger(std::string_view arg) {
+        int64_t value = 0;
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc() || end != arg.data() + arg.size()) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // A score as ZADD takes it: a float, "+inf" or "-inf", never NaN
+    std::optional<double> parseScore(std::string_view arg) {
+        if (arg.size() > 1 && arg[0] == '+' && arg[1] != '-') {
+            arg.remove_prefix(1);
+        }
+        double value = 0;
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc() || end != arg.data() + arg.size() || std::isnan(value)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Name of a type as SCAN's TYPE option spells it
+    std::optional<ValueType> parseTypeName(std::string_view name) {
+        constexpr std::array<std::pair<std::string_view, ValueType>, 5> names{{
+            {"string", ValueType::STRING},
+            {"list", ValueType::LIST},
+            {"set", ValueType::SET},
+            {"hash", ValueType::HASH},
+            {"zset", ValueType::ZSET},
+        }};
+        for (const auto& [type_name, type] : names) {
+            if (equalsIgnoreCase(name, type_name)) {
+                return type;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // An increment as INCRBYFLOAT takes it, never NaN
+    std::optional<long double> parseFloat(std::string_view arg) {
+        long double value = 0;
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc() || end != arg.data() + arg.size() || std::isnan(value)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Absolute expire time in milliseconds for a relative `amount` in
+    // `unit_ms` units, or nullopt if it overflows
+    std::optional<int64_t> expireTime(int64_t amount, int64_t unit_ms) {
+        const int64_t max = std::numeric_limits<int64_t>::max();
+        int64_t now = redis::Storage::now();
+        if (amount > (max - now) / unit_ms || amount < -(max - now) / unit_ms) {
+            return std::nullopt;
+        }
+        return now + amount * unit_ms;
+    }
 
     std::string handleSet(const CommandArgsSpan& args, redis::Storage& storage) {
-        if (args.size() < 2) {
-            return Protocol::serializeError("Invalid command arguments");
+        std::string_view key = args[0];
+        std::string_view value = args[1];
+
+        // SET key value [NX | XX] [EX seconds | PX milliseconds]
+        bool nx = false;
+        bool xx = false;
+        std::optional<int64_t> expire_at;
+        for (size_t i = 2; i < args.size(); i++) {
+            if (equalsIgnoreCase(args[i], "NX") && !xx) {
+                nx = true;
+            } else if (equalsIgnoreCase(args[i], "XX") && !nx) {
+                xx = true;
+            } else if ((equalsIgnoreCase(args[i], "EX") || equalsIgnoreCase(args[i], "PX")) &&
+                       !expire_at.has_value() && i + 1 < args.size()) {
+                int64_t unit_ms = equalsIgnoreCase(args[i], "EX") ? 1000 : 1;
+                auto amount = parseInteger(args[++i]);
+                if (!amount.has_value()) {
+                    return Protocol::serializeError("ERR value is not an integer or out of range");
+                }
+                expire_at = *amount > 0 ? expireTime(*amount, unit_ms) : std::nullopt;
+                if (!expire_at.has_value()) {
+                    return Protocol::serializeError("ERR invalid expire time in 'set' command");
+                }
+            } else {
+                return Protocol::serializeError("ERR syntax error");
+            }
         }
-        const std::string& key = args[0];
-        const std::string& value = args[1];
-        storage.set(key, value);
+
+        if ((nx || xx) && storage.exists(key) != xx) {
+            return Protocol::serializeNullBulkString();
+        }
+        storage.set(key, value, expire_at);
         return Protocol::serializeSimpleString("OK");
     }
 
     std::string handleGet(const CommandArgsSpan& args, redis::Storage& storage) {
-        if (args.size() != 1) {
-            return Protocol::serializeError("Invalid command arguments");
-        }
-        const std::string& key = args[0];
+        std::string_view key = args[0];
         auto result = storage.get(key);
         if (result.has_value()) {
-            auto value = result.value();
+            const auto& value = result.value();
             if (value.has_value()) {
-                return Protocol::serializeBulkString(value.value());
+                return Protocol::serializeBulkString(value->view());
             }
             return Protocol::serializeNullBulkString();
         }
         return Protocol::serializeError(result.error());
     }   
 
+    std::string increment(const CommandArgsSpan& args, redis::Storage& storage, int64_t delta) {
+        auto value = storage.increment(args[0], delta);
+        if (!value.has_value()) {
+            return Protocol::serializeError(value.error());
+        }
+        return Protocol::serializeInteger(*value);
+    }
+
+    std::string handleIncr(const CommandArgsSpan& args, redis::Storage& storage) {
+        return increment(args, storage, 1);
+    }
+
+    std::string handleDecr(const CommandArgsSpan& args, redis::Storage& storage) {
+        return increment(args, storage, -1);
+    }
+
+    std::string handleIncrby(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto delta = parseInteger(args[1]);
+        if (!delta.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        return increment(args, storage, *delta);
+    }
+
+    std::string handleDecrby(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto delta = parseInteger(args[1]);
+        if (!delta.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        if (*delta == std::numeric_limits<int64_t>::min()) {
+            return Protocol::serializeError("ERR decrement would overflow");
+        }
+        return increment(args, storage, -*delta);
+    }
+
+    std::string handleIncrbyfloat(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto delta = parseFloat(args[1]);
+        if (!delta.has_value()) {
+            return Protocol::serializeError("ERR value is not a valid float");
+        }
+        auto value = storage.incrementFloat(args[0], *delta);
+        if (!value.has_value()) {
+            return Protocol::serializeError(value.error());
+        }
+        return Protocol::serializeBulkString(*value);
+    }
+
+    std::string handleAppend(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto size = storage.append(args[0], args[1]);
+        if (!size.has_value()) {
+            return Protocol::serializeError(size.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*size));
+    }
+
+    std::string handleGetrange(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto start = parseInteger(args[1]);
+        auto end = parseInteger(args[2]);
+        if (!start.has_value() || !end.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        auto value = storage.get(args[0]);
+        if (!value.has_value()) {
+            return Protocol::serializeError(value.error());
+        }
+        std::string_view bytes = value->has_value() ? (*value)->view() : std::string_view();
+        auto size = static_cast<int64_t>(bytes.size());
+        // Negative offsets count from the end, as in Redis
+        if (*start < 0 && *end < 0 && *start > *end) {
+            return Protocol::serializeBulkString("");
+        }
+        int64_t first = *start < 0 ? std::max<int64_t>(size + *start, 0) : *start;
+        int64_t last = *end < 0 ? std::max<int64_t>(size + *end, 0) : std::min(*end, size - 1);
+        if (first > last || size == 0) {
+            return Protocol::serializeBulkString("");
+        }
+        return Protocol::serializeBulkString(bytes.substr(first, last - first + 1));
+    }
+
+    std::string handleSetrange(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto offset = parseInteger(args[1]);
+        if (!offset.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        if (*offset < 0) {
+            return Protocol::serializeError("ERR offset is out of range");
+        }
+        auto size = storage.setRange(args[0], static_cast<size_t>(*offset), args[2]);
+        if (!size.has_value()) {
+            return Protocol::serializeError(size.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*size));
+    }
+
     std::string handleDel(const CommandArgsSpan& args, redis::Storage& storage) {
-        if (args.empty()) {
-            return Protocol::serializeError("Empty command arguments");
+        return Protocol::serializeInteger(static_cast<int64_t>(storage.delMany(args)));
+    }
+
+    std::string handleExists(const CommandArgsSpan& args, redis::Storage& storage) {
+        return Protocol::serializeInteger(static_cast<int64_t>(storage.existsMany(args)));
+    }   
+
+    std::string handleMget(const CommandArgsSpan& args, redis::Storage& storage) {
+        std::string reply;
+        Protocol::appendArrayHeader(reply, args.size());
+        storage.getMany(args, [&reply](const std::optional<StringValue>& value) {
+            if (value.has_value()) {
+                Protocol::appendBulkString(reply, value->view());
+            } else {
+                reply += Protocol::serializeNullBulkString();
+            }
+        });
+        return reply;
+    }
+
+    std::string handleMset(const CommandArgsSpan& args, redis::Storage& storage) {
+        if (args.size() % 2 != 0) {
+            return Protocol::serializeError("ERR wrong number of arguments for 'mset' command");
         }
-        int count = 0;
-        for (const auto& key : args) {
-            if (storage.del(key)) {
-                count++;
+        storage.setMany(args);
+        return Protocol::serializeSimpleString("OK");
+    }
+
+    std::string handleMsetnx(const CommandArgsSpan& args, redis::Storage& storage) {
+        if (args.size() % 2 != 0) {
+            return Protocol::serializeError("ERR wrong number of arguments for 'msetnx' command");
+        }
+        return Protocol::serializeInteger(storage.setMany(args, true) ? 1 : 0);
+    }
+
+    std::string expire(const CommandArgsSpan& args, redis::Storage& storage, int64_t unit_ms) {
+        auto amount = parseInteger(args[1]);
+        if (!amount.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        auto when = expireTime(*amount, unit_ms);
+        if (!when.has_value()) {
+            return Protocol::serializeError("ERR invalid expire time in 'expire' command");
+        }
+        return Protocol::serializeInteger(storage.expireAt(args[0], *when) ? 1 : 0);
+    }
+
+    std::string handleExpire(const CommandArgsSpan& args, redis::Storage& storage) {
+        return expire(args, storage, 1000);
+    }
+
+    std::string handlePexpire(const CommandArgsSpan& args, redis::Storage& storage) {
+        return expire(args, storage, 1);
+    }
+
+    std::string handlePexpireat(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto when = parseInteger(args[1]);
+        if (!when.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        return Protocol::serializeInteger(storage.expireAt(args[0], *when) ? 1 : 0);
+    }
+
+    std::string handleTtl(const CommandArgsSpan& args, redis::Storage& storage) {
+        int64_t ttl = storage.ttl(args[0]);
+        // Round to the nearest second like Redis does
+        return Protocol::serializeInteger(ttl < 0 ? ttl : (ttl + 500) / 1000);
+    }
+
+    std::string handlePttl(const CommandArgsSpan& args, redis::Storage& storage) {
+        return Protocol::serializeInteger(storage.ttl(args[0]));
+    }
+
+    std::string handlePersist(const CommandArgsSpan& args, redis::Storage& storage) {
+        return Protocol::serializeInteger(storage.persist(args[0]) ? 1 : 0);
+    }
+
+    std::string push(const CommandArgsSpan& args, redis::Storage& storage, ListEnd end) {
+        auto length = storage.push(args[0], end, args.subspan(1));
+        if (!length.has_value()) {
+            return Protocol::serializeError(length.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*length));
+    }
+
+    std::string handleLpush(const CommandArgsSpan& args, redis::Storage& storage) {
+        return push(args, storage, ListEnd::HEAD);
+    }
+
+    std::string handleRpush(const CommandArgsSpan& args, redis::Storage& storage) {
+        return push(args, storage, ListEnd::TAIL);
+    }
+
+    std::string pop(const CommandArgsSpan& args, redis::Storage& storage, ListEnd end) {
+        // LPOP key [count]: a single element, or an array when count is given
+        if (args.size() > 2) {
+            return Protocol::serializeError("Invalid command arguments");
+        }
+        size_t count = 1;
+        if (args.size() == 2) {
+            auto parsed = parseInteger(args[1]);
+            if (!parsed.has_value() || *parsed < 0) {
+                return Protocol::serializeError("ERR value is out of range, must be positive");
             }
+            count = static_cast<size_t>(*parsed);
+        }
+        auto values = storage.pop(args[0], end, count);
+        if (!values.has_value()) {
+            return Protocol::serializeError(values.error());
+        }
+        if (args.size() == 1) {
+            return values->empty() ? Protocol::serializeNullBulkString() : Protocol::serializeBulkString(values->front());
+        }
+        if (values->empty() && count > 0) {
+            return Protocol::serializeNullArray();
         }
-        return Protocol::serializeInteger(count);
+        return Protocol::serializeArray(*values);
     }
 
-    std::string handleExists(const CommandArgsSpan& args, redis::Storage& storage) {
-        if (args.empty()) {
-            return Protocol::serializeError("Empty command arguments");
+    std::string handleLpop(const CommandArgsSpan& args, redis::Storage& storage) {
+        return pop(args, storage, ListEnd::HEAD);
+    }
+
+    std::string handleRpop(const CommandArgsSpan& args, redis::Storage& storage) {
+        return pop(args, storage, ListEnd::TAIL);
+    }
+
+    std::string handleLlen(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto list = storage.list(args[0]);
+        if (!list.has_value()) {
+            return Protocol::serializeError(list.error());
+        }
+        return Protocol::serializeInteger(*list == nullptr ? 0 : static_cast<int64_t>((*list)->size()));
+    }
+
+    std::string handleLindex(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto index = parseInteger(args[1]);
+        if (!index.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        auto list = storage.list(args[0]);
+        if (!list.has_value()) {
+            return Protocol::serializeError(list.error());
+        }
+        std::optional<std::string_view> value;
+        if (*list != nullptr) {
+            value = (*list)->index(*index);
+        }
+        return value.has_value() ? Protocol::serializeBulkString(*value) : Protocol::serializeNullBulkString();
+    }
+
+    std::string handleLrange(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto start = parseInteger(args[1]);
+        auto stop = parseInteger(args[2]);
+        if (!start.has_value() || !stop.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
         }
-        int count = 0;
-        for (const auto& key : args) {
-            if (storage.exists(key)) {
-                count++;
+        auto list = storage.list(args[0]);
+        if (!list.has_value()) {
+            return Protocol::serializeError(list.error());
+        }
+        auto range = *list == nullptr ? std::nullopt : (*list)->range(*start, *stop);
+        if (!range.has_value()) {
+            return "*0\r\n";
+        }
+        // Serialize straight from the list nodes
+        std::string reply;
+        Protocol::appendArrayHeader(reply, range->second - range->first + 1);
+        (*list)->forRange(range->first, range->second, [&reply](std::string_view value) {
+            Protocol::appendBulkString(reply, value);
+        });
+        return reply;
+    }
+
+    std::string handleLtrim(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto start = parseInteger(args[1]);
+        auto stop = parseInteger(args[2]);
+        if (!start.has_value() || !stop.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        auto trimmed = storage.trim(args[0], *start, *stop);
+        if (!trimmed.has_value()) {
+            return Protocol::serializeError(trimmed.error());
+        }
+        return Protocol::serializeSimpleString("OK");
+    }
+
+    std::string handleHset(const CommandArgsSpan& args, redis::Storage& storage) {
+        if (args.size() % 2 == 0) {
+            return Protocol::serializeError("ERR wrong number of arguments for 'hset' command");
+        }
+        auto added = storage.hashSet(args[0], args.subspan(1));
+        if (!added.has_value()) {
+            return Protocol::serializeError(added.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*added));
+    }
+
+    std::string handleHget(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto hash = storage.hash(args[0]);
+        if (!hash.has_value()) {
+            return Protocol::serializeError(hash.error());
+        }
+        std::optional<StringValue> value;
+        if (*hash != nullptr) {
+            value = (*hash)->get(args[1]);
+        }
+        return value.has_value() ? Protocol::serializeBulkString(value->view()) : Protocol::serializeNullBulkString();
+    }
+
+    std::string handleHmget(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto hash = storage.hash(args[0]);
+        if (!hash.has_value()) {
+            return Protocol::serializeError(hash.error());
+        }
+        std::string reply;
+        Protocol::appendArrayHeader(reply, args.size() - 1);
+        for (std::string_view field : args.subspan(1)) {
+            std::optional<StringValue> value;
+            if (*hash != nullptr) {
+                value = (*hash)->get(field);
+            }
+            if (value.has_value()) {
+                Protocol::appendBulkString(reply, value->view());
+            } else {
+                reply += Protocol::serializeNullBulkString();
             }
         }
-        return Protocol::serializeInteger(count);
-    }   
+        return reply;
+    }
+
+    std::string handleHdel(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto deleted = storage.hashDelete(args[0], args.subspan(1));
+        if (!deleted.has_value()) {
+            return Protocol::serializeError(deleted.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*deleted));
+    }
+
+    std::string handleHgetall(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto hash = storage.hash(args[0]);
+        if (!hash.has_value()) {
+            return Protocol::serializeError(hash.error());
+        }
+        if (*hash == nullptr) {
+            return "*0\r\n";
+        }
+        std::string reply;
+        Protocol::appendArrayHeader(reply, (*hash)->size() * 2);
+        (*hash)->forEach([&reply](std::string_view field, std::string_view value) {
+            Protocol::appendBulkString(reply, field);
+            Protocol::appendBulkString(reply, value);
+        });
+        return reply;
+    }
+
+    std::string handleHincrby(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto delta = parseInteger(args[2]);
+        if (!delta.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        auto value = storage.hashIncrement(args[0], args[1], *delta);
+        if (!value.has_value()) {
+            return Protocol::serializeError(value.error());
+        }
+        return Protocol::serializeInteger(*value);
+    }
+
+    std::string handleHlen(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto hash = storage.hash(args[0]);
+        if (!hash.has_value()) {
+            return Protocol::serializeError(hash.error());
+        }
+        return Protocol::serializeInteger(*hash == nullptr ? 0 : static_cast<int64_t>((*hash)->size()));
+    }
+
+    std::string handleHexists(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto hash = storage.hash(args[0]);
+        if (!hash.has_value()) {
+            return Protocol::serializeError(hash.error());
+        }
+        bool exists = *hash != nullptr && (*hash)->get(args[1]).has_value();
+        return Protocol::serializeInteger(exists ? 1 : 0);
+    }
+
+    std::string handleSadd(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto added = storage.setAdd(args[0], args.subspan(1));
+        if (!added.has_value()) {
+            return Protocol::serializeError(added.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*added));
+    }
+
+    std::string handleSrem(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto removed = storage.setRemove(args[0], args.subspan(1));
+        if (!removed.has_value()) {
+            return Protocol::serializeError(removed.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*removed));
+    }
+
+    std::string handleSismember(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto set = storage.getSet(args[0]);
+        if (!set.has_value()) {
+            return Protocol::serializeError(set.error());
+        }
+        return Protocol::serializeInteger(*set != nullptr && (*set)->contains(args[1]) ? 1 : 0);
+    }
+
+    std::string handleScard(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto set = storage.getSet(args[0]);
+        if (!set.has_value()) {
+            return Protocol::serializeError(set.error());
+        }
+        return Protocol::serializeInteger(*set == nullptr ? 0 : static_cast<int64_t>((*set)->size()));
+    }
+
+    std::string handleSmembers(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto set = storage.getSet(args[0]);
+        if (!set.has_value()) {
+            return Protocol::serializeError(set.error());
+        }
+        if (*set == nullptr) {
+            return "*0\r\n";
+        }
+        std::string reply;
+        Protocol::appendArrayHeader(reply, (*set)->size());
+        (*set)->forEach([&reply](std::string_view member) { Protocol::appendBulkString(reply, member); });
+        return reply;
+    }
+
+    // SINTER, SUNION and SDIFF: the members that `combine` finds in the sets
+    // at the keys. The count is known only at the end, so the members are
+    // written first and the array header put in front of them.
+    std::string combineSets(const CommandArgsSpan& keys, redis::Storage& storage,
+                            void (*combine)(std::span<const Set* const>, const Set::MemberFn&)) {
+        std::vector<const Set*> sets;
+        sets.reserve(keys.size());
+        for (std::string_view key : keys) {
+            auto set = storage.getSet(key);
+            if (!set.has_value()) {
+                return Protocol::serializeError(set.error());
+            }
+            sets.push_back(*set);
+        }
+        std::string members;
+        size_t count = 0;
+        combine(sets, [&members, &count](std::string_view member) {
+            Protocol::appendBulkString(members, member);
+            count++;
+        });
+        std::string reply;
+        reply.reserve(members.size() + 16);
+        Protocol::appendArrayHeader(reply, count);
+        reply += members;
+        return reply;
+    }
+
+    std::string handleSinter(const CommandArgsSpan& args, redis::Storage& storage) {
+        return combineSets(args, storage, Set::intersect);
+    }
+
+    std::string handleSunion(const CommandArgsSpan& args, redis::Storage& storage) {
+        return combineSets(args, storage, Set::unite);
+    }
+
+    std::string handleSdiff(const CommandArgsSpan& args, redis::Storage& storage) {
+        return combineSets(args, storage, Set::difference);
+    }
+
+    std::string handleZadd(const CommandArgsSpan& args, redis::Storage& storage) {
+        // ZADD key [NX | XX] [CH] score member [score member ...]
+        auto condition = Storage::ZAddCondition::ALWAYS;
+        bool changed = false;
+        size_t i = 1;
+        for (; i < args.size(); i++) {
+            if (equalsIgnoreCase(args[i], "NX") || equalsIgnoreCase(args[i], "XX")) {
+                auto option = equalsIgnoreCase(args[i], "NX") ? Storage::ZAddCondition::NX : Storage::ZAddCondition::XX;
+                if (condition != Storage::ZAddCondition::ALWAYS && condition != option) {
+                    return Protocol::serializeError("ERR XX and NX options at the same time are not compatible");
+                }
+                condition = option;
+            } else if (equalsIgnoreCase(args[i], "CH")) {
+                changed = true;
+            } else {
+                break;
+            }
+        }
+        if (i == args.size() || (args.size() - i) % 2 != 0) {
+            return Protocol::serializeError("ERR syntax error");
+        }
+        std::vector<std::pair<double, std::string_view>> entries;
+        entries.reserve((args.size() - i) / 2);
+        for (; i < args.size(); i += 2) {
+            auto score = parseScore(args[i]);
+            if (!score.has_value()) {
+                return Protocol::serializeError("ERR value is not a valid float");
+            }
+            entries.emplace_back(*score, args[i + 1]);
+        }
+        auto result = storage.zsetAdd(args[0], entries, condition);
+        if (!result.has_value()) {
+            return Protocol::serializeError(result.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(changed ? result->changed : result->added));
+    }
+
+    std::string handleZrem(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto removed = storage.zsetRemove(args[0], args.subspan(1));
+        if (!removed.has_value()) {
+            return Protocol::serializeError(removed.error());
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*removed));
+    }
+
+    std::string handleZscore(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto zset = storage.zset(args[0]);
+        if (!zset.has_value()) {
+            return Protocol::serializeError(zset.error());
+        }
+        auto score = *zset == nullptr ? std::nullopt : (*zset)->score(args[1]);
+        if (!score.has_value()) {
+            return Protocol::serializeNullBulkString();
+        }
+        std::array<char, 32> buffer;
+        return Protocol::serializeBulkString(formatScore(*score, buffer));
+    }
+
+    std::string handleZrank(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto zset = storage.zset(args[0]);
+        if (!zset.has_value()) {
+            return Protocol::serializeError(zset.error());
+        }
+        auto rank = *zset == nullptr ? std::nullopt : (*zset)->rank(args[1]);
+        if (!rank.has_value()) {
+            return Protocol::serializeNullBulkString();
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*rank));
+    }
+
+    std::string handleZcard(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto zset = storage.zset(args[0]);
+        if (!zset.has_value()) {
+            return Protocol::serializeError(zset.error());
+        }
+        return Protocol::serializeInteger(*zset == nullptr ? 0 : static_cast<int64_t>((*zset)->size()));
+    }
+
+    std::string handleZincrby(const CommandArgsSpan& args, redis::Storage& storage) {
+        auto delta = parseScore(args[1]);
+        if (!delta.has_value()) {
+            return Protocol::serializeError("ERR value is not a valid float");
+        }
+        auto score = storage.zsetIncrement(args[0], args[2], *delta);
+        if (!score.has_value()) {
+            return Protocol::serializeError(score.error());
+        }
+        std::array<char, 32> buffer;
+        return Protocol::serializeBulkString(formatScore(*score, buffer));
+    }
+
+    // The entries ZRANGE and ZRANGEBYSCORE found, with their scores if
+    // WITHSCORES was given. The count is known only at the end, so the
+    // entries are written first and the array header put in front of them.
+    class ZSetReply {
+    public:
+        explicit ZSetReply(bool with_scores) : with_scores_(with_scores), count_(0) {}
+
+        void add(std::string_view member, double score) {
+            Protocol::appendBulkString(entries_, member);
+            if (with_scores_) {
+                std::array<char, 32> buffer;
+                Protocol::appendBulkString(entries_, formatScore(score, buffer));
+            }
+            count_++;
+        }
+
+        std::string finish() const {
+            std::string reply;
+            reply.reserve(entries_.size() + 16);
+            Protocol::appendArrayHeader(reply, with_scores_ ? count_ * 2 : count_);
+            reply += entries_;
+            return reply;
+        }
+
+    private:
+        bool with_scores_;
+        size_t count_;
+        std::string entries_;
+    };
+
+    std::string handleZrange(const CommandArgsSpan& args, redis::Storage& storage) {
+        // ZRANGE key start stop [WITHSCORES]
+        if (args.size() > 4) {
+            return Protocol::serializeError("Invalid command arguments");
+        }
+        if (args.size() == 4 && !equalsIgnoreCase(args[3], "WITHSCORES")) {
+            return Protocol::serializeError("ERR syntax error");
+        }
+        auto start = parseInteger(args[1]);
+        auto stop = parseInteger(args[2]);
+        if (!start.has_value() || !stop.has_value()) {
+            return Protocol::serializeError("ERR value is not an integer or out of range");
+        }
+        auto zset = storage.zset(args[0]);
+        if (!zset.has_value()) {
+            return Protocol::serializeError(zset.error());
+        }
+        auto range = *zset == nullptr ? std::nullopt : (*zset)->range(*start, *stop);
+        ZSetReply reply(args.size() == 4);
+        if (range.has_value()) {
+            (*zset)->forRange(range->first, range->second,
+                              [&reply](std::string_view member, double score) { reply.add(member, score); });
+        }
+        return reply.finish();
+    }
+
+    // A ZRANGEBYSCORE bound: a score, "-inf" or "+inf", excluded if it
+    // starts with "("
+    std::optional<std::pair<double, bool>> parseScoreBound(std::string_view arg) {
+        bool exclusive = !arg.empty() && arg[0] == '(';
+        if (exclusive) {
+            arg.remove_prefix(1);
+        }
+        auto score = parseScore(arg);
+        if (!score.has_value()) {
+            return std::nullopt;
+        }
+        return std::pair{*score, exclusive};
+    }
+
+    std::string handleZrangebyscore(const CommandArgsSpan& args, redis::Storage& storage) {
+        // ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+        auto min = parseScoreBound(args[1]);
+        auto max = parseScoreBound(args[2]);
+        if (!min.has_value() || !max.has_value()) {
+            return Protocol::serializeError("ERR min or max is not a float");
+        }
+        bool with_scores = false;
+        int64_t offset = 0;
+        int64_t count = -1;
+        for (size_t i = 3; i < args.size(); i++) {
+            if (equalsIgnoreCase(args[i], "WITHSCORES")) {
+                with_scores = true;
+            } else if (equalsIgnoreCase(args[i], "LIMIT") && i + 2 < args.size()) {
+                auto parsed_offset = parseInteger(args[i + 1]);
+                auto parsed_count = parseInteger(args[i + 2]);
+                if (!parsed_offset.has_value() || !parsed_count.has_value()) {
+                    return Protocol::serializeError("ERR value is not an integer or out of range");
+                }
+                offset = *parsed_offset;
+                count = *parsed_count;
+                i += 2;
+            } else {
+                return Protocol::serializeError("ERR syntax error");
+            }
+        }
+        auto zset = storage.zset(args[0]);
+        if (!zset.has_value()) {
+            return Protocol::serializeError(zset.error());
+        }
+        ZSetReply reply(with_scores);
+        // A negative offset returns nothing and a negative count everything
+        if (*zset != nullptr && offset >= 0) {
+            ScoreRange range{min->first, max->first, min->second, max->second};
+            (*zset)->forScoreRange(range, static_cast<size_t>(offset),
+                                   count < 0 ? std::numeric_limits<size_t>::max() : static_cast<size_t>(count),
+                                   [&reply](std::string_view member, double score) { reply.add(member, score); });
+        }
+        return reply.finish();
+    }
+
+    std::string handleMemory(const CommandArgsSpan& args, redis::Storage& storage) {
+        // MEMORY USAGE key
+        if (args.size() != 2 || !equalsIgnoreCase(args[0], "USAGE")) {
+            return Protocol::serializeError("ERR syntax error");
+        }
+        auto usage = storage.memoryUsage(args[1]);
+        if (!usage.has_value()) {
+            return Protocol::serializeNullBulkString();
+        }
+        return Protocol::serializeInteger(static_cast<int64_t>(*usage));
+    }
+
+    std::string handleScan(const CommandArgsSpan& args, redis::Storage& storage) {
+        // SCAN cursor [MATCH pattern] [COUNT count] [TYPE type]
+        uint64_t cursor = 0;
+        auto [end, ec] = std::from_chars(args[0].data(), args[0].data() + args[0].size(), cursor);
+        if (ec != std::errc() || end != args[0].data() + args[0].size()) {
+            return Protocol::serializeError("ERR invalid cursor");
+        }
+        std::optional<GlobPattern> pattern;
+        size_t count = 10;
+        std::optional<ValueType> type;
+        for (size_t i = 1; i < args.size(); i += 2) {
+            if (i + 1 == args.size()) {
+                return Protocol::serializeError("ERR syntax error");
+            }
+            if (equalsIgnoreCase(args[i], "MATCH")) {
+                pattern.emplace(args[i + 1]);
+            } else if (equalsIgnoreCase(args[i], "COUNT")) {
+                auto value = parseInteger(args[i + 1]);
+                if (!value.has_value()) {
+                    return Protocol::serializeError("ERR value is not an integer or out of range");
+                }
+                if (*value < 1) {
+                    return Protocol::serializeError("ERR syntax error");
+                }
+                count = static_cast<size_t>(*value);
+            } else if (equalsIgnoreCase(args[i], "TYPE")) {
+                type = parseTypeName(args[i + 1]);
+                if (!type.has_value()) {
+                    return Protocol::serializeError(std::format("ERR unknown type name '{}'", args[i + 1]));
+                }
+            } else {
+                return Protocol::serializeError("ERR syntax error");
+            }
+        }
+        if (pattern.has_value() && pattern->matchesAll()) {
+            pattern.reset();
+        }
+
+        std::string keys;
+        size_t found = 0;
+        cursor = storage.scan(cursor, count, [&](std::string_view key, ValueType key_type) {
+            if ((type.has_value() && key_type != *type) || (pattern.has_value() && !pattern->matches(key))) {
+                return;
+            }
+            Protocol::appendBulkString(keys, key);
+            found++;
+        });
+        std::string reply;
+        Protocol::appendArrayHeader(reply, 2);
+        Protocol::appendBulkString(reply, std::to_string(cursor));
+        Protocol::appendArrayHeader(reply, found);
+        return reply + keys;
+    }
+
+    std::string handleKeys(const CommandArgsSpan& args, redis::Storage& storage) {
+        GlobPattern pattern(args[0]);
+        std::string keys;
+        size_t found = 0;
+        // Nothing changes the keyspace between the steps, so no key repeats
+        size_t cursor = 0;
+        do {
+            cursor = storage.scan(cursor, 1000, [&](std::string_view key, ValueType) {
+                if (pattern.matches(key)) {
+                    Protocol::appendBulkString(keys, key);
+                    found++;
+                }
+            });
+        } while (cursor != 0);
+        std::string reply;
+        Protocol::appendArrayHeader(reply, found);
+        return reply + keys;
+    }
+
+    std::string handleDbsize(const CommandArgsSpan&, redis::Storage& storage) {
+        return Protocol::serializeInteger(static_cast<int64_t>(storage.size()));
+    }
+
+    // FLUSHALL and FLUSHDB [ASYNC|SYNC]: there is a single database. ASYNC
+    // leaves the old keyspace to the lazy free thread.
+    std::string handleFlush(const CommandArgsSpan& args, redis::Storage& storage) {
+        bool async = args.size() == 1 && equalsIgnoreCase(args[0], "ASYNC");
+        if (args.size() > 1 || (args.size() == 1 && !async && !equalsIgnoreCase(args[0], "SYNC"))) {
+            return Protocol::serializeError("ERR syntax error");
+        }
+        if (async) {
+            storage.clearAsync();
+        } else {
+            storage.clear();
+        }
+        return Protocol::serializeSimpleString("OK");
+    }
+
+    std::string handleRandomkey(const CommandArgsSpan&, redis::Storage& storage) {
+        auto key = storage.randomKey();
+        if (!key.has_value()) {
+            return Protocol::serializeNullBulkString();
+        }
+        return Protocol::serializeBulkString(*key);
+    }
 
     std::string handlePing(const CommandArgsSpan& args, redis::Storage&) {
         if (args.empty()) {
@@ -83,32 +928,249 @@ namespace {
         return Protocol::serializeError("NOPROTO");
     }
 
-    const std::unordered_map<std::string, CommandHandler> command_handlers = {
-        {"SET", handleSet},
-        {"GET", handleGet},
-        {"DEL", handleDel},
-        {"EXISTS", handleExists},
-        {"PING", handlePing},
-        {"HELLO", handleHello},
-    };
+    constexpr CommandTable commands(std::to_array<Command>({
+        {"SET", handleSet, -3, Command::WRITE | Command::DENYOOM, {1, 1, 1, ReplyMerge::NONE}},
+        {"GET", handleGet, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"INCR", handleIncr, 2, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"DECR", handleDecr, 2, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"INCRBY", handleIncrby, 3, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"DECRBY", handleDecrby, 3, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"INCRBYFLOAT", handleIncrbyfloat, 3, Command::WRITE | Command::DENYOOM | Command::FAST,
+         {1, 1, 1, ReplyMerge::NONE}},
+        {"APPEND", handleAppend, 3, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"GETRANGE", handleGetrange, 4, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"SETRANGE", handleSetrange, 4, Command::WRITE | Command::DENYOOM, {1, 1, 1, ReplyMerge::NONE}},
+        {"DEL", handleDel, -2, Command::WRITE, {1, -1, 1, ReplyMerge::SUM}},
+        // DEL already leaves big values to the lazy free thread
+        {"UNLINK", handleDel, -2, Command::WRITE | Command::FAST, {1, -1, 1, ReplyMerge::SUM}},
+        {"EXISTS", handleExists, -2, Command::READONLY | Command::FAST, {1, -1, 1, ReplyMerge::SUM}},
+        {"MGET", handleMget, -2, Command::READONLY | Command::FAST, {1, -1, 1, ReplyMerge::ARRAY}},
+        {"MSET", handleMset, -3, Command::WRITE | Command::DENYOOM, {1, -1, 2, ReplyMerge::NONE}},
+        // Atomic: all keys are set or none, so they must be on one shard
+        {"MSETNX", handleMsetnx, -3, Command::WRITE | Command::DENYOOM, {1, -1, 2, ReplyMerge::NONE}},
+        {"EXPIRE", handleExpire, 3, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"PEXPIRE", handlePexpire, 3, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"PEXPIREAT", handlePexpireat, 3, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"TTL", handleTtl, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"PTTL", handlePttl, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"PERSIST", handlePersist, 2, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"LPUSH", handleLpush, -3, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"RPUSH", handleRpush, -3, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"LPOP", handleLpop, -2, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"RPOP", handleRpop, -2, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"LLEN", handleLlen, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"LINDEX", handleLindex, 3, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"LRANGE", handleLrange, 4, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"LTRIM", handleLtrim, 4, Command::WRITE, {1, 1, 1, ReplyMerge::NONE}},
+        {"HSET", handleHset, -4, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"HGET", handleHget, 3, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"HMGET", handleHmget, -3, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"HDEL", handleHdel, -3, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"HGETALL", handleHgetall, 2, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"HINCRBY", handleHincrby, 4, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"HLEN", handleHlen, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"HEXISTS", handleHexists, 3, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"SADD", handleSadd, -3, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"SREM", handleSrem, -3, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"SISMEMBER", handleSismember, 3, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"SCARD", handleScard, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"SMEMBERS", handleSmembers, 2, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"SINTER", handleSinter, -2, Command::READONLY, {1, -1, 1, ReplyMerge::NONE}},
+        {"SUNION", handleSunion, -2, Command::READONLY, {1, -1, 1, ReplyMerge::NONE}},
+        {"SDIFF", handleSdiff, -2, Command::READONLY, {1, -1, 1, ReplyMerge::NONE}},
+        {"ZADD", handleZadd, -4, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZREM", handleZrem, -3, Command::WRITE | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZSCORE", handleZscore, 3, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZRANK", handleZrank, 3, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZCARD", handleZcard, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZINCRBY", handleZincrby, 4, Command::WRITE | Command::DENYOOM | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZRANGE", handleZrange, -4, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"ZRANGEBYSCORE", handleZrangebyscore, -4, Command::READONLY, {1, 1, 1, ReplyMerge::NONE}},
+        {"MEMORY", handleMemory, -2, Command::READONLY, {2, 2, 1, ReplyMerge::NONE}},
+        // Keyspace commands, run on every shard. SCAN's cursor picks the
+        // shard, so the event loop routes it.
+        {"SCAN", handleScan, -2, Command::READONLY, {0, 0, 0, ReplyMerge::NONE}},
+        {"KEYS", handleKeys, 2, Command::READONLY, {0, 0, 0, ReplyMerge::CONCAT}},
+        {"DBSIZE", handleDbsize, 1, Command::READONLY | Command::FAST, {0, 0, 0, ReplyMerge::SUM}},
+        {"FLUSHALL", handleFlush, -1, Command::WRITE, {0, 0, 0, ReplyMerge::OK}},
+        {"FLUSHDB", handleFlush, -1, Command::WRITE, {0, 0, 0, ReplyMerge::OK}},
+        {"RANDOMKEY", handleRandomkey, 1, Command::READONLY, {0, 0, 0, ReplyMerge::ANY}},
+        {"PING", handlePing, -1, Command::FAST, {0, 0, 0, ReplyMerge::NONE}},
+        {"HELLO", handleHello, -1, Command::FAST, {0, 0, 0, ReplyMerge::NONE}},
+        // Persistence and introspection commands, run by the event loop
+        {"SAVE", nullptr, 1, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+        {"BGSAVE", nullptr, 1, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+        {"LASTSAVE", nullptr, 1, Command::SERVER | Command::FAST, {0, 0, 0, ReplyMerge::NONE}},
+        {"BGREWRITEAOF", nullptr, 1, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+        {"INFO", nullptr, -1, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+        {"CONFIG", nullptr, -2, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+        {"SLOWLOG", nullptr, -2, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+        {"LATENCY", nullptr, -2, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+    }));
 }
 
-Database::Database() {
+Database::Database()
+    : append_log_enabled_(false), shard_(0), shards_(1), stats_(commands.commands().size()), evicted_keys_(0),
+      slow_log_nanos_(static_cast<uint64_t>(SlowLogSettings{}.log_slower_than) * 1000), latency_monitor_(nullptr) {
 }
 
 Database::~Database() {
 }
 
-std::string Database::executeCommand(const CommandArgs& args) {
+std::string Database::executeCommand(CommandArgsSpan args) {
     if (args.empty()) {
         return Protocol::serializeError("Empty command");
     }
-    const std::string& command = args[0];
-    auto handler = command_handlers.find(command);
-    if (handler == command_handlers.end()) {
-        return Protocol::serializeError(std::format("Unknown command: {}", command));
+    const Command* command = commands.find(args[0]);
+    if (command == nullptr || command->handler == nullptr) {
+        return Protocol::serializeError(std::format("Unknown command: {}", args[0]));
+    }
+    if (!command->acceptsArgs(args.size())) {
+        stats_.reject(static_cast<size_t>(command - commands.commands().data()));
+        return Protocol::serializeError(std::format("ERR wrong number of arguments for '{}' command", args[0]));
+    }
+    // Also when another thread runs it, as a replay does
+    memory::AccountScope account(&storage_.account());
+    if (!command->has(Command::WRITE)) {
+        uint64_t start = clock_.start();
+        std::string reply = command->handler(args.subspan(1), storage_);
+        recordCall(*command, args, clock_.stop(start), reply.starts_with('-'));
+        return reply;
+    }
+    // Evicted keys are logged as deleted: a replay could not pick the same
+    // ones. Evicting is not part of the command's time.
+    if (command->has(Command::DENYOOM) && !storage_.evict([this](std::string_view key) {
+            bump(evicted_keys_);
+            clock_.interrupt();
+            if (append_log_enabled_) {
+                Protocol::appendCommand(append_log_, std::array{std::string_view("DEL"), key});
+            }
+        })) {
+        stats_.reject(static_cast<size_t>(command - commands.commands().data()));
+        return Protocol::serializeError("OOM command not allowed when used memory > 'maxmemory'.");
+    }
+    uint64_t start = clock_.start();
+    uint64_t changes = storage_.changes();
+    std::string reply = command->handler(args.subspan(1), storage_);
+    if (append_log_enabled_ && storage_.changes() != changes) {
+        propagate(*command, args);
+    }
+    recordCall(*command, args, clock_.stop(start), reply.starts_with('-'));
+    return reply;
+}
+
+void Database::propagate(const Command& command, CommandArgsSpan args) {
+    // Matched by the table's name, whatever case the client sent
+    std::string_view name = command.name;
+    if (shards_ > 1 && (name == "FLUSHALL" || name == "FLUSHDB")) {
+        // Only this shard's keys were flushed when the command was logged
+        std::string shard = std::to_string(shard_);
+        std::string shards = std::to_string(shards_);
+        Protocol::appendCommand(append_log_, std::array{FLUSH_SHARD, std::string_view(shard), std::string_view(shards)});
+        return;
+    }
+    if (name != "SET" && name != "EXPIRE" && name != "PEXPIRE" && name != "INCRBYFLOAT") {
+        Protocol::appendCommand(append_log_, args);
+        return;
+    }
+    // Relative expire times are logged as absolute ones, so that a replay
+    // does not extend them
+    std::string_view key = args[1];
+    if (name == "SET") {
+        Protocol::appendCommand(append_log_, std::array{name, key, args[2]});
+    } else if (name == "INCRBYFLOAT") {
+        // The result, so that a replay does not round differently
+        auto value = storage_.get(key);
+        std::string result(value.value()->view());
+        Protocol::appendCommand(append_log_, std::array{std::string_view("SET"), key, std::string_view(result)});
+    } else if (!storage_.exists(key)) {
+        // An expire time in the past deleted the key
+        Protocol::appendCommand(append_log_, std::array{std::string_view("DEL"), key});
+        return;
+    }
+    if (auto when = storage_.expireTime(key)) {
+        std::string timestamp = std::to_string(*when);
+        Protocol::appendCommand(append_log_, std::array{std::string_view("PEXPIREAT"), key, std::string_view(timestamp)});
     }
-    return handler->second(std::ranges::drop_view(args, 1), storage_);
+}
+
+void Database::enableAppendLog(size_t shard, size_t shards) {
+    append_log_enabled_ = true;
+    shard_ = shard;
+    shards_ = shards;
+}
+
+std::string& Database::appendLog() {
+    return append_log_;
+}
+
+size_t Database::activeExpireCycle(std::chrono::microseconds budget) {
+    return storage_.activeExpireCycle(budget);
+}
+
+void Database::incrementalRehash(std::chrono::microseconds budget) {
+    storage_.incrementalRehash(budget);
+}
+
+size_t Database::activeDefragCycle(std::chrono::microseconds interval) {
+    return storage_.activeDefragCycle(interval);
+}
+
+Storage& Database::storage() {
+    return storage_;
+}
+
+const Command* Database::command(std::string_view name) {
+    return commands.find(name);
+}
+
+std::span<const Command> Database::commandTable() {
+    return commands.commands();
+}
+
+CommandStats& Database::stats() {
+    return stats_;
+}
+
+const CommandStats& Database::stats() const {
+    return stats_;
+}
+
+uint64_t Database::evictedKeys() const {
+    return evicted_keys_.load(std::memory_order_relaxed);
+}
+
+void Database::resetStats() {
+    stats_.reset();
+    evicted_keys_.store(0, std::memory_order_relaxed);
+}
+
+CommandClock& Database::clock() {
+    return clock_;
+}
+
+void Database::recordCall(const Command& command, CommandArgsSpan args, uint64_t cycles, bool failed) {
+    uint64_t nanos = stats_.record(static_cast<size_t>(&command - commands.commands().data()), cycles, failed);
+    if (nanos >= slow_log_nanos_) {
+        slow_log_.add(args, nanos / 1000);
+    }
+    if (latency_monitor_ != nullptr && latency_monitor_->exceeds(std::chrono::nanoseconds(nanos))) {
+        latency_monitor_->record(command.has(Command::FAST) ? "fast-command" : "command",
+                                 std::chrono::nanoseconds(nanos));
+    }
+}
+
+SlowLog& Database::slowLog() {
+    return slow_log_;
+}
+
+void Database::setSlowLogSettings(const SlowLogSettings& settings) {
+    slow_log_nanos_ = settings.log_slower_than < 0 ? UINT64_MAX : static_cast<uint64_t>(settings.log_slower_than) * 1000;
+    slow_log_.setMaxLength(settings.max_length);
+}
+
+void Database::setLatencyMonitor(LatencyMonitor* monitor) {
+    latency_monitor_ = monitor;
 }
 
 } // namespace redis
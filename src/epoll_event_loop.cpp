@@ -0,0 +1,171 @@
+#include "redis/epoll_event_loop.hpp"
+#include "redis/log.hpp"
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+const constexpr int MAX_EVENTS = 10;
+
+namespace {
+    void epoll_add(int epoll_fd, int fd, uint32_t events) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            throw std::runtime_error(std::format("Failed to add socket {} to epoll", fd));
+        }
+    }
+}
+
+namespace redis {
+
+EpollEventLoop::EpollEventLoop(size_t index, const std::vector<std::unique_ptr<EventLoop>>& shards,
+                               Persistence& persistence)
+    : EventLoop(index, shards, persistence), epoll_fd_(-1) {
+}
+
+EpollEventLoop::~EpollEventLoop() {
+    if (epoll_fd_ != -1) {
+        ::close(epoll_fd_);
+    }
+}
+
+void EpollEventLoop::listen(const std::string& host, int port) {
+    server_socket_ = listenSocket(host, port);
+    epoll_fd_ = epoll_create1(0);
+    if (epoll_fd_ == -1) {
+        throw std::runtime_error("Failed to create epoll");
+    }
+    epoll_add(epoll_fd_, server_socket_, EPOLLIN);
+    epoll_add(epoll_fd_, wakeup_fd_, EPOLLIN);
+}
+
+void EpollEventLoop::run(const std::atomic<bool>& running, int stop_fd) {
+    // Level-triggered and never read here, so it wakes every loop
+    epoll_add(epoll_fd_, stop_fd, EPOLLIN);
+    epoll_event events[MAX_EVENTS];
+
+    while (running) {
+        int nfds = epoll_wait(epoll_fd_, events, MAX_EVENTS, CRON_INTERVAL_MS);
+        if (nfds == -1) {
+            if (!running) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::format("Failed to wait on epoll: {}", strerror(errno)));
+        }
+        iterationStarted();
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].data.fd;
+            REDIS_DEBUG("Event on socket {}", fd);
+            if (fd == server_socket_) {
+                acceptConnections();
+            } else if (fd == wakeup_fd_) {
+                runTasks();
+            } else if (fd != stop_fd) {
+                handleClient(fd);
+            }
+        }
+        cron();
+        flushAppendOnly();
+        sendPendingWrites();
+        iterationFinished();
+    }
+}
+
+void EpollEventLoop::acceptConnections() {
+    while (true) {
+        sockaddr_in client_address;
+        socklen_t client_address_len = sizeof(client_address);
+        int client_socket = accept(server_socket_, (struct sockaddr*)&client_address, &client_address_len);
+        if (client_socket == -1) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                REDIS_DEBUG("No more connections to accept");
+                break;
+            }
+            throw std::runtime_error("Failed to accept connection");
+        }
+
+        REDIS_DEBUG("Accepted connection from {} on shard {}, socket {}", inet_ntoa(client_address.sin_addr), index_, client_socket);
+
+        setNonBlocking(client_socket);
+
+        connections_[client_socket] = std::make_unique<ClientConnection>(client_socket, *this, next_connection_id_++);
+        epoll_add(epoll_fd_, client_socket, EPOLLIN | EPOLLET);
+    }
+}
+
+void EpollEventLoop::handleClient(int client_socket) {
+    REDIS_DEBUG("Handling client on socket {}", client_socket);
+    auto it = connections_.find(client_socket);
+    if (it == connections_.end()) {
+        throw std::runtime_error("Client socket not found");
+    }
+    auto& connection = it->second;
+    connection->handle();
+    if (!connection->isActive() || connection->readyToClose()) {
+        REDIS_DEBUG("Client socket {} is not active, removing from connections", client_socket);
+        watching_writes_.erase(client_socket);
+        connections_.erase(it);
+        bump(closed_connections_);
+        return;
+    }
+    flush(client_socket, *connection);
+}
+
+void EpollEventLoop::sendPendingWrites() {
+    for (int client_socket : pending_writes_) {
+        auto it = connections_.find(client_socket);
+        if (it == connections_.end()) {
+            continue;
+        }
+        it->second->sendResponse();
+        if (it->second->readyToClose()) {
+            REDIS_DEBUG("Closing client socket {} after a protocol error", client_socket);
+            watching_writes_.erase(client_socket);
+            connections_.erase(it);
+            bump(closed_connections_);
+            continue;
+        }
+        watchWrites(client_socket, it->second->hasPendingData());
+    }
+    pending_writes_.clear();
+}
+
+void EpollEventLoop::watchWrites(int client_socket, bool watch) {
+    if (watching_writes_.contains(client_socket) == watch) {
+        return;
+    }
+    REDIS_DEBUG("Client socket {} has pending data: {}", client_socket, watch);
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    if (watch) {
+        event.events |= EPOLLOUT;
+        watching_writes_.insert(client_socket);
+    } else {
+        watching_writes_.erase(client_socket);
+    }
+    event.data.fd = client_socket;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_socket, &event) == -1) {
+        throw std::runtime_error("Failed to modify client socket in epoll");
+    }
+}
+
+std::string_view EpollEventLoop::backendName() const {
+    return "epoll";
+}
+
+void EpollEventLoop::flush(int client_socket, ClientConnection& connection) {
+    if (connection.hasPendingData()) {
+        pending_writes_.push_back(client_socket);
+    }
+}
+
+} // namespace redis
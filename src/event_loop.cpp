@@ -0,0 +1,1091 @@
+#include "redis/event_loop.hpp"
+#include "redis/epoll_event_loop.hpp"
+#include "redis/log.hpp"
+#include "redis/memory.hpp"
+#include "redis/uring_event_loop.hpp"
+#include "redis/protocol.hpp"
+#include "redis/rdb.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <sys/eventfd.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace {
+    // Remove the first bulk string, "$<length>\r\n<bytes>\r\n" or "$-1\r\n",
+    // from the front of `reply` and return it
+    std::string_view take_bulk_string(std::string_view& reply) {
+        size_t header_end = reply.find("\r\n");
+        if (header_end == std::string_view::npos) {
+            return std::exchange(reply, {});
+        }
+        int64_t length = -1;
+        std::from_chars(reply.data() + 1, reply.data() + header_end, length);
+        size_t size = std::min(reply.size(), header_end + 2 + (length >= 0 ? static_cast<size_t>(length) + 2 : 0));
+        std::string_view element = reply.substr(0, size);
+        reply.remove_prefix(size);
+        return element;
+    }
+
+    // ReplyMerge::ARRAY: every part replied with the elements of its keys in
+    // order, so the elements are dealt back following the shard of each key
+    std::string merge_arrays(const std::vector<std::string>& replies, const std::vector<size_t>& key_shards) {
+        std::vector<std::string_view> rest(replies.begin(), replies.end());
+        for (std::string_view& elements : rest) {
+            size_t header_end = elements.find("\r\n");
+            elements.remove_prefix(header_end == std::string_view::npos ? elements.size() : header_end + 2);
+        }
+        std::string reply;
+        redis::Protocol::appendArrayHeader(reply, key_shards.size());
+        for (size_t shard : key_shards) {
+            reply += take_bulk_string(rest[shard]);
+        }
+        return reply;
+    }
+
+    // ReplyMerge::CONCAT: the elements of every array, in shard order
+    std::string concat_arrays(const std::vector<std::string>& replies) {
+        int64_t count = 0;
+        std::string elements;
+        for (std::string_view reply : replies) {
+            size_t header_end = reply.find("\r\n");
+            if (reply.empty() || header_end == std::string_view::npos) {
+                continue;
+            }
+            int64_t size = 0;
+            std::from_chars(reply.data() + 1, reply.data() + header_end, size);
+            count += size;
+            elements += reply.substr(header_end + 2);
+        }
+        std::string reply;
+        redis::Protocol::appendArrayHeader(reply, static_cast<size_t>(count));
+        return reply + elements;
+    }
+
+    std::string merge_replies(redis::ReplyMerge merge, const std::vector<std::string>& replies,
+                              const std::vector<size_t>& key_shards) {
+        int64_t sum = 0;
+        std::vector<const std::string*> found;
+        for (const auto& reply : replies) {
+            if (reply.empty()) {
+                continue; // shard without a part of the command
+            }
+            if (reply[0] == '-') {
+                return reply;
+            }
+            if (merge == redis::ReplyMerge::ANY && reply != redis::Protocol::serializeNullBulkString()) {
+                found.push_back(&reply);
+            }
+            if (merge == redis::ReplyMerge::SUM) {
+                // Integer reply: ":<value>\r\n"
+                int64_t value = 0;
+                std::from_chars(reply.data() + 1, reply.data() + reply.size(), value);
+                sum += value;
+            }
+        }
+        if (merge == redis::ReplyMerge::SUM) {
+            return redis::Protocol::serializeInteger(sum);
+        }
+        if (merge == redis::ReplyMerge::ARRAY) {
+            return merge_arrays(replies, key_shards);
+        }
+        if (merge == redis::ReplyMerge::CONCAT) {
+            return concat_arrays(replies);
+        }
+        if (merge == redis::ReplyMerge::ANY) {
+            thread_local std::minstd_rand random(std::random_device{}());
+            return found.empty() ? redis::Protocol::serializeNullBulkString() : *found[random() % found.size()];
+        }
+        return redis::Protocol::serializeSimpleString("OK");
+    }
+
+    // Share of every cron interval the active expire cycle may spend, 25% as
+    // in Redis
+    const constexpr std::chrono::microseconds ACTIVE_EXPIRE_BUDGET(25000);
+    // Time every cron interval spends on resizes of idle tables, 1 ms as in
+    // Redis
+    const constexpr std::chrono::microseconds REHASH_BUDGET(1000);
+
+    // Bytes as Redis' INFO writes them for people: 1.50M
+    std::string humanBytes(size_t bytes) {
+        constexpr std::string_view UNITS = "BKMGTP";
+        double value = static_cast<double>(bytes);
+        size_t unit = 0;
+        while (value >= 1024 && unit + 1 < UNITS.size()) {
+            value /= 1024;
+            unit++;
+        }
+        return unit == 0 ? std::format("{}B", bytes) : std::format("{:.2f}{}", value, UNITS[unit]);
+    }
+
+    std::string_view policyName(redis::EvictionPolicy policy) {
+        switch (policy) {
+            case redis::EvictionPolicy::NOEVICTION:
+                return "noeviction";
+            case redis::EvictionPolicy::ALLKEYS_LRU:
+                return "allkeys-lru";
+            case redis::EvictionPolicy::ALLKEYS_LFU:
+                return "allkeys-lfu";
+            case redis::EvictionPolicy::VOLATILE_TTL:
+                return "volatile-ttl";
+        }
+        return "";
+    }
+
+    // For uptime_in_seconds
+    const auto START_TIME = std::chrono::steady_clock::now();
+
+    // Command names are reported in lowercase, as Redis does
+    std::string lowercase(std::string_view text) {
+        std::string lower(text);
+        std::ranges::transform(lower, lower.begin(), [](unsigned char c) { return std::tolower(c); });
+        return lower;
+    }
+
+    double toMicros(uint64_t nanos) {
+        return static_cast<double>(nanos) / 1000;
+    }
+
+    // Set while a loop pauses the others
+    std::atomic<bool> pausing{false};
+
+    // Reply to a command that found another loop pausing the shards
+    const std::string PAUSE_BUSY_ERROR = "-ERR Another command is pausing the event loops, try again\r\n";
+
+    int64_t unixTime() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+namespace redis {
+
+EventLoop::EventLoop(size_t index, const std::vector<std::unique_ptr<EventLoop>>& shards, Persistence& persistence)
+    : index_(index), shards_(shards), server_socket_(-1), wakeup_fd_(-1),
+      next_connection_id_(0), closed_connections_(0), port_(0), wakeup_pending_(false),
+      last_cron_(std::chrono::steady_clock::now()), ops_samples_{}, ops_sample_(0), last_calls_(0), ops_per_sec_(0),
+      latency_monitor_(nullptr), persistence_(persistence), child_(-1), child_job_(ChildJob::SAVE) {
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK);
+    if (wakeup_fd_ == -1) {
+        throw std::runtime_error("Failed to create eventfd");
+    }
+}
+
+EventLoop::~EventLoop() {
+    if (child_ != -1) {
+        // Let a running BGSAVE or BGREWRITEAOF finish rather than lose its work
+        reapChild(true);
+    }
+    connections_.clear();
+    for (int fd : {server_socket_, wakeup_fd_}) {
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+}
+
+std::unique_ptr<EventLoop> EventLoop::create(Backend backend, size_t index,
+                                             const std::vector<std::unique_ptr<EventLoop>>& shards,
+                                             Persistence& persistence) {
+    switch (backend) {
+        case Backend::IO_URING:
+            return std::make_unique<UringEventLoop>(index, shards, persistence);
+        case Backend::EPOLL:
+            break;
+    }
+    return std::make_unique<EpollEventLoop>(index, shards, persistence);
+}
+
+void EventLoop::setNonBlocking(int socket_fd) {
+    int flags = fcntl(socket_fd, F_GETFL, 0);
+    if (flags == -1) {
+        throw std::runtime_error("Failed to get socket flags");
+    }
+    if (fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        throw std::runtime_error("Failed to set socket to non-blocking");
+    }
+}
+
+int EventLoop::listenSocket(const std::string& host, int port) {
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd == -1) {
+        throw std::runtime_error("Failed to create socket");
+    }
+
+    // Every event loop binds its own socket to the same port and the kernel
+    // balances incoming connections between them
+    int enable = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1 ||
+        setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        ::close(socket_fd);
+        throw std::runtime_error("Failed to set socket options");
+    }
+
+    sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = inet_addr(host.c_str());
+
+    if (::bind(socket_fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        ::close(socket_fd);
+        throw std::runtime_error("Failed to bind socket");
+    }
+
+    setNonBlocking(socket_fd);
+
+    if (::listen(socket_fd, SOMAXCONN) == -1) {
+        ::close(socket_fd);
+        throw std::runtime_error("Failed to listen on socket");
+    }
+    port_ = port;
+    return socket_fd;
+}
+
+void EventLoop::post(std::function<void()> task) {
+    mailbox_.push(std::move(task));
+    if (!wakeup_pending_.exchange(true, std::memory_order_acq_rel)) {
+        uint64_t one = 1;
+        ssize_t result = ::write(wakeup_fd_, &one, sizeof(one));
+        (void)result; // the counter only overflows if the loop is gone
+    }
+}
+
+void EventLoop::cron() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_cron_ < std::chrono::milliseconds(CRON_INTERVAL_MS)) {
+        return;
+    }
+    sampleOps(now);
+    last_cron_ = now;
+    database_.storage().refreshClock(Storage::now());
+    monitored("expire-cycle", [this] {
+        database_.activeExpireCycle(ACTIVE_EXPIRE_BUDGET);
+    });
+    database_.incrementalRehash(REHASH_BUDGET);
+    monitored("active-defrag-cycle", [this] {
+        database_.activeDefragCycle(std::chrono::milliseconds(CRON_INTERVAL_MS));
+    });
+    if (child_ != -1) {
+        reapChild();
+    }
+}
+
+void EventLoop::sampleOps(std::chrono::steady_clock::time_point now) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - last_cron_).count();
+    uint64_t calls = database_.stats().totalCalls();
+    // CONFIG RESETSTAT may have zeroed the counters since the last sample
+    uint64_t ran = calls >= last_calls_ ? calls - last_calls_ : calls;
+    last_calls_ = calls;
+    ops_samples_[ops_sample_] = elapsed <= 0 ? 0 : ran * 1'000'000 / static_cast<uint64_t>(elapsed);
+    ops_sample_ = (ops_sample_ + 1) % OPS_SAMPLES;
+    uint64_t sum = 0;
+    for (uint64_t sample : ops_samples_) {
+        sum += sample;
+    }
+    ops_per_sec_.store(sum / OPS_SAMPLES, std::memory_order_relaxed);
+}
+
+Database& EventLoop::database() {
+    return database_;
+}
+
+void EventLoop::setLatencyMonitor(LatencyMonitor* monitor) {
+    latency_monitor_ = monitor;
+    database_.setLatencyMonitor(monitor);
+}
+
+void EventLoop::monitored(std::string_view event, const std::function<void()>& job) {
+    if (latency_monitor_ == nullptr || !latency_monitor_->enabled()) {
+        job();
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    job();
+    latency_monitor_->record(event, std::chrono::steady_clock::now() - start);
+}
+
+void EventLoop::iterationStarted() {
+    if (latency_monitor_ != nullptr && latency_monitor_->enabled()) {
+        iteration_start_ = std::chrono::steady_clock::now();
+    }
+}
+
+void EventLoop::iterationFinished() {
+    if (iteration_start_ != std::chrono::steady_clock::time_point{}) {
+        latency_monitor_->record("event-loop", std::chrono::steady_clock::now() - iteration_start_);
+        iteration_start_ = {};
+    }
+}
+
+void EventLoop::runTasks() {
+    uint64_t value;
+    ssize_t result = ::read(wakeup_fd_, &value, sizeof(value));
+    (void)result;
+    // Clear the flag before draining: a task posted from now on signals again
+    wakeup_pending_.store(false, std::memory_order_release);
+    mailbox_.drain();
+}
+
+void EventLoop::flushAppendOnly() {
+    std::string& log = database_.appendLog();
+    if (!log.empty()) {
+        persistence_.aof->append(log);
+        log.clear();
+    }
+    for (auto& [origin, task] : held_replies_) {
+        origin->post(std::move(task));
+    }
+    held_replies_.clear();
+}
+
+void EventLoop::replyTo(EventLoop* origin, Mailbox::Task task) {
+    if (persistence_.aof == nullptr) {
+        origin->post(std::move(task));
+        return;
+    }
+    held_replies_.emplace_back(origin, std::move(task));
+}
+
+void EventLoop::deliver(int client_socket, uint64_t connection_id, uint64_t slot, std::string reply) {
+    auto it = connections_.find(client_socket);
+    if (it == connections_.end() || it->second->id() != connection_id) {
+        // The client went away while its command was on another shard
+        return;
+    }
+    it->second->deliverReply(slot, std::move(reply));
+    flush(client_socket, *it->second);
+}
+
+std::optional<std::string> EventLoop::execute(ClientConnection& connection, CommandArgsSpan args) {
+    if (args.empty()) {
+        return database_.executeCommand(args);
+    }
+    const Command* command = Database::command(args[0]);
+    if (command != nullptr && command->has(Command::SERVER)) {
+        return executeServerCommand(connection, *command, args);
+    }
+    if (shards_.size() == 1 || command == nullptr) {
+        return database_.executeCommand(args);
+    }
+    const KeySpec* spec = &command->keys;
+    if (spec->first == 0 && command->name == "SCAN") {
+        return scan(connection, args);
+    }
+    if (spec->first == 0 && spec->merge != ReplyMerge::NONE) {
+        // A keyspace command: every shard runs all of it
+        fanOut(connection, std::vector<CommandArgs>(shards_.size(), CommandArgs(args.begin(), args.end())),
+               [merge = spec->merge](const std::vector<std::string>& replies) {
+                   return merge_replies(merge, replies, {});
+               });
+        return std::nullopt;
+    }
+    if (spec->first == 0 || args.size() <= static_cast<size_t>(spec->first)) {
+        return database_.executeCommand(args);
+    }
+    size_t last = spec->last < 0 ? args.size() + spec->last : spec->last;
+    last = std::min(last, args.size() - 1);
+    if (spec->last < 0 && (args.size() - spec->first) % spec->step != 0) {
+        // A key without all its arguments: the command fails as a whole here
+        // rather than partly on the shards that got complete groups
+        return database_.executeCommand(args);
+    }
+
+    size_t shard = shardOf(args[spec->first]);
+    bool single_shard = true;
+    for (size_t pos = spec->first + spec->step; pos <= last; pos += spec->step) {
+        if (shardOf(args[pos]) != shard) {
+            single_shard = false;
+            break;
+        }
+    }
+    if (single_shard) {
+        if (shard == index_) {
+            return database_.executeCommand(args);
+        }
+        forward(connection, shard, args);
+        return std::nullopt;
+    }
+    if (spec->merge == ReplyMerge::NONE) {
+        return Protocol::serializeError("CROSSSLOT Keys in request don't hash to the same shard");
+    }
+    // ReplyMerge::ARRAY deals the elements back by the shard of each key
+    std::vector<size_t> key_shards;
+    if (spec->merge == ReplyMerge::ARRAY) {
+        for (size_t pos = spec->first; pos <= last; pos += spec->step) {
+            key_shards.push_back(shardOf(args[pos]));
+        }
+    }
+    fanOut(connection, splitByShard(*spec, args, shards_.size()),
+           [merge = spec->merge, key_shards = std::move(key_shards)](const std::vector<std::string>& replies) {
+               return merge_replies(merge, replies, key_shards);
+           });
+    return std::nullopt;
+}
+
+std::optional<std::string> EventLoop::scan(ClientConnection& connection, CommandArgsSpan args) {
+    // The cursor walks the shards in turn: shard + shard cursor * shards. A
+    // shard done with its keys hands over to the next one with cursor 0.
+    uint64_t cursor = 0;
+    if (args.size() < 2 ||
+        std::from_chars(args[1].data(), args[1].data() + args[1].size(), cursor).ptr != args[1].data() + args[1].size()) {
+        return database_.executeCommand(args);
+    }
+    size_t shards = shards_.size();
+    size_t shard = cursor % shards;
+    std::string shard_cursor = std::to_string(cursor / shards);
+    std::vector<CommandArgs> parts(shards);
+    parts[shard].assign(args.begin(), args.end());
+    parts[shard][1] = shard_cursor;
+    fanOut(connection, std::move(parts), [shard, shards](const std::vector<std::string>& replies) {
+        // "*2\r\n$<length>\r\n<cursor>\r\n<keys>"
+        const std::string& reply = replies[shard];
+        if (!reply.starts_with("*2\r\n")) {
+            return reply;
+        }
+        std::string_view rest(reply);
+        rest.remove_prefix(4);
+        std::string_view element = take_bulk_string(rest);
+        size_t digits = element.find("\r\n") + 2;
+        uint64_t next = 0;
+        std::from_chars(element.data() + digits, element.data() + element.size() - 2, next);
+        uint64_t merged = next != 0 ? next * shards + shard : (shard + 1 < shards ? shard + 1 : 0);
+        std::string result;
+        Protocol::appendArrayHeader(result, 2);
+        Protocol::appendBulkString(result, std::to_string(merged));
+        result += rest;
+        return result;
+    });
+    return std::nullopt;
+}
+
+size_t EventLoop::shardOf(std::string_view key) const {
+    return shardOf(key, shards_.size());
+}
+
+size_t EventLoop::shardOf(std::string_view key, size_t shards) {
+    // Mix the hash so that the shard index does not correlate with the low bits
+    // the storage hash table uses
+    uint64_t hash = std::hash<std::string_view>{}(key);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash % shards;
+}
+
+std::optional<std::string> EventLoop::executeServerCommand(ClientConnection& connection, const Command& command,
+                                                          CommandArgsSpan args) {
+    auto index = static_cast<size_t>(&command - Database::commandTable().data());
+    if (!command.acceptsArgs(args.size())) {
+        database_.stats().reject(index);
+        return Protocol::serializeError(std::format("ERR wrong number of arguments for '{}' command", args[0]));
+    }
+    CommandClock& clock = database_.clock();
+    uint64_t start = clock.start();
+    std::optional<std::string> reply = runServerCommand(connection, command, args);
+    // A command sent to every shard counts the time it took to send it out
+    database_.recordCall(command, args, clock.stop(start), reply.has_value() && reply->starts_with('-'));
+    return reply;
+}
+
+std::optional<std::string> EventLoop::runServerCommand(ClientConnection& connection, const Command& command,
+                                                       CommandArgsSpan args) {
+    if (command.name == "SAVE") {
+        return save();
+    }
+    if (command.name == "BGSAVE") {
+        return backgroundSave();
+    }
+    if (command.name == "BGREWRITEAOF") {
+        return rewriteAppendOnly();
+    }
+    if (command.name == "INFO") {
+        return info(args);
+    }
+    if (command.name == "CONFIG") {
+        return config(connection, args);
+    }
+    if (command.name == "SLOWLOG") {
+        return slowLog(connection, args);
+    }
+    if (command.name == "LATENCY") {
+        return latency(args);
+    }
+    return Protocol::serializeInteger(persistence_.last_save.load());
+}
+
+std::string EventLoop::info(CommandArgsSpan args) {
+    std::vector<std::string> sections;
+    for (size_t i = 1; i < args.size(); i++) {
+        sections.push_back(lowercase(args[i]));
+    }
+    if (sections.empty()) {
+        sections.emplace_back("default");
+    }
+    // Whether `section` was asked for, by name or as part of "default" when
+    // `by_default` is set
+    auto wanted = [&](std::string_view section, bool by_default) {
+        return std::ranges::any_of(sections, [&](const std::string& asked) {
+            return asked == section || asked == "all" || asked == "everything" || (by_default && asked == "default");
+        });
+    };
+    std::string text;
+    auto out = std::back_inserter(text);
+    // Sections are separated by an empty line
+    auto begin = [&](std::string_view title) {
+        std::format_to(out, "{}# {}\r\n", text.empty() ? "" : "\r\n", title);
+    };
+    if (wanted("server", true)) {
+        utsname system;
+        uname(&system);
+        auto uptime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - START_TIME).count();
+        begin("Server");
+        std::format_to(out, "redis_mode:standalone\r\nos:{} {} {}\r\narch_bits:{}\r\n", system.sysname, system.release,
+                       system.machine, sizeof(void*) * 8);
+        std::format_to(out, "multiplexing_api:{}\r\nevent_loops:{}\r\nprocess_id:{}\r\ntcp_port:{}\r\n", backendName(),
+                       shards_.size(), getpid(), port_);
+        std::format_to(out, "uptime_in_seconds:{}\r\nuptime_in_days:{}\r\nhz:{}\r\n", uptime, uptime / 86400,
+                       1000 / CRON_INTERVAL_MS);
+    }
+    if (wanted("clients", true)) {
+        uint64_t connected = 0;
+        for (const auto& shard : shards_) {
+            // Closed first: a connection is accepted before it is closed
+            uint64_t closed = shard->closed_connections_.load(std::memory_order_relaxed);
+            uint64_t accepted = shard->next_connection_id_.load(std::memory_order_relaxed);
+            connected += accepted - std::min(closed, accepted);
+        }
+        begin("Clients");
+        std::format_to(out, "connected_clients:{}\r\n", connected);
+    }
+    memory::Stats memory = memory::stats();
+    if (wanted("memory", true)) {
+        const MemoryLimits& limits = database_.storage().memoryLimits();
+        auto ratio = [](size_t part, size_t whole) {
+            return whole == 0 ? 0.0 : static_cast<double>(part) / static_cast<double>(whole);
+        };
+        begin("Memory");
+        std::format_to(out, "used_memory:{}\r\nused_memory_human:{}\r\n", memory.allocated, humanBytes(memory.allocated));
+        std::format_to(out, "used_memory_rss:{}\r\nused_memory_rss_human:{}\r\n", memory.resident,
+                       humanBytes(memory.resident));
+        std::format_to(out, "maxmemory:{}\r\nmaxmemory_human:{}\r\nmaxmemory_policy:{}\r\n", limits.max_memory,
+                       humanBytes(limits.max_memory), policyName(limits.policy));
+        std::format_to(out, "allocator_allocated:{}\r\nallocator_active:{}\r\n", memory.allocated, memory.active);
+        std::format_to(out, "allocator_frag_ratio:{:.2f}\r\nallocator_frag_bytes:{}\r\n",
+                       ratio(memory.active, memory.allocated),
+                       static_cast<int64_t>(memory.active) - static_cast<int64_t>(memory.allocated));
+        std::format_to(out, "mem_fragmentation_ratio:{:.2f}\r\nmem_fragmentation_bytes:{}\r\n",
+                       ratio(memory.resident, memory.allocated),
+                       static_cast<int64_t>(memory.resident) - static_cast<int64_t>(memory.allocated));
+        std::format_to(out, "mem_allocator:slab\r\nactive_defrag_enabled:{}\r\n",
+                       database_.storage().defragSettings().enabled ? 1 : 0);
+    }
+    if (wanted("stats", true)) {
+        uint64_t connections = 0;
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        uint64_t ops = 0;
+        uint64_t evicted = 0;
+        for (const auto& shard : shards_) {
+            const CommandStats& stats = shard->database_.stats();
+            connections += shard->next_connection_id_.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < stats.size(); i++) {
+                calls += stats[i].calls.load(std::memory_order_relaxed);
+                errors += stats[i].rejected.load(std::memory_order_relaxed) + stats[i].failed.load(std::memory_order_relaxed);
+            }
+            ops += shard->ops_per_sec_.load(std::memory_order_relaxed);
+            evicted += shard->database_.evictedKeys();
+        }
+        begin("Stats");
+        std::format_to(out, "total_connections_received:{}\r\ntotal_commands_processed:{}\r\n", connections, calls);
+        std::format_to(out, "instantaneous_ops_per_sec:{}\r\ntotal_error_replies:{}\r\nevicted_keys:{}\r\n", ops, errors,
+                       evicted);
+        std::format_to(out, "active_defrag_hits:{}\r\nactive_defrag_misses:{}\r\n", memory.defrag_hits,
+                       memory.defrag_misses);
+    }
+    bool command_section = wanted("commandstats", false);
+    bool latency_section = wanted("latencystats", false);
+    if (command_section || latency_section) {
+        CommandStats stats = commandStats();
+        std::span<const Command> table = Database::commandTable();
+        if (command_section) {
+            begin("Commandstats");
+            for (size_t i = 0; i < stats.size(); i++) {
+                const CommandStats::Entry& entry = stats[i];
+                uint64_t calls = entry.calls.load(std::memory_order_relaxed);
+                uint64_t rejected = entry.rejected.load(std::memory_order_relaxed);
+                if (calls == 0 && rejected == 0) {
+                    continue;
+                }
+                double micros = toMicros(entry.nanos.load(std::memory_order_relaxed));
+                std::format_to(out, "cmdstat_{}:calls={},usec={},usec_per_call={:.2f},rejected_calls={},failed_calls={}\r\n",
+                               lowercase(table[i].name), calls, static_cast<uint64_t>(micros),
+                               calls == 0 ? 0.0 : micros / static_cast<double>(calls), rejected,
+                               entry.failed.load(std::memory_order_relaxed));
+            }
+        }
+        if (latency_section) {
+            begin("Latencystats");
+            for (size_t i = 0; i < stats.size(); i++) {
+                const LatencyHistogram& latency = stats[i].latency;
+                if (latency.total() == 0) {
+                    continue;
+                }
+                std::format_to(out, "latency_percentiles_usec_{}:p50={:.3f},p99={:.3f},p99.9={:.3f}\r\n",
+                               lowercase(table[i].name), toMicros(latency.percentile(50)),
+                               toMicros(latency.percentile(99)), toMicros(latency.percentile(99.9)));
+            }
+        }
+    }
+    return Protocol::serializeBulkString(text);
+}
+
+std::optional<std::string> EventLoop::config(ClientConnection& connection, CommandArgsSpan args) {
+    if (args.size() == 2 && lowercase(args[1]) == "resetstat") {
+        // Each shard zeroes its own counters, between two of its commands
+        ShardTask reset = [](EventLoop& shard) {
+            shard.database_.resetStats();
+            return Protocol::serializeSimpleString("OK");
+        };
+        fanOut(connection, std::vector<ShardTask>(shards_.size(), reset), [](const std::vector<std::string>& replies) {
+            return merge_replies(ReplyMerge::OK, replies, {});
+        });
+        return std::nullopt;
+    }
+    return Protocol::serializeError(
+        std::format("ERR unknown subcommand or wrong number of arguments for '{}'. Try CONFIG HELP.", args[1]));
+}
+
+std::optional<std::string> EventLoop::slowLog(ClientConnection& connection, CommandArgsSpan args) {
+    std::string subcommand = lowercase(args[1]);
+    if (subcommand == "get" && args.size() <= 3) {
+        int64_t count = 10;
+        if (args.size() == 3) {
+            auto [end, error] = std::from_chars(args[2].data(), args[2].data() + args[2].size(), count);
+            if (error != std::errc() || end != args[2].data() + args[2].size() || count < -1) {
+                return Protocol::serializeError("ERR count should be greater than or equal to -1");
+            }
+        }
+        // Every shard copies out its newest entries into its own slot; the
+        // merge runs on this loop once all of them have answered
+        auto entries = std::make_shared<std::vector<std::vector<SlowLog::Entry>>>(shards_.size());
+        ShardTask copy = [entries, count](EventLoop& shard) {
+            const SlowLog& log = shard.database_.slowLog();
+            size_t kept = count == -1 ? log.length() : std::min(log.length(), static_cast<size_t>(count));
+            auto& copied = (*entries)[shard.index_];
+            for (size_t age = 0; age < kept; age++) {
+                copied.push_back(log[age]);
+            }
+            return std::string();
+        };
+        fanOut(connection, std::vector<ShardTask>(shards_.size(), copy),
+               [entries, count](const std::vector<std::string>&) {
+                   // The entries of every shard, newest first
+                   std::vector<const SlowLog::Entry*> merged;
+                   for (const auto& copied : *entries) {
+                       for (const SlowLog::Entry& entry : copied) {
+                           merged.push_back(&entry);
+                       }
+                   }
+                   std::ranges::sort(merged, std::greater<>(), &SlowLog::Entry::id);
+                   size_t shown = count == -1 ? merged.size() : std::min(merged.size(), static_cast<size_t>(count));
+                   std::string reply;
+                   Protocol::appendArrayHeader(reply, shown);
+                   for (size_t i = 0; i < shown; i++) {
+                       SlowLog::appendReply(reply, *merged[i]);
+                   }
+                   return reply;
+               });
+        return std::nullopt;
+    }
+    if (subcommand == "len" && args.size() == 2) {
+        ShardTask length = [](EventLoop& shard) {
+            return Protocol::serializeInteger(static_cast<int64_t>(shard.database_.slowLog().length()));
+        };
+        fanOut(connection, std::vector<ShardTask>(shards_.size(), length), [](const std::vector<std::string>& replies) {
+            return merge_replies(ReplyMerge::SUM, replies, {});
+        });
+        return std::nullopt;
+    }
+    if (subcommand == "reset" && args.size() == 2) {
+        ShardTask reset = [](EventLoop& shard) {
+            shard.database_.slowLog().reset();
+            return Protocol::serializeSimpleString("OK");
+        };
+        fanOut(connection, std::vector<ShardTask>(shards_.size(), reset), [](const std::vector<std::string>& replies) {
+            return merge_replies(ReplyMerge::OK, replies, {});
+        });
+        return std::nullopt;
+    }
+    return Protocol::serializeError(
+        std::format("ERR unknown subcommand or wrong number of arguments for '{}'. Try SLOWLOG HELP.", args[1]));
+}
+
+std::string EventLoop::latency(CommandArgsSpan args) {
+    std::string subcommand = lowercase(args[1]);
+    std::vector<LatencyMonitor::Event> events;
+    if (latency_monitor_ != nullptr && subcommand != "histogram") {
+        events = latency_monitor_->events();
+    }
+    std::string reply;
+    if (subcommand == "latest" && args.size() == 2) {
+        Protocol::appendArrayHeader(reply, events.size());
+        for (const LatencyMonitor::Event& event : events) {
+            Protocol::appendArrayHeader(reply, 4);
+            Protocol::appendBulkString(reply, event.name);
+            reply += Protocol::serializeInteger(event.latest().time);
+            reply += Protocol::serializeInteger(static_cast<int64_t>(event.latest().millis));
+            reply += Protocol::serializeInteger(static_cast<int64_t>(event.max));
+        }
+        return reply;
+    }
+    if (subcommand == "history" && args.size() == 3) {
+        auto it = std::ranges::find(events, args[2], &LatencyMonitor::Event::name);
+        size_t length = it == events.end() ? 0 : it->length;
+        Protocol::appendArrayHeader(reply, length);
+        // Oldest first
+        for (size_t i = 0; i < length; i++) {
+            const LatencyMonitor::Sample& sample =
+                it->samples[(it->next + LatencyMonitor::HISTORY - length + i) % LatencyMonitor::HISTORY];
+            Protocol::appendArrayHeader(reply, 2);
+            reply += Protocol::serializeInteger(sample.time);
+            reply += Protocol::serializeInteger(static_cast<int64_t>(sample.millis));
+        }
+        return reply;
+    }
+    if (subcommand == "reset") {
+        size_t reset = latency_monitor_ == nullptr ? 0 : latency_monitor_->reset(args.subspan(2));
+        return Protocol::serializeInteger(static_cast<int64_t>(reset));
+    }
+    if (subcommand != "histogram") {
+        return Protocol::serializeError(
+            std::format("ERR unknown subcommand or wrong number of arguments for '{}'. Try LATENCY HELP.", args[1]));
+    }
+    CommandStats stats = commandStats();
+    std::span<const Command> table = Database::commandTable();
+    // Every command that ran, or those named
+    std::vector<size_t> shown;
+    for (size_t i = 0; i < stats.size(); i++) {
+        bool named = args.size() == 2 || std::ranges::any_of(args.subspan(2), [&](const auto& name) {
+            return Database::command(name) == &table[i];
+        });
+        if (named && stats[i].calls.load(std::memory_order_relaxed) > 0) {
+            shown.push_back(i);
+        }
+    }
+    Protocol::appendArrayHeader(reply, shown.size() * 2);
+    for (size_t i : shown) {
+        // As Redis reports it: the number of calls that took at most each
+        // power of two of microseconds, for the powers some call fell under
+        std::map<uint64_t, uint64_t> counts;
+        for (size_t bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++) {
+            if (uint64_t count = stats[i].latency.count(bucket)) {
+                uint64_t micros = (LatencyHistogram::bucketLimit(bucket) + 999) / 1000;
+                counts[std::bit_ceil(std::max<uint64_t>(micros, 1))] += count;
+            }
+        }
+        Protocol::appendBulkString(reply, lowercase(table[i].name));
+        Protocol::appendArrayHeader(reply, 4);
+        Protocol::appendBulkString(reply, "calls");
+        reply += Protocol::serializeInteger(static_cast<int64_t>(stats[i].calls.load(std::memory_order_relaxed)));
+        Protocol::appendBulkString(reply, "histogram_usec");
+        Protocol::appendArrayHeader(reply, counts.size() * 2);
+        uint64_t cumulative = 0;
+        for (auto [micros, count] : counts) {
+            cumulative += count;
+            reply += Protocol::serializeInteger(static_cast<int64_t>(micros));
+            reply += Protocol::serializeInteger(static_cast<int64_t>(cumulative));
+        }
+    }
+    return reply;
+}
+
+CommandStats EventLoop::commandStats() const {
+    CommandStats total(Database::commandTable().size());
+    for (const auto& shard : shards_) {
+        total.merge(shard->database_.stats());
+    }
+    return total;
+}
+
+std::string EventLoop::save() {
+    if (persistence_.saving.exchange(true)) {
+        return Protocol::serializeError("ERR Background save already in progress");
+    }
+    std::string reply = Protocol::serializeSimpleString("OK");
+    try {
+        if (withShardsPaused([this]() {
+                Rdb::save(persistence_.rdb_path, storages());
+            })) {
+            persistence_.last_save = unixTime();
+            REDIS_INFO("DB saved on disk");
+        } else {
+            reply = PAUSE_BUSY_ERROR;
+        }
+    } catch (const std::exception& e) {
+        REDIS_ERROR("Failed to save snapshot: {}", e.what());
+        reply = Protocol::serializeError(std::format("ERR {}", e.what()));
+    }
+    persistence_.saving = false;
+    return reply;
+}
+
+std::string EventLoop::backgroundSave() {
+    if (persistence_.saving.exchange(true)) {
+        return Protocol::serializeError("ERR Background save already in progress");
+    }
+    pid_t pid = forkChild([]() {}, [this]() {
+        Rdb::save(persistence_.rdb_path, storages());
+    });
+    if (pid == -1) {
+        persistence_.saving = false;
+        return Protocol::serializeError(std::format("ERR Failed to fork: {}", strerror(errno)));
+    }
+    child_ = pid;
+    child_job_ = ChildJob::SAVE;
+    REDIS_INFO("Background saving started by pid {}", pid);
+    return Protocol::serializeSimpleString("Background saving started");
+}
+
+std::string EventLoop::rewriteAppendOnly() {
+    AppendOnlyFile* aof = persistence_.aof.get();
+    if (aof == nullptr) {
+        return Protocol::serializeError("ERR Append only file is not enabled");
+    }
+    if (persistence_.saving.exchange(true)) {
+        return Protocol::serializeError("ERR Background save or rewrite already in progress");
+    }
+    // Every loop has flushed its batch when `prepare` runs, so the commands
+    // kept for the rewrite are exactly those missing from the child's image
+    pid_t pid = forkChild([aof]() { aof->startRewrite(); }, [this, aof]() {
+        AppendOnlyFile::writeCommands(aof->rewritePath(::getpid()), storages());
+    });
+    if (pid == -1) {
+        aof->abortRewrite(pid);
+        persistence_.saving = false;
+        return Protocol::serializeError(std::format("ERR Failed to fork: {}", strerror(errno)));
+    }
+    child_ = pid;
+    child_job_ = ChildJob::REWRITE;
+    REDIS_INFO("Background append only file rewriting started by pid {}", pid);
+    return Protocol::serializeSimpleString("Background append only file rewriting started");
+}
+
+pid_t EventLoop::forkChild(const std::function<void()>& prepare, const std::function<void()>& job) {
+    pid_t pid = -1;
+    bool paused = withShardsPaused([&]() {
+        prepare();
+        pid = ::fork();
+        if (pid != 0) {
+            return;
+        }
+        // The child has this thread only, and a copy-on-write image of every
+        // shard as it was at the fork
+        int status = 0;
+        try {
+            job();
+        } catch (const std::exception&) {
+            status = 1;
+        }
+        ::_exit(status);
+    });
+    if (!paused) {
+        errno = EBUSY;
+    }
+    return pid;
+}
+
+void EventLoop::reapChild(bool block) {
+    int status = 0;
+    pid_t pid = ::waitpid(child_, &status, block ? 0 : WNOHANG);
+    if (pid == 0) {
+        return;
+    }
+    bool ok = pid == child_ && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (child_job_ == ChildJob::SAVE) {
+        if (ok) {
+            persistence_.last_save = unixTime();
+            REDIS_INFO("Background saving terminated with success");
+        } else {
+            REDIS_ERROR("Background saving failed");
+        }
+    } else if (ok) {
+        try {
+            persistence_.aof->finishRewrite(child_);
+            REDIS_INFO("Background append only file rewriting terminated with success");
+        } catch (const std::exception& e) {
+            REDIS_ERROR("Background append only file rewriting failed: {}", e.what());
+        }
+    } else {
+        persistence_.aof->abortRewrite(child_);
+        REDIS_ERROR("Background append only file rewriting failed");
+    }
+    child_ = -1;
+    persistence_.saving = false;
+}
+
+bool EventLoop::withShardsPaused(const std::function<void()>& fn) {
+    if (pausing.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+    struct Barrier {
+        std::atomic<size_t> parked{0};
+        std::atomic<bool> released{false};
+    };
+    auto barrier = std::make_shared<Barrier>();
+    // Commands executed before the pause reach the append-only file first
+    flushAppendOnly();
+    for (const auto& shard : shards_) {
+        if (shard.get() == this) {
+            continue;
+        }
+        EventLoop* loop = shard.get();
+        loop->post([barrier, loop]() {
+            loop->flushAppendOnly();
+            barrier->parked.fetch_add(1);
+            barrier->parked.notify_one();
+            barrier->released.wait(false);
+        });
+    }
+    size_t others = shards_.size() - 1;
+    for (size_t parked = barrier->parked.load(); parked != others; parked = barrier->parked.load()) {
+        barrier->parked.wait(parked);
+    }
+
+    // Release the other loops even if `fn` throws
+    struct Release {
+        Barrier& barrier;
+        ~Release() {
+            barrier.released = true;
+            barrier.released.notify_all();
+            pausing.store(false, std::memory_order_release);
+        }
+    } release{*barrier};
+    fn();
+    return true;
+}
+
+std::vector<Storage*> EventLoop::storages() const {
+    std::vector<Storage*> storages;
+    storages.reserve(shards_.size());
+    for (const auto& shard : shards_) {
+        storages.push_back(&shard->database_.storage());
+    }
+    return storages;
+}
+
+void EventLoop::forward(ClientConnection& connection, size_t shard, CommandArgsSpan args) {
+    // The arguments view into the connection's input buffer, so the target
+    // shard gets its own copy
+    std::vector<std::string> owned(args.begin(), args.end());
+    auto slot = connection.reserveReply();
+    int client_socket = connection.socket();
+    uint64_t connection_id = connection.id();
+    EventLoop* target = shards_[shard].get();
+    target->post([this, target, client_socket, connection_id, slot, owned = std::move(owned)]() {
+        CommandArgs views(owned.begin(), owned.end());
+        auto reply = target->database_.executeCommand(views);
+        target->replyTo(this, [this, client_socket, connection_id, slot, reply = std::move(reply)]() mutable {
+            deliver(client_socket, connection_id, slot, std::move(reply));
+        });
+    });
+    // Handing the command over is not part of the next local command's time
+    database_.clock().interrupt();
+}
+
+std::vector<CommandArgs> EventLoop::splitByShard(const KeySpec& spec, CommandArgsSpan args, size_t shards) {
+    size_t last = spec.last < 0 ? args.size() + spec.last : spec.last;
+    last = std::min(last, args.size() - 1);
+    std::vector<CommandArgs> parts(shards);
+    for (size_t pos = spec.first; pos <= last; pos += spec.step) {
+        auto& part = parts[shardOf(args[pos], shards)];
+        if (part.empty()) {
+            part.assign(args.begin(), args.begin() + spec.first);
+        }
+        part.insert(part.end(), args.begin() + pos, args.begin() + std::min(pos + spec.step, args.size()));
+    }
+    return parts;
+}
+
+void EventLoop::fanOut(ClientConnection& connection, std::vector<CommandArgs> parts, MergeFn merge) {
+    std::vector<ShardTask> tasks(parts.size());
+    for (size_t shard = 0; shard < parts.size(); ++shard) {
+        if (parts[shard].empty()) {
+            continue;
+        }
+        if (shard == index_) {
+            // Runs before fanOut() returns, while the arguments still view
+            // into the connection's input buffer
+            tasks[shard] = [args = std::move(parts[shard])](EventLoop& loop) {
+                return loop.database_.executeCommand(args);
+            };
+            continue;
+        }
+        // The remote shards get their own copies of the arguments
+        tasks[shard] = [owned = std::vector<std::string>(parts[shard].begin(), parts[shard].end())](EventLoop& loop) {
+            CommandArgs views(owned.begin(), owned.end());
+            return loop.database_.executeCommand(views);
+        };
+    }
+    fanOut(connection, std::move(tasks), std::move(merge));
+}
+
+void EventLoop::fanOut(ClientConnection& connection, std::vector<ShardTask> tasks, MergeFn merge) {
+    // Owned by this loop's thread only: remote shards post their replies back
+    struct FanOut {
+        size_t remaining = 0;
+        std::vector<std::string> replies;
+    };
+    auto state = std::make_shared<FanOut>();
+    state->replies.resize(shards_.size());
+    state->remaining = std::ranges::count_if(tasks, [](const auto& task) { return static_cast<bool>(task); });
+
+    auto slot = connection.reserveReply();
+    int client_socket = connection.socket();
+    uint64_t connection_id = connection.id();
+    auto complete = [this, state, client_socket, connection_id, slot, merge = std::move(merge)](size_t shard,
+                                                                                               std::string reply) {
+        state->replies[shard] = std::move(reply);
+        if (--state->remaining == 0) {
+            deliver(client_socket, connection_id, slot, merge(state->replies));
+        }
+    };
+
+    for (size_t shard = 0; shard < tasks.size(); ++shard) {
+        if (!tasks[shard]) {
+            continue;
+        }
+        if (shard == index_) {
+            // Timed from here, not from the end of the previous command
+            database_.clock().interrupt();
+            complete(shard, tasks[shard](*this));
+            continue;
+        }
+        EventLoop* target = shards_[shard].get();
+        target->post([this, target, shard, complete, task = std::move(tasks[shard])]() {
+            auto reply = task(*target);
+            target->replyTo(this, [complete, shard, reply = std::move(reply)]() mutable {
+                complete(shard, std::move(reply));
+            });
+        });
+    }
+    // Posting the parts is not part of the next local command's time
+    database_.clock().interrupt();
+}
+
+} // namespace redis
@@ -0,0 +1,128 @@
+#include "redis/glob.hpp"
+#include <utility>
+
+namespace redis {
+
+GlobPattern::GlobPattern(std::string_view pattern) {
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if (c == '*') {
+            // Consecutive stars match the same texts as one
+            if (tokens_.empty() || tokens_.back().type != Token::STAR) {
+                tokens_.push_back({Token::STAR, 0, 0});
+            }
+        } else if (c == '?') {
+            tokens_.push_back({Token::ANY, 0, 0});
+        } else if (c == '\\' && i + 1 < pattern.size()) {
+            addLiteral(pattern[++i]);
+        } else if (c == '[' && pattern.find(']', i + 2) != std::string_view::npos) {
+            std::bitset<256> members;
+            size_t j = i + 1;
+            bool negate = pattern[j] == '^';
+            if (negate) {
+                j++;
+            }
+            // A `]` right after the opening is a member, not the end
+            for (bool first = true; j < pattern.size() && (first || pattern[j] != ']'); j++, first = false) {
+                if (pattern[j] == '\\' && j + 1 < pattern.size()) {
+                    j++;
+                } else if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']') {
+                    auto low = static_cast<uint8_t>(pattern[j]);
+                    auto high = static_cast<uint8_t>(pattern[j + 2]);
+                    if (low > high) {
+                        std::swap(low, high);
+                    }
+                    for (unsigned byte = low; byte <= high; byte++) {
+                        members.set(byte);
+                    }
+                    j += 2;
+                    continue;
+                }
+                members.set(static_cast<uint8_t>(pattern[j]));
+            }
+            if (j == pattern.size()) {
+                // No closing bracket after all, e.g. "[^]": a literal `[`
+                addLiteral(c);
+                continue;
+            }
+            if (negate) {
+                members.flip();
+            }
+            tokens_.push_back({Token::CLASS, static_cast<uint32_t>(classes_.size()), 0});
+            classes_.push_back(members);
+            i = j;
+        } else {
+            addLiteral(c);
+        }
+    }
+
+    if (tokens_.size() == 1 && tokens_[0].type == Token::STAR) {
+        kind_ = Kind::ALL;
+    } else if (tokens_.empty() || (tokens_.size() == 1 && tokens_[0].type == Token::LITERAL)) {
+        kind_ = Kind::LITERAL;
+    } else if (tokens_.size() == 2 && tokens_[0].type == Token::LITERAL && tokens_[1].type == Token::STAR) {
+        kind_ = Kind::PREFIX;
+    } else {
+        kind_ = Kind::GENERAL;
+    }
+}
+
+void GlobPattern::addLiteral(char c) {
+    if (tokens_.empty() || tokens_.back().type != Token::LITERAL) {
+        tokens_.push_back({Token::LITERAL, static_cast<uint32_t>(literals_.size()), 0});
+    }
+    literals_ += c;
+    tokens_.back().length++;
+}
+
+bool GlobPattern::matches(std::string_view text) const {
+    switch (kind_) {
+        case Kind::ALL:
+            return true;
+        case Kind::LITERAL:
+            return text == literals_;
+        case Kind::PREFIX:
+            return text.starts_with(literals_);
+        case Kind::GENERAL:
+            break;
+    }
+    // Between two stars a pattern matches in at most one way, so on a
+    // mismatch only the last star has to try a longer run
+    size_t token = 0;
+    size_t pos = 0;
+    size_t star_token = tokens_.size();
+    size_t star_pos = 0;
+    while (pos < text.size() || token < tokens_.size()) {
+        if (token < tokens_.size()) {
+            const Token& current = tokens_[token];
+            if (current.type == Token::STAR) {
+                star_token = token++;
+                star_pos = pos;
+                continue;
+            }
+            bool matched = false;
+            if (current.type == Token::LITERAL) {
+                std::string_view literal(literals_.data() + current.offset, current.length);
+                matched = text.substr(pos).starts_with(literal);
+                if (matched) {
+                    pos += literal.size();
+                }
+            } else if (pos < text.size()) {
+                matched = current.type == Token::ANY || classes_[current.offset].test(static_cast<uint8_t>(text[pos]));
+                pos += matched ? 1 : 0;
+            }
+            if (matched) {
+                token++;
+                continue;
+            }
+        }
+        if (star_token == tokens_.size() || star_pos >= text.size()) {
+            return false;
+        }
+        pos = ++star_pos;
+        token = star_token + 1;
+    }
+    return true;
+}
+
+} // namespace redis
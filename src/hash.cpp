@@ -0,0 +1,159 @@
+#include "redis/hash.hpp"
+#include "redis/memory.hpp"
+#include "redis/varint.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+    size_t encodedSize(std::string_view value) {
+        return redis::varint::size(value.size()) + value.size();
+    }
+
+    char* writeString(char* out, std::string_view value) {
+        out = redis::varint::write(out, value.size());
+        std::memcpy(out, value.data(), value.size());
+        return out + value.size();
+    }
+}
+
+namespace redis {
+
+Hash::Hash() : packed_(nullptr), packed_size_(0), packed_capacity_(0), packed_count_(0) {
+}
+
+Hash::~Hash() {
+    memory::release(packed_);
+}
+
+size_t Hash::size() const {
+    return table_ != nullptr ? table_->size() : packed_count_;
+}
+
+std::string_view Hash::readString(const char*& entry) {
+    size_t length;
+    const char* data = varint::read(entry, length);
+    entry = data + length;
+    return std::string_view(data, length);
+}
+
+const char* Hash::findPacked(std::string_view field) const {
+    const char* entry = packed_;
+    const char* end = packed_ + packed_size_;
+    while (entry < end) {
+        const char* start = entry;
+        std::string_view candidate = readString(entry);
+        if (candidate == field) {
+            return start;
+        }
+        readString(entry);
+    }
+    return nullptr;
+}
+
+char* Hash::splicePacked(size_t offset, size_t size, size_t replacement) {
+    size_t new_size = packed_size_ - size + replacement;
+    if (new_size > packed_capacity_) {
+        size_t capacity = std::max<size_t>(new_size, packed_capacity_ * 2);
+        auto* grown = static_cast<char*>(memory::reallocate(packed_, capacity));
+        packed_ = grown;
+        packed_capacity_ = static_cast<uint32_t>(capacity);
+    }
+    std::memmove(packed_ + offset + replacement, packed_ + offset + size, packed_size_ - offset - size);
+    packed_size_ = static_cast<uint32_t>(new_size);
+    return packed_ + offset;
+}
+
+void Hash::convert() {
+    auto table = std::make_unique<Table>();
+    table->reserve(packed_count_);
+    forEach([&table](std::string_view field, std::string_view value) {
+        table->tryEmplace(field, Object::createString(field, value));
+    });
+    table_ = std::move(table);
+    memory::release(packed_);
+    packed_ = nullptr;
+    packed_size_ = packed_capacity_ = packed_count_ = 0;
+}
+
+std::optional<StringValue> Hash::get(std::string_view field) const {
+    if (table_ != nullptr) {
+        const Object::Ptr* value = table_->find(field);
+        if (value == nullptr) {
+            return std::nullopt;
+        }
+        return (*value)->string();
+    }
+    const char* entry = findPacked(field);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+    readString(entry);
+    return StringValue(readString(entry));
+}
+
+bool Hash::set(std::string_view field, std::string_view value, const HashLimits& limits) {
+    if (table_ == nullptr) {
+        const char* entry = nullptr;
+        bool fits = field.size() <= limits.max_packed_value && value.size() <= limits.max_packed_value;
+        if (fits) {
+            entry = findPacked(field);
+            fits = entry != nullptr || packed_count_ < limits.max_packed_entries;
+        }
+        if (!fits) {
+            convert();
+        } else if (entry == nullptr) {
+            char* out = splicePacked(packed_size_, 0, encodedSize(field) + encodedSize(value));
+            writeString(writeString(out, field), value);
+            packed_count_++;
+            return true;
+        } else {
+            // Resize the old value in place, keeping the field order
+            const char* old_value = entry;
+            readString(old_value);
+            const char* old_end = old_value;
+            readString(old_end);
+            char* out = splicePacked(static_cast<size_t>(old_value - packed_),
+                                     static_cast<size_t>(old_end - old_value), encodedSize(value));
+            writeString(out, value);
+            return false;
+        }
+    }
+
+    Object::Ptr object = Object::createString(field, value);
+    auto [slot, inserted] = table_->tryEmplace(field, std::move(object));
+    if (!inserted) {
+        *slot = std::move(object);
+    }
+    return inserted;
+}
+
+bool Hash::erase(std::string_view field) {
+    if (table_ != nullptr) {
+        return table_->erase(field);
+    }
+    const char* entry = findPacked(field);
+    if (entry == nullptr) {
+        return false;
+    }
+    const char* end = entry;
+    readString(end);
+    readString(end);
+    splicePacked(static_cast<size_t>(entry - packed_), static_cast<size_t>(end - entry), 0);
+    packed_count_--;
+    return true;
+}
+
+size_t Hash::memoryUsage() const {
+    if (table_ == nullptr) {
+        return packed_ != nullptr ? memory::usableSize(packed_) : 0;
+    }
+    size_t usage = sizeof(Table) + table_->memoryUsage();
+    table_->forEach([&usage](std::string_view, const Object::Ptr& value) {
+        usage += value->memoryUsage();
+    });
+    return usage;
+}
+
+} // namespace redis
@@ -0,0 +1,315 @@
+#include "redis/intset.hpp"
+#include "redis/memory.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Intersections of sets this many times apart in size search the larger
+    // set for each element of the smaller one instead of merging them
+    constexpr size_t GALLOP_RATIO = 32;
+
+    size_t widthOf(int64_t value) {
+        if (value >= INT16_MIN && value <= INT16_MAX) {
+            return sizeof(int16_t);
+        }
+        if (value >= INT32_MIN && value <= INT32_MAX) {
+            return sizeof(int32_t);
+        }
+        return sizeof(int64_t);
+    }
+
+    // Call `fn` with the elements at `data` as an array of their type
+    template <typename Fn>
+    decltype(auto) withType(size_t width, const char* data, Fn&& fn) {
+        switch (width) {
+            case sizeof(int16_t):
+                return fn(reinterpret_cast<const int16_t*>(data));
+            case sizeof(int32_t):
+                return fn(reinterpret_cast<const int32_t*>(data));
+            default:
+                return fn(reinterpret_cast<const int64_t*>(data));
+        }
+    }
+
+    template <typename A, typename B>
+    void mergeIntersect(const A* a, size_t a_size, const B* b, size_t b_size, std::vector<int64_t>& out) {
+        size_t i = 0;
+        size_t j = 0;
+        while (i < a_size && j < b_size) {
+            if (a[i] < b[j]) {
+                i++;
+            } else if (b[j] < a[i]) {
+                j++;
+            } else {
+                out.push_back(a[i]);
+                i++;
+                j++;
+            }
+        }
+    }
+
+    // Look up each element of `small` in `large`, from where the previous
+    // one was found: double the step until past the element, then binary
+    // search the last step
+    template <typename A, typename B>
+    void gallopIntersect(const A* small, size_t small_size, const B* large, size_t large_size,
+                         std::vector<int64_t>& out) {
+        size_t low = 0;
+        for (size_t i = 0; i < small_size && low < large_size; i++) {
+            int64_t value = small[i];
+            size_t high = low;
+            for (size_t step = 1; high < large_size && large[high] < value; step *= 2) {
+                low = high + 1;
+                high += step;
+            }
+            high = std::min(high, large_size);
+            low = static_cast<size_t>(std::lower_bound(large + low, large + high, value) - large);
+            if (low < large_size && large[low] == value) {
+                out.push_back(value);
+                low++;
+            }
+        }
+    }
+
+#if defined(__SSE2__)
+    // The lanes of `a` that equal any lane of `b`, one bit per lane, found by
+    // comparing `a` with every rotation of `b`
+    template <typename T>
+    struct Block;
+
+    template <>
+    struct Block<int16_t> {
+        static constexpr size_t LANES = 8;
+
+        static uint32_t matches(__m128i a, __m128i b) {
+            __m128i equal = _mm_cmpeq_epi16(a, b);
+            for (size_t rotation = 1; rotation < LANES; rotation++) {
+                b = _mm_or_si128(_mm_srli_si128(b, 2), _mm_slli_si128(b, 14));
+                equal = _mm_or_si128(equal, _mm_cmpeq_epi16(a, b));
+            }
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(equal, _mm_setzero_si128())));
+        }
+    };
+
+    template <>
+    struct Block<int32_t> {
+        static constexpr size_t LANES = 4;
+
+        static uint32_t matches(__m128i a, __m128i b) {
+            __m128i equal = _mm_cmpeq_epi32(a, b);
+            for (size_t rotation = 1; rotation < LANES; rotation++) {
+                b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1));
+                equal = _mm_or_si128(equal, _mm_cmpeq_epi32(a, b));
+            }
+            return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+        }
+    };
+
+    template <>
+    struct Block<int64_t> {
+        static constexpr size_t LANES = 2;
+
+        // SSE2 has no 64-bit compare: both 32-bit halves must be equal
+        static __m128i equal64(__m128i a, __m128i b) {
+            __m128i equal = _mm_cmpeq_epi32(a, b);
+            return _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        }
+
+        static uint32_t matches(__m128i a, __m128i b) {
+            __m128i equal = _mm_or_si128(equal64(a, b), equal64(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))));
+            return static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(equal)));
+        }
+    };
+
+    // Merge 16 bytes of each array at a time, advancing the block whose last
+    // element is smaller, then finish the tails one element at a time.
+    // Every element is unique, so it matches at most once and the matches
+    // come out in order.
+    template <typename T>
+    void blockIntersect(const T* a, size_t a_size, const T* b, size_t b_size, std::vector<int64_t>& out) {
+        constexpr size_t LANES = Block<T>::LANES;
+        size_t i = 0;
+        size_t j = 0;
+        while (i + LANES <= a_size && j + LANES <= b_size) {
+            __m128i a_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i b_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+            for (uint32_t match = Block<T>::matches(a_block, b_block); match != 0; match &= match - 1) {
+                out.push_back(a[i + std::countr_zero(match)]);
+            }
+            T a_last = a[i + LANES - 1];
+            T b_last = b[j + LANES - 1];
+            if (a_last <= b_last) {
+                i += LANES;
+            }
+            if (b_last <= a_last) {
+                j += LANES;
+            }
+        }
+        mergeIntersect(a + i, a_size - i, b + j, b_size - j, out);
+    }
+#endif
+
+    // `small` must not be larger than `large`
+    template <typename A, typename B>
+    void intersectSorted(const A* small, size_t small_size, const B* large, size_t large_size,
+                         std::vector<int64_t>& out) {
+        if (small_size == 0) {
+            return;
+        }
+        if (large_size / small_size >= GALLOP_RATIO) {
+            gallopIntersect(small, small_size, large, large_size, out);
+            return;
+        }
+#if defined(__SSE2__)
+        if constexpr (std::is_same_v<A, B>) {
+            blockIntersect(small, small_size, large, large_size, out);
+            return;
+        }
+#endif
+        mergeIntersect(small, small_size, large, large_size, out);
+    }
+}
+
+namespace redis {
+
+IntSet::IntSet() : data_(nullptr), size_(0), capacity_(0), width_(sizeof(int16_t)) {
+}
+
+IntSet::~IntSet() {
+    memory::release(data_);
+}
+
+int64_t IntSet::at(size_t index) const {
+    return withType(width_, data_, [index](auto elements) { return static_cast<int64_t>(elements[index]); });
+}
+
+size_t IntSet::lowerBound(int64_t value) const {
+    return withType(width_, data_, [this, value](auto elements) {
+        return static_cast<size_t>(std::lower_bound(elements, elements + size_, value) - elements);
+    });
+}
+
+bool IntSet::contains(int64_t value) const {
+    if (widthOf(value) > width_) {
+        return false;
+    }
+    size_t index = lowerBound(value);
+    return index < size_ && at(index) == value;
+}
+
+void IntSet::reserve(size_t count) {
+    if (count <= capacity_) {
+        return;
+    }
+    size_t capacity = std::max<size_t>(count, capacity_ * 2);
+    auto* grown = static_cast<char*>(memory::reallocate(data_, capacity * width_));
+    data_ = grown;
+    capacity_ = static_cast<uint32_t>(capacity);
+}
+
+void IntSet::widen(size_t width) {
+    // A new buffer rather than in place, so that no memory is read as one
+    // width after being written as another
+    auto* wider = static_cast<char*>(memory::allocate(std::max<size_t>(capacity_, 1) * width));
+    for (size_t i = 0; i < size_; i++) {
+        int64_t value = at(i);
+        switch (width) {
+            case sizeof(int32_t): {
+                auto narrow = static_cast<int32_t>(value);
+                std::memcpy(wider + i * width, &narrow, width);
+                break;
+            }
+            default:
+                std::memcpy(wider + i * width, &value, width);
+                break;
+        }
+    }
+    memory::release(data_);
+    data_ = wider;
+    capacity_ = std::max<uint32_t>(capacity_, 1);
+    width_ = static_cast<uint8_t>(width);
+}
+
+bool IntSet::insert(int64_t value) {
+    size_t index;
+    if (widthOf(value) > width_) {
+        // A value too wide for the elements is beyond all of them
+        widen(widthOf(value));
+        index = value < 0 ? 0 : size_;
+    } else {
+        index = lowerBound(value);
+        if (index < size_ && at(index) == value) {
+            return false;
+        }
+    }
+    reserve(size_ + 1);
+    std::memmove(data_ + (index + 1) * width_, data_ + index * width_, (size_ - index) * width_);
+    switch (width_) {
+        case sizeof(int16_t): {
+            auto narrow = static_cast<int16_t>(value);
+            std::memcpy(data_ + index * width_, &narrow, width_);
+            break;
+        }
+        case sizeof(int32_t): {
+            auto narrow = static_cast<int32_t>(value);
+            std::memcpy(data_ + index * width_, &narrow, width_);
+            break;
+        }
+        default:
+            std::memcpy(data_ + index * width_, &value, width_);
+            break;
+    }
+    size_++;
+    return true;
+}
+
+bool IntSet::erase(int64_t value) {
+    if (!contains(value)) {
+        return false;
+    }
+    size_t index = lowerBound(value);
+    std::memmove(data_ + index * width_, data_ + (index + 1) * width_, (size_ - index - 1) * width_);
+    size_--;
+    return true;
+}
+
+void IntSet::clear() {
+    memory::release(data_);
+    data_ = nullptr;
+    size_ = capacity_ = 0;
+    width_ = sizeof(int16_t);
+}
+
+void IntSet::intersect(const IntSet& other, std::vector<int64_t>& out) const {
+    const IntSet& small = size_ <= other.size_ ? *this : other;
+    const IntSet& large = size_ <= other.size_ ? other : *this;
+    withType(small.width_, small.data_, [&](auto small_elements) {
+        withType(large.width_, large.data_, [&](auto large_elements) {
+            intersectSorted(small_elements, small.size_, large_elements, large.size_, out);
+        });
+    });
+}
+
+void IntSet::intersect(std::span<const int64_t> sorted, std::vector<int64_t>& out) const {
+    withType(width_, data_, [&](auto elements) {
+        if (sorted.size() <= size_) {
+            intersectSorted(sorted.data(), sorted.size(), elements, size_, out);
+        } else {
+            intersectSorted(elements, size_, sorted.data(), sorted.size(), out);
+        }
+    });
+}
+
+size_t IntSet::memoryUsage() const {
+    return data_ != nullptr ? memory::usableSize(data_) : 0;
+}
+
+} // namespace redis
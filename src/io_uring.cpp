@@ -0,0 +1,189 @@
+#include "redis/io_uring.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    int io_uring_setup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+    }
+
+    void* map_ring(int fd, size_t size, off_t offset) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error(std::format("Failed to map io_uring: {}", strerror(errno)));
+        }
+        return ptr;
+    }
+
+    template <typename T>
+    T* at(void* base, unsigned offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+}
+
+namespace redis {
+
+IoUring::IoUring(unsigned entries)
+    : sq_ring_(nullptr), cq_ring_(nullptr), sqes_(nullptr), sqe_tail_(0),
+      buffer_group_(0), buffer_size_(0) {
+    // Only the owning loop's thread submits, and completions are reaped in one
+    // place, which lets the kernel defer task work until we wait. Older
+    // kernels reject the flags and get a plain ring.
+    const unsigned flag_sets[] = {
+        IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_COOP_TASKRUN,
+        0,
+    };
+    ring_fd_ = -1;
+    for (unsigned flags : flag_sets) {
+        std::memset(&params_, 0, sizeof(params_));
+        params_.flags = flags;
+        ring_fd_ = io_uring_setup(entries, &params_);
+        if (ring_fd_ != -1 || errno != EINVAL) {
+            break;
+        }
+    }
+    if (ring_fd_ == -1) {
+        throw std::runtime_error(std::format("io_uring is not available: {}", strerror(errno)));
+    }
+    if (!(params_.features & IORING_FEAT_EXT_ARG)) {
+        ::close(ring_fd_);
+        throw std::runtime_error("io_uring backend needs Linux 5.11 or newer");
+    }
+
+    sq_ring_size_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+    if (params_.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        cq_ring_size_ = sq_ring_size_;
+    }
+    sq_ring_ = map_ring(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = (params_.features & IORING_FEAT_SINGLE_MMAP)
+        ? sq_ring_
+        : map_ring(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params_.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map_ring(ring_fd_, sqes_size_, IORING_OFF_SQES));
+
+    sq_head_ = at<unsigned>(sq_ring_, params_.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, params_.sq_off.tail);
+    sq_array_ = at<unsigned>(sq_ring_, params_.sq_off.array);
+    sq_mask_ = *at<unsigned>(sq_ring_, params_.sq_off.ring_mask);
+    sqe_tail_ = *sq_tail_;
+    cq_head_ = at<unsigned>(cq_ring_, params_.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, params_.cq_off.tail);
+    cq_mask_ = *at<unsigned>(cq_ring_, params_.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(cq_ring_, params_.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    // The kernel cancels the requests still in flight after the ring is
+    // closed, not before close() returns: whatever memory they use has to
+    // outlive it, or the owner has to cancel and reap them first
+    ::close(ring_fd_);
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    munmap(sq_ring_, sq_ring_size_);
+}
+
+bool IoUring::submissionQueueFull() {
+    return sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= params_.sq_entries;
+}
+
+io_uring_sqe* IoUring::getSqe() {
+    while (submissionQueueFull()) {
+        int result = enter(pendingSubmissions(), 0, 0, nullptr, 0);
+        if (result == -EBUSY || result == -EAGAIN) {
+            // The completions have nowhere to go; make room and try again
+            setCompletionsAside();
+        }
+    }
+    unsigned index = sqe_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    sqe_tail_++;
+    return sqe;
+}
+
+void IoUring::submitAndWait(int timeout_ms) {
+    __kernel_timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    enter(pendingSubmissions(), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+void IoUring::setupBuffers(uint16_t group, unsigned count, unsigned size) {
+    buffers_ = std::make_unique_for_overwrite<char[]>(static_cast<size_t>(count) * size);
+    buffer_group_ = group;
+    buffer_size_ = size;
+    provideBuffers(0, count);
+}
+
+std::string_view IoUring::buffer(uint16_t id, size_t length) const {
+    return std::string_view(buffers_.get() + static_cast<size_t>(id) * buffer_size_, length);
+}
+
+void IoUring::recycleBuffer(uint16_t id) {
+    provideBuffers(id, 1);
+}
+
+void IoUring::provideBuffers(uint16_t first_id, unsigned count) {
+    // Provided buffers rather than a registered buffer ring: a ring needs
+    // Linux 5.19, and some kernels register one without ever selecting from it
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(buffers_.get() + static_cast<size_t>(first_id) * buffer_size_);
+    sqe->len = buffer_size_;
+    sqe->off = first_id;
+    sqe->buf_group = buffer_group_;
+    if (params_.features & IORING_FEAT_CQE_SKIP) {
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    }
+    sqe->user_data = PROVIDE_BUFFERS_TAG;
+}
+
+unsigned IoUring::pendingSubmissions() {
+    // Publish the entries filled in since the last submission
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    return sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+}
+
+void IoUring::setCompletionsAside() {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        set_aside_.push_back(cqes_[head & cq_mask_]);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+int IoUring::enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t arg_size) {
+    int result = io_uring_enter(ring_fd_, to_submit, min_complete, flags, arg, arg_size);
+    if (result == -1) {
+        // ETIME: the wait timed out; EINTR: a signal arrived; EBUSY, EAGAIN:
+        // the completion queue is full and has to be reaped first
+        if (errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN) {
+            return -errno;
+        }
+        throw std::runtime_error(std::format("io_uring_enter failed: {}", strerror(errno)));
+    }
+    return result;
+}
+
+} // namespace redis
@@ -0,0 +1,60 @@
+#include "redis/latency_monitor.hpp"
+#include <algorithm>
+
+namespace redis {
+
+LatencyMonitor::LatencyMonitor() : threshold_ms_(0) {
+}
+
+void LatencyMonitor::setThreshold(std::chrono::milliseconds threshold) {
+    threshold_ms_.store(threshold.count(), std::memory_order_relaxed);
+}
+
+std::chrono::milliseconds LatencyMonitor::threshold() const {
+    return std::chrono::milliseconds(threshold_ms_.load(std::memory_order_relaxed));
+}
+
+void LatencyMonitor::record(std::string_view event, std::chrono::nanoseconds duration) {
+    if (!exceeds(duration)) {
+        return;
+    }
+    auto millis = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::lock_guard lock(mutex_);
+    auto it = std::ranges::find(events_, event, &Event::name);
+    if (it == events_.end()) {
+        it = events_.insert(events_.end(), Event{.name = std::string(event)});
+    }
+    Event& recorded = *it;
+    recorded.max = std::max(recorded.max, millis);
+    // One sample per second, the worst of it
+    Sample& latest = recorded.samples[(recorded.next + HISTORY - 1) % HISTORY];
+    if (recorded.length > 0 && latest.time == now) {
+        latest.millis = std::max(latest.millis, millis);
+        return;
+    }
+    recorded.samples[recorded.next] = {now, millis};
+    recorded.next = (recorded.next + 1) % HISTORY;
+    recorded.length = std::min(recorded.length + 1, HISTORY);
+}
+
+std::vector<LatencyMonitor::Event> LatencyMonitor::events() const {
+    std::lock_guard lock(mutex_);
+    return events_;
+}
+
+size_t LatencyMonitor::reset(std::span<const std::string_view> names) {
+    std::lock_guard lock(mutex_);
+    size_t before = events_.size();
+    if (names.empty()) {
+        events_.clear();
+    } else {
+        std::erase_if(events_, [&](const Event& event) {
+            return std::ranges::find(names, event.name) != names.end();
+        });
+    }
+    return before - events_.size();
+}
+
+} // namespace redis
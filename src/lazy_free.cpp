@@ -0,0 +1,59 @@
+#include "redis/lazy_free.hpp"
+
+namespace redis {
+
+LazyFree::LazyFree() : running_(0), stopping_(false) {
+    thread_ = std::thread(&LazyFree::run, this);
+}
+
+LazyFree::~LazyFree() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void LazyFree::push(Job job) {
+    {
+        std::lock_guard lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+size_t LazyFree::pending() const {
+    std::lock_guard lock(mutex_);
+    return jobs_.size() + running_;
+}
+
+void LazyFree::drain() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] { return jobs_.empty() && running_ == 0; });
+}
+
+void LazyFree::run() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            // Stopping with nothing left to free
+            return;
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        running_++;
+        // Free outside the lock, so that the loops can keep handing over
+        lock.unlock();
+        job();
+        job = nullptr;
+        lock.lock();
+        running_--;
+        if (jobs_.empty() && running_ == 0) {
+            idle_.notify_all();
+        }
+    }
+}
+
+} // namespace redis
@@ -0,0 +1,29 @@
+#include "redis/log.hpp"
+#include <string>
+
+namespace redis::log {
+
+void setLevel(spdlog::level::level_enum level) {
+    spdlog::set_level(level);
+    active_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+std::optional<spdlog::level::level_enum> parseLevel(std::string_view name) {
+    if (name == "verbose") {
+        return spdlog::level::debug;
+    }
+    if (name == "notice") {
+        return spdlog::level::info;
+    }
+    if (name == "nothing") {
+        return spdlog::level::off;
+    }
+    auto level = spdlog::level::from_str(std::string(name));
+    // from_str() falls back to off for names it does not know
+    if (level == spdlog::level::off && name != "off") {
+        return std::nullopt;
+    }
+    return level;
+}
+
+} // namespace redis::log
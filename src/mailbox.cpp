@@ -0,0 +1,66 @@
+#include "redis/mailbox.hpp"
+
+namespace redis {
+
+Mailbox::Mailbox() : head_(&stub_), tail_(&stub_) {
+}
+
+Mailbox::~Mailbox() {
+    // Tasks that were never run are dropped
+    while (Node* node = pop()) {
+        delete node;
+    }
+}
+
+void Mailbox::push(Task task) {
+    auto* node = new Node();
+    node->task = std::move(task);
+    pushNode(node);
+}
+
+size_t Mailbox::drain() {
+    size_t count = 0;
+    while (Node* node = pop()) {
+        node->task();
+        delete node;
+        ++count;
+    }
+    return count;
+}
+
+void Mailbox::pushNode(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+Mailbox::Node* Mailbox::pop() {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+        tail_ = next;
+        return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+        // A producer has swapped head_ but not linked its node yet; it will
+        // wake the consumer once it has
+        return nullptr;
+    }
+    pushNode(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+} // namespace redis
@@ -1,12 +1,33 @@
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <stdexcept>
 #include <signal.h>
 #include "redis/server.hpp"
-
-#include <spdlog/spdlog.h>
+#include "redis/log.hpp"
+#include "redis/set.hpp"
 
 static redis::Server* g_server = nullptr;
 
-void signalHandler(int signal) {
+// Bytes given as a number with an optional kb, mb or gb suffix, as Redis
+// reads maxmemory
+static size_t parseMemory(const std::string& value) {
+    size_t digits = 0;
+    size_t bytes = std::stoull(value, &digits);
+    std::string_view unit = std::string_view(value).substr(digits);
+    if (unit == "kb" || unit == "KB") {
+        return bytes << 10;
+    } else if (unit == "mb" || unit == "MB") {
+        return bytes << 20;
+    } else if (unit == "gb" || unit == "GB") {
+        return bytes << 30;
+    } else if (!unit.empty()) {
+        throw std::invalid_argument("unknown memory unit " + std::string(unit));
+    }
+    return bytes;
+}
+
+void signalHandler(int) {
     if (g_server != nullptr) {
         std::cout << "\nShutting down server..." << std::endl;
         g_server->stop();
@@ -14,27 +35,159 @@ void signalHandler(int signal) {
 }
 
 int main(int argc, char* argv[]) {
-    spdlog::set_level(spdlog::level::debug);
     // Parse command line arguments
     std::string host = "127.0.0.1";
     int port = 6379;
-    
-    // TODO: Add argument parsing
+    size_t threads = 1;
+    redis::Backend backend = redis::Backend::EPOLL;
+    std::string dbfilename = "dump.rdb";
+    bool appendonly = false;
+    std::string appendfilename = "appendonly.aof";
+    redis::FsyncPolicy appendfsync = redis::FsyncPolicy::EVERYSEC;
+    redis::HashLimits hash_limits;
+    size_t set_max_intset_entries = redis::Set::DEFAULT_MAX_INTSET_ENTRIES;
+    redis::ZSetLimits zset_limits;
+    redis::MemoryLimits memory_limits;
+    redis::DefragSettings defrag_settings;
+    redis::SlowLogSettings slow_log_settings;
+    int64_t latency_monitor_threshold = 0;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string_view option = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for option " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--host") {
+                host = value;
+            } else if (option == "--port") {
+                port = std::stoi(value);
+            } else if (option == "--threads") {
+                threads = std::stoul(value);
+            } else if (option == "--dbfilename") {
+                dbfilename = value;
+            } else if (option == "--appendonly") {
+                if (value != "yes" && value != "no") {
+                    std::cerr << "Invalid appendonly " << value << ", expected yes or no" << std::endl;
+                    return 1;
+                }
+                appendonly = value == "yes";
+            } else if (option == "--appendfilename") {
+                appendfilename = value;
+            } else if (option == "--appendfsync") {
+                if (value == "always") {
+                    appendfsync = redis::FsyncPolicy::ALWAYS;
+                } else if (value == "everysec") {
+                    appendfsync = redis::FsyncPolicy::EVERYSEC;
+                } else if (value == "no") {
+                    appendfsync = redis::FsyncPolicy::NO;
+                } else {
+                    std::cerr << "Unknown appendfsync " << value << ", expected always, everysec or no" << std::endl;
+                    return 1;
+                }
+            } else if (option == "--hash-max-listpack-entries") {
+                hash_limits.max_packed_entries = std::stoul(value);
+            } else if (option == "--hash-max-listpack-value") {
+                hash_limits.max_packed_value = std::stoul(value);
+            } else if (option == "--set-max-intset-entries") {
+                set_max_intset_entries = std::stoul(value);
+            } else if (option == "--zset-max-listpack-entries") {
+                zset_limits.max_packed_entries = std::stoul(value);
+            } else if (option == "--zset-max-listpack-value") {
+                zset_limits.max_packed_value = std::stoul(value);
+            } else if (option == "--maxmemory") {
+                memory_limits.max_memory = parseMemory(value);
+            } else if (option == "--maxmemory-policy") {
+                if (value == "noeviction") {
+                    memory_limits.policy = redis::EvictionPolicy::NOEVICTION;
+                } else if (value == "allkeys-lru") {
+                    memory_limits.policy = redis::EvictionPolicy::ALLKEYS_LRU;
+                } else if (value == "allkeys-lfu") {
+                    memory_limits.policy = redis::EvictionPolicy::ALLKEYS_LFU;
+                } else if (value == "volatile-ttl") {
+                    memory_limits.policy = redis::EvictionPolicy::VOLATILE_TTL;
+                } else {
+                    std::cerr << "Unknown maxmemory-policy " << value
+                              << ", expected noeviction, allkeys-lru, allkeys-lfu or volatile-ttl" << std::endl;
+                    return 1;
+                }
+            } else if (option == "--maxmemory-samples") {
+                memory_limits.samples = std::stoul(value);
+            } else if (option == "--activedefrag") {
+                if (value != "yes" && value != "no") {
+                    std::cerr << "Invalid activedefrag " << value << ", expected yes or no" << std::endl;
+                    return 1;
+                }
+                defrag_settings.enabled = value == "yes";
+            } else if (option == "--active-defrag-ignore-bytes") {
+                defrag_settings.ignore_bytes = parseMemory(value);
+            } else if (option == "--active-defrag-threshold-lower") {
+                defrag_settings.threshold_lower = std::stoul(value);
+            } else if (option == "--active-defrag-threshold-upper") {
+                defrag_settings.threshold_upper = std::stoul(value);
+            } else if (option == "--active-defrag-cycle-min") {
+                defrag_settings.cycle_min = std::stoul(value);
+            } else if (option == "--active-defrag-cycle-max") {
+                defrag_settings.cycle_max = std::stoul(value);
+            } else if (option == "--slowlog-log-slower-than") {
+                slow_log_settings.log_slower_than = std::stoll(value);
+            } else if (option == "--slowlog-max-len") {
+                slow_log_settings.max_length = std::stoul(value);
+            } else if (option == "--latency-monitor-threshold") {
+                latency_monitor_threshold = std::stoll(value);
+            } else if (option == "--loglevel") {
+                auto level = redis::log::parseLevel(value);
+                if (!level) {
+                    std::cerr << "Unknown loglevel " << value << ", expected debug, verbose, notice, warning or nothing"
+                              << std::endl;
+                    return 1;
+                }
+                redis::log::setLevel(*level);
+            } else if (option == "--backend") {
+                if (value == "epoll") {
+                    backend = redis::Backend::EPOLL;
+                } else if (value == "io_uring") {
+                    backend = redis::Backend::IO_URING;
+                } else {
+                    std::cerr << "Unknown backend " << value << ", expected epoll or io_uring" << std::endl;
+                    return 1;
+                }
+            } else {
+                std::cerr << "Unknown option " << option << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    }
     
     // Create and start server
-    redis::Server server(host, port);
+    redis::Server server(host, port, threads, backend, dbfilename);
+    server.setHashLimits(hash_limits);
+    server.setMaxIntsetEntries(set_max_intset_entries);
+    server.setZSetLimits(zset_limits);
+    server.setMemoryLimits(memory_limits);
+    server.setDefragSettings(defrag_settings);
+    server.setSlowLogSettings(slow_log_settings);
+    server.setLatencyMonitorThreshold(std::chrono::milliseconds(latency_monitor_threshold));
+    if (appendonly) {
+        server.enableAppendOnly(appendfilename, appendfsync);
+    }
     g_server = &server;
     
     // Setup signal handlers
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
     
-    std::cout << "Starting Redis server on " << host << ":" << port << std::endl;
+    std::cout << "Starting Redis server on " << host << ":" << port << " with " << threads << " thread(s)" << std::endl;
     
     try {
         server.start();
     } catch (const std::exception& e) {
-        spdlog::error("Server error: {}", e.what());
+        REDIS_ERROR("Server error: {}", e.what());
         return 1;
     }
     
@@ -0,0 +1,53 @@
+#include "redis/mapped_file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace redis {
+
+MappedFile::MappedFile(void* data, size_t size) : data_(data), size_(size) {
+}
+
+MappedFile::~MappedFile() {
+    if (size_ != 0) {
+        ::munmap(data_, size_);
+    }
+}
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            return nullptr;
+        }
+        throw std::runtime_error(std::format("Failed to open {}: {}", path, strerror(errno)));
+    }
+    struct stat info;
+    if (::fstat(fd, &info) == -1) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error(std::format("Failed to stat {}: {}", path, strerror(error)));
+    }
+    auto size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        // mmap() rejects empty mappings
+        ::close(fd);
+        return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+    }
+    // The mapping keeps the file referenced on its own
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(std::format("Failed to map {}: {}", path, strerror(error)));
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    return std::unique_ptr<MappedFile>(new MappedFile(data, size));
+}
+
+} // namespace redis
@@ -0,0 +1,550 @@
+#include "redis/memory.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    using redis::memory::MAX_SMALL;
+
+    // Every thread counts in a slot of its own, so that threads allocating
+    // at the same time do not fight over a cache line; used() adds the slots
+    // up. Past this many threads, threads share slots.
+    constexpr size_t COUNTER_SLOTS = 64;
+
+    struct alignas(64) Counter {
+        // Negative in a thread that frees more than it allocates
+        std::atomic<int64_t> bytes{0};
+        // The part of `bytes` served by the slab allocator
+        std::atomic<int64_t> small{0};
+    };
+
+    std::array<Counter, COUNTER_SLOTS> counters;
+    // Slots handed out so far; used() reads no others
+    std::atomic<size_t> threads{0};
+
+    Counter& counter() {
+        thread_local Counter& counter = counters[threads.fetch_add(1, std::memory_order_relaxed) % COUNTER_SLOTS];
+        return counter;
+    }
+
+    // See AccountScope
+    thread_local redis::memory::Account* current_account = nullptr;
+
+    void count(int64_t bytes) {
+        counter().bytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (current_account != nullptr) {
+            current_account->bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void countSmall(int64_t bytes) {
+        count(bytes);
+        counter().small.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void* counted(void* pointer) {
+        if (pointer == nullptr) {
+            throw std::bad_alloc();
+        }
+        count(static_cast<int64_t>(malloc_usable_size(pointer)));
+        return pointer;
+    }
+
+    // Size classes of the slab allocator, spaced as jemalloc's small classes:
+    // at most 25% of an allocation is lost to rounding past 128 bytes
+    constexpr std::array<uint32_t, 20> CLASS_SIZES{16,  32,  48,  64,  80,  96,  112, 128, 160, 192,
+                                                   224, 256, 320, 384, 448, 512, 640, 768, 896, 1024};
+    constexpr size_t CLASSES = CLASS_SIZES.size();
+    static_assert(CLASS_SIZES.back() == MAX_SMALL);
+
+    // Class of every size rounded up to 16 bytes
+    constexpr auto CLASS_OF = [] {
+        std::array<uint8_t, MAX_SMALL / 16 + 1> table{};
+        uint8_t size_class = 0;
+        for (size_t i = 0; i < table.size(); i++) {
+            while (CLASS_SIZES[size_class] < i * 16) {
+                size_class++;
+            }
+            table[i] = size_class;
+        }
+        return table;
+    }();
+
+    size_t classOf(size_t size) {
+        return CLASS_OF[(size + 15) / 16];
+    }
+
+    // Runs are aligned on their size, so the run of an allocation is its
+    // address with the low bits cleared
+    constexpr size_t RUN_SIZE = 64 << 10;
+    // Address space reserved for runs. Pages are only backed once touched;
+    // should it run out, small allocations fall back to malloc.
+    constexpr size_t REGION_SIZE = size_t(64) << 30;
+
+    // Header at the start of every run, followed by its slots
+    struct alignas(64) Run {
+        uint32_t size_class;
+        uint32_t capacity;
+        // Slots handed out, those sitting in thread caches included
+        uint32_t used;
+        // Slots handed out at least once; those past it were never touched
+        uint32_t carved;
+        // Released slots, linked through their first word
+        void* free;
+        // Neighbours in the list of runs of the class with free slots
+        Run* prev;
+        Run* next;
+        bool listed;
+
+        char* slot(size_t index) {
+            return reinterpret_cast<char*>(this + 1) + index * CLASS_SIZES[size_class];
+        }
+    };
+    static_assert(sizeof(Run) == 64);
+
+    Run* runOf(const void* pointer) {
+        return reinterpret_cast<Run*>(reinterpret_cast<uintptr_t>(pointer) & ~(RUN_SIZE - 1));
+    }
+
+    struct SizeClass {
+        std::mutex lock;
+        // Runs with free slots. Allocations are taken from the front; a full
+        // run that gets a slot back joins at the end.
+        Run* head = nullptr;
+        Run* tail = nullptr;
+        size_t runs = 0;
+        // Slots handed out across the class's runs
+        size_t used = 0;
+    };
+
+    // Runs are handed to the size classes from a region of address space
+    // reserved once. Each class has a lock of its own; thread caches make
+    // taking it rare.
+    class Heap {
+    public:
+        Heap() {
+            void* region = mmap(nullptr, REGION_SIZE + RUN_SIZE, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED) {
+                return;
+            }
+            base_ = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(region) + RUN_SIZE - 1) & ~(RUN_SIZE - 1));
+            end_ = base_ + REGION_SIZE;
+            next_run_ = base_;
+            // A child forked while another thread holds a lock would find it
+            // held forever
+            pthread_atfork([] { heap().lockAll(); }, [] { heap().unlockAll(); }, [] { heap().unlockAll(); });
+        }
+
+        static Heap& heap() {
+            // Never destroyed: threads may release memory until the very end
+            static Heap* instance = new Heap();
+            return *instance;
+        }
+
+        bool enabled() const {
+            return base_ != nullptr;
+        }
+
+        bool owns(const void* pointer) const {
+            return pointer >= base_ && pointer < end_;
+        }
+
+        // Move up to `count` slots of a class to `out`. Returns how many, fewer
+        // only once the region is used up.
+        size_t take(size_t size_class, void** out, size_t count) {
+            SizeClass& sc = classes_[size_class];
+            std::lock_guard lock(sc.lock);
+            size_t taken = 0;
+            while (taken < count) {
+                Run* run = sc.head;
+                if (run == nullptr && (run = newRun(sc, size_class)) == nullptr) {
+                    break;
+                }
+                while (taken < count && run->used < run->capacity) {
+                    out[taken++] = carve(sc, run);
+                }
+                if (run->used == run->capacity) {
+                    unlist(sc, run);
+                }
+            }
+            return taken;
+        }
+
+        // Return slots of a class to their runs
+        void give(size_t size_class, void* const* slots, size_t count) {
+            SizeClass& sc = classes_[size_class];
+            std::lock_guard lock(sc.lock);
+            for (size_t i = 0; i < count; i++) {
+                put(sc, runOf(slots[i]), slots[i]);
+            }
+        }
+
+        void* defragment(void* pointer) {
+            Run* run = runOf(pointer);
+            SizeClass& sc = classes_[run->size_class];
+            std::unique_lock lock(sc.lock);
+            // Only runs below the average fill are worth emptying, into the
+            // fullest of the first few runs with room
+            Run* target = nullptr;
+            if (run->used * sc.runs < sc.used) {
+                size_t looked = 0;
+                for (Run* candidate = sc.head; candidate != nullptr && looked < 8; candidate = candidate->next, looked++) {
+                    if (candidate != run && candidate->used >= run->used &&
+                        (target == nullptr || candidate->used > target->used)) {
+                        target = candidate;
+                    }
+                }
+            }
+            if (target == nullptr) {
+                defrag_misses_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            void* moved = carve(sc, target);
+            if (target->used == target->capacity) {
+                unlist(sc, target);
+            }
+            std::memcpy(moved, pointer, CLASS_SIZES[run->size_class]);
+            put(sc, run, pointer);
+            defrag_hits_.fetch_add(1, std::memory_order_relaxed);
+            return moved;
+        }
+
+        void countMiss() {
+            defrag_misses_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        size_t activeRuns() const {
+            return runs_in_use_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t defragHits() const {
+            return defrag_hits_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t defragMisses() const {
+            return defrag_misses_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        char* base_ = nullptr;
+        char* end_ = nullptr;
+        std::array<SizeClass, CLASSES> classes_;
+        std::mutex runs_lock_;
+        // Next run never used, and emptied runs, their pages returned
+        char* next_run_ = nullptr;
+        std::vector<Run*> free_runs_;
+        std::atomic<size_t> runs_in_use_{0};
+        std::atomic<uint64_t> defrag_hits_{0};
+        std::atomic<uint64_t> defrag_misses_{0};
+
+        // A fresh run for a class, at the front of its list; nullptr once
+        // the region is used up
+        Run* newRun(SizeClass& sc, size_t size_class) {
+            Run* run;
+            {
+                std::lock_guard lock(runs_lock_);
+                if (!free_runs_.empty()) {
+                    run = free_runs_.back();
+                    free_runs_.pop_back();
+                } else if (next_run_ != end_) {
+                    run = reinterpret_cast<Run*>(next_run_);
+                    next_run_ += RUN_SIZE;
+                } else {
+                    return nullptr;
+                }
+                runs_in_use_.fetch_add(1, std::memory_order_relaxed);
+            }
+            *run = Run{static_cast<uint32_t>(size_class),
+                       static_cast<uint32_t>((RUN_SIZE - sizeof(Run)) / CLASS_SIZES[size_class]), 0, 0, nullptr,
+                       nullptr, nullptr, false};
+            sc.runs++;
+            list(sc, run);
+            return run;
+        }
+
+        // Give an emptied run's pages back to the system
+        void retire(SizeClass& sc, Run* run) {
+            unlist(sc, run);
+            sc.runs--;
+            madvise(run, RUN_SIZE, MADV_DONTNEED);
+            std::lock_guard lock(runs_lock_);
+            free_runs_.push_back(run);
+            runs_in_use_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        static void* carve(SizeClass& sc, Run* run) {
+            void* slot = run->free;
+            if (slot != nullptr) {
+                std::memcpy(&run->free, slot, sizeof(void*));
+            } else {
+                slot = run->slot(run->carved++);
+            }
+            run->used++;
+            sc.used++;
+            return slot;
+        }
+
+        void put(SizeClass& sc, Run* run, void* slot) {
+            bool was_full = run->used == run->capacity;
+            std::memcpy(slot, &run->free, sizeof(void*));
+            run->free = slot;
+            run->used--;
+            sc.used--;
+            if (was_full) {
+                list(sc, run);
+            }
+            // The last run with room stays, so that a class hovering around a
+            // run boundary does not map and unmap it over and over
+            if (run->used == 0 && (sc.head != run || run->next != nullptr)) {
+                retire(sc, run);
+            }
+        }
+
+        static void list(SizeClass& sc, Run* run) {
+            run->listed = true;
+            run->prev = sc.tail;
+            run->next = nullptr;
+            (sc.tail != nullptr ? sc.tail->next : sc.head) = run;
+            sc.tail = run;
+        }
+
+        static void unlist(SizeClass& sc, Run* run) {
+            if (!run->listed) {
+                return;
+            }
+            run->listed = false;
+            (run->prev != nullptr ? run->prev->next : sc.head) = run->next;
+            (run->next != nullptr ? run->next->prev : sc.tail) = run->prev;
+        }
+
+        void lockAll() {
+            for (SizeClass& sc : classes_) {
+                sc.lock.lock();
+            }
+            runs_lock_.lock();
+        }
+
+        void unlockAll() {
+            runs_lock_.unlock();
+            for (SizeClass& sc : classes_) {
+                sc.lock.unlock();
+            }
+        }
+    };
+
+    Heap& heap() {
+        return Heap::heap();
+    }
+
+    // Free slots of every class kept by a thread, taken from and given back
+    // to the heap CACHE_BATCH at a time
+    constexpr size_t CACHE_SIZE = 64;
+    constexpr size_t CACHE_BATCH = 32;
+
+    struct ThreadCache {
+        enum State : uint8_t {
+            UNUSED,
+            ACTIVE,
+            // The thread is exiting: slots go straight to the heap
+            CLOSED,
+        };
+        struct Bin {
+            uint32_t count;
+            void* slots[CACHE_SIZE];
+        };
+        std::array<Bin, CLASSES> bins;
+        State state;
+    };
+    constinit thread_local ThreadCache cache{};
+
+    // Returns the cached slots to the heap when the thread exits
+    struct CacheFlush {
+        ~CacheFlush() {
+            for (size_t size_class = 0; size_class < CLASSES; size_class++) {
+                ThreadCache::Bin& bin = cache.bins[size_class];
+                heap().give(size_class, bin.slots, bin.count);
+                bin.count = 0;
+            }
+            cache.state = ThreadCache::CLOSED;
+        }
+    };
+
+    // Whether the thread may cache slots, setting its cache up on first use
+    bool cacheOpen() {
+        if (cache.state == ThreadCache::UNUSED) {
+            thread_local CacheFlush flush;
+            (void)flush;
+            cache.state = ThreadCache::ACTIVE;
+        }
+        return cache.state == ThreadCache::ACTIVE;
+    }
+
+    // nullptr once the region is used up
+    void* allocateSmall(size_t size_class) {
+        if (!cacheOpen()) {
+            void* slot = nullptr;
+            heap().take(size_class, &slot, 1);
+            return slot;
+        }
+        ThreadCache::Bin& bin = cache.bins[size_class];
+        if (bin.count == 0) {
+            bin.count = static_cast<uint32_t>(heap().take(size_class, bin.slots, CACHE_BATCH));
+            if (bin.count == 0) {
+                return nullptr;
+            }
+        }
+        return bin.slots[--bin.count];
+    }
+
+    void releaseSmall(size_t size_class, void* slot) {
+        if (!cacheOpen()) {
+            heap().give(size_class, &slot, 1);
+            return;
+        }
+        ThreadCache::Bin& bin = cache.bins[size_class];
+        if (bin.count == CACHE_SIZE) {
+            // The oldest half goes; the most recently freed slots are the
+            // likeliest in cache
+            heap().give(size_class, bin.slots, CACHE_BATCH);
+            std::memmove(bin.slots, bin.slots + CACHE_BATCH, (CACHE_SIZE - CACHE_BATCH) * sizeof(void*));
+            bin.count -= CACHE_BATCH;
+        }
+        bin.slots[bin.count++] = slot;
+    }
+
+    // Sum of a field of the counters in use
+    int64_t total(std::atomic<int64_t> Counter::*field) {
+        size_t slots = std::min(threads.load(std::memory_order_relaxed), COUNTER_SLOTS);
+        int64_t sum = 0;
+        for (size_t i = 0; i < slots; i++) {
+            sum += (counters[i].*field).load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+}
+
+namespace redis::memory {
+
+void* allocate(size_t size) {
+    if (size <= MAX_SMALL && heap().enabled()) {
+        size_t size_class = classOf(size);
+        if (void* slot = allocateSmall(size_class)) {
+            countSmall(CLASS_SIZES[size_class]);
+            return slot;
+        }
+    }
+    return counted(std::malloc(size));
+}
+
+void* allocateZeroed(size_t size) {
+    if (size <= MAX_SMALL && heap().enabled()) {
+        void* block = allocate(size);
+        std::memset(block, 0, size);
+        return block;
+    }
+    return counted(std::calloc(size, 1));
+}
+
+void* reallocate(void* pointer, size_t size) {
+    if (pointer == nullptr) {
+        return allocate(size);
+    }
+    bool small = heap().owns(pointer);
+    if (small && size <= MAX_SMALL && classOf(size) == runOf(pointer)->size_class) {
+        return pointer;
+    }
+    if (small || size <= MAX_SMALL) {
+        // Between size classes, or between the slabs and malloc
+        void* moved = allocate(size);
+        std::memcpy(moved, pointer, std::min(size, usableSize(pointer)));
+        release(pointer);
+        return moved;
+    }
+    size_t before = malloc_usable_size(pointer);
+    void* grown = std::realloc(pointer, size);
+    if (grown == nullptr) {
+        throw std::bad_alloc();
+    }
+    count(static_cast<int64_t>(malloc_usable_size(grown)) - static_cast<int64_t>(before));
+    return grown;
+}
+
+void release(void* pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+    if (heap().owns(pointer)) {
+        size_t size_class = runOf(pointer)->size_class;
+        countSmall(-static_cast<int64_t>(CLASS_SIZES[size_class]));
+        releaseSmall(size_class, pointer);
+        return;
+    }
+    count(-static_cast<int64_t>(malloc_usable_size(pointer)));
+    std::free(pointer);
+}
+
+size_t usableSize(const void* pointer) {
+    if (heap().owns(pointer)) {
+        return CLASS_SIZES[runOf(pointer)->size_class];
+    }
+    return malloc_usable_size(const_cast<void*>(pointer));
+}
+
+void* defragment(void* pointer) {
+    if (!heap().owns(pointer)) {
+        heap().countMiss();
+        return nullptr;
+    }
+    return heap().defragment(pointer);
+}
+
+size_t used() {
+    return static_cast<size_t>(std::max<int64_t>(total(&Counter::bytes), 0));
+}
+
+size_t Account::used() const {
+    return static_cast<size_t>(std::max<int64_t>(bytes.load(std::memory_order_relaxed), 0));
+}
+
+AccountScope::AccountScope(Account* account) : previous_(current_account) {
+    current_account = account;
+}
+
+AccountScope::~AccountScope() {
+    current_account = previous_;
+}
+
+Account* currentAccount() {
+    return current_account;
+}
+
+size_t active() {
+    int64_t large = total(&Counter::bytes) - total(&Counter::small);
+    return heap().activeRuns() * RUN_SIZE + static_cast<size_t>(std::max<int64_t>(large, 0));
+}
+
+Stats stats() {
+    size_t resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        size_t pages = 0;
+        if (std::fscanf(statm, "%*s %zu", &pages) == 1) {
+            resident = pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        }
+        std::fclose(statm);
+    }
+    return Stats{used(), active(), heap().activeRuns() * RUN_SIZE, resident, heap().defragHits(), heap().defragMisses()};
+}
+
+} // namespace redis::memory
@@ -0,0 +1,327 @@
+#include "redis/object.hpp"
+#include "redis/hash.hpp"
+#include "redis/memory.hpp"
+#include "redis/set.hpp"
+#include "redis/zset.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace {
+    // Decimal strings of the shared integers, built on first use
+    const std::array<std::string, redis::Object::SHARED_INTEGERS>& sharedIntegers() {
+        static const auto pool = [] {
+            std::array<std::string, redis::Object::SHARED_INTEGERS> strings;
+            for (size_t i = 0; i < strings.size(); i++) {
+                strings[i] = std::to_string(i);
+            }
+            return strings;
+        }();
+        return pool;
+    }
+
+    // Layout of the RAW payload
+    struct RawString {
+        char* data;
+        size_t size;
+        size_t capacity;
+    };
+}
+
+namespace redis {
+
+std::optional<int64_t> canonicalInteger(std::string_view value) {
+    if (value.empty() || value.size() > 20) {
+        return std::nullopt;
+    }
+    int64_t result = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc() || end != value.data() + value.size()) {
+        return std::nullopt;
+    }
+    char digits[20];
+    auto [rendered, rendered_ec] = std::to_chars(digits, digits + sizeof(digits), result);
+    if (std::string_view(digits, rendered - digits) != value) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+StringValue::StringValue(std::string_view view) : view_(view) {
+}
+
+StringValue::StringValue(int64_t value) {
+    if (value >= 0 && value < Object::SHARED_INTEGERS) {
+        view_ = sharedIntegers()[value];
+        return;
+    }
+    auto [end, ec] = std::to_chars(digits_, digits_ + sizeof(digits_), value);
+    view_ = std::string_view(digits_, end - digits_);
+}
+
+StringValue::StringValue(const StringValue& other) {
+    *this = other;
+}
+
+StringValue& StringValue::operator=(const StringValue& other) {
+    if (other.view_.data() == other.digits_) {
+        // Point at our own copy of the digits
+        std::memcpy(digits_, other.digits_, other.view_.size());
+        view_ = std::string_view(digits_, other.view_.size());
+    } else {
+        view_ = other.view_;
+    }
+    return *this;
+}
+
+Object::Object(ValueType type, Encoding encoding, size_t key_size)
+    : type_(static_cast<uint8_t>(type)), encoding_(encoding), access_(0),
+      key_size_(static_cast<uint32_t>(key_size)) {
+}
+
+void Object::Deleter::operator()(Object* object) const {
+    if (object->encoding_ == Encoding::RAW) {
+        RawString raw;
+        std::memcpy(&raw, object->payload(), sizeof(raw));
+        memory::release(raw.data);
+    } else if (object->encoding_ == Encoding::QUICKLIST) {
+        object->list().~QuickList();
+    } else if (object->encoding_ == Encoding::HASH) {
+        object->hash().~Hash();
+    } else if (object->encoding_ == Encoding::SET) {
+        object->set().~Set();
+    } else if (object->encoding_ == Encoding::ZSET) {
+        object->zset().~ZSet();
+    }
+    object->~Object();
+    memory::release(object);
+}
+
+Object::Ptr Object::allocate(ValueType type, Encoding encoding, std::string_view key, size_t payload_size) {
+    // malloc rather than operator new, so that memoryUsage() can ask the
+    // allocator for the real size, and counted as keyspace memory
+    void* block = memory::allocate(sizeof(Object) + payload_size + key.size());
+    Ptr object(new (block) Object(type, encoding, key.size()));
+    std::memcpy(object->payload() + payload_size, key.data(), key.size());
+    return object;
+}
+
+Object::Ptr Object::createInteger(std::string_view key, int64_t value) {
+    Ptr object = allocate(ValueType::STRING, Encoding::INT, key, sizeof(int64_t));
+    std::memcpy(object->payload(), &value, sizeof(int64_t));
+    return object;
+}
+
+Object::Ptr Object::createString(std::string_view key, std::string_view value) {
+    if (auto integer = canonicalInteger(value)) {
+        return createInteger(key, *integer);
+    }
+    if (value.size() <= EMBED_LIMIT) {
+        Ptr object = allocate(ValueType::STRING, Encoding::EMBSTR, key, sizeof(uint32_t) + value.size());
+        auto size = static_cast<uint32_t>(value.size());
+        std::memcpy(object->payload(), &size, sizeof(size));
+        std::memcpy(object->payload() + sizeof(size), value.data(), value.size());
+        return object;
+    }
+    RawString raw{static_cast<char*>(memory::allocate(value.size())), value.size(), value.size()};
+    std::memcpy(raw.data, value.data(), value.size());
+    Ptr object;
+    try {
+        object = allocate(ValueType::STRING, Encoding::RAW, key, sizeof(RawString));
+    } catch (...) {
+        memory::release(raw.data);
+        throw;
+    }
+    std::memcpy(object->payload(), &raw, sizeof(raw));
+    return object;
+}
+
+Object::Ptr Object::createList(std::string_view key) {
+    Ptr object = allocate(ValueType::LIST, Encoding::QUICKLIST, key, sizeof(QuickList));
+    new (object->payload()) QuickList();
+    return object;
+}
+
+Object::Ptr Object::createHash(std::string_view key) {
+    Ptr object = allocate(ValueType::HASH, Encoding::HASH, key, sizeof(Hash));
+    new (object->payload()) Hash();
+    return object;
+}
+
+Object::Ptr Object::createSet(std::string_view key) {
+    Ptr object = allocate(ValueType::SET, Encoding::SET, key, sizeof(Set));
+    new (object->payload()) Set();
+    return object;
+}
+
+Object::Ptr Object::createZSet(std::string_view key) {
+    Ptr object = allocate(ValueType::ZSET, Encoding::ZSET, key, sizeof(ZSet));
+    new (object->payload()) ZSet();
+    return object;
+}
+
+size_t Object::payloadSize() const {
+    switch (encoding_) {
+        case Encoding::INT:
+            return sizeof(int64_t);
+        case Encoding::EMBSTR: {
+            uint32_t size;
+            std::memcpy(&size, payload(), sizeof(size));
+            return sizeof(size) + size;
+        }
+        case Encoding::RAW:
+            return sizeof(RawString);
+        case Encoding::QUICKLIST:
+            return sizeof(QuickList);
+        case Encoding::HASH:
+            return sizeof(Hash);
+        case Encoding::SET:
+            return sizeof(Set);
+        case Encoding::ZSET:
+            return sizeof(ZSet);
+    }
+    return 0;
+}
+
+std::string_view Object::key() const {
+    return std::string_view(payload() + payloadSize(), key_size_);
+}
+
+StringValue Object::string() const {
+    switch (encoding_) {
+        case Encoding::INT:
+            return StringValue(integer());
+        case Encoding::EMBSTR: {
+            uint32_t size;
+            std::memcpy(&size, payload(), sizeof(size));
+            return StringValue(std::string_view(payload() + sizeof(size), size));
+        }
+        case Encoding::RAW: {
+            RawString raw;
+            std::memcpy(&raw, payload(), sizeof(raw));
+            return StringValue(std::string_view(raw.data, raw.size));
+        }
+        case Encoding::QUICKLIST:
+        case Encoding::HASH:
+        case Encoding::SET:
+        case Encoding::ZSET:
+            break;
+    }
+    return StringValue(std::string_view());
+}
+
+int64_t Object::integer() const {
+    int64_t value;
+    std::memcpy(&value, payload(), sizeof(value));
+    return value;
+}
+
+void Object::setInteger(int64_t value) {
+    std::memcpy(payload(), &value, sizeof(value));
+}
+
+std::span<char> Object::resizeRaw(size_t size) {
+    RawString raw;
+    std::memcpy(&raw, payload(), sizeof(raw));
+    if (size > raw.capacity) {
+        size_t capacity = std::max(size, raw.capacity * 2);
+        char* data = static_cast<char*>(memory::reallocate(raw.data, capacity));
+        raw.data = data;
+        raw.capacity = capacity;
+    }
+    if (size > raw.size) {
+        std::memset(raw.data + raw.size, 0, size - raw.size);
+    }
+    raw.size = size;
+    std::memcpy(payload(), &raw, sizeof(raw));
+    return std::span<char>(raw.data, raw.size);
+}
+
+QuickList& Object::list() {
+    return *std::launder(reinterpret_cast<QuickList*>(payload()));
+}
+
+const QuickList& Object::list() const {
+    return *std::launder(reinterpret_cast<const QuickList*>(payload()));
+}
+
+Hash& Object::hash() {
+    return *std::launder(reinterpret_cast<Hash*>(payload()));
+}
+
+const Hash& Object::hash() const {
+    return *std::launder(reinterpret_cast<const Hash*>(payload()));
+}
+
+Set& Object::set() {
+    return *std::launder(reinterpret_cast<Set*>(payload()));
+}
+
+const Set& Object::set() const {
+    return *std::launder(reinterpret_cast<const Set*>(payload()));
+}
+
+ZSet& Object::zset() {
+    return *std::launder(reinterpret_cast<ZSet*>(payload()));
+}
+
+const ZSet& Object::zset() const {
+    return *std::launder(reinterpret_cast<const ZSet*>(payload()));
+}
+
+size_t Object::memoryUsage() const {
+    size_t usage = memory::usableSize(this);
+    if (encoding_ == Encoding::RAW) {
+        RawString raw;
+        std::memcpy(&raw, payload(), sizeof(raw));
+        usage += memory::usableSize(raw.data);
+    } else if (encoding_ == Encoding::QUICKLIST) {
+        usage += list().memoryUsage();
+    } else if (encoding_ == Encoding::HASH) {
+        usage += hash().memoryUsage();
+    } else if (encoding_ == Encoding::SET) {
+        usage += set().memoryUsage();
+    } else if (encoding_ == Encoding::ZSET) {
+        usage += zset().memoryUsage();
+    }
+    return usage;
+}
+
+bool Object::defragment(Ptr& object) {
+    if (object->encoding_ == Encoding::RAW) {
+        RawString raw;
+        std::memcpy(&raw, object->payload(), sizeof(raw));
+        if (void* moved = memory::defragment(raw.data)) {
+            raw.data = static_cast<char*>(moved);
+            std::memcpy(object->payload(), &raw, sizeof(raw));
+        }
+    }
+    // The bytes are copied as they are: the headers of collections hold no
+    // pointers into themselves
+    void* moved = memory::defragment(object.get());
+    if (moved == nullptr) {
+        return false;
+    }
+    (void)object.release();
+    object.reset(std::launder(static_cast<Object*>(moved)));
+    return true;
+}
+
+size_t Object::freeEffort() const {
+    if (encoding_ == Encoding::QUICKLIST) {
+        return list().size();
+    } else if (encoding_ == Encoding::HASH) {
+        return hash().packed() ? 1 : hash().size();
+    } else if (encoding_ == Encoding::SET) {
+        return set().intset() ? 1 : set().size();
+    } else if (encoding_ == Encoding::ZSET) {
+        return zset().packed() ? 1 : zset().size();
+    }
+    return 1;
+}
+
+} // namespace redis
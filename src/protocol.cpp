@@ -1,89 +1,187 @@
 #include "redis/protocol.hpp"
 #include <sstream>
 #include <algorithm>
+#include <charconv>
 #include <vector>
 
 namespace redis {
 
-std::expected<std::vector<CommandArgs>, std::string> Protocol::parseCommand(const std::string& data) {
-    std::vector<CommandArgs> results;
-    std::string_view data_view(data);
+namespace {
+    // Upper bound for preallocating argument slots from an untrusted array length
+    constexpr int64_t MAX_ARGS_RESERVE = 64;
 
-    while (!data_view.empty()) {
-        CommandArgs args;
-
-        if (data_view.empty() || data_view[0] != '*') {
-            return std::unexpected("Invalid RESP command: must start with '*'");
-        }
-        
-        size_t pos = 1;
-        
-        // Parse array length
-        size_t array_end = data_view.find("\r\n", pos);
-        if (array_end == std::string::npos) {
-            return std::unexpected("Invalid RESP command: missing array length terminator");
+    std::optional<int64_t> parseLength(std::string_view str) {
+        int64_t value;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc() || ptr != str.data() + str.size()) {
+            return std::nullopt;
         }
-        
-        int array_length;
-        try {
-            array_length = std::stoi(std::string(data_view.substr(pos, array_end - pos)));
-        } catch (const std::exception&) {
-            return std::unexpected("Invalid RESP command: invalid array length");
-        }
-        pos = array_end + 2;
-        
-        // Parse each bulk string in the array
-        for (int i = 0; i < array_length; ++i) {
-            if (pos >= data_view.length() || data_view[pos] != '$') {
-                return std::unexpected("Invalid RESP command: expected bulk string");
+        return value;
+    }
+}
+
+std::optional<std::string_view> RequestParser::readLine(std::string_view input) {
+    size_t line_end = input.find("\r\n", std::max(scan_, pos_));
+    if (line_end == std::string_view::npos) {
+        // The '\r' of a split terminator may already be the last byte
+        scan_ = input.empty() ? 0 : input.size() - 1;
+        return std::nullopt;
+    }
+    auto line = input.substr(pos_, line_end - pos_);
+    pos_ = line_end + 2;
+    scan_ = pos_;
+    return line;
+}
+
+std::expected<std::optional<CommandArgsSpan>, std::string> RequestParser::next(std::string_view& input) {
+    while (true) {
+        switch (state_) {
+            case State::ARRAY_HEADER: {
+                if (input.empty()) {
+                    return std::nullopt;
+                }
+                if (input[0] != '*') {
+                    return std::unexpected("Invalid RESP command: must start with '*'");
+                }
+                auto line = readLine(input);
+                if (!line.has_value()) {
+                    return std::nullopt;
+                }
+                auto length = parseLength(line->substr(1));
+                if (!length.has_value() || length.value() > MAX_MULTIBULK_LENGTH) {
+                    return std::unexpected("Invalid RESP command: invalid array length");
+                }
+                remaining_args_ = length.value();
+                arg_offsets_.reserve(std::clamp<int64_t>(remaining_args_, 0, MAX_ARGS_RESERVE));
+                state_ = State::BULK_HEADER;
+                break;
             }
-            
-            pos++; // Skip '$'
-            
-            // Parse bulk string length
-            size_t length_end = data_view.find("\r\n", pos);
-            if (length_end == std::string::npos) {
-                return std::unexpected("Invalid RESP command: missing bulk string length terminator");
+            case State::BULK_HEADER: {
+                if (remaining_args_ <= 0) {
+                    args_.clear();
+                    for (const auto& [offset, length] : arg_offsets_) {
+                        args_.push_back(input.substr(offset, length));
+                    }
+                    input.remove_prefix(pos_);
+                    reset();
+                    return CommandArgsSpan(args_);
+                }
+                if (pos_ >= input.size()) {
+                    return std::nullopt;
+                }
+                if (input[pos_] != '$') {
+                    return std::unexpected("Invalid RESP command: expected bulk string");
+                }
+                auto line = readLine(input);
+                if (!line.has_value()) {
+                    return std::nullopt;
+                }
+                auto length = parseLength(line->substr(1));
+                if (!length.has_value() || length.value() < 0 || length.value() > MAX_BULK_LENGTH) {
+                    return std::unexpected("Invalid RESP command: invalid bulk string length");
+                }
+                bulk_length_ = length.value();
+                state_ = State::BULK_BODY;
+                break;
             }
-            
-            int bulk_length;
-            try {
-                bulk_length = std::stoi(std::string(data_view.substr(pos, length_end - pos)));
-            } catch (const std::exception&) {
-                return std::unexpected("Invalid RESP command: invalid bulk string length");
+            case State::BULK_BODY: {
+                // Waiting for the body costs O(1) per call no matter how large it is
+                if (input.size() - pos_ < static_cast<size_t>(bulk_length_) + 2) {
+                    return std::nullopt;
+                }
+                arg_offsets_.emplace_back(pos_, bulk_length_);
+                pos_ += bulk_length_ + 2; // Skip content and \r\n
+                scan_ = pos_;
+                remaining_args_--;
+                state_ = State::BULK_HEADER;
+                break;
             }
-            pos = length_end + 2;
-            
-            // Extract bulk string content
-            if (pos + bulk_length + 2 > data_view.length()) {
-                return std::unexpected("Invalid RESP command: bulk string content too short");
+        }
+    }
+}
+
+std::string RequestParser::truncatedError(std::string_view input) const {
+    switch (state_) {
+        case State::ARRAY_HEADER:
+            return "Invalid RESP command: missing array length terminator";
+        case State::BULK_HEADER:
+            if (pos_ >= input.size()) {
+                return "Invalid RESP command: expected bulk string";
             }
-            
-            auto arg = data_view.substr(pos, bulk_length);
-            args.emplace_back(arg);
-            pos += bulk_length + 2; // Skip content and \r\n
+            return "Invalid RESP command: missing bulk string length terminator";
+        case State::BULK_BODY:
+            return "Invalid RESP command: bulk string content too short";
+    }
+    return "Invalid RESP command";
+}
+
+size_t RequestParser::frameSizeHint() const {
+    if (state_ != State::BULK_BODY) {
+        return 0;
+    }
+    return pos_ + bulk_length_ + 2;
+}
+
+void RequestParser::reset() {
+    state_ = State::ARRAY_HEADER;
+    pos_ = 0;
+    scan_ = 0;
+    remaining_args_ = 0;
+    bulk_length_ = 0;
+    arg_offsets_.clear();
+}
+
+std::expected<std::vector<CommandArgs>, std::string> Protocol::parseCommand(const std::string& data) {
+    std::vector<CommandArgs> results;
+    std::string_view data_view(data);
+    RequestParser parser;
+
+    while (!data_view.empty()) {
+        auto command = parser.next(data_view);
+        if (!command.has_value()) {
+            return std::unexpected(command.error());
+        }
+        if (!command->has_value()) {
+            return std::unexpected(parser.truncatedError(data_view));
         }
-        results.push_back(args);
-        data_view.remove_prefix(pos);
+        results.emplace_back(command->value().begin(), command->value().end());
     }
     
     return results;
 }
 
-std::string Protocol::serializeSimpleString(const std::string& str) {
-    return "+" + str + "\r\n";
+std::string Protocol::serializeSimpleString(std::string_view str) {
+    std::string result;
+    result.reserve(str.size() + 3);
+    result += '+';
+    result += str;
+    result += "\r\n";
+    return result;
 }
 
-std::string Protocol::serializeError(const std::string& error) {
-    return "-" + error + "\r\n";
+std::string Protocol::serializeError(std::string_view error) {
+    std::string result;
+    result.reserve(error.size() + 3);
+    result += '-';
+    result += error;
+    result += "\r\n";
+    return result;
 }
 
 std::string Protocol::serializeInteger(int64_t value) {
     return ":" + std::to_string(value) + "\r\n";
 }
 
-std::string Protocol::serializeBulkString(const std::string& str) {
-    return "$" + std::to_string(str.length()) + "\r\n" + str + "\r\n";
+std::string Protocol::serializeBulkString(std::string_view str) {
+    auto length = std::to_string(str.length());
+    std::string result;
+    result.reserve(length.size() + str.size() + 5);
+    result += '$';
+    result += length;
+    result += "\r\n";
+    result += str;
+    result += "\r\n";
+    return result;
 }
 
 std::string Protocol::serializeNullBulkString() {
@@ -102,6 +200,27 @@ std::string Protocol::serializeNullArray() {
     return "*-1\r\n";
 }
 
+void Protocol::appendArrayHeader(std::string& out, size_t size) {
+    out += '*';
+    out += std::to_string(size);
+    out += "\r\n";
+}
+
+void Protocol::appendBulkString(std::string& out, std::string_view str) {
+    out += '$';
+    out += std::to_string(str.size());
+    out += "\r\n";
+    out += str;
+    out += "\r\n";
+}
+
+void Protocol::appendCommand(std::string& out, CommandArgsSpan args) {
+    appendArrayHeader(out, args.size());
+    for (std::string_view arg : args) {
+        appendBulkString(out, arg);
+    }
+}
+
 std::string Protocol::serialize(const std::string& response, ResponseType type) {
     switch (type) {
         case ResponseType::SIMPLE_STRING:
@@ -0,0 +1,260 @@
+#include "redis/quicklist.hpp"
+#include "redis/memory.hpp"
+#include "redis/varint.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+    // Entry bytes of a new node; with the header a small list fits in 64 bytes
+    constexpr size_t MIN_NODE_CAPACITY = 32;
+
+    // The low 7-bit group goes last, each group flagging whether another one
+    // precedes it, so the value is read from the end backwards
+    void writeBackLength(char* out, size_t value, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            auto group = static_cast<unsigned char>((value >> (7 * i)) & 0x7f);
+            out[size - 1 - i] = static_cast<char>(i + 1 < size ? group | 0x80 : group);
+        }
+    }
+}
+
+namespace redis {
+
+QuickList::QuickList() : head_(nullptr), tail_(nullptr), count_(0) {
+}
+
+QuickList::~QuickList() {
+    Node* node = head_;
+    while (node != nullptr) {
+        Node* next = node->next;
+        memory::release(node);
+        node = next;
+    }
+}
+
+std::string_view QuickList::element(const char* entry) {
+    size_t length;
+    const char* data = varint::read(entry, length);
+    return std::string_view(data, length);
+}
+
+const char* QuickList::skip(const char* entry) {
+    size_t length;
+    const char* data = varint::read(entry, length);
+    size_t header = static_cast<size_t>(data - entry);
+    return data + length + varint::size(header + length);
+}
+
+const char* QuickList::skipBack(const char* entry_end) {
+    const char* p = entry_end - 1;
+    size_t size = static_cast<unsigned char>(*p) & 0x7f;
+    for (int shift = 7; static_cast<unsigned char>(*p) & 0x80; shift += 7) {
+        p--;
+        size |= static_cast<size_t>(static_cast<unsigned char>(*p) & 0x7f) << shift;
+    }
+    return p - size;
+}
+
+size_t QuickList::entrySize(size_t length) {
+    size_t size = varint::size(length) + length;
+    return size + varint::size(size);
+}
+
+void QuickList::writeEntry(char* out, std::string_view value) {
+    char* data = varint::write(out, value.size());
+    std::memcpy(data, value.data(), value.size());
+    size_t size = static_cast<size_t>(data - out) + value.size();
+    writeBackLength(data + value.size(), size, varint::size(size));
+}
+
+QuickList::Node* QuickList::allocateNode(size_t capacity) {
+    void* block = memory::allocate(sizeof(Node) + capacity);
+    auto* node = new (block) Node{nullptr, nullptr, 0, 0, 0, static_cast<uint32_t>(capacity)};
+    return node;
+}
+
+QuickList::Node* QuickList::reserve(Node* node, ListEnd end, size_t size) {
+    size_t free_at_end = end == ListEnd::HEAD ? node->begin : node->capacity - node->end;
+    if (free_at_end >= size) {
+        return node;
+    }
+    size_t used = node->used();
+    if (node->capacity - used >= size) {
+        // Move the entries against the other end
+        size_t begin = end == ListEnd::HEAD ? node->capacity - used : 0;
+        std::memmove(node->data() + begin, node->data() + node->begin, used);
+        node->begin = static_cast<uint32_t>(begin);
+        node->end = static_cast<uint32_t>(begin + used);
+        return node;
+    }
+
+    size_t capacity = std::max(used + size, std::min<size_t>(node->capacity * 2, NODE_MAX_BYTES));
+    Node* grown = allocateNode(capacity);
+    size_t begin = end == ListEnd::HEAD ? capacity - used : 0;
+    std::memcpy(grown->data() + begin, node->data() + node->begin, used);
+    grown->begin = static_cast<uint32_t>(begin);
+    grown->end = static_cast<uint32_t>(begin + used);
+    grown->count = node->count;
+    grown->prev = node->prev;
+    grown->next = node->next;
+    (grown->prev != nullptr ? grown->prev->next : head_) = grown;
+    (grown->next != nullptr ? grown->next->prev : tail_) = grown;
+    memory::release(node);
+    return grown;
+}
+
+void QuickList::unlink(Node* node) {
+    (node->prev != nullptr ? node->prev->next : head_) = node->next;
+    (node->next != nullptr ? node->next->prev : tail_) = node->prev;
+}
+
+void QuickList::push(ListEnd end, std::string_view value) {
+    size_t size = entrySize(value.size());
+    Node* node = end == ListEnd::HEAD ? head_ : tail_;
+    if (node == nullptr || node->used() + size > NODE_MAX_BYTES) {
+        size_t capacity = std::max(size, MIN_NODE_CAPACITY);
+        node = allocateNode(capacity);
+        node->begin = node->end = static_cast<uint32_t>(end == ListEnd::HEAD ? capacity : 0);
+        if (end == ListEnd::HEAD) {
+            node->next = head_;
+            (head_ != nullptr ? head_->prev : tail_) = node;
+            head_ = node;
+        } else {
+            node->prev = tail_;
+            (tail_ != nullptr ? tail_->next : head_) = node;
+            tail_ = node;
+        }
+    } else {
+        node = reserve(node, end, size);
+    }
+
+    if (end == ListEnd::HEAD) {
+        node->begin -= static_cast<uint32_t>(size);
+        writeEntry(node->data() + node->begin, value);
+    } else {
+        writeEntry(node->data() + node->end, value);
+        node->end += static_cast<uint32_t>(size);
+    }
+    node->count++;
+    count_++;
+}
+
+std::string QuickList::pop(ListEnd end) {
+    Node* node = end == ListEnd::HEAD ? head_ : tail_;
+    std::string value;
+    if (end == ListEnd::HEAD) {
+        const char* entry = node->data() + node->begin;
+        value = element(entry);
+        node->begin = static_cast<uint32_t>(skip(entry) - node->data());
+    } else {
+        const char* entry = skipBack(node->data() + node->end);
+        value = element(entry);
+        node->end = static_cast<uint32_t>(entry - node->data());
+    }
+    count_--;
+    if (--node->count == 0) {
+        unlink(node);
+        memory::release(node);
+    }
+    return value;
+}
+
+void QuickList::remove(ListEnd end, size_t count) {
+    count = std::min(count, count_);
+    while (count > 0) {
+        Node* node = end == ListEnd::HEAD ? head_ : tail_;
+        if (count >= node->count) {
+            count -= node->count;
+            count_ -= node->count;
+            unlink(node);
+            memory::release(node);
+            continue;
+        }
+        if (end == ListEnd::HEAD) {
+            const char* entry = node->data() + node->begin;
+            for (size_t i = 0; i < count; i++) {
+                entry = skip(entry);
+            }
+            node->begin = static_cast<uint32_t>(entry - node->data());
+        } else {
+            const char* entry = node->data() + node->end;
+            for (size_t i = 0; i < count; i++) {
+                entry = skipBack(entry);
+            }
+            node->end = static_cast<uint32_t>(entry - node->data());
+        }
+        node->count -= static_cast<uint32_t>(count);
+        count_ -= count;
+        count = 0;
+    }
+}
+
+const QuickList::Node* QuickList::nodeAt(size_t& offset) const {
+    if (offset < count_ / 2) {
+        const Node* node = head_;
+        while (offset >= node->count) {
+            offset -= node->count;
+            node = node->next;
+        }
+        return node;
+    }
+    size_t from_tail = count_ - 1 - offset;
+    const Node* node = tail_;
+    while (from_tail >= node->count) {
+        from_tail -= node->count;
+        node = node->prev;
+    }
+    offset = node->count - 1 - from_tail;
+    return node;
+}
+
+std::optional<std::string_view> QuickList::index(int64_t index) const {
+    if (index < 0) {
+        index += static_cast<int64_t>(count_);
+    }
+    if (index < 0 || static_cast<size_t>(index) >= count_) {
+        return std::nullopt;
+    }
+    size_t offset = static_cast<size_t>(index);
+    const Node* node = nodeAt(offset);
+    // Walk the node from its nearer end
+    if (offset < node->count / 2) {
+        const char* entry = node->data() + node->begin;
+        for (size_t i = 0; i < offset; i++) {
+            entry = skip(entry);
+        }
+        return element(entry);
+    }
+    const char* entry = skipBack(node->data() + node->end);
+    for (size_t i = node->count - 1; i > offset; i--) {
+        entry = skipBack(entry);
+    }
+    return element(entry);
+}
+
+std::optional<std::pair<size_t, size_t>> QuickList::range(int64_t start, int64_t stop) const {
+    auto size = static_cast<int64_t>(count_);
+    if (start < 0) {
+        start = std::max<int64_t>(start + size, 0);
+    }
+    if (stop < 0) {
+        stop += size;
+    }
+    stop = std::min(stop, size - 1);
+    if (start > stop) {
+        return std::nullopt;
+    }
+    return std::pair{static_cast<size_t>(start), static_cast<size_t>(stop)};
+}
+
+size_t QuickList::memoryUsage() const {
+    size_t usage = 0;
+    for (const Node* node = head_; node != nullptr; node = node->next) {
+        usage += memory::usableSize(node);
+    }
+    return usage;
+}
+
+} // namespace redis
@@ -0,0 +1,412 @@
+#include "redis/rdb.hpp"
+#include "redis/hash.hpp"
+#include "redis/set.hpp"
+#include "redis/zset.hpp"
+#include "redis/mapped_file.hpp"
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr std::string_view MAGIC = "DRDB";
+    constexpr uint8_t VERSION = 1;
+
+    // Record types
+    constexpr uint8_t TYPE_STRING = 0;
+    constexpr uint8_t TYPE_INT = 1;
+    // Element count, then the elements from head to tail
+    constexpr uint8_t TYPE_LIST = 2;
+    // Field count, then field and value of each
+    constexpr uint8_t TYPE_HASH = 3;
+    // Member count, then the members
+    constexpr uint8_t TYPE_SET = 4;
+    // Member count, then each member and the bits of its score, in order
+    constexpr uint8_t TYPE_ZSET = 5;
+    constexpr uint8_t OPCODE_EXPIRE_MS = 0xfc;
+    constexpr uint8_t OPCODE_EOF = 0xff;
+
+    constexpr size_t CHECKSUM_SIZE = sizeof(uint64_t);
+    // Bytes buffered before a write() while saving
+    constexpr size_t WRITE_BUFFER_SIZE = 1 << 16;
+
+    // CRC-64/Jones, the checksum of Redis' RDB files, table driven
+    constexpr std::array<uint64_t, 256> CRC64_TABLE = [] {
+        std::array<uint64_t, 256> table{};
+        for (uint64_t i = 0; i < 256; i++) {
+            uint64_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x95ac9329ac4bc9b5ULL : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }();
+
+    uint64_t crc64(uint64_t crc, std::string_view data) {
+        for (unsigned char c : data) {
+            crc = CRC64_TABLE[(crc ^ c) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    std::runtime_error corrupt(std::string_view reason) {
+        return std::runtime_error(std::format("Corrupt snapshot: {}", reason));
+    }
+
+    // Buffered writer that checksums what it writes
+    class Writer {
+    public:
+        explicit Writer(int fd) : fd_(fd), crc_(0) {
+            buffer_.reserve(WRITE_BUFFER_SIZE);
+        }
+
+        void byte(uint8_t value) {
+            buffer_.push_back(static_cast<char>(value));
+        }
+
+        void varint(uint64_t value) {
+            while (value >= 0x80) {
+                byte(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            byte(static_cast<uint8_t>(value));
+        }
+
+        void int64(int64_t value) {
+            auto bits = static_cast<uint64_t>(value);
+            for (int i = 0; i < 8; i++) {
+                byte(static_cast<uint8_t>(bits >> (8 * i)));
+            }
+        }
+
+        void string(std::string_view value) {
+            varint(value.size());
+            buffer_.append(value);
+            if (buffer_.size() >= WRITE_BUFFER_SIZE) {
+                flush();
+            }
+        }
+
+        // Write the end of file marker and the checksum
+        void finish() {
+            byte(OPCODE_EOF);
+            flush();
+            int64(static_cast<int64_t>(crc_));
+            write(buffer_);
+            buffer_.clear();
+        }
+
+    private:
+        int fd_;
+        uint64_t crc_;
+        std::string buffer_;
+
+        void flush() {
+            crc_ = crc64(crc_, buffer_);
+            write(buffer_);
+            buffer_.clear();
+        }
+
+        void write(std::string_view data) {
+            while (!data.empty()) {
+                ssize_t written = ::write(fd_, data.data(), data.size());
+                if (written == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error(std::format("Failed to write snapshot: {}", strerror(errno)));
+                }
+                data.remove_prefix(static_cast<size_t>(written));
+            }
+        }
+    };
+
+    // Bounds-checked decoder over the mapped file
+    class Reader {
+    public:
+        Reader(const char* data, size_t size) : pos_(data), end_(data + size) {}
+
+        bool atEnd() const {
+            return pos_ == end_;
+        }
+
+        uint8_t byte() {
+            if (pos_ == end_) {
+                throw corrupt("unexpected end of file");
+            }
+            return static_cast<uint8_t>(*pos_++);
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                uint8_t b = byte();
+                value |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if ((b & 0x80) == 0) {
+                    return value;
+                }
+            }
+            throw corrupt("varint too long");
+        }
+
+        int64_t int64() {
+            std::string_view data = bytes(8);
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+            }
+            return static_cast<int64_t>(bits);
+        }
+
+        std::string_view string() {
+            return bytes(varint());
+        }
+
+        std::string_view bytes(uint64_t size) {
+            if (size > static_cast<uint64_t>(end_ - pos_)) {
+                throw corrupt("unexpected end of file");
+            }
+            std::string_view data(pos_, size);
+            pos_ += size;
+            return data;
+        }
+
+    private:
+        const char* pos_;
+        const char* end_;
+    };
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+}
+
+namespace redis {
+
+void Rdb::save(const std::string& path, const std::vector<Storage*>& shards) {
+    std::string temp_path = std::format("{}.tmp-{}", path, ::getpid());
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error(std::format("Failed to create {}: {}", temp_path, strerror(errno)));
+    }
+
+    try {
+        size_t count = 0;
+        for (Storage* shard : shards) {
+            count += shard->size();
+        }
+        Writer writer(fd);
+        for (char c : MAGIC) {
+            writer.byte(static_cast<uint8_t>(c));
+        }
+        writer.byte(VERSION);
+        writer.varint(count);
+
+        for (Storage* shard : shards) {
+            shard->forEach([&](const Object& object, int64_t expire_at) {
+                if (expire_at != 0) {
+                    writer.byte(OPCODE_EXPIRE_MS);
+                    writer.int64(expire_at);
+                }
+                if (object.type() == ValueType::ZSET) {
+                    writer.byte(TYPE_ZSET);
+                    writer.string(object.key());
+                    writer.varint(object.zset().size());
+                    object.zset().forEach([&writer](std::string_view member, double score) {
+                        writer.string(member);
+                        writer.int64(std::bit_cast<int64_t>(score));
+                    });
+                } else if (object.type() == ValueType::SET) {
+                    writer.byte(TYPE_SET);
+                    writer.string(object.key());
+                    writer.varint(object.set().size());
+                    object.set().forEach([&writer](std::string_view member) { writer.string(member); });
+                } else if (object.type() == ValueType::HASH) {
+                    writer.byte(TYPE_HASH);
+                    writer.string(object.key());
+                    writer.varint(object.hash().size());
+                    object.hash().forEach([&writer](std::string_view field, std::string_view value) {
+                        writer.string(field);
+                        writer.string(value);
+                    });
+                } else if (object.type() == ValueType::LIST) {
+                    writer.byte(TYPE_LIST);
+                    writer.string(object.key());
+                    writer.varint(object.list().size());
+                    object.list().forEach([&writer](std::string_view value) {
+                        writer.string(value);
+                    });
+                } else if (object.encoding() == Encoding::INT) {
+                    writer.byte(TYPE_INT);
+                    writer.string(object.key());
+                    writer.varint(zigzag(object.integer()));
+                } else {
+                    writer.byte(TYPE_STRING);
+                    writer.string(object.key());
+                    writer.string(object.string().view());
+                }
+            });
+        }
+        writer.finish();
+
+        if (::fsync(fd) == -1) {
+            throw std::runtime_error(std::format("Failed to sync snapshot: {}", strerror(errno)));
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temp_path.c_str());
+        throw;
+    }
+    ::close(fd);
+
+    if (::rename(temp_path.c_str(), path.c_str()) == -1) {
+        int error = errno;
+        ::unlink(temp_path.c_str());
+        throw std::runtime_error(std::format("Failed to rename snapshot to {}: {}", path, strerror(error)));
+    }
+}
+
+size_t Rdb::load(const std::string& path, const std::vector<Storage*>& shards,
+                 const std::function<size_t(std::string_view key)>& shard_of) {
+    auto file = MappedFile::open(path);
+    if (file == nullptr) {
+        return 0;
+    }
+    std::string_view data = file->view();
+    if (data.size() < MAGIC.size() + 1 + CHECKSUM_SIZE) {
+        throw corrupt("file too short");
+    }
+    std::string_view body = data.substr(0, data.size() - CHECKSUM_SIZE);
+    Reader trailer(data.data() + body.size(), CHECKSUM_SIZE);
+    if (crc64(0, body) != static_cast<uint64_t>(trailer.int64())) {
+        throw corrupt("checksum mismatch");
+    }
+
+    Reader reader(body.data(), body.size());
+    if (reader.bytes(MAGIC.size()) != MAGIC) {
+        throw corrupt("bad magic");
+    }
+    if (uint8_t version = reader.byte(); version != VERSION) {
+        throw corrupt(std::format("unsupported version {}", version));
+    }
+    // Size the tables up front so that the load never rehashes
+    uint64_t count = reader.varint();
+    for (Storage* shard : shards) {
+        memory::AccountScope account(&shard->account());
+        shard->reserve(count / shards.size() + count / shards.size() / 16);
+    }
+
+    int64_t now = Storage::now();
+    size_t loaded = 0;
+    while (true) {
+        uint8_t type = reader.byte();
+        if (type == OPCODE_EOF) {
+            break;
+        }
+        std::optional<int64_t> expire_at;
+        if (type == OPCODE_EXPIRE_MS) {
+            expire_at = reader.int64();
+            type = reader.byte();
+        }
+
+        std::string_view key = reader.string();
+        bool expired = expire_at.has_value() && *expire_at <= now;
+        size_t shard = shards.size() == 1 ? 0 : shard_of(key);
+        memory::AccountScope account(&shards[shard]->account());
+        Object::Ptr object;
+        switch (type) {
+            case TYPE_STRING: {
+                std::string_view value = reader.string();
+                if (!expired) {
+                    object = Object::createString(key, value);
+                }
+                break;
+            }
+            case TYPE_INT: {
+                int64_t value = unzigzag(reader.varint());
+                if (!expired) {
+                    object = Object::createInteger(key, value);
+                }
+                break;
+            }
+            case TYPE_LIST: {
+                uint64_t size = reader.varint();
+                if (!expired) {
+                    object = Object::createList(key);
+                }
+                for (uint64_t i = 0; i < size; i++) {
+                    std::string_view value = reader.string();
+                    if (!expired) {
+                        object->list().push(ListEnd::TAIL, value);
+                    }
+                }
+                break;
+            }
+            case TYPE_HASH: {
+                uint64_t size = reader.varint();
+                if (!expired) {
+                    object = Object::createHash(key);
+                }
+                for (uint64_t i = 0; i < size; i++) {
+                    std::string_view field = reader.string();
+                    std::string_view value = reader.string();
+                    if (!expired) {
+                        object->hash().set(field, value, shards[shard]->hashLimits());
+                    }
+                }
+                break;
+            }
+            case TYPE_SET: {
+                uint64_t size = reader.varint();
+                if (!expired) {
+                    object = Object::createSet(key);
+                }
+                for (uint64_t i = 0; i < size; i++) {
+                    std::string_view member = reader.string();
+                    if (!expired) {
+                        object->set().add(member, shards[shard]->maxIntsetEntries());
+                    }
+                }
+                break;
+            }
+            case TYPE_ZSET: {
+                uint64_t size = reader.varint();
+                if (!expired) {
+                    object = Object::createZSet(key);
+                }
+                for (uint64_t i = 0; i < size; i++) {
+                    std::string_view member = reader.string();
+                    auto score = std::bit_cast<double>(reader.int64());
+                    if (!expired) {
+                        object->zset().add(member, score, shards[shard]->zsetLimits());
+                    }
+                }
+                break;
+            }
+            default:
+                throw corrupt(std::format("unknown record type {}", type));
+        }
+        if (expired) {
+            continue;
+        }
+        if (shards[shard]->restore(std::move(object), expire_at)) {
+            loaded++;
+        }
+    }
+    if (!reader.atEnd()) {
+        throw corrupt("data after end of file marker");
+    }
+    return loaded;
+}
+
+} // namespace redis
@@ -1,110 +1,252 @@
 #include "redis/server.hpp"
-#include "redis/client_connection.hpp"
+#include "redis/log.hpp"
+#include "redis/rdb.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
 #include <stdexcept>
-#include <sys/epoll.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <cstring>
 
-#include <spdlog/spdlog.h>
+namespace redis {
 
-const constexpr int MAX_EVENTS = 10;
-const constexpr int TIMEOUT = 1000;
+// Server implementation
+Server::Server(const std::string& host, int port, size_t threads, Backend backend, const std::string& rdb_path)
+    : host_(host), port_(port), threads_(std::max<size_t>(threads, 1)), backend_(backend),
+      max_intset_entries_(Set::DEFAULT_MAX_INTSET_ENTRIES), running_(false) {
+    persistence_.rdb_path = rdb_path;
+    stop_fd_ = eventfd(0, EFD_NONBLOCK);
+    if (stop_fd_ == -1) {
+        throw std::runtime_error("Failed to create eventfd");
+    }
+}
 
-namespace {
-    void set_nonblocking(int socket_fd) {
-        int flags = fcntl(socket_fd, F_GETFL, 0);
-        if (flags == -1) {
-            throw std::runtime_error("Failed to get socket flags");
-        }
-        if (fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-            throw std::runtime_error("Failed to set socket to non-blocking");
+Server::~Server() {
+    stop();
+    ::close(stop_fd_);
+}
+
+void Server::start() {
+    // Forget a stop request left over from a previous run
+    uint64_t value;
+    while (::read(stop_fd_, &value, sizeof(value)) > 0) {
+    }
+
+    shards_.clear();
+    shards_.reserve(threads_);
+    for (size_t i = 0; i < threads_; i++) {
+        shards_.push_back(EventLoop::create(backend_, i, shards_, persistence_));
+        shards_.back()->listen(host_, port_);
+        shards_.back()->database().storage().setHashLimits(hash_limits_);
+        shards_.back()->database().storage().setMaxIntsetEntries(max_intset_entries_);
+        shards_.back()->database().storage().setZSetLimits(zset_limits_);
+        shards_.back()->database().storage().setLazyFree(&lazy_free_);
+        // Loaded keys get access clocks for the policy, but are not evicted
+        // before they are all in, as in Redis
+        MemoryLimits loading = memory_limits_;
+        loading.max_memory = 0;
+        shards_.back()->database().storage().setMemoryLimits(loading);
+    }
+    loadData();
+    MemoryLimits limits = memory_limits_;
+    limits.shards = shards_.size();
+    for (const auto& shard : shards_) {
+        shard->database().storage().setMemoryLimits(limits);
+        shard->database().storage().setDefragSettings(defrag_settings_);
+        shard->database().setSlowLogSettings(slow_log_settings_);
+        shard->setLatencyMonitor(&latency_monitor_);
+    }
+    running_ = true;
+    REDIS_DEBUG("Running {} event loop(s)", threads_);
+
+    std::vector<std::exception_ptr> errors(threads_);
+    std::vector<std::thread> workers;
+    auto run = [this, &errors](size_t i) {
+        // Whatever the loop allocates or frees is its keyspace's
+        memory::AccountScope account(&shards_[i]->database().storage().account());
+        try {
+            shards_[i]->run(running_, stop_fd_);
+        } catch (...) {
+            errors[i] = std::current_exception();
+            stop();
         }
+    };
+    for (size_t i = 1; i < threads_; i++) {
+        workers.emplace_back(run, i);
     }
+    run(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    shards_.clear();
+    persistence_.aof.reset();
 
-    int init_socket(const std::string& host, int port) {
-        int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (socket_fd == -1) {
-            throw std::runtime_error("Failed to create socket");
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
         }
+    }
+}
 
-        sockaddr_in address;
-        address.sin_family = AF_INET;
-        address.sin_port = htons(port);
-        address.sin_addr.s_addr = inet_addr(host.c_str());
+void Server::enableAppendOnly(const std::string& path, FsyncPolicy fsync) {
+    persistence_.appendonly = true;
+    persistence_.aof_path = path;
+    persistence_.fsync = fsync;
+}
 
-        if (bind(socket_fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-            throw std::runtime_error("Failed to bind socket");
-        }
+void Server::setHashLimits(const HashLimits& limits) {
+    hash_limits_ = limits;
+}
 
-        set_nonblocking(socket_fd);
+void Server::setMaxIntsetEntries(size_t entries) {
+    max_intset_entries_ = entries;
+}
 
-        if (listen(socket_fd, SOMAXCONN) == -1) {
-            throw std::runtime_error("Failed to listen on socket");
-        }
-        return socket_fd;
-    }
+void Server::setZSetLimits(const ZSetLimits& limits) {
+    zset_limits_ = limits;
+}
+
+void Server::setMemoryLimits(const MemoryLimits& limits) {
+    memory_limits_ = limits;
+}
 
-    int init_epoll(int server_socket) {
-        struct epoll_event event;
-        event.events = EPOLLIN;
-        event.data.fd = server_socket;
+void Server::setDefragSettings(const DefragSettings& settings) {
+    defrag_settings_ = settings;
+}
 
-        int epoll_fd = epoll_create1(0);
-        if (epoll_fd == -1) {
-            throw std::runtime_error("Failed to create epoll");
+void Server::setSlowLogSettings(const SlowLogSettings& settings) {
+    slow_log_settings_ = settings;
+}
+
+void Server::setLatencyMonitorThreshold(std::chrono::milliseconds threshold) {
+    latency_monitor_.setThreshold(threshold);
+}
+
+void Server::loadData() {
+    auto start = std::chrono::steady_clock::now();
+    auto report = [&start](std::string_view what, size_t count, const std::string& path) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        REDIS_INFO("Loaded {} {} from {} in {:.3f}s ({:.0f}/s)", count, what, path, elapsed.count(),
+                     count / elapsed.count());
+    };
+    if (!persistence_.appendonly) {
+        if (size_t keys = loadSnapshot()) {
+            report("keys", keys, persistence_.rdb_path);
         }
-        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &event) == -1) {
-            throw std::runtime_error("Failed to add server socket to epoll");
+        return;
+    }
+
+    if (std::filesystem::exists(persistence_.aof_path)) {
+        size_t commands = replayAppendOnly();
+        report("commands", commands, persistence_.aof_path);
+    } else {
+        // A new log starts with whatever the snapshot held
+        if (size_t keys = loadSnapshot()) {
+            report("keys", keys, persistence_.rdb_path);
         }
-        return epoll_fd;
+        AppendOnlyFile::writeCommands(persistence_.aof_path, storages());
+    }
+    persistence_.aof = std::make_unique<AppendOnlyFile>(persistence_.aof_path, persistence_.fsync);
+    for (size_t i = 0; i < shards_.size(); i++) {
+        shards_[i]->database().enableAppendLog(i, shards_.size());
     }
 }
 
-namespace redis {
-
-// Server implementation
-Server::Server(const std::string& host, int port)
-    : host_(host), port_(port), server_socket_(-1), running_(false) {
+size_t Server::loadSnapshot() {
+    return Rdb::load(persistence_.rdb_path, storages(), [this](std::string_view key) {
+        return EventLoop::shardOf(key, shards_.size());
+    });
 }
 
-Server::~Server() {
-    stop();
+bool Server::onShard(const KeySpec& spec, CommandArgsSpan args, size_t shard) const {
+    size_t last = spec.last < 0 ? args.size() + spec.last : spec.last;
+    last = std::min(last, args.size() - 1);
+    for (size_t pos = spec.first + spec.step; pos <= last; pos += spec.step) {
+        if (EventLoop::shardOf(args[pos], shards_.size()) != shard) {
+            return false;
+        }
+    }
+    return true;
 }
 
-void Server::start() {
-    server_socket_ = init_socket(host_, port_);
-    epoll_fd_ = init_epoll(server_socket_);
-    running_ = true;
-    epoll_event events[MAX_EVENTS];
-
-    while (running_) {
-        int nfds = epoll_wait(epoll_fd_, events, MAX_EVENTS, TIMEOUT);
-        if (nfds == -1) {
-            if (!running_) {
-                break;
+size_t Server::replayAppendOnly() {
+    return AppendOnlyFile::replay(persistence_.aof_path, [this](CommandArgsSpan args) {
+        if (args[0] == Database::FLUSH_SHARD && args.size() == 3) {
+            size_t shard = 0;
+            size_t shards = 0;
+            std::from_chars(args[1].data(), args[1].data() + args[1].size(), shard);
+            std::from_chars(args[2].data(), args[2].data() + args[2].size(), shards);
+            if (shard >= shards) {
+                REDIS_WARN("Replaying {} from the append-only file failed: invalid shard", args[0]);
+                return;
             }
-            throw std::runtime_error(std::format("Failed to wait on epoll: {}", strerror(errno)));
+            flushShard(shard, shards);
+            return;
         }
-        for (int i = 0; i < nfds; i++) {
-            spdlog::debug("Event on socket {}", events[i].data.fd);
-            if (events[i].data.fd == server_socket_) {
-                acceptConnections();
-            } else {
-                handleClient(events[i].data.fd);
+        // Route like a client command. The thread count may have changed since
+        // the log was written, so a logged multi-key command may now span shards.
+        const Command* command = Database::command(args[0]);
+        const KeySpec* spec = command != nullptr ? &command->keys : nullptr;
+        std::string reply;
+        if (shards_.size() > 1 && spec != nullptr && spec->first == 0 && spec->merge != ReplyMerge::NONE) {
+            // FLUSHALL empties every shard
+            for (const auto& shard : shards_) {
+                reply = shard->database().executeCommand(args);
+            }
+        } else if (shards_.size() == 1 || spec == nullptr || spec->first == 0 ||
+                   args.size() <= static_cast<size_t>(spec->first)) {
+            reply = shards_[0]->database().executeCommand(args);
+        } else if (size_t shard = EventLoop::shardOf(args[spec->first], shards_.size()); onShard(*spec, args, shard)) {
+            reply = shards_[shard]->database().executeCommand(args);
+        } else {
+            auto parts = EventLoop::splitByShard(*spec, args, shards_.size());
+            for (size_t shard = 0; shard < parts.size(); shard++) {
+                if (!parts[shard].empty()) {
+                    reply = shards_[shard]->database().executeCommand(parts[shard]);
+                }
             }
         }
+        if (!reply.empty() && reply[0] == '-') {
+            REDIS_WARN("Replaying {} from the append-only file failed: {}", args[0], reply);
+        }
+    });
+}
+
+void Server::flushShard(size_t shard, size_t shards) {
+    if (shards == shards_.size()) {
+        shards_[shard]->database().storage().clear();
+        return;
+    }
+    for (Storage* storage : storages()) {
+        std::vector<std::string> keys;
+        size_t cursor = 0;
+        do {
+            cursor = storage->scan(cursor, 1024, [&](std::string_view key, ValueType) {
+                if (EventLoop::shardOf(key, shards) == shard) {
+                    keys.emplace_back(key);
+                }
+            });
+        } while (cursor != 0);
+        for (const std::string& key : keys) {
+            storage->del(key);
+        }
     }
-    ::close(server_socket_);
-    ::close(epoll_fd_);
+}
+
+std::vector<Storage*> Server::storages() const {
+    std::vector<Storage*> storages;
+    for (const auto& shard : shards_) {
+        storages.push_back(&shard->database().storage());
+    }
+    return storages;
 }
 
 void Server::stop() {
-    // TODO: Implement server shutdown
     running_ = false;
+    uint64_t one = 1;
+    ssize_t result = ::write(stop_fd_, &one, sizeof(one));
+    (void)result;
 }
 
 bool Server::isRunning() const {
@@ -119,61 +261,12 @@ int Server::getPort() const {
     return port_;
 }
 
-void Server::acceptConnections() {
-    while (true) {
-        sockaddr_in client_address;
-        socklen_t client_address_len = sizeof(client_address);
-        int client_socket = accept(server_socket_, (struct sockaddr*)&client_address, &client_address_len);
-        if (client_socket == -1) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                spdlog::debug("No more connections to accept");
-                break;
-            }
-            throw std::runtime_error("Failed to accept connection");
-        }
-
-        spdlog::debug("Accepted connection from {}, socket {}", inet_ntoa(client_address.sin_addr), client_socket);
-
-        set_nonblocking(client_socket);
-
-        connections_[client_socket] = std::make_unique<ClientConnection>(client_socket, database_);
-
-        struct epoll_event event;
-        event.events = EPOLLIN | EPOLLET;
-        event.data.fd = client_socket;
-        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_socket, &event) == -1) {
-            throw std::runtime_error("Failed to add client socket to epoll");
-        }
-    }
+size_t Server::getThreads() const {
+    return threads_;
 }
 
-void Server::handleClient(int client_socket) {
-    spdlog::debug("Handling client on socket {}", client_socket);
-    if (connections_.find(client_socket) == connections_.end()) {
-        throw std::runtime_error("Client socket not found");
-    }
-    auto& connection = connections_[client_socket];
-    auto had_pending_data = connection->hasPendingData();
-    connection->handle();
-    if (!connection->isActive()) {
-        spdlog::debug("Client socket {} is not active, removing from connections", client_socket);
-        connections_.erase(client_socket);
-        return;
-    }
-    auto has_pending_data = connection->hasPendingData();
-    if (had_pending_data != has_pending_data) {
-        spdlog::debug("Client socket {} has pending data: {} -> {}", client_socket, had_pending_data, has_pending_data);
-        struct epoll_event event;
-        event.events = EPOLLIN | EPOLLET;
-        if (has_pending_data) {
-            event.events |= EPOLLOUT;
-        }
-        event.data.fd = client_socket;
-        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_socket, &event) == -1) {
-            throw std::runtime_error("Failed to modify client socket in epoll");
-        }
-    }
+Backend Server::getBackend() const {
+    return backend_;
 }
 
 } // namespace redis
-
@@ -0,0 +1,146 @@
+#include "redis/set.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace {
+    void emitIntegers(const std::vector<int64_t>& values, const redis::Set::MemberFn& fn) {
+        char digits[20];
+        for (int64_t value : values) {
+            auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            fn(std::string_view(digits, end - digits));
+        }
+    }
+
+    bool allIntsets(std::span<const redis::Set* const> sets) {
+        return std::all_of(sets.begin(), sets.end(), [](const redis::Set* set) {
+            return set == nullptr || set->intset();
+        });
+    }
+}
+
+namespace redis {
+
+Set::Set() = default;
+
+Set::~Set() = default;
+
+size_t Set::size() const {
+    return table_ != nullptr ? table_->size() : ints_.size();
+}
+
+bool Set::contains(std::string_view member) const {
+    if (table_ != nullptr) {
+        return table_->contains(member);
+    }
+    auto value = canonicalInteger(member);
+    return value.has_value() && ints_.contains(*value);
+}
+
+void Set::convert() {
+    auto table = std::make_unique<Table>();
+    table->reserve(ints_.size());
+    forEach([&table](std::string_view member) {
+        table->tryEmplace(member, Object::createString(member, {}));
+    });
+    table_ = std::move(table);
+    ints_.clear();
+}
+
+bool Set::add(std::string_view member, size_t max_intset_entries) {
+    if (table_ == nullptr) {
+        auto value = canonicalInteger(member);
+        if (value.has_value() && (ints_.size() < max_intset_entries || ints_.contains(*value))) {
+            return ints_.insert(*value);
+        }
+        convert();
+    }
+    if (table_->contains(member)) {
+        return false;
+    }
+    table_->tryEmplace(member, Object::createString(member, {}));
+    return true;
+}
+
+bool Set::remove(std::string_view member) {
+    if (table_ != nullptr) {
+        return table_->erase(member);
+    }
+    auto value = canonicalInteger(member);
+    return value.has_value() && ints_.erase(*value);
+}
+
+size_t Set::memoryUsage() const {
+    if (table_ == nullptr) {
+        return ints_.memoryUsage();
+    }
+    size_t usage = sizeof(Table) + table_->memoryUsage();
+    table_->forEach([&usage](std::string_view, const Object::Ptr& object) {
+        usage += object->memoryUsage();
+    });
+    return usage;
+}
+
+void Set::intersect(std::span<const Set* const> sets, const MemberFn& fn) {
+    if (sets.empty() || std::find(sets.begin(), sets.end(), nullptr) != sets.end()) {
+        return;
+    }
+    // Start from the smallest set, which bounds the result
+    std::vector<const Set*> sorted(sets.begin(), sets.end());
+    std::sort(sorted.begin(), sorted.end(), [](const Set* a, const Set* b) { return a->size() < b->size(); });
+
+    if (allIntsets(sorted) && sorted.size() > 1) {
+        std::vector<int64_t> result;
+        std::vector<int64_t> next;
+        sorted[0]->ints_.intersect(sorted[1]->ints_, result);
+        for (size_t i = 2; i < sorted.size() && !result.empty(); i++) {
+            next.clear();
+            sorted[i]->ints_.intersect(result, next);
+            result.swap(next);
+        }
+        emitIntegers(result, fn);
+        return;
+    }
+    auto others = std::span(sorted).subspan(1);
+    sorted[0]->forEach([&](std::string_view member) {
+        if (std::all_of(others.begin(), others.end(), [member](const Set* set) { return set->contains(member); })) {
+            fn(member);
+        }
+    });
+}
+
+void Set::unite(std::span<const Set* const> sets, const MemberFn& fn) {
+    if (allIntsets(sets)) {
+        std::vector<int64_t> result;
+        for (const Set* set : sets) {
+            if (set != nullptr) {
+                set->ints_.forEach([&result](int64_t value) { result.push_back(value); });
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        emitIntegers(result, fn);
+        return;
+    }
+    Set result;
+    for (const Set* set : sets) {
+        if (set != nullptr) {
+            set->forEach([&result](std::string_view member) { result.add(member, DEFAULT_MAX_INTSET_ENTRIES); });
+        }
+    }
+    result.forEach(fn);
+}
+
+void Set::difference(std::span<const Set* const> sets, const MemberFn& fn) {
+    if (sets.empty() || sets[0] == nullptr) {
+        return;
+    }
+    auto others = sets.subspan(1);
+    sets[0]->forEach([&](std::string_view member) {
+        if (std::none_of(others.begin(), others.end(),
+                         [member](const Set* set) { return set != nullptr && set->contains(member); })) {
+            fn(member);
+        }
+    });
+}
+
+} // namespace redis
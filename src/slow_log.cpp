@@ -0,0 +1,88 @@
+#include "redis/slow_log.hpp"
+#include "redis/protocol.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+
+namespace {
+    std::atomic<uint64_t> next_id{0};
+}
+
+namespace redis {
+
+SlowLog::SlowLog(size_t max_length) : entries_(max_length), next_(0), length_(0) {
+}
+
+void SlowLog::add(CommandArgsSpan args, uint64_t micros) {
+    if (entries_.empty()) {
+        return;
+    }
+    Entry& entry = entries_[next_];
+    next_ = (next_ + 1) % entries_.size();
+    length_ = std::min(length_ + 1, entries_.size());
+    entry.id = next_id.fetch_add(1, std::memory_order_relaxed);
+    entry.time = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    entry.micros = micros;
+    entry.argc = args.size();
+    entry.kept = args.size() > MAX_ARGS ? MAX_ARGS - 1 : args.size();
+    entry.bytes.clear();
+    for (size_t i = 0; i < entry.kept; i++) {
+        entry.sizes[i] = args[i].size();
+        entry.bytes.append(args[i].substr(0, MAX_ARG_BYTES));
+    }
+}
+
+size_t SlowLog::length() const {
+    return length_;
+}
+
+const SlowLog::Entry& SlowLog::operator[](size_t age) const {
+    return entries_[(next_ + entries_.size() - 1 - age) % entries_.size()];
+}
+
+void SlowLog::reset() {
+    length_ = 0;
+}
+
+void SlowLog::setMaxLength(size_t max_length) {
+    if (max_length == entries_.size()) {
+        return;
+    }
+    std::vector<Entry> entries(max_length);
+    size_t kept = std::min(length_, max_length);
+    // Oldest first, so that the newest ends up just before next_
+    for (size_t i = 0; i < kept; i++) {
+        entries[i] = std::move(entries_[(next_ + entries_.size() - kept + i) % entries_.size()]);
+    }
+    entries_ = std::move(entries);
+    next_ = max_length == 0 ? 0 : kept % max_length;
+    length_ = kept;
+}
+
+void SlowLog::appendReply(std::string& out, const Entry& entry) {
+    Protocol::appendArrayHeader(out, 6);
+    out += Protocol::serializeInteger(static_cast<int64_t>(entry.id));
+    out += Protocol::serializeInteger(entry.time);
+    out += Protocol::serializeInteger(static_cast<int64_t>(entry.micros));
+    Protocol::appendArrayHeader(out, entry.kept + (entry.argc > entry.kept ? 1 : 0));
+    std::string_view bytes = entry.bytes;
+    for (size_t i = 0; i < entry.kept; i++) {
+        size_t stored = std::min(entry.sizes[i], MAX_ARG_BYTES);
+        std::string_view arg = bytes.substr(0, stored);
+        bytes.remove_prefix(stored);
+        if (entry.sizes[i] > stored) {
+            Protocol::appendBulkString(out, std::format("{}... ({} more bytes)", arg, entry.sizes[i] - stored));
+        } else {
+            Protocol::appendBulkString(out, arg);
+        }
+    }
+    if (entry.argc > entry.kept) {
+        Protocol::appendBulkString(out, std::format("... ({} more arguments)", entry.argc - entry.kept));
+    }
+    Protocol::appendBulkString(out, "");
+    Protocol::appendBulkString(out, "");
+}
+
+} // namespace redis
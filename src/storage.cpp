@@ -1,53 +1,1029 @@
 #include "redis/storage.hpp"
+#include "redis/lazy_free.hpp"
+#include "redis/memory.hpp"
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <span>
+#include <vector>
+
+namespace {
+    // Keys sampled per round of the active expire cycle
+    const constexpr size_t EXPIRE_SAMPLE_SIZE = 20;
+    // Empty groups skipped per round before giving up on filling the sample
+    const constexpr size_t EXPIRE_MAX_EMPTY_GROUPS = EXPIRE_SAMPLE_SIZE * 10;
+    // Another round runs only if more than a quarter of the sample had expired
+    const constexpr size_t EXPIRE_REPEAT_THRESHOLD = EXPIRE_SAMPLE_SIZE / 4;
+    // Groups moved between two checks of the rehash time budget
+    const constexpr size_t REHASH_GROUPS_PER_STEP = 100;
+    // Keys of a batch hashed and prefetched before the first of them is looked
+    // up: enough to cover a memory access, few enough that the prefetched
+    // lines are still cached when used
+    const constexpr size_t PREFETCH_WINDOW = 16;
+    // Longest string APPEND and SETRANGE may build, Redis' proto-max-bulk-len
+    const constexpr size_t MAX_STRING_SIZE = 512 * 1024 * 1024;
+    // Cursor positions a SCAN call may visit per key it was asked for, so
+    // that a sparse keyspace does not make one call walk all of it
+    const constexpr size_t SCAN_POSITIONS_PER_KEY = 10;
+    // Expired keys RANDOMKEY removes before giving up on finding a live one
+    const constexpr size_t RANDOM_KEY_TRIES = 100;
+    // Eviction candidates kept between evictions, as in Redis
+    const constexpr size_t EVICTION_POOL_SIZE = 16;
+    // LFU counter of a new key, so that it is not evicted before it had a
+    // chance to be accessed again
+    const constexpr uint8_t LFU_INIT_VAL = 5;
+    // How slowly the LFU counter grows: 10 saturates it at about a million
+    // accesses
+    const constexpr double LFU_LOG_FACTOR = 10;
+}
 
 namespace redis {
 
-Storage::Storage() {
+Storage::Storage()
+    : expire_cursor_(0), defrag_cursor_(0), changes_(0), max_intset_entries_(Set::DEFAULT_MAX_INTSET_ENTRIES),
+      random_(std::random_device{}()), lazy_free_(nullptr), clock_(now() / 1000) {
 }
 
 Storage::~Storage() {
+    // What is still being freed is counted to account_
+    if (lazy_free_ != nullptr) {
+        lazy_free_->drain();
+    }
+}
+
+int64_t Storage::now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+Object::Ptr* Storage::find(std::string_view key) {
+    return find(key, data_.hash(key));
+}
+
+Object::Ptr* Storage::find(std::string_view key, size_t hash) {
+    Object::Ptr* object = data_.find(key, hash);
+    if (object == nullptr) {
+        return nullptr;
+    }
+    if (!expires_.empty()) {
+        const Expire* expire = expires_.find(key, hash);
+        if (expire != nullptr && expire->when <= now()) {
+            erase(key);
+            return nullptr;
+        }
+    }
+    touch(**object);
+    return object;
 }
 
-void Storage::set(const std::string& key, const std::string& value) {
-    // TODO: Implement SET operation
-    data_[key] = value;
+void Storage::erase(std::string_view key) {
+    // The expire entry borrows the key from the object, so it goes first
+    if (!expires_.empty()) {
+        expires_.erase(key);
+    }
+    data_.erase(key);
 }
 
-std::expected<std::optional<std::string>, std::string> Storage::get(const std::string& key) {
-    // TODO: Implement GET operation
-    auto it = data_.find(key);
-    if (it == data_.end()) {
+void Storage::unlink(std::string_view key) {
+    if (lazy_free_ == nullptr) {
+        erase(key);
+        return;
+    }
+    if (!expires_.empty()) {
+        expires_.erase(key);
+    }
+    std::optional<Object::Ptr> object = data_.take(key);
+    if (object.has_value() && (*object)->freeEffort() > LAZY_FREE_THRESHOLD) {
+        lazy_free_->free(std::move(*object));
+    }
+}
+
+Object* Storage::insert(std::string_view key, Object::Ptr object) {
+    stamp(*object);
+    return data_.tryEmplace(key, std::move(object)).first->get();
+}
+
+void Storage::replace(Object::Ptr& slot, Object::Ptr object) {
+    // The new value keeps the access clock of the old one, as in Redis
+    object->setAccess(slot->access());
+    if (!expires_.empty()) {
+        if (Expire* expire = expires_.find(object->key())) {
+            expire->object = object.get();
+        }
+    }
+    slot = std::move(object);
+}
+
+void Storage::set(std::string_view key, std::string_view value, std::optional<int64_t> expire_at) {
+    Object::Ptr object = Object::createString(key, value);
+    const Object* stored = object.get();
+    stamp(*object);
+    auto [slot, inserted] = data_.tryEmplace(key, std::move(object));
+    if (!inserted) {
+        if (!expire_at.has_value() && !expires_.empty()) {
+            expires_.erase(key);
+        }
+        replace(*slot, std::move(object));
+        touch(**slot);
+    }
+    if (expire_at.has_value()) {
+        *expires_.tryEmplace(key, stored, *expire_at).first = Expire{stored, *expire_at};
+    }
+    changes_++;
+}
+
+std::expected<std::optional<StringValue>, std::string> Storage::get(std::string_view key) {
+    Object::Ptr* object = find(key);
+    if (object == nullptr) {
         return std::nullopt;
     }
-    if (std::holds_alternative<std::string>(it->second)) {
-        return std::get<std::string>(it->second);
+    if ((*object)->type() == ValueType::STRING) {
+        return (*object)->string();
+    }
+    return std::unexpected(std::string(WRONGTYPE));
+}
+
+std::expected<int64_t, std::string> Storage::increment(std::string_view key, int64_t delta) {
+    Object::Ptr* slot = find(key);
+    if (slot == nullptr) {
+        insert(key, Object::createInteger(key, delta));
+        changes_++;
+        return delta;
+    }
+    Object& object = **slot;
+    if (object.type() != ValueType::STRING) {
+        return std::unexpected(std::string(WRONGTYPE));
+    }
+    // Strings that spell an integer are INT-encoded; APPEND and SETRANGE
+    // results may not be yet
+    std::optional<int64_t> current =
+        object.encoding() == Encoding::INT ? object.integer() : canonicalInteger(object.string().view());
+    if (!current.has_value()) {
+        return std::unexpected("ERR value is not an integer or out of range");
     }
-    return std::unexpected("Value is not a string");
+    int64_t value;
+    if (__builtin_add_overflow(*current, delta, &value)) {
+        return std::unexpected("ERR increment or decrement would overflow");
+    }
+    if (object.encoding() == Encoding::INT) {
+        object.setInteger(value);
+    } else {
+        replace(*slot, Object::createInteger(key, value));
+    }
+    changes_++;
+    return value;
+}
+
+std::expected<std::string, std::string> Storage::incrementFloat(std::string_view key, long double delta) {
+    Object::Ptr* slot = find(key);
+    long double value = 0;
+    if (slot != nullptr) {
+        if ((*slot)->type() != ValueType::STRING) {
+            return std::unexpected(std::string(WRONGTYPE));
+        }
+        StringValue current = (*slot)->string();
+        std::string_view digits = current.view();
+        auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (ec != std::errc() || end != digits.data() + digits.size() || std::isnan(value)) {
+            return std::unexpected("ERR value is not a valid float");
+        }
+    }
+    value += delta;
+    if (!std::isfinite(value)) {
+        return std::unexpected("ERR increment would produce NaN or Infinity");
+    }
+    // Fixed notation as Redis writes it, so that 10.5 + 0.1 reads "10.6"
+    std::string text = std::format("{:.17f}", value);
+    if (text.find('.') != std::string::npos) {
+        text.erase(text.find_last_not_of('0') + 1);
+        if (text.back() == '.') {
+            text.pop_back();
+        }
+    }
+    if (text == "-0") {
+        text = "0";
+    }
+    if (slot == nullptr) {
+        insert(key, Object::createString(key, text));
+    } else {
+        replace(*slot, Object::createString(key, text));
+    }
+    changes_++;
+    return text;
 }
 
-bool Storage::del(const std::string& key) {
-    // TODO: Implement DEL operation
-    return data_.erase(key) > 0;
+std::expected<size_t, std::string> Storage::append(std::string_view key, std::string_view value) {
+    Object::Ptr* slot = find(key);
+    if (slot == nullptr) {
+        insert(key, Object::createString(key, value));
+        changes_++;
+        return value.size();
+    }
+    if ((*slot)->type() != ValueType::STRING) {
+        return std::unexpected(std::string(WRONGTYPE));
+    }
+    size_t size = (*slot)->string().view().size();
+    if (size + value.size() > MAX_STRING_SIZE) {
+        return std::unexpected("ERR string exceeds maximum allowed size (proto-max-bulk-len)");
+    }
+    writeString(*slot, size, value);
+    changes_++;
+    return size + value.size();
 }
 
-bool Storage::exists(const std::string& key) {
-    // TODO: Implement EXISTS operation
-    return data_.contains(key);
+std::expected<size_t, std::string> Storage::setRange(std::string_view key, size_t offset, std::string_view value) {
+    Object::Ptr* slot = find(key);
+    if (slot != nullptr && (*slot)->type() != ValueType::STRING) {
+        return std::unexpected(std::string(WRONGTYPE));
+    }
+    size_t size = slot != nullptr ? (*slot)->string().view().size() : 0;
+    if (value.empty()) {
+        return size;
+    }
+    if (offset > MAX_STRING_SIZE - value.size()) {
+        return std::unexpected("ERR string exceeds maximum allowed size (proto-max-bulk-len)");
+    }
+    if (slot == nullptr) {
+        std::string padded(offset, '\0');
+        padded += value;
+        insert(key, Object::createString(key, padded));
+    } else {
+        writeString(*slot, offset, value);
+    }
+    changes_++;
+    return std::max(size, offset + value.size());
+}
+
+void Storage::writeString(Object::Ptr& slot, size_t offset, std::string_view value) {
+    size_t size = std::max(slot->string().view().size(), offset + value.size());
+    if (slot->encoding() == Encoding::RAW) {
+        std::span<char> bytes = slot->resizeRaw(size);
+        std::memcpy(bytes.data() + offset, value.data(), value.size());
+        return;
+    }
+    // Short strings and integers are rebuilt, at a cost bounded by the
+    // embedding limit; past it the result is RAW and grows in place
+    std::string result(slot->string().view());
+    result.resize(size, '\0');
+    result.replace(offset, value.size(), value);
+    replace(slot, Object::createString(slot->key(), result));
+}
+
+std::expected<Object*, std::string> Storage::find(std::string_view key, ValueType type) {
+    Object::Ptr* object = find(key);
+    if (object == nullptr) {
+        return nullptr;
+    }
+    if ((*object)->type() != type) {
+        return std::unexpected(std::string(WRONGTYPE));
+    }
+    return object->get();
+}
+
+std::expected<Object*, std::string> Storage::findOrCreate(std::string_view key, ValueType type,
+                                                          Object::Ptr (*create)(std::string_view)) {
+    auto found = find(key, type);
+    if (found.has_value() && *found == nullptr) {
+        return insert(key, create(key));
+    }
+    return found;
+}
+
+std::expected<size_t, std::string> Storage::push(std::string_view key, ListEnd end, CommandArgsSpan values) {
+    auto object = findOrCreate(key, ValueType::LIST, Object::createList);
+    if (!object.has_value()) {
+        return std::unexpected(object.error());
+    }
+    QuickList& list = (*object)->list();
+    for (std::string_view value : values) {
+        list.push(end, value);
+    }
+    changes_++;
+    return list.size();
+}
+
+std::expected<std::vector<std::string>, std::string> Storage::pop(std::string_view key, ListEnd end, size_t count) {
+    auto found = find(key, ValueType::LIST);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    std::vector<std::string> values;
+    if (*found == nullptr || count == 0) {
+        return values;
+    }
+    QuickList& list = (*found)->list();
+    values.reserve(std::min(count, list.size()));
+    while (values.size() < count && !list.empty()) {
+        values.push_back(list.pop(end));
+    }
+    if (list.empty()) {
+        erase(key);
+    }
+    changes_++;
+    return values;
+}
+
+std::expected<void, std::string> Storage::trim(std::string_view key, int64_t start, int64_t stop) {
+    auto found = find(key, ValueType::LIST);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    if (*found == nullptr) {
+        return {};
+    }
+    QuickList& list = (*found)->list();
+    auto range = list.range(start, stop);
+    if (!range.has_value()) {
+        erase(key);
+        changes_++;
+        return {};
+    }
+    size_t size = list.size();
+    if (range->first == 0 && range->second == size - 1) {
+        return {};
+    }
+    list.remove(ListEnd::TAIL, size - 1 - range->second);
+    list.remove(ListEnd::HEAD, range->first);
+    changes_++;
+    return {};
+}
+
+std::expected<const QuickList*, std::string> Storage::list(std::string_view key) {
+    auto found = find(key, ValueType::LIST);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    return *found == nullptr ? nullptr : &(*found)->list();
+}
+
+std::expected<size_t, std::string> Storage::hashSet(std::string_view key, CommandArgsSpan field_values) {
+    auto object = findOrCreate(key, ValueType::HASH, Object::createHash);
+    if (!object.has_value()) {
+        return std::unexpected(object.error());
+    }
+    Hash& hash = (*object)->hash();
+    size_t added = 0;
+    for (size_t i = 0; i + 1 < field_values.size(); i += 2) {
+        if (hash.set(field_values[i], field_values[i + 1], hash_limits_)) {
+            added++;
+        }
+    }
+    changes_++;
+    return added;
+}
+
+std::expected<size_t, std::string> Storage::hashDelete(std::string_view key, CommandArgsSpan fields) {
+    auto found = find(key, ValueType::HASH);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    if (*found == nullptr) {
+        return 0;
+    }
+    Hash& hash = (*found)->hash();
+    size_t deleted = 0;
+    for (std::string_view field : fields) {
+        if (hash.erase(field)) {
+            deleted++;
+        }
+    }
+    if (hash.size() == 0) {
+        erase(key);
+    }
+    if (deleted > 0) {
+        changes_++;
+    }
+    return deleted;
+}
+
+std::expected<int64_t, std::string> Storage::hashIncrement(std::string_view key, std::string_view field,
+                                                           int64_t delta) {
+    auto object = find(key, ValueType::HASH);
+    if (!object.has_value()) {
+        return std::unexpected(object.error());
+    }
+    int64_t value = 0;
+    if (*object != nullptr) {
+        if (auto current = (*object)->hash().get(field)) {
+            std::string_view digits = current->view();
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            if (ec != std::errc() || end != digits.data() + digits.size()) {
+                return std::unexpected("ERR hash value is not an integer");
+            }
+        }
+    }
+    if (__builtin_add_overflow(value, delta, &value)) {
+        return std::unexpected("ERR increment or decrement would overflow");
+    }
+    if (*object == nullptr) {
+        object = findOrCreate(key, ValueType::HASH, Object::createHash);
+    }
+    (*object)->hash().set(field, std::to_string(value), hash_limits_);
+    changes_++;
+    return value;
+}
+
+std::expected<const Hash*, std::string> Storage::hash(std::string_view key) {
+    auto found = find(key, ValueType::HASH);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    return *found == nullptr ? nullptr : &(*found)->hash();
+}
+
+void Storage::setHashLimits(const HashLimits& limits) {
+    hash_limits_ = limits;
+}
+
+const HashLimits& Storage::hashLimits() const {
+    return hash_limits_;
+}
+
+std::expected<size_t, std::string> Storage::setAdd(std::string_view key, CommandArgsSpan members) {
+    auto object = findOrCreate(key, ValueType::SET, Object::createSet);
+    if (!object.has_value()) {
+        return std::unexpected(object.error());
+    }
+    Set& set = (*object)->set();
+    size_t added = 0;
+    for (std::string_view member : members) {
+        if (set.add(member, max_intset_entries_)) {
+            added++;
+        }
+    }
+    if (added > 0) {
+        changes_++;
+    }
+    return added;
+}
+
+std::expected<size_t, std::string> Storage::setRemove(std::string_view key, CommandArgsSpan members) {
+    auto found = find(key, ValueType::SET);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    if (*found == nullptr) {
+        return 0;
+    }
+    Set& set = (*found)->set();
+    size_t removed = 0;
+    for (std::string_view member : members) {
+        if (set.remove(member)) {
+            removed++;
+        }
+    }
+    if (set.size() == 0) {
+        erase(key);
+    }
+    if (removed > 0) {
+        changes_++;
+    }
+    return removed;
+}
+
+std::expected<const Set*, std::string> Storage::getSet(std::string_view key) {
+    auto found = find(key, ValueType::SET);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    return *found == nullptr ? nullptr : &(*found)->set();
+}
+
+void Storage::setMaxIntsetEntries(size_t entries) {
+    max_intset_entries_ = entries;
+}
+
+size_t Storage::maxIntsetEntries() const {
+    return max_intset_entries_;
+}
+
+std::expected<Storage::ZAddResult, std::string> Storage::zsetAdd(
+    std::string_view key, std::span<const std::pair<double, std::string_view>> entries, ZAddCondition condition) {
+    // XX never creates the key
+    auto object = condition == ZAddCondition::XX ? find(key, ValueType::ZSET)
+                                                 : findOrCreate(key, ValueType::ZSET, Object::createZSet);
+    if (!object.has_value()) {
+        return std::unexpected(object.error());
+    }
+    ZAddResult result{0, 0};
+    if (*object == nullptr) {
+        return result;
+    }
+    ZSet& zset = (*object)->zset();
+    for (auto [score, member] : entries) {
+        std::optional<double> current = zset.score(member);
+        if ((condition == ZAddCondition::NX && current.has_value()) ||
+            (condition == ZAddCondition::XX && !current.has_value()) || current == score) {
+            continue;
+        }
+        zset.add(member, score, zset_limits_);
+        result.added += current.has_value() ? 0 : 1;
+        result.changed++;
+    }
+    if (zset.size() == 0) {
+        // NX or XX skipped every member of a new key
+        erase(key);
+    }
+    if (result.changed > 0) {
+        changes_++;
+    }
+    return result;
+}
+
+std::expected<size_t, std::string> Storage::zsetRemove(std::string_view key, CommandArgsSpan members) {
+    auto found = find(key, ValueType::ZSET);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    if (*found == nullptr) {
+        return 0;
+    }
+    ZSet& zset = (*found)->zset();
+    size_t removed = 0;
+    for (std::string_view member : members) {
+        if (zset.remove(member)) {
+            removed++;
+        }
+    }
+    if (zset.size() == 0) {
+        erase(key);
+    }
+    if (removed > 0) {
+        changes_++;
+    }
+    return removed;
+}
+
+std::expected<double, std::string> Storage::zsetIncrement(std::string_view key, std::string_view member,
+                                                          double delta) {
+    auto object = find(key, ValueType::ZSET);
+    if (!object.has_value()) {
+        return std::unexpected(object.error());
+    }
+    double score = delta;
+    if (*object != nullptr) {
+        score += (*object)->zset().score(member).value_or(0);
+    }
+    if (std::isnan(score)) {
+        return std::unexpected("ERR resulting score is not a number (NaN)");
+    }
+    if (*object == nullptr) {
+        object = findOrCreate(key, ValueType::ZSET, Object::createZSet);
+    }
+    (*object)->zset().add(member, score, zset_limits_);
+    changes_++;
+    return score;
+}
+
+std::expected<const ZSet*, std::string> Storage::zset(std::string_view key) {
+    auto found = find(key, ValueType::ZSET);
+    if (!found.has_value()) {
+        return std::unexpected(found.error());
+    }
+    return *found == nullptr ? nullptr : &(*found)->zset();
+}
+
+void Storage::setZSetLimits(const ZSetLimits& limits) {
+    zset_limits_ = limits;
+}
+
+const ZSetLimits& Storage::zsetLimits() const {
+    return zset_limits_;
+}
+
+bool Storage::del(std::string_view key) {
+    if (find(key) == nullptr) {
+        return false;
+    }
+    unlink(key);
+    changes_++;
+    return true;
+}
+
+bool Storage::exists(std::string_view key) {
+    return find(key) != nullptr;
+}
+
+template <typename Fn>
+void Storage::forEachPrefetched(CommandArgsSpan keys, size_t step, Fn&& fn) {
+    std::array<size_t, PREFETCH_WINDOW> hashes;
+    for (size_t start = 0; start < keys.size(); start += PREFETCH_WINDOW * step) {
+        size_t count = std::min(PREFETCH_WINDOW, (keys.size() - start + step - 1) / step);
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = data_.hash(keys[start + i * step]);
+            data_.prefetch(hashes[i]);
+            if (!expires_.empty()) {
+                expires_.prefetch(hashes[i]);
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            fn(start + i * step, hashes[i]);
+        }
+    }
+}
+
+void Storage::getMany(CommandArgsSpan keys, const std::function<void(const std::optional<StringValue>&)>& fn) {
+    forEachPrefetched(keys, 1, [&](size_t position, size_t hash) {
+        Object::Ptr* object = find(keys[position], hash);
+        if (object != nullptr && (*object)->type() == ValueType::STRING) {
+            fn((*object)->string());
+        } else {
+            fn(std::nullopt);
+        }
+    });
+}
+
+bool Storage::setMany(CommandArgsSpan key_values, bool only_if_none_exist) {
+    if (only_if_none_exist) {
+        bool any_exists = false;
+        forEachPrefetched(key_values, 2, [&](size_t position, size_t hash) {
+            any_exists = any_exists || find(key_values[position], hash) != nullptr;
+        });
+        if (any_exists) {
+            return false;
+        }
+    }
+    // set() hashes again, but finds the slots of the key in cache
+    forEachPrefetched(key_values, 2, [&](size_t position, size_t) {
+        set(key_values[position], key_values[position + 1]);
+    });
+    return true;
+}
+
+size_t Storage::delMany(CommandArgsSpan keys) {
+    size_t deleted = 0;
+    forEachPrefetched(keys, 1, [&](size_t position, size_t hash) {
+        if (find(keys[position], hash) != nullptr) {
+            unlink(keys[position]);
+            changes_++;
+            deleted++;
+        }
+    });
+    return deleted;
+}
+
+size_t Storage::existsMany(CommandArgsSpan keys) {
+    size_t existing = 0;
+    forEachPrefetched(keys, 1, [&](size_t position, size_t hash) {
+        existing += find(keys[position], hash) != nullptr ? 1 : 0;
+    });
+    return existing;
+}
+
+bool Storage::expireAt(std::string_view key, int64_t when) {
+    Object::Ptr* object = find(key);
+    if (object == nullptr) {
+        return false;
+    }
+    changes_++;
+    if (when <= now()) {
+        erase(key);
+        return true;
+    }
+    const Object* stored = object->get();
+    *expires_.tryEmplace(key, stored, when).first = Expire{stored, when};
+    return true;
+}
+
+bool Storage::persist(std::string_view key) {
+    if (find(key) == nullptr || !expires_.erase(key)) {
+        return false;
+    }
+    changes_++;
+    return true;
+}
+
+int64_t Storage::ttl(std::string_view key) {
+    if (find(key) == nullptr) {
+        return -2;
+    }
+    const Expire* expire = expires_.find(key);
+    if (expire == nullptr) {
+        return -1;
+    }
+    return std::max<int64_t>(expire->when - now(), 0);
+}
+
+std::optional<int64_t> Storage::expireTime(std::string_view key) {
+    if (find(key) == nullptr || expires_.empty()) {
+        return std::nullopt;
+    }
+    const Expire* expire = expires_.find(key);
+    if (expire == nullptr) {
+        return std::nullopt;
+    }
+    return expire->when;
+}
+
+uint64_t Storage::changes() const {
+    return changes_;
+}
+
+size_t Storage::activeExpireCycle(std::chrono::microseconds budget) {
+    auto start = std::chrono::steady_clock::now();
+    size_t removed = 0;
+    std::vector<std::string> expired;
+
+    while (!expires_.empty()) {
+        // Resume the scan where the last round stopped, so that every key gets
+        // sampled in turn. A round ends early when the scan wraps around.
+        int64_t current = now();
+        size_t sampled = 0;
+        size_t empty = 0;
+        do {
+            size_t visited = 0;
+            expire_cursor_ = expires_.scan(expire_cursor_, [&](std::string_view key, const Expire& expire) {
+                visited++;
+                if (expire.when <= current) {
+                    expired.emplace_back(key);
+                }
+            });
+            sampled += visited;
+            empty += visited == 0 ? 1 : 0;
+        } while (expire_cursor_ != 0 && sampled < EXPIRE_SAMPLE_SIZE && empty < EXPIRE_MAX_EMPTY_GROUPS);
+
+        for (const auto& key : expired) {
+            erase(key);
+        }
+        removed += expired.size();
+        bool repeat = expired.size() > EXPIRE_REPEAT_THRESHOLD;
+        expired.clear();
+        if (!repeat || std::chrono::steady_clock::now() - start >= budget) {
+            break;
+        }
+    }
+    return removed;
+}
+
+void Storage::incrementalRehash(std::chrono::microseconds budget) {
+    auto start = std::chrono::steady_clock::now();
+    while (data_.rehashStep(REHASH_GROUPS_PER_STEP) || expires_.rehashStep(REHASH_GROUPS_PER_STEP)) {
+        if (std::chrono::steady_clock::now() - start >= budget) {
+            break;
+        }
+    }
+}
+
+size_t Storage::activeDefragCycle(std::chrono::microseconds interval) {
+    const DefragSettings& settings = defrag_settings_;
+    size_t allocated = memory::used();
+    size_t active = memory::active();
+    if (!settings.enabled || data_.empty() || active <= allocated) {
+        return 0;
+    }
+    size_t wasted = active - allocated;
+    double percent = 100.0 * static_cast<double>(wasted) / static_cast<double>(allocated);
+    double lower = static_cast<double>(settings.threshold_lower);
+    double upper = static_cast<double>(settings.threshold_upper);
+    if (wasted < settings.ignore_bytes || percent < lower) {
+        return 0;
+    }
+    double progress = std::min((percent - lower) / std::max(upper - lower, 1.0), 1.0);
+    double effort = std::lerp(static_cast<double>(settings.cycle_min), static_cast<double>(settings.cycle_max), progress);
+    auto budget = std::chrono::duration<double, std::micro>(interval) * effort / 100;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t moved = 0;
+    do {
+        defrag_cursor_ = data_.scan(defrag_cursor_, [&](std::string_view key, Object::Ptr& object) {
+            // Found before the move: probing expires_ reads the key through
+            // the object it points to
+            Expire* expire = expires_.empty() ? nullptr : expires_.find(key);
+            if (Object::defragment(object)) {
+                moved++;
+                if (expire != nullptr) {
+                    expire->object = object.get();
+                }
+            }
+        });
+    } while (defrag_cursor_ != 0 && std::chrono::steady_clock::now() - start < budget);
+    return moved;
+}
+
+void Storage::setDefragSettings(const DefragSettings& settings) {
+    defrag_settings_ = settings;
+}
+
+const DefragSettings& Storage::defragSettings() const {
+    return defrag_settings_;
+}
+
+std::optional<size_t> Storage::memoryUsage(std::string_view key) {
+    Object::Ptr* object = find(key);
+    if (object == nullptr) {
+        return std::nullopt;
+    }
+    size_t usage = (*object)->memoryUsage() + data_.memoryUsage() / data_.size();
+    if (expires_.contains(key)) {
+        usage += expires_.memoryUsage() / expires_.size();
+    }
+    return usage;
+}
+
+bool Storage::restore(Object::Ptr object, std::optional<int64_t> expire_at) {
+    const Object* stored = object.get();
+    std::string_view key = stored->key();
+    stamp(*object);
+    if (!data_.tryEmplace(key, std::move(object)).second) {
+        return false;
+    }
+    if (expire_at.has_value()) {
+        expires_.tryEmplace(key, stored, *expire_at);
+    }
+    return true;
+}
+
+void Storage::reserve(size_t count) {
+    data_.reserve(count);
+}
+
+size_t Storage::scan(size_t cursor, size_t count,
+                     const std::function<void(std::string_view key, ValueType type)>& fn) {
+    int64_t current = expires_.empty() ? 0 : now();
+    size_t visited = 0;
+    size_t positions = 0;
+    do {
+        cursor = data_.scan(cursor, [&](std::string_view key, Object::Ptr& object) {
+            visited++;
+            if (!expires_.empty()) {
+                const Expire* expire = expires_.find(key);
+                if (expire != nullptr && expire->when <= current) {
+                    return;
+                }
+            }
+            fn(key, object->type());
+        });
+    } while (cursor != 0 && visited < count && ++positions < count * SCAN_POSITIONS_PER_KEY);
+    return cursor;
+}
+
+std::optional<std::string> Storage::randomKey() {
+    for (size_t tries = 0; tries < RANDOM_KEY_TRIES; tries++) {
+        auto key = data_.randomKey(random_());
+        if (!key.has_value()) {
+            return std::nullopt;
+        }
+        // Copied first: find() removes the key if it has expired
+        std::string copy(*key);
+        if (find(copy) != nullptr) {
+            return copy;
+        }
+    }
+    return std::nullopt;
 }
 
 size_t Storage::size() const {
     return data_.size();
 }
 
+size_t Storage::expiresSize() const {
+    return expires_.size();
+}
+
 void Storage::clear() {
+    expires_.clear();
     data_.clear();
+    changes_++;
 }
 
-ValueType Storage::getValueType(const std::string& key) const {
-    // TODO: Implement value type checking
-    return ValueType::NONE;
+void Storage::clearAsync() {
+    if (lazy_free_ == nullptr) {
+        clear();
+        return;
+    }
+    // The expire entries borrow their keys from the objects, so they must
+    // go first: a pair destroys its second member first
+    lazy_free_->free(std::make_pair(std::move(data_), std::move(expires_)));
+    changes_++;
 }
 
-} // namespace redis
+void Storage::setLazyFree(LazyFree* lazy_free) {
+    lazy_free_ = lazy_free;
+}
+
+void Storage::setMemoryLimits(const MemoryLimits& limits) {
+    if (limits.policy != memory_limits_.policy) {
+        eviction_pool_.clear();
+    }
+    memory_limits_ = limits;
+    memory_limits_.samples = std::max<size_t>(limits.samples, 1);
+}
+
+const MemoryLimits& Storage::memoryLimits() const {
+    return memory_limits_;
+}
+
+memory::Account& Storage::account() {
+    return account_;
+}
+
+void Storage::refreshClock(int64_t now) {
+    clock_ = now / 1000;
+}
+
+void Storage::stamp(Object& object) {
+    if (memory_limits_.policy == EvictionPolicy::ALLKEYS_LRU) {
+        object.setAccess(static_cast<uint16_t>(clock_));
+    } else if (memory_limits_.policy == EvictionPolicy::ALLKEYS_LFU) {
+        object.setAccess(static_cast<uint16_t>((clock_ / 60 & 0xff) << 8 | LFU_INIT_VAL));
+    }
+}
+
+void Storage::touch(Object& object) {
+    if (memory_limits_.policy == EvictionPolicy::ALLKEYS_LRU) {
+        // Seconds, wrapping every 18 hours: keys idle for longer are seen as
+        // idle for less
+        object.setAccess(static_cast<uint16_t>(clock_));
+    } else if (memory_limits_.policy == EvictionPolicy::ALLKEYS_LFU) {
+        // The low byte counts accesses logarithmically, the high one holds
+        // the minute of the last decay
+        uint8_t counter = frequency(object);
+        if (counter < UINT8_MAX) {
+            double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+            if (std::generate_canonical<double, 64>(random_) < 1 / (base * LFU_LOG_FACTOR + 1)) {
+                counter++;
+            }
+        }
+        object.setAccess(static_cast<uint16_t>((clock_ / 60 & 0xff) << 8 | counter));
+    }
+}
+
+uint8_t Storage::frequency(const Object& object) const {
+    // One point lost per minute. The minutes wrap every 256, which a key
+    // left alone for that long has lost all its points to anyway, unless it
+    // had more than 256.
+    auto counter = static_cast<uint8_t>(object.access() & 0xff);
+    auto elapsed = static_cast<uint8_t>(clock_ / 60 - (object.access() >> 8));
+    return counter > elapsed ? counter - elapsed : 0;
+}
 
+std::optional<std::string> Storage::evictionCandidate() {
+    bool volatile_only = memory_limits_.policy == EvictionPolicy::VOLATILE_TTL;
+    auto consider = [this](std::string_view key, uint64_t score) {
+        auto same = std::ranges::find(eviction_pool_, key, &EvictionCandidate::key);
+        if (same != eviction_pool_.end()) {
+            eviction_pool_.erase(same);
+        } else if (eviction_pool_.size() == EVICTION_POOL_SIZE) {
+            if (score <= eviction_pool_.front().score) {
+                return;
+            }
+            eviction_pool_.erase(eviction_pool_.begin());
+        }
+        auto position = std::ranges::upper_bound(eviction_pool_, score, {}, &EvictionCandidate::score);
+        eviction_pool_.insert(position, EvictionCandidate{std::string(key), score});
+    };
+    for (;;) {
+        if (volatile_only ? expires_.empty() : data_.empty()) {
+            return std::nullopt;
+        }
+        if (volatile_only) {
+            expires_.sample(random_(), memory_limits_.samples, [&](std::string_view key, const Expire& expire) {
+                consider(key, UINT64_MAX - static_cast<uint64_t>(expire.when));
+            });
+        } else {
+            bool lru = memory_limits_.policy == EvictionPolicy::ALLKEYS_LRU;
+            data_.sample(random_(), memory_limits_.samples, [&](std::string_view key, const Object::Ptr& object) {
+                consider(key, lru ? static_cast<uint16_t>(clock_ - object->access()) : UINT8_MAX - frequency(*object));
+            });
+        }
+        // Scores may be stale, but keys must still be there
+        while (!eviction_pool_.empty()) {
+            std::string key = std::move(eviction_pool_.back().key);
+            eviction_pool_.pop_back();
+            if (volatile_only ? expires_.contains(key) : data_.contains(key)) {
+                return key;
+            }
+        }
+    }
+}
+
+bool Storage::evict(const std::function<void(std::string_view key)>& fn) {
+    if (memory_limits_.max_memory == 0) {
+        return true;
+    }
+    // A shard of several goes by its own memory, so that it never evicts
+    // its keys to make room for another shard's
+    size_t shards = std::max<size_t>(memory_limits_.shards, 1);
+    size_t limit = memory_limits_.max_memory / shards;
+    auto used = [this, shards] {
+        return shards == 1 ? memory::used() : account_.used();
+    };
+    while (used() > limit) {
+        if (memory_limits_.policy == EvictionPolicy::NOEVICTION) {
+            return false;
+        }
+        auto key = evictionCandidate();
+        if (!key.has_value()) {
+            return false;
+        }
+        fn(*key);
+        erase(*key);
+        changes_++;
+    }
+    return true;
+}
+
+} // namespace redis
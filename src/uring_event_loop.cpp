@@ -0,0 +1,326 @@
+#include "redis/uring_event_loop.hpp"
+#include "redis/log.hpp"
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <unistd.h>
+
+const constexpr uint16_t BUFFER_GROUP = 0;
+
+namespace {
+    // user_data layout: operation in the top byte, the low 24 bits of the
+    // connection id next (so a completion for a closed connection is not
+    // applied to a new one that reused its descriptor), the socket at the bottom
+    uint64_t encode(uint8_t operation, uint64_t connection_id, int fd) {
+        return (static_cast<uint64_t>(operation) << 56) |
+               ((connection_id & 0xffffff) << 32) |
+               static_cast<uint32_t>(fd);
+    }
+}
+
+namespace redis {
+
+UringEventLoop::UringEventLoop(size_t index, const std::vector<std::unique_ptr<EventLoop>>& shards,
+                               Persistence& persistence)
+    : EventLoop(index, shards, persistence) {
+}
+
+UringEventLoop::~UringEventLoop() {
+    // run() waited for the sends and receives; what is left in flight uses
+    // no memory of ours
+    ring_.reset();
+}
+
+void UringEventLoop::listen(const std::string& host, int port) {
+    server_socket_ = listenSocket(host, port);
+}
+
+void UringEventLoop::run(const std::atomic<bool>& running, int stop_fd) {
+    // The ring is created on the thread that submits to it
+    ring_ = std::make_unique<IoUring>(RING_ENTRIES);
+    ring_->setupBuffers(BUFFER_GROUP, RECV_BUFFERS, RECV_BUFFER_SIZE);
+    armAccept();
+    armPoll(wakeup_fd_, Operation::WAKEUP);
+    armPoll(stop_fd, Operation::STOP);
+
+    while (running) {
+        ring_->submitAndWait(CRON_INTERVAL_MS);
+        iterationStarted();
+        ring_->forEachCompletion([this](const io_uring_cqe& cqe) {
+            handleCompletion(cqe);
+        });
+        cron();
+        // The sends queued by this iteration are submitted by the next wait,
+        // after the commands they answer have been logged
+        flushAppendOnly();
+        iterationFinished();
+    }
+    // On the loop's thread: the ring takes submissions from no other
+    cancelRequests();
+}
+
+std::string_view UringEventLoop::backendName() const {
+    return "io_uring";
+}
+
+void UringEventLoop::flush(int client_socket, ClientConnection& connection) {
+    auto& state = *sends_[client_socket];
+    auto& output = connection.output();
+    if (state.in_flight || output.empty()) {
+        return;
+    }
+    std::memset(&state.message, 0, sizeof(state.message));
+    state.message.msg_iov = state.iov;
+    state.message.msg_iovlen = output.gather(state.iov, OutputBuffer::MAX_IOV);
+    state.in_flight = true;
+
+    if (ring_->submissionQueueFull()) {
+        // The send is about to be submitted early, ahead of the end of the
+        // iteration: log the commands it answers first
+        flushAppendOnly();
+    }
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = client_socket;
+    sqe->addr = reinterpret_cast<uint64_t>(&state.message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = encode(static_cast<uint8_t>(Operation::SEND), connection.id(), client_socket);
+}
+
+void UringEventLoop::armAccept() {
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server_socket_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = encode(static_cast<uint8_t>(Operation::ACCEPT), 0, server_socket_);
+}
+
+void UringEventLoop::armRecv(int client_socket, uint64_t connection_id) {
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client_socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = encode(static_cast<uint8_t>(Operation::RECV), connection_id, client_socket);
+    receiving_++;
+}
+
+void UringEventLoop::armPoll(int fd, Operation operation) {
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = encode(static_cast<uint8_t>(operation), 0, fd);
+}
+
+void UringEventLoop::cancelRequests() {
+    // Sends in flight read from connection output buffers and receives write
+    // into the ring's buffers, all of which go away with the loop: end every
+    // one and wait until the kernel is done with it
+    size_t sending = 0;
+    auto cancel = [this, &sending](uint64_t connection_id, int client_socket) {
+        io_uring_sqe* sqe = ring_->getSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = encode(static_cast<uint8_t>(Operation::SEND), connection_id, client_socket);
+        sqe->user_data = encode(static_cast<uint8_t>(Operation::CANCEL), connection_id, client_socket);
+        sending++;
+    };
+    for (const auto& [client_socket, connection] : connections_) {
+        ::shutdown(client_socket, SHUT_RDWR);
+        if (sends_[client_socket]->in_flight) {
+            cancel(connection->id(), client_socket);
+        }
+    }
+    for (const auto& [id, closing] : closing_) {
+        cancel(id, closing.connection->socket());
+    }
+    while (sending > 0 || receiving_ > 0) {
+        ring_->submitAndWait(CRON_INTERVAL_MS);
+        ring_->forEachCompletion([this, &sending](const io_uring_cqe& cqe) {
+            // Cancelled or not, a request is done once it completes for good
+            auto operation = static_cast<Operation>(cqe.user_data >> 56);
+            if (operation == Operation::SEND) {
+                sending--;
+            } else if (operation == Operation::RECV && !(cqe.flags & IORING_CQE_F_MORE)) {
+                receiving_--;
+            }
+        });
+    }
+}
+
+void UringEventLoop::handleCompletion(const io_uring_cqe& cqe) {
+    auto operation = static_cast<Operation>(cqe.user_data >> 56);
+    auto id_bits = static_cast<uint32_t>((cqe.user_data >> 32) & 0xffffff);
+    auto fd = static_cast<int>(cqe.user_data & 0xffffffff);
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    switch (operation) {
+        case Operation::ACCEPT:
+            onAccept(cqe.res, cqe.flags);
+            break;
+        case Operation::RECV:
+            if (!more) {
+                receiving_--;
+            }
+            onRecv(fd, id_bits, cqe.res, cqe.flags);
+            break;
+        case Operation::SEND:
+            onSend(fd, id_bits, cqe.res);
+            break;
+        case Operation::WAKEUP:
+            runTasks();
+            if (!more) {
+                armPoll(fd, Operation::WAKEUP);
+            }
+            break;
+        case Operation::STOP:
+            // The loop condition notices the shutdown
+            break;
+        case Operation::CANCEL:
+            break;
+    }
+}
+
+void UringEventLoop::onAccept(int result, uint32_t flags) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+        armAccept();
+    }
+    if (result < 0) {
+        REDIS_DEBUG("Accept failed: {}", strerror(-result));
+        return;
+    }
+    int client_socket = result;
+    REDIS_DEBUG("Accepted connection on shard {}, socket {}", index_, client_socket);
+    auto connection_id = next_connection_id_++;
+    connections_[client_socket] = std::make_unique<ClientConnection>(client_socket, *this, connection_id);
+    sends_[client_socket] = std::make_unique<SendState>();
+    armRecv(client_socket, connection_id);
+}
+
+void UringEventLoop::onRecv(int client_socket, uint32_t id_bits, int result, uint32_t flags) {
+    ClientConnection* connection = findConnection(client_socket, id_bits);
+    if (flags & IORING_CQE_F_BUFFER) {
+        auto buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (connection != nullptr && result > 0) {
+            REDIS_DEBUG("Received {} bytes from socket {}", result, client_socket);
+            connection->receive(ring_->buffer(buffer_id, result));
+        }
+        ring_->recycleBuffer(buffer_id);
+    }
+    if (connection == nullptr) {
+        return;
+    }
+    if (result == 0 || (result < 0 && result != -ENOBUFS && result != -ECANCELED)) {
+        REDIS_DEBUG("Client socket {} closed by peer", client_socket);
+        closeConnection(client_socket);
+        return;
+    }
+    bool ended = !(flags & IORING_CQE_F_MORE);
+    auto paused = paused_.find(client_socket);
+    if (paused != paused_.end()) {
+        if (ended) {
+            paused->second = true;
+            resumeRecv(client_socket, *connection);
+        }
+    } else if (connection->outputFull()) {
+        pauseRecv(client_socket, *connection, ended);
+    } else if (ended) {
+        // Out of buffers or the kernel ended the multishot receive
+        armRecv(client_socket, connection->id());
+    }
+    flush(client_socket, *connection);
+}
+
+void UringEventLoop::pauseRecv(int client_socket, ClientConnection& connection, bool ended) {
+    REDIS_DEBUG("Client socket {} stops receiving, {} reply bytes queued",
+                client_socket, connection.output().size());
+    paused_[client_socket] = ended;
+    if (ended) {
+        return;
+    }
+    // Whatever the kernel has received by then still arrives, and waits in
+    // the connection's input
+    io_uring_sqe* sqe = ring_->getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = encode(static_cast<uint8_t>(Operation::RECV), connection.id(), client_socket);
+    sqe->user_data = encode(static_cast<uint8_t>(Operation::CANCEL), connection.id(), client_socket);
+}
+
+void UringEventLoop::resumeRecv(int client_socket, ClientConnection& connection) {
+    auto paused = paused_.find(client_socket);
+    // Not before the cancelled receive is done, or two would deliver at once
+    if (paused == paused_.end() || !paused->second || connection.outputFull()) {
+        return;
+    }
+    // Run the commands that arrived while paused first; they may fill the
+    // output again
+    connection.receive({});
+    if (connection.outputFull()) {
+        return;
+    }
+    REDIS_DEBUG("Client socket {} receives again", client_socket);
+    paused_.erase(paused);
+    armRecv(client_socket, connection.id());
+}
+
+void UringEventLoop::onSend(int client_socket, uint32_t id_bits, int result) {
+    ClientConnection* connection = findConnection(client_socket, id_bits);
+    if (connection == nullptr) {
+        // Closed while the send was in flight; its buffers can go now
+        for (auto it = closing_.begin(); it != closing_.end(); ++it) {
+            if ((it->first & 0xffffff) == id_bits) {
+                closing_.erase(it);
+                break;
+            }
+        }
+        return;
+    }
+    sends_[client_socket]->in_flight = false;
+    if (result < 0) {
+        REDIS_DEBUG("Failed to send to socket {}: {}", client_socket, strerror(-result));
+        closeConnection(client_socket);
+        return;
+    }
+    // A short send leaves the tail queued for the next sendmsg
+    connection->output().consume(result);
+    if (connection->readyToClose()) {
+        REDIS_DEBUG("Closing client socket {} after a protocol error", client_socket);
+        closeConnection(client_socket);
+        return;
+    }
+    resumeRecv(client_socket, *connection);
+    flush(client_socket, *connection);
+}
+
+void UringEventLoop::closeConnection(int client_socket) {
+    auto it = connections_.find(client_socket);
+    if (it == connections_.end()) {
+        return;
+    }
+    auto connection = std::move(it->second);
+    connections_.erase(it);
+    bump(closed_connections_);
+    auto send = std::move(sends_[client_socket]);
+    sends_.erase(client_socket);
+    paused_.erase(client_socket);
+    // Shutting the socket down also ends its multishot receive
+    ::shutdown(client_socket, SHUT_RDWR);
+    connection->close();
+    if (send->in_flight) {
+        auto id = connection->id();
+        closing_[id] = ClosingConnection{std::move(connection), std::move(send)};
+    }
+}
+
+ClientConnection* UringEventLoop::findConnection(int client_socket, uint32_t id_bits) {
+    auto it = connections_.find(client_socket);
+    if (it == connections_.end() || (it->second->id() & 0xffffff) != id_bits) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+} // namespace redis
@@ -0,0 +1,513 @@
+#include "redis/zset.hpp"
+#include "redis/dict.hpp"
+#include "redis/memory.hpp"
+#include "redis/varint.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+
+namespace {
+    // Entries are ordered by score, then by member
+    bool precedes(double score, std::string_view member, double other_score, std::string_view other_member) {
+        return score < other_score || (score == other_score && member < other_member);
+    }
+
+    // A packed entry: the score, then the member's length as a varint and
+    // its bytes
+    struct PackedEntry {
+        double score;
+        std::string_view member;
+        const char* end;
+    };
+
+    PackedEntry readPacked(const char* entry) {
+        double score;
+        std::memcpy(&score, entry, sizeof(score));
+        size_t length;
+        const char* data = redis::varint::read(entry + sizeof(score), length);
+        return {score, std::string_view(data, length), data + length};
+    }
+
+    size_t packedSize(std::string_view member) {
+        return sizeof(double) + redis::varint::size(member.size()) + member.size();
+    }
+
+    void writePacked(char* out, std::string_view member, double score) {
+        std::memcpy(out, &score, sizeof(score));
+        out = redis::varint::write(out + sizeof(score), member.size());
+        std::memcpy(out, member.data(), member.size());
+    }
+}
+
+namespace redis {
+
+std::string_view formatScore(double score, std::array<char, 32>& buffer) {
+    auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), score);
+    return std::string_view(buffer.data(), static_cast<size_t>(end - buffer.data()));
+}
+
+// Redis' zskiplist: every node is in the level 0 list and, with probability
+// 1/4 per level, in the lists above it. Each link records how many level 0
+// nodes it skips, so that a search adds up the rank of where it stops.
+class ZSet::SkipList {
+public:
+    static constexpr size_t MAX_HEIGHT = 32;
+
+    struct Node;
+    struct Level {
+        Node* forward;
+        size_t span;
+    };
+
+    // One allocation: this header, `height` levels and the member bytes
+    struct Node {
+        double score;
+        Node* backward;
+        uint32_t member_size;
+        uint8_t height;
+
+        Level* levels() {
+            return reinterpret_cast<Level*>(this + 1);
+        }
+        const Level* levels() const {
+            return reinterpret_cast<const Level*>(this + 1);
+        }
+        std::string_view member() const {
+            return std::string_view(reinterpret_cast<const char*>(levels() + height), member_size);
+        }
+        Node* next() const {
+            return levels()[0].forward;
+        }
+    };
+
+    SkipList() : header_(allocate(MAX_HEIGHT, {})), length_(0), height_(1) {
+    }
+
+    ~SkipList() {
+        index_.clear();
+        Node* node = header_->next();
+        memory::release(header_);
+        while (node != nullptr) {
+            Node* next = node->next();
+            memory::release(node);
+            node = next;
+        }
+    }
+
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    size_t size() const {
+        return length_;
+    }
+
+    Node* find(std::string_view member) const {
+        Node* const* node = index_.find(member);
+        return node != nullptr ? *node : nullptr;
+    }
+
+    void insert(std::string_view member, double score) {
+        Node* node = allocate(randomHeight(), member);
+        node->score = score;
+        link(node);
+        index_.tryEmplace(node->member(), node);
+    }
+
+    void erase(Node* node) {
+        index_.erase(node->member());
+        unlink(node);
+        memory::release(node);
+    }
+
+    void update(Node* node, double score) {
+        // A score that stays between the neighbours keeps the node in place
+        Node* next = node->next();
+        if ((node->backward == nullptr || node->backward->score < score) && (next == nullptr || next->score > score)) {
+            node->score = score;
+            return;
+        }
+        unlink(node);
+        node->score = score;
+        link(node);
+    }
+
+    // Position of a node in the list, from 0
+    size_t rank(const Node* target) const {
+        size_t rank = 0;
+        const Node* node = header_;
+        for (size_t level = height_; level-- > 0;) {
+            while (node->levels()[level].forward != nullptr && before(node->levels()[level].forward, target)) {
+                rank += node->levels()[level].span;
+                node = node->levels()[level].forward;
+            }
+        }
+        return rank;
+    }
+
+    // The node at `position`, which must be in the list
+    Node* at(size_t position) const {
+        // Spans count from the header, which is position 0 of the walk
+        size_t traversed = 0;
+        Node* node = header_;
+        for (size_t level = height_; level-- > 0;) {
+            while (node->levels()[level].forward != nullptr && traversed + node->levels()[level].span <= position + 1) {
+                traversed += node->levels()[level].span;
+                node = node->levels()[level].forward;
+            }
+            if (traversed == position + 1) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    // The first node with a score in `range` and its position, or nullptr
+    std::pair<Node*, size_t> first(const ScoreRange& range) const {
+        size_t rank = 0;
+        const Node* node = header_;
+        for (size_t level = height_; level-- > 0;) {
+            while (node->levels()[level].forward != nullptr && !range.aboveMin(node->levels()[level].forward->score)) {
+                rank += node->levels()[level].span;
+                node = node->levels()[level].forward;
+            }
+        }
+        Node* candidate = node->next();
+        if (candidate == nullptr || !range.belowMax(candidate->score)) {
+            return {nullptr, 0};
+        }
+        return {candidate, rank};
+    }
+
+    Node* head() const {
+        return header_->next();
+    }
+
+    size_t memoryUsage() const {
+        size_t usage = memory::usableSize(header_) + index_.memoryUsage();
+        for (const Node* node = head(); node != nullptr; node = node->next()) {
+            usage += memory::usableSize(node);
+        }
+        return usage;
+    }
+
+private:
+    // Index entries are a single pointer; the member is the node's
+    struct IndexTraits {
+        struct Entry {
+            Node* node;
+            Entry(std::string_view, Node* n) : node(n) {}
+        };
+        static std::string_view key(const Entry& entry) { return entry.node->member(); }
+        static Node*& value(Entry& entry) { return entry.node; }
+    };
+
+    Node* header_;
+    size_t length_;
+    size_t height_;
+    Dict<Node*, IndexTraits> index_;
+
+    static Node* allocate(size_t height, std::string_view member) {
+        void* block = memory::allocate(sizeof(Node) + height * sizeof(Level) + member.size());
+        auto* node = new (block) Node{0, nullptr, static_cast<uint32_t>(member.size()), static_cast<uint8_t>(height)};
+        for (size_t level = 0; level < height; level++) {
+            node->levels()[level] = {nullptr, 0};
+        }
+        if (!member.empty()) {
+            std::memcpy(node->levels() + height, member.data(), member.size());
+        }
+        return node;
+    }
+
+    static size_t randomHeight() {
+        thread_local std::minstd_rand random(std::random_device{}());
+        size_t height = 1;
+        while (height < MAX_HEIGHT && random() % 4 == 0) {
+            height++;
+        }
+        return height;
+    }
+
+    static bool before(const Node* node, const Node* target) {
+        return precedes(node->score, node->member(), target->score, target->member());
+    }
+
+    // Insert a node that is not in the list at the position of its score
+    void link(Node* node) {
+        Node* update[MAX_HEIGHT];
+        size_t rank[MAX_HEIGHT];
+        Node* current = header_;
+        for (size_t level = height_; level-- > 0;) {
+            rank[level] = level == height_ - 1 ? 0 : rank[level + 1];
+            while (current->levels()[level].forward != nullptr && before(current->levels()[level].forward, node)) {
+                rank[level] += current->levels()[level].span;
+                current = current->levels()[level].forward;
+            }
+            update[level] = current;
+        }
+        if (node->height > height_) {
+            for (size_t level = height_; level < node->height; level++) {
+                rank[level] = 0;
+                update[level] = header_;
+                header_->levels()[level].span = length_;
+            }
+            height_ = node->height;
+        }
+        for (size_t level = 0; level < node->height; level++) {
+            Level& previous = update[level]->levels()[level];
+            node->levels()[level].forward = previous.forward;
+            previous.forward = node;
+            node->levels()[level].span = previous.span - (rank[0] - rank[level]);
+            previous.span = rank[0] - rank[level] + 1;
+        }
+        for (size_t level = node->height; level < height_; level++) {
+            update[level]->levels()[level].span++;
+        }
+        node->backward = update[0] == header_ ? nullptr : update[0];
+        if (node->next() != nullptr) {
+            node->next()->backward = node;
+        }
+        length_++;
+    }
+
+    // Take a node out of the list without freeing it
+    void unlink(Node* node) {
+        Node* update[MAX_HEIGHT];
+        Node* current = header_;
+        for (size_t level = height_; level-- > 0;) {
+            while (current->levels()[level].forward != nullptr && before(current->levels()[level].forward, node)) {
+                current = current->levels()[level].forward;
+            }
+            update[level] = current;
+        }
+        for (size_t level = 0; level < height_; level++) {
+            Level& previous = update[level]->levels()[level];
+            if (previous.forward == node) {
+                previous.span += node->levels()[level].span - 1;
+                previous.forward = node->levels()[level].forward;
+            } else {
+                previous.span--;
+            }
+        }
+        if (node->next() != nullptr) {
+            node->next()->backward = node->backward;
+        }
+        while (height_ > 1 && header_->levels()[height_ - 1].forward == nullptr) {
+            height_--;
+        }
+        length_--;
+    }
+};
+
+ZSet::ZSet() : packed_(nullptr), packed_size_(0), packed_capacity_(0), packed_count_(0) {
+}
+
+ZSet::~ZSet() {
+    memory::release(packed_);
+}
+
+size_t ZSet::size() const {
+    return skiplist_ != nullptr ? skiplist_->size() : packed_count_;
+}
+
+const char* ZSet::findPacked(std::string_view member, size_t* position) const {
+    const char* entry = packed_;
+    const char* end = packed_ + packed_size_;
+    for (size_t i = 0; entry < end; i++) {
+        PackedEntry current = readPacked(entry);
+        if (current.member == member) {
+            if (position != nullptr) {
+                *position = i;
+            }
+            return entry;
+        }
+        entry = current.end;
+    }
+    return nullptr;
+}
+
+char* ZSet::splicePacked(size_t offset, size_t size, size_t replacement) {
+    size_t new_size = packed_size_ - size + replacement;
+    if (new_size > packed_capacity_) {
+        size_t capacity = std::max<size_t>(new_size, packed_capacity_ * 2);
+        auto* grown = static_cast<char*>(memory::reallocate(packed_, capacity));
+        packed_ = grown;
+        packed_capacity_ = static_cast<uint32_t>(capacity);
+    }
+    std::memmove(packed_ + offset + replacement, packed_ + offset + size, packed_size_ - offset - size);
+    packed_size_ = static_cast<uint32_t>(new_size);
+    return packed_ + offset;
+}
+
+void ZSet::insertPacked(std::string_view member, double score) {
+    const char* entry = packed_;
+    const char* end = packed_ + packed_size_;
+    while (entry < end) {
+        PackedEntry current = readPacked(entry);
+        if (precedes(score, member, current.score, current.member)) {
+            break;
+        }
+        entry = current.end;
+    }
+    writePacked(splicePacked(static_cast<size_t>(entry - packed_), 0, packedSize(member)), member, score);
+    packed_count_++;
+}
+
+void ZSet::removePacked(const char* entry) {
+    const char* end = readPacked(entry).end;
+    splicePacked(static_cast<size_t>(entry - packed_), static_cast<size_t>(end - entry), 0);
+    packed_count_--;
+}
+
+void ZSet::convert() {
+    auto skiplist = std::make_unique<SkipList>();
+    forEach([&skiplist](std::string_view member, double score) { skiplist->insert(member, score); });
+    skiplist_ = std::move(skiplist);
+    memory::release(packed_);
+    packed_ = nullptr;
+    packed_size_ = packed_capacity_ = packed_count_ = 0;
+}
+
+std::optional<double> ZSet::score(std::string_view member) const {
+    if (skiplist_ != nullptr) {
+        const SkipList::Node* node = skiplist_->find(member);
+        return node != nullptr ? std::optional(node->score) : std::nullopt;
+    }
+    const char* entry = findPacked(member);
+    return entry != nullptr ? std::optional(readPacked(entry).score) : std::nullopt;
+}
+
+bool ZSet::add(std::string_view member, double score, const ZSetLimits& limits) {
+    if (skiplist_ == nullptr) {
+        if (const char* entry = findPacked(member)) {
+            if (readPacked(entry).score != score) {
+                removePacked(entry);
+                insertPacked(member, score);
+            }
+            return false;
+        }
+        if (member.size() <= limits.max_packed_value && packed_count_ < limits.max_packed_entries) {
+            insertPacked(member, score);
+            return true;
+        }
+        convert();
+    }
+    if (SkipList::Node* node = skiplist_->find(member)) {
+        if (node->score != score) {
+            skiplist_->update(node, score);
+        }
+        return false;
+    }
+    skiplist_->insert(member, score);
+    return true;
+}
+
+bool ZSet::remove(std::string_view member) {
+    if (skiplist_ != nullptr) {
+        SkipList::Node* node = skiplist_->find(member);
+        if (node == nullptr) {
+            return false;
+        }
+        skiplist_->erase(node);
+        return true;
+    }
+    const char* entry = findPacked(member);
+    if (entry == nullptr) {
+        return false;
+    }
+    removePacked(entry);
+    return true;
+}
+
+std::optional<size_t> ZSet::rank(std::string_view member) const {
+    if (skiplist_ != nullptr) {
+        const SkipList::Node* node = skiplist_->find(member);
+        return node != nullptr ? std::optional(skiplist_->rank(node)) : std::nullopt;
+    }
+    size_t position;
+    return findPacked(member, &position) != nullptr ? std::optional(position) : std::nullopt;
+}
+
+std::optional<std::pair<size_t, size_t>> ZSet::range(int64_t start, int64_t stop) const {
+    auto size = static_cast<int64_t>(this->size());
+    if (start < 0) {
+        start = std::max<int64_t>(start + size, 0);
+    }
+    if (stop < 0) {
+        stop += size;
+    }
+    stop = std::min(stop, size - 1);
+    if (start > stop) {
+        return std::nullopt;
+    }
+    return std::pair{static_cast<size_t>(start), static_cast<size_t>(stop)};
+}
+
+void ZSet::forRange(size_t start, size_t stop, const EntryFn& fn) const {
+    if (skiplist_ != nullptr) {
+        const SkipList::Node* node = skiplist_->at(start);
+        for (size_t i = start; i <= stop; i++, node = node->next()) {
+            fn(node->member(), node->score);
+        }
+        return;
+    }
+    const char* entry = packed_;
+    for (size_t i = 0; i <= stop; i++) {
+        PackedEntry current = readPacked(entry);
+        if (i >= start) {
+            fn(current.member, current.score);
+        }
+        entry = current.end;
+    }
+}
+
+void ZSet::forScoreRange(const ScoreRange& range, size_t offset, size_t count, const EntryFn& fn) const {
+    if (skiplist_ != nullptr) {
+        auto [node, rank] = skiplist_->first(range);
+        if (node == nullptr || rank + offset >= skiplist_->size()) {
+            return;
+        }
+        // Jump over the offset by rank rather than one node at a time
+        if (offset > 0) {
+            node = skiplist_->at(rank + offset);
+        }
+        for (; node != nullptr && count > 0 && range.belowMax(node->score); node = node->next(), count--) {
+            fn(node->member(), node->score);
+        }
+        return;
+    }
+    const char* entry = packed_;
+    const char* end = packed_ + packed_size_;
+    while (entry < end && count > 0) {
+        PackedEntry current = readPacked(entry);
+        if (!range.belowMax(current.score)) {
+            break;
+        }
+        if (range.aboveMin(current.score)) {
+            if (offset > 0) {
+                offset--;
+            } else {
+                fn(current.member, current.score);
+                count--;
+            }
+        }
+        entry = current.end;
+    }
+}
+
+void ZSet::forEach(const EntryFn& fn) const {
+    if (size() > 0) {
+        forRange(0, size() - 1, fn);
+    }
+}
+
+size_t ZSet::memoryUsage() const {
+    if (skiplist_ == nullptr) {
+        return packed_ != nullptr ? memory::usableSize(packed_) : 0;
+    }
+    return sizeof(SkipList) + skiplist_->memoryUsage();
+}
+
+} // namespace redis
@@ -0,0 +1,312 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/aof.hpp"
+#include "redis/database.hpp"
+#include "redis/memory.hpp"
+#include "redis/protocol.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    // A log path in the temporary directory, removed afterwards
+    struct TempFile {
+        std::string path;
+
+        TempFile() : path((std::filesystem::temp_directory_path() / "test_aof.aof").string()) {
+            std::filesystem::remove(path);
+        }
+        ~TempFile() {
+            std::filesystem::remove(path);
+        }
+    };
+
+    std::string command(std::vector<std::string_view> args) {
+        std::string out;
+        Protocol::appendCommand(out, args);
+        return out;
+    }
+
+    std::vector<std::vector<std::string>> replay(const std::string& path) {
+        std::vector<std::vector<std::string>> commands;
+        AppendOnlyFile::replay(path, [&](CommandArgsSpan args) {
+            commands.emplace_back(args.begin(), args.end());
+        });
+        return commands;
+    }
+
+    std::string execute(Database& db, std::vector<std::string_view> args) {
+        return db.executeCommand(args);
+    }
+}
+
+TEST_CASE("AppendOnlyFile: Append and replay round trip", "[aof]") {
+    TempFile file;
+    {
+        AppendOnlyFile aof(file.path, FsyncPolicy::ALWAYS);
+        aof.append(command({"SET", "key", "value"}) + command({"DEL", "other"}));
+        aof.append(command({"SET", "binary", std::string_view("a\0b\r\n", 5)}));
+    }
+
+    auto commands = replay(file.path);
+    REQUIRE(commands.size() == 3);
+    REQUIRE(commands[0] == std::vector<std::string>{"SET", "key", "value"});
+    REQUIRE(commands[1] == std::vector<std::string>{"DEL", "other"});
+    REQUIRE(commands[2] == std::vector<std::string>{"SET", "binary", std::string("a\0b\r\n", 5)});
+}
+
+TEST_CASE("AppendOnlyFile: Missing file replays nothing", "[aof]") {
+    TempFile file;
+    REQUIRE(AppendOnlyFile::replay(file.path, [](CommandArgsSpan) { FAIL("unexpected command"); }) == 0);
+}
+
+TEST_CASE("AppendOnlyFile: Incomplete tail is truncated", "[aof]") {
+    TempFile file;
+    std::string complete = command({"SET", "a", "1"});
+    std::string partial = command({"SET", "b", "2"}).substr(0, 10);
+    {
+        std::ofstream out(file.path, std::ios::binary);
+        out << complete << partial;
+    }
+
+    auto commands = replay(file.path);
+    REQUIRE(commands.size() == 1);
+    REQUIRE(std::filesystem::file_size(file.path) == complete.size());
+
+    // Appending after the truncation continues a well-formed log
+    {
+        AppendOnlyFile aof(file.path, FsyncPolicy::NO);
+        aof.append(command({"SET", "b", "2"}));
+    }
+    REQUIRE(replay(file.path).size() == 2);
+}
+
+TEST_CASE("AppendOnlyFile: Malformed file throws", "[aof]") {
+    TempFile file;
+    {
+        std::ofstream out(file.path, std::ios::binary);
+        out << command({"SET", "a", "1"}) << "*1\r\n$x\r\n";
+    }
+    REQUIRE_THROWS_AS(replay(file.path), std::runtime_error);
+}
+
+TEST_CASE("AppendOnlyFile: Write commands recreates the keyspace", "[aof]") {
+    TempFile file;
+    Storage first;
+    Storage second;
+    int64_t expire_at = Storage::now() + 60000;
+    first.set("plain", "value");
+    first.set("number", "42");
+    second.set("expiring", "soon", expire_at);
+    AppendOnlyFile::writeCommands(file.path, {&first, &second});
+
+    Database db;
+    AppendOnlyFile::replay(file.path, [&](CommandArgsSpan args) { db.executeCommand(args); });
+    REQUIRE(db.storage().size() == 3);
+    REQUIRE(db.storage().get("plain").value().value() == "value");
+    REQUIRE(db.storage().get("number").value().value() == "42");
+    REQUIRE(db.storage().expireTime("expiring") == expire_at);
+    REQUIRE_FALSE(db.storage().expireTime("plain").has_value());
+}
+
+TEST_CASE("AppendOnlyFile: Write commands recreates lists", "[aof]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string> strings;
+    for (int i = 0; i < 200; i++) {
+        strings.push_back(std::to_string(i));
+    }
+    std::vector<std::string_view> values(strings.begin(), strings.end());
+    source.push("list", ListEnd::TAIL, values);
+    AppendOnlyFile::writeCommands(file.path, {&source});
+
+    // Long lists take several RPUSH commands
+    auto commands = replay(file.path);
+    REQUIRE(commands.size() == 4);
+    REQUIRE(commands[0][0] == "RPUSH");
+
+    Database db;
+    AppendOnlyFile::replay(file.path, [&](CommandArgsSpan args) { db.executeCommand(args); });
+    REQUIRE(execute(db, {"LLEN", "list"}) == ":200\r\n");
+    REQUIRE(execute(db, {"LINDEX", "list", "-1"}) == "$3\r\n199\r\n");
+}
+
+TEST_CASE("AppendOnlyFile: Write commands recreates hashes", "[aof]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string> strings;
+    for (int i = 0; i < 100; i++) {
+        strings.push_back("field" + std::to_string(i));
+        strings.push_back(std::to_string(i * 100000));
+    }
+    std::vector<std::string_view> pairs(strings.begin(), strings.end());
+    source.hashSet("hash", pairs);
+    AppendOnlyFile::writeCommands(file.path, {&source});
+
+    auto commands = replay(file.path);
+    REQUIRE(commands.size() == 2);
+    REQUIRE(commands[0][0] == "HSET");
+    REQUIRE(commands[0].size() == 2 + 64 * 2);
+
+    Database db;
+    AppendOnlyFile::replay(file.path, [&](CommandArgsSpan args) { db.executeCommand(args); });
+    REQUIRE(execute(db, {"HLEN", "hash"}) == ":100\r\n");
+    REQUIRE(execute(db, {"HGET", "hash", "field99"}) == "$7\r\n9900000\r\n");
+}
+
+TEST_CASE("AppendOnlyFile: Write commands recreates sets", "[aof]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string> strings;
+    for (int i = 0; i < 100; i++) {
+        strings.push_back(std::to_string(i * 1000));
+    }
+    std::vector<std::string_view> members(strings.begin(), strings.end());
+    source.setAdd("set", members);
+    AppendOnlyFile::writeCommands(file.path, {&source});
+
+    auto commands = replay(file.path);
+    REQUIRE(commands.size() == 2);
+    REQUIRE(commands[0][0] == "SADD");
+
+    Database db;
+    AppendOnlyFile::replay(file.path, [&](CommandArgsSpan args) { db.executeCommand(args); });
+    REQUIRE(execute(db, {"SCARD", "set"}) == ":100\r\n");
+    REQUIRE(execute(db, {"SISMEMBER", "set", "99000"}) == ":1\r\n");
+}
+
+TEST_CASE("AppendOnlyFile: Write commands recreates sorted sets", "[aof]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string> strings;
+    for (int i = 0; i < 100; i++) {
+        strings.push_back("player" + std::to_string(i));
+    }
+    std::vector<std::pair<double, std::string_view>> entries;
+    for (int i = 0; i < 100; i++) {
+        entries.emplace_back(i / 10.0, strings[i]);
+    }
+    source.zsetAdd("board", entries, Storage::ZAddCondition::ALWAYS);
+    AppendOnlyFile::writeCommands(file.path, {&source});
+
+    auto commands = replay(file.path);
+    REQUIRE(commands.size() == 2);
+    REQUIRE(commands[0][0] == "ZADD");
+
+    Database db;
+    AppendOnlyFile::replay(file.path, [&](CommandArgsSpan args) { db.executeCommand(args); });
+    REQUIRE(execute(db, {"ZCARD", "board"}) == ":100\r\n");
+    REQUIRE(execute(db, {"ZSCORE", "board", "player99"}) == "$3\r\n9.9\r\n");
+    REQUIRE(execute(db, {"ZRANK", "board", "player42"}) == ":42\r\n");
+}
+
+TEST_CASE("Database: Modifications are logged with absolute expiries", "[aof]") {
+    Database db;
+    execute(db, {"SET", "a", "1"});
+    REQUIRE(db.appendLog().empty());
+
+    db.enableAppendLog();
+    execute(db, {"GET", "a"});
+    execute(db, {"DEL", "missing"});
+    REQUIRE(db.appendLog().empty());
+
+    execute(db, {"SET", "b", "2"});
+    REQUIRE(db.appendLog() == command({"SET", "b", "2"}));
+    db.appendLog().clear();
+
+    execute(db, {"EXPIRE", "b", "100"});
+    auto expire_at = db.storage().expireTime("b");
+    REQUIRE(expire_at.has_value());
+    std::string timestamp = std::to_string(*expire_at);
+    REQUIRE(db.appendLog() == command({"PEXPIREAT", "b", timestamp}));
+    db.appendLog().clear();
+
+    // Lowercase names are recognised too
+    execute(db, {"set", "d", "4", "ex", "100"});
+    timestamp = std::to_string(db.storage().expireTime("d").value());
+    REQUIRE(db.appendLog() == command({"SET", "d", "4"}) + command({"PEXPIREAT", "d", timestamp}));
+    db.appendLog().clear();
+
+    execute(db, {"SET", "c", "3", "PX", "5000"});
+    timestamp = std::to_string(db.storage().expireTime("c").value());
+    REQUIRE(db.appendLog() == command({"SET", "c", "3"}) + command({"PEXPIREAT", "c", timestamp}));
+    db.appendLog().clear();
+
+    // An expiry in the past deletes the key
+    execute(db, {"PEXPIRE", "a", "-1"});
+    REQUIRE(db.appendLog() == command({"DEL", "a"}));
+    db.appendLog().clear();
+
+    execute(db, {"RPUSH", "list", "x", "y"});
+    execute(db, {"LPOP", "missing"});
+    execute(db, {"LPOP", "list"});
+    REQUIRE(db.appendLog() == command({"RPUSH", "list", "x", "y"}) + command({"LPOP", "list"}));
+    db.appendLog().clear();
+
+    execute(db, {"HSET", "hash", "f", "1"});
+    execute(db, {"HDEL", "hash", "missing"});
+    execute(db, {"HINCRBY", "hash", "f", "2"});
+    REQUIRE(db.appendLog() == command({"HSET", "hash", "f", "1"}) + command({"HINCRBY", "hash", "f", "2"}));
+    db.appendLog().clear();
+
+    execute(db, {"SADD", "set", "a"});
+    execute(db, {"SADD", "set", "a"});
+    execute(db, {"SREM", "set", "missing"});
+    execute(db, {"SINTER", "set", "other"});
+    REQUIRE(db.appendLog() == command({"SADD", "set", "a"}));
+    db.appendLog().clear();
+
+    execute(db, {"ZADD", "zset", "1", "a"});
+    execute(db, {"ZADD", "zset", "1", "a"});
+    execute(db, {"ZADD", "zset", "NX", "2", "a"});
+    execute(db, {"ZREM", "zset", "missing"});
+    execute(db, {"ZINCRBY", "zset", "2", "a"});
+    REQUIRE(db.appendLog() == command({"ZADD", "zset", "1", "a"}) + command({"ZINCRBY", "zset", "2", "a"}));
+    db.appendLog().clear();
+
+    // Float increments are logged as their result
+    execute(db, {"INCR", "counter"});
+    execute(db, {"INCRBYFLOAT", "counter", "0.5"});
+    execute(db, {"APPEND", "counter", "0"});
+    execute(db, {"SETRANGE", "counter", "0", ""});
+    REQUIRE(db.appendLog() == command({"INCR", "counter"}) + command({"SET", "counter", "1.5"}) +
+                                  command({"APPEND", "counter", "0"}));
+}
+
+TEST_CASE("Database: Evictions are logged as deletions", "[aof]") {
+    Database db;
+    db.storage().setMemoryLimits({0, EvictionPolicy::ALLKEYS_LRU});
+    db.enableAppendLog();
+    execute(db, {"SET", "a", "1"});
+    db.appendLog().clear();
+
+    // Just over the limit: evicting the only key is enough
+    db.storage().setMemoryLimits({memory::used() - 1, EvictionPolicy::ALLKEYS_LRU});
+    execute(db, {"SET", "b", "2"});
+    REQUIRE(db.appendLog() == command({"DEL", "a"}) + command({"SET", "b", "2"}));
+}
+
+TEST_CASE("Database: A shard logs its flushes for its own keys", "[aof]") {
+    Database single;
+    single.enableAppendLog();
+    execute(single, {"SET", "a", "1"});
+    single.appendLog().clear();
+    execute(single, {"FLUSHALL"});
+    REQUIRE(single.appendLog() == command({"FLUSHALL"}));
+
+    Database shard;
+    shard.enableAppendLog(2, 4);
+    execute(shard, {"SET", "a", "1"});
+    shard.appendLog().clear();
+    execute(shard, {"flushall", "ASYNC"});
+    execute(shard, {"SET", "a", "1"});
+    execute(shard, {"FLUSHDB"});
+    REQUIRE(shard.appendLog() == command({"FLUSHSHARD", "2", "4"}) + command({"SET", "a", "1"}) +
+                                     command({"FLUSHSHARD", "2", "4"}));
+    // Not a client command
+    REQUIRE(execute(shard, {"FLUSHSHARD", "2", "4"}).starts_with("-"));
+}
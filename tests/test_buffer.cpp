@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/buffer.hpp"
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace redis;
+
+TEST_CASE("InputBuffer: Append and consume", "[buffer]") {
+    InputBuffer buffer;
+    REQUIRE(buffer.size() == 0);
+
+    buffer.append("hello ");
+    buffer.append("world");
+    REQUIRE(buffer.readable() == "hello world");
+
+    buffer.consume(6);
+    REQUIRE(buffer.readable() == "world");
+
+    buffer.consume(5);
+    REQUIRE(buffer.size() == 0);
+}
+
+TEST_CASE("InputBuffer: Grows past the initial capacity", "[buffer]") {
+    InputBuffer buffer;
+    std::string data(InputBuffer::INITIAL_CAPACITY * 3 + 17, 'x');
+    buffer.append(data);
+    REQUIRE(buffer.readable() == data);
+    REQUIRE(buffer.capacity() >= data.size());
+}
+
+TEST_CASE("InputBuffer: Reserve keeps unconsumed bytes", "[buffer]") {
+    InputBuffer buffer;
+    buffer.append("*3\r\n$3\r\nSET\r\n");
+    buffer.consume(4);
+    buffer.reserve(1024 * 1024);
+    REQUIRE(buffer.capacity() >= 1024 * 1024);
+    REQUIRE(buffer.readable() == "$3\r\nSET\r\n");
+}
+
+TEST_CASE("InputBuffer: Releases a large idle buffer", "[buffer]") {
+    InputBuffer buffer;
+    buffer.reserve(InputBuffer::MAX_IDLE_CAPACITY * 2);
+    buffer.append("data");
+    buffer.consume(4);
+    REQUIRE(buffer.capacity() == InputBuffer::INITIAL_CAPACITY);
+}
+
+TEST_CASE("InputBuffer: Reads from a socket beyond free space", "[buffer]") {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int size = 256 * 1024;
+    REQUIRE(setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == 0);
+
+    std::string payload(InputBuffer::INITIAL_CAPACITY + 1000, 'a');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>('a' + i % 26);
+    }
+    REQUIRE(::write(fds[1], payload.data(), payload.size()) == static_cast<ssize_t>(payload.size()));
+
+    InputBuffer buffer;
+    while (buffer.size() < payload.size()) {
+        REQUIRE(buffer.readFrom(fds[0]) > 0);
+    }
+    REQUIRE(buffer.readable() == payload);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_CASE("OutputBuffer: Coalesces small replies", "[buffer]") {
+    OutputBuffer buffer;
+    REQUIRE(buffer.empty());
+
+    buffer.append(std::string("+OK\r\n"));
+    buffer.append(std::string(":1\r\n"));
+    REQUIRE(buffer.size() == 9);
+
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    REQUIRE(buffer.flushTo(fds[1]));
+    REQUIRE(buffer.empty());
+
+    char received[16];
+    REQUIRE(::read(fds[0], received, sizeof(received)) == 9);
+    REQUIRE(std::string(received, 9) == "+OK\r\n:1\r\n");
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_CASE("OutputBuffer: Keeps the unsent tail on a short write", "[buffer]") {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    REQUIRE(fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK) == 0);
+
+    std::string expected;
+    OutputBuffer buffer;
+    for (int i = 0; i < 2000; ++i) {
+        std::string reply = "$3\r\n" + std::to_string(100 + i % 900) + "\r\n";
+        expected += reply;
+        buffer.append(std::move(reply));
+    }
+    std::string large(OutputBuffer::CHUNK_SIZE * 64, 'z');
+    expected += large;
+    buffer.append(std::move(large));
+
+    // The socket cannot take everything at once
+    REQUIRE_FALSE(buffer.flushTo(fds[1]));
+    REQUIRE(buffer.size() > 0);
+
+    std::string received;
+    char chunk[64 * 1024];
+    while (received.size() < expected.size()) {
+        ssize_t n = ::read(fds[0], chunk, sizeof(chunk));
+        REQUIRE(n > 0);
+        received.append(chunk, n);
+        buffer.flushTo(fds[1]);
+    }
+    REQUIRE(buffer.empty());
+    REQUIRE(received == expected);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,185 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/command.hpp"
+#include "redis/database.hpp"
+#include "redis/memory.hpp"
+#include <string>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    std::string handleOk(const CommandArgsSpan&, Storage&) {
+        return "+OK\r\n";
+    }
+
+    constexpr CommandTable table(std::to_array<Command>({
+        {"GET", handleOk, 2, Command::READONLY | Command::FAST, {1, 1, 1, ReplyMerge::NONE}},
+        {"SET", handleOk, -3, Command::WRITE, {1, 1, 1, ReplyMerge::NONE}},
+        {"DEL", handleOk, -2, Command::WRITE, {1, -1, 1, ReplyMerge::SUM}},
+        {"SAVE", nullptr, 1, Command::SERVER, {0, 0, 0, ReplyMerge::NONE}},
+    }));
+
+    std::string execute(Database& db, std::vector<std::string_view> args) {
+        return db.executeCommand(args);
+    }
+}
+
+TEST_CASE("CommandTable: Finds names in any case", "[command]") {
+    REQUIRE(table.find("GET")->name == "GET");
+    REQUIRE(table.find("get")->name == "GET");
+    REQUIRE(table.find("dEl")->keys.merge == ReplyMerge::SUM);
+    REQUIRE(table.find("SAVE")->has(Command::SERVER));
+
+    REQUIRE(table.find("GETX") == nullptr);
+    REQUIRE(table.find("GE") == nullptr);
+    REQUIRE(table.find("") == nullptr);
+    REQUIRE(table.find("SAVES") == nullptr);
+}
+
+TEST_CASE("Command: Arity", "[command]") {
+    const Command* get = table.find("GET");
+    REQUIRE(get->acceptsArgs(2));
+    REQUIRE_FALSE(get->acceptsArgs(1));
+    REQUIRE_FALSE(get->acceptsArgs(3));
+    const Command* set = table.find("SET");
+    REQUIRE_FALSE(set->acceptsArgs(2));
+    REQUIRE(set->acceptsArgs(3));
+    REQUIRE(set->acceptsArgs(7));
+}
+
+TEST_CASE("Database: Every table entry is consistent", "[command]") {
+    for (std::string_view name : {"SET", "GET", "ZRANGEBYSCORE", "BGREWRITEAOF"}) {
+        REQUIRE(Database::command(name) != nullptr);
+    }
+    const Command* get = Database::command("get");
+    REQUIRE(get->has(Command::READONLY));
+    REQUIRE_FALSE(get->has(Command::WRITE));
+    REQUIRE(Database::command("lpush")->has(Command::WRITE));
+    REQUIRE(Database::command("bgsave")->handler == nullptr);
+    REQUIRE(Database::command("NOSUCHCOMMAND") == nullptr);
+}
+
+TEST_CASE("Database: Commands in any case", "[command]") {
+    Database db;
+    REQUIRE(execute(db, {"set", "key", "value"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"Get", "key"}) == "$5\r\nvalue\r\n");
+    REQUIRE(execute(db, {"get"}) == "-ERR wrong number of arguments for 'get' command\r\n");
+    REQUIRE(execute(db, {"get", "key", "extra"}) == "-ERR wrong number of arguments for 'get' command\r\n");
+    REQUIRE(execute(db, {"bogus", "key"}) == "-Unknown command: bogus\r\n");
+    // Run by the event loop, not the database
+    REQUIRE(execute(db, {"SAVE"}) == "-Unknown command: SAVE\r\n");
+}
+
+TEST_CASE("Database: MGET, MSET and MSETNX", "[command]") {
+    Database db;
+    REQUIRE(execute(db, {"MSET", "a", "1", "b", "2"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"MSET", "a", "1", "b"}) == "-ERR wrong number of arguments for 'mset' command\r\n");
+    REQUIRE(execute(db, {"LPUSH", "list", "x"}) == ":1\r\n");
+    REQUIRE(execute(db, {"MGET", "a", "missing", "list", "b"}) == "*4\r\n$1\r\n1\r\n$-1\r\n$-1\r\n$1\r\n2\r\n");
+    REQUIRE(execute(db, {"MSETNX", "c", "3", "a", "4"}) == ":0\r\n");
+    REQUIRE(execute(db, {"EXISTS", "c"}) == ":0\r\n");
+    REQUIRE(execute(db, {"MSETNX", "c", "3", "d", "4"}) == ":1\r\n");
+    REQUIRE(execute(db, {"DEL", "a", "c", "missing"}) == ":2\r\n");
+}
+
+TEST_CASE("Database: String commands", "[command]") {
+    Database db;
+    REQUIRE(execute(db, {"INCR", "n"}) == ":1\r\n");
+    REQUIRE(execute(db, {"INCRBY", "n", "10"}) == ":11\r\n");
+    REQUIRE(execute(db, {"DECRBY", "n", "20"}) == ":-9\r\n");
+    REQUIRE(execute(db, {"DECR", "n"}) == ":-10\r\n");
+    REQUIRE(execute(db, {"DECRBY", "n", "-9223372036854775808"}) == "-ERR decrement would overflow\r\n");
+    REQUIRE(execute(db, {"INCRBY", "n", "x"}) == "-ERR value is not an integer or out of range\r\n");
+    REQUIRE(execute(db, {"INCRBYFLOAT", "n", "0.25"}) == "$5\r\n-9.75\r\n");
+    REQUIRE(execute(db, {"INCRBYFLOAT", "n", "nan"}) == "-ERR value is not a valid float\r\n");
+
+    REQUIRE(execute(db, {"APPEND", "s", "Hello World"}) == ":11\r\n");
+    REQUIRE(execute(db, {"GETRANGE", "s", "0", "4"}) == "$5\r\nHello\r\n");
+    REQUIRE(execute(db, {"GETRANGE", "s", "-5", "-1"}) == "$5\r\nWorld\r\n");
+    REQUIRE(execute(db, {"GETRANGE", "s", "6", "100"}) == "$5\r\nWorld\r\n");
+    REQUIRE(execute(db, {"GETRANGE", "s", "5", "3"}) == "$0\r\n\r\n");
+    REQUIRE(execute(db, {"GETRANGE", "s", "-1", "-5"}) == "$0\r\n\r\n");
+    REQUIRE(execute(db, {"GETRANGE", "missing", "0", "-1"}) == "$0\r\n\r\n");
+    REQUIRE(execute(db, {"SETRANGE", "s", "6", "Redis"}) == ":11\r\n");
+    REQUIRE(execute(db, {"GET", "s"}) == "$11\r\nHello Redis\r\n");
+    REQUIRE(execute(db, {"SETRANGE", "s", "-1", "x"}) == "-ERR offset is out of range\r\n");
+}
+
+TEST_CASE("Database: Keyspace commands", "[command]") {
+    Database db;
+    REQUIRE(execute(db, {"DBSIZE"}) == ":0\r\n");
+    REQUIRE(execute(db, {"RANDOMKEY"}) == "$-1\r\n");
+    REQUIRE(execute(db, {"MSET", "user:1", "a", "user:2", "b", "item:1", "c"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"SADD", "user:set", "x"}) == ":1\r\n");
+    REQUIRE(execute(db, {"DBSIZE"}) == ":4\r\n");
+    REQUIRE(execute(db, {"KEYS", "item:*"}) == "*1\r\n$6\r\nitem:1\r\n");
+    REQUIRE(execute(db, {"KEYS", "user:[0-9]"}).starts_with("*2\r\n"));
+
+    REQUIRE(execute(db, {"SCAN", "0", "MATCH", "user:*", "TYPE", "set", "COUNT", "100"}) ==
+            "*2\r\n$1\r\n0\r\n*1\r\n$8\r\nuser:set\r\n");
+    REQUIRE(execute(db, {"SCAN", "x"}) == "-ERR invalid cursor\r\n");
+    REQUIRE(execute(db, {"SCAN", "0", "COUNT", "0"}) == "-ERR syntax error\r\n");
+    REQUIRE(execute(db, {"SCAN", "0", "MATCH"}) == "-ERR syntax error\r\n");
+    REQUIRE(execute(db, {"SCAN", "0", "TYPE", "stream"}) == "-ERR unknown type name 'stream'\r\n");
+    REQUIRE(execute(db, {"RANDOMKEY"}) != "$-1\r\n");
+
+    REQUIRE(execute(db, {"UNLINK", "user:1", "user:3"}) == ":1\r\n");
+    REQUIRE(execute(db, {"FLUSHALL", "now"}) == "-ERR syntax error\r\n");
+    REQUIRE(execute(db, {"FLUSHALL", "async"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"DBSIZE"}) == ":0\r\n");
+    REQUIRE(execute(db, {"SET", "k", "v"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"FLUSHDB", "SYNC"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"DBSIZE"}) == ":0\r\n");
+}
+
+TEST_CASE("Database: Writes over maxmemory", "[command]") {
+    Database db;
+    REQUIRE(execute(db, {"SET", "a", "1"}) == "+OK\r\n");
+    db.storage().setMemoryLimits({1, EvictionPolicy::NOEVICTION});
+    REQUIRE(execute(db, {"SET", "b", "2"}) == "-OOM command not allowed when used memory > 'maxmemory'.\r\n");
+    REQUIRE(execute(db, {"lpush", "list", "x"}).starts_with("-OOM"));
+    // Reads and commands that only free memory still run
+    REQUIRE(execute(db, {"GET", "a"}) == "$1\r\n1\r\n");
+    REQUIRE(execute(db, {"DEL", "a"}) == ":1\r\n");
+
+    db.storage().setMemoryLimits({memory::used() + (1 << 20), EvictionPolicy::NOEVICTION});
+    REQUIRE(execute(db, {"SET", "b", "2"}) == "+OK\r\n");
+}
+
+TEST_CASE("Database: Command statistics", "[command]") {
+    Database db;
+    auto entry = [&](std::string_view name) -> const CommandStats::Entry& {
+        return db.stats()[static_cast<size_t>(Database::command(name) - Database::commandTable().data())];
+    };
+    REQUIRE(execute(db, {"SET", "k", "v"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"get", "k"}) == "$1\r\nv\r\n");
+    REQUIRE(execute(db, {"GET"}).starts_with("-ERR"));
+    REQUIRE(execute(db, {"INCR", "k"}).starts_with("-ERR"));
+    REQUIRE(entry("SET").calls == 1);
+    REQUIRE(entry("GET").calls == 1);
+    REQUIRE(entry("GET").rejected == 1);
+    REQUIRE(entry("INCR").failed == 1);
+    REQUIRE(entry("GET").latency.total() == 1);
+    REQUIRE(db.stats().totalCalls() == 3);
+
+    db.resetStats();
+    REQUIRE(db.stats().totalCalls() == 0);
+    REQUIRE(entry("GET").rejected == 0);
+}
+
+TEST_CASE("Database: Slow log", "[command]") {
+    Database db;
+    REQUIRE(execute(db, {"SET", "k", "v"}) == "+OK\r\n");
+    REQUIRE(db.slowLog().length() == 0);
+    db.setSlowLogSettings({0, 2});
+    REQUIRE(execute(db, {"SET", "k", "v"}) == "+OK\r\n");
+    REQUIRE(execute(db, {"GET", "k"}) == "$1\r\nv\r\n");
+    REQUIRE(execute(db, {"GET"}).starts_with("-ERR"));
+    REQUIRE(db.slowLog().length() == 2);
+    REQUIRE(db.slowLog()[0].bytes == "GETk");
+
+    db.setSlowLogSettings({-1, 2});
+    db.slowLog().reset();
+    REQUIRE(execute(db, {"GET", "k"}) == "$1\r\nv\r\n");
+    REQUIRE(db.slowLog().length() == 0);
+}
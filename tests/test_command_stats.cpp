@@ -0,0 +1,81 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/command_stats.hpp"
+#include <cstdint>
+
+using namespace redis;
+
+TEST_CASE("LatencyHistogram: Buckets bound their values", "[command_stats]") {
+    uint64_t previous = 0;
+    for (uint64_t nanos : {0ULL, 1ULL, 7ULL, 15ULL, 16ULL, 17ULL, 100ULL, 1000ULL, 12345ULL, 1ULL << 30, (1ULL << 36) - 1}) {
+        size_t bucket = LatencyHistogram::bucketOf(nanos);
+        REQUIRE(bucket < LatencyHistogram::BUCKETS);
+        REQUIRE(bucket >= previous);
+        previous = bucket;
+        uint64_t limit = LatencyHistogram::bucketLimit(bucket);
+        REQUIRE(nanos < limit);
+        // Within 1/SUB_BUCKETS of the value
+        REQUIRE(limit - nanos <= nanos / LatencyHistogram::SUB_BUCKETS + 1);
+        REQUIRE((bucket == 0 || LatencyHistogram::bucketLimit(bucket - 1) <= nanos));
+    }
+    REQUIRE(LatencyHistogram::bucketOf(UINT64_MAX) == LatencyHistogram::BUCKETS - 1);
+}
+
+TEST_CASE("LatencyHistogram: Percentiles", "[command_stats]") {
+    LatencyHistogram histogram;
+    REQUIRE(histogram.percentile(50) == 0);
+    for (uint64_t nanos = 1; nanos <= 1000; nanos++) {
+        histogram.record(nanos * 1000);
+    }
+    REQUIRE(histogram.total() == 1000);
+    uint64_t median = histogram.percentile(50);
+    REQUIRE(median > 500'000);
+    REQUIRE(median <= 500'000 + 500'000 / LatencyHistogram::SUB_BUCKETS);
+    REQUIRE(histogram.percentile(100) > 1'000'000);
+    REQUIRE(histogram.percentile(99.9) <= histogram.percentile(100));
+
+    LatencyHistogram other;
+    other.merge(histogram);
+    other.merge(histogram);
+    REQUIRE(other.total() == 2000);
+    REQUIRE(other.percentile(50) == median);
+    other.reset();
+    REQUIRE(other.total() == 0);
+}
+
+TEST_CASE("CommandStats: Records, merges and resets", "[command_stats]") {
+    CommandStats stats(4);
+    stats.record(1, 100, false);
+    stats.record(1, 100, true);
+    stats.reject(2);
+    REQUIRE(stats[1].calls == 2);
+    REQUIRE(stats[1].failed == 1);
+    REQUIRE(stats[1].latency.total() == 2);
+    REQUIRE(stats[2].calls == 0);
+    REQUIRE(stats[2].rejected == 1);
+    REQUIRE(stats.totalCalls() == 2);
+
+    CommandStats total(4);
+    total.merge(stats);
+    total.merge(stats);
+    REQUIRE(total.totalCalls() == 4);
+    REQUIRE(total[1].nanos == 2 * stats[1].nanos);
+    REQUIRE(total[2].rejected == 2);
+
+    stats.reset();
+    REQUIRE(stats.totalCalls() == 0);
+    REQUIRE(stats[1].latency.total() == 0);
+    REQUIRE(total.totalCalls() == 4);
+}
+
+TEST_CASE("CommandClock: Commands of a batch share their timestamps", "[command_stats]") {
+    CommandClock clock;
+    clock.beginBatch();
+    uint64_t first = clock.start();
+    uint64_t took = clock.stop(first);
+    uint64_t second = clock.start();
+    REQUIRE(second == first + took);
+    took = clock.stop(second);
+    REQUIRE(clock.start() == second + took);
+    clock.endBatch();
+    REQUIRE(clock.start() >= second + took);
+}
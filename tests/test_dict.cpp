@@ -0,0 +1,323 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/dict.hpp"
+#include <set>
+#include <string>
+#include <unordered_map>
+
+using namespace redis;
+
+namespace {
+    std::string key(int i) {
+        return "key:" + std::to_string(i);
+    }
+}
+
+TEST_CASE("Dict: Insert, find and erase", "[dict]") {
+    Dict<std::string> dict;
+    REQUIRE(dict.empty());
+    REQUIRE(dict.find("missing") == nullptr);
+
+    SECTION("Insert new keys") {
+        auto [value, inserted] = dict.tryEmplace("key1", "value1");
+        REQUIRE(inserted);
+        REQUIRE(*value == "value1");
+        REQUIRE(dict.size() == 1);
+        REQUIRE(*dict.find("key1") == "value1");
+    }
+
+    SECTION("Existing keys are not replaced") {
+        dict.tryEmplace("key1", "value1");
+        auto [value, inserted] = dict.tryEmplace("key1", "value2");
+        REQUIRE_FALSE(inserted);
+        REQUIRE(*value == "value1");
+        REQUIRE(dict.size() == 1);
+    }
+
+    SECTION("Lookup by string_view into a larger buffer") {
+        dict.tryEmplace("key1", "value1");
+        std::string buffer = "xxkey1xx";
+        REQUIRE(dict.contains(std::string_view(buffer).substr(2, 4)));
+        REQUIRE_FALSE(dict.contains(std::string_view(buffer).substr(2, 3)));
+    }
+
+    SECTION("Erase") {
+        dict.tryEmplace("key1", "value1");
+        REQUIRE(dict.erase("key1"));
+        REQUIRE_FALSE(dict.erase("key1"));
+        REQUIRE(dict.find("key1") == nullptr);
+        REQUIRE(dict.empty());
+    }
+
+    SECTION("Empty key") {
+        dict.tryEmplace("", "empty");
+        REQUIRE(*dict.find("") == "empty");
+    }
+}
+
+TEST_CASE("Dict: Lookups with a precomputed hash", "[dict]") {
+    Dict<int> dict;
+    // Prefetching is only a hint, also on an empty dict
+    dict.prefetch(Dict<int>::hash("key:1"));
+    bool rehashing = false;
+    for (int i = 0; i < 1000; i++) {
+        dict.tryEmplace(key(i), i);
+        rehashing = rehashing || dict.isRehashing();
+        size_t hash = Dict<int>::hash(key(i / 2));
+        dict.prefetch(hash);
+        REQUIRE(*dict.find(key(i / 2), hash) == i / 2);
+    }
+    REQUIRE(rehashing);
+    size_t hash = Dict<int>::hash("missing");
+    dict.prefetch(hash);
+    REQUIRE(dict.find("missing", hash) == nullptr);
+}
+
+TEST_CASE("Dict: Growth rehashes incrementally", "[dict]") {
+    Dict<int> dict;
+    const int count = 100000;
+    bool saw_rehash = false;
+
+    for (int i = 0; i < count; i++) {
+        REQUIRE(dict.tryEmplace(key(i), i).second);
+        saw_rehash = saw_rehash || dict.isRehashing();
+        if (i % 997 == 0) {
+            // Keys stay reachable while entries move between the tables
+            REQUIRE(*dict.find(key(i / 2)) == i / 2);
+        }
+    }
+    REQUIRE(saw_rehash);
+    REQUIRE(dict.size() == count);
+
+    for (int i = 0; i < count; i++) {
+        const int* value = dict.find(key(i));
+        REQUIRE(value != nullptr);
+        REQUIRE(*value == i);
+    }
+    REQUIRE(dict.find(key(count)) == nullptr);
+
+    SECTION("Idle rehash finishes a resize") {
+        while (dict.rehashStep(100)) {
+        }
+        REQUIRE_FALSE(dict.isRehashing());
+        REQUIRE(dict.size() == count);
+    }
+}
+
+TEST_CASE("Dict: Erase shrinks and reuses slots", "[dict]") {
+    Dict<int> dict;
+    const int count = 50000;
+    for (int i = 0; i < count; i++) {
+        dict.tryEmplace(key(i), i);
+    }
+    size_t full_capacity = dict.capacity();
+
+    for (int i = 0; i < count; i++) {
+        if (i % 100 != 0) {
+            REQUIRE(dict.erase(key(i)));
+        }
+    }
+    while (dict.rehashStep(100)) {
+    }
+    REQUIRE(dict.size() == count / 100);
+    REQUIRE(dict.capacity() < full_capacity / 8);
+    for (int i = 0; i < count; i += 100) {
+        REQUIRE(*dict.find(key(i)) == i);
+    }
+
+    SECTION("Insert and erase churn keeps the table bounded") {
+        for (int i = 0; i < 200000; i++) {
+            dict.tryEmplace("churn", i);
+            dict.erase("churn");
+        }
+        REQUIRE(dict.size() == count / 100);
+        REQUIRE(dict.capacity() < full_capacity / 8);
+    }
+
+    SECTION("Erasing everything releases the table") {
+        for (int i = 0; i < count; i += 100) {
+            REQUIRE(dict.erase(key(i)));
+        }
+        while (dict.rehashStep(100)) {
+        }
+        REQUIRE(dict.empty());
+        REQUIRE(dict.capacity() <= 16);
+    }
+}
+
+TEST_CASE("Dict: Scan", "[dict]") {
+    Dict<int> dict;
+
+    SECTION("Empty dict") {
+        int calls = 0;
+        REQUIRE(dict.scan(0, [&](std::string_view, int) { calls++; }) == 0);
+        REQUIRE(calls == 0);
+    }
+
+    SECTION("Every key is returned") {
+        for (int i = 0; i < 5000; i++) {
+            dict.tryEmplace(key(i), i);
+        }
+        while (dict.rehashStep(100)) {
+        }
+        std::multiset<std::string> seen;
+        size_t cursor = 0;
+        do {
+            cursor = dict.scan(cursor, [&](std::string_view k, int) { seen.emplace(k); });
+        } while (cursor != 0);
+        REQUIRE(seen.size() == 5000);
+        REQUIRE(std::set<std::string>(seen.begin(), seen.end()).size() == 5000);
+    }
+
+    SECTION("Keys present for the whole scan are returned across a resize") {
+        for (int i = 0; i < 1000; i++) {
+            dict.tryEmplace(key(i), i);
+        }
+        while (dict.rehashStep(100)) {
+        }
+        std::set<std::string> seen;
+        size_t cursor = 0;
+        int added = 0;
+        do {
+            cursor = dict.scan(cursor, [&](std::string_view k, int) { seen.emplace(k); });
+            // Grow the table while the scan is in progress
+            for (int i = 0; i < 50; i++, added++) {
+                dict.tryEmplace("new:" + std::to_string(added), added);
+            }
+        } while (cursor != 0);
+        for (int i = 0; i < 1000; i++) {
+            REQUIRE(seen.contains(key(i)));
+        }
+    }
+}
+
+TEST_CASE("Dict: Scan across many resizes", "[dict]") {
+    // Keys displaced past their home group must still be reported when the
+    // table doubles or halves between two steps
+    for (bool growing : {true, false}) {
+        Dict<int> dict;
+        for (int i = 0; i < 3000; i++) {
+            dict.tryEmplace(key(i), i);
+        }
+        std::set<std::string> seen;
+        size_t cursor = 0;
+        int changed = 0;
+        do {
+            cursor = dict.scan(cursor, [&](std::string_view k, int) { seen.emplace(k); });
+            for (int i = 0; i < 40; i++, changed++) {
+                if (growing) {
+                    dict.tryEmplace("new:" + std::to_string(changed), changed);
+                } else {
+                    dict.erase(key(1000 + changed));
+                }
+            }
+        } while (cursor != 0);
+        for (int i = 0; i < 1000; i++) {
+            REQUIRE(seen.contains(key(i)));
+        }
+    }
+}
+
+TEST_CASE("Dict: Random keys", "[dict]") {
+    Dict<int> dict;
+    REQUIRE_FALSE(dict.randomKey(42).has_value());
+    for (int i = 0; i < 200; i++) {
+        dict.tryEmplace(key(i), i);
+    }
+    std::set<std::string> picked;
+    uint64_t random = 1;
+    for (int i = 0; i < 2000; i++) {
+        random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto k = dict.randomKey(random);
+        REQUIRE(k.has_value());
+        REQUIRE(dict.contains(*k));
+        picked.emplace(*k);
+    }
+    REQUIRE(picked.size() > 150);
+}
+
+TEST_CASE("Dict: Samples", "[dict]") {
+    Dict<int> dict;
+    size_t visited = 0;
+    dict.sample(42, 5, [&](std::string_view, int) { visited++; });
+    REQUIRE(visited == 0);
+    for (int i = 0; i < 200; i++) {
+        dict.tryEmplace(key(i), i);
+    }
+    std::set<std::string> sampled;
+    uint64_t random = 1;
+    for (int i = 0; i < 200; i++) {
+        random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+        std::set<std::string> sample;
+        dict.sample(random, 5, [&](std::string_view k, int value) {
+            REQUIRE(k == key(value));
+            sample.emplace(k);
+        });
+        REQUIRE(sample.size() == 5);
+        sampled.insert(sample.begin(), sample.end());
+    }
+    REQUIRE(sampled.size() > 150);
+
+    // A sample larger than the dict visits every entry once
+    visited = 0;
+    dict.sample(7, 1000, [&](std::string_view, int) { visited++; });
+    REQUIRE(visited == 200);
+}
+
+TEST_CASE("Dict: Matches std::unordered_map under random operations", "[dict]") {
+    Dict<int> dict;
+    std::unordered_map<std::string, int> reference;
+    uint64_t state = 42;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    for (int i = 0; i < 200000; i++) {
+        std::string k = key(static_cast<int>(next() % 5000));
+        switch (next() % 3) {
+            case 0: {
+                auto [value, inserted] = dict.tryEmplace(k, i);
+                REQUIRE(inserted == reference.emplace(k, i).second);
+                REQUIRE(*value == reference[k]);
+                break;
+            }
+            case 1:
+                REQUIRE(dict.erase(k) == (reference.erase(k) == 1));
+                break;
+            default: {
+                const int* value = dict.find(k);
+                auto it = reference.find(k);
+                REQUIRE((value != nullptr) == (it != reference.end()));
+                if (value != nullptr) {
+                    REQUIRE(*value == it->second);
+                }
+                break;
+            }
+        }
+    }
+    REQUIRE(dict.size() == reference.size());
+
+    size_t visited = 0;
+    dict.forEach([&](std::string_view k, int value) {
+        REQUIRE(reference.at(std::string(k)) == value);
+        visited++;
+    });
+    REQUIRE(visited == reference.size());
+}
+
+TEST_CASE("Dict: Move", "[dict]") {
+    Dict<std::string> dict;
+    for (int i = 0; i < 1000; i++) {
+        dict.tryEmplace(key(i), "value");
+    }
+    Dict<std::string> moved(std::move(dict));
+    REQUIRE(moved.size() == 1000);
+    REQUIRE(dict.empty());
+    REQUIRE(*moved.find(key(999)) == "value");
+
+    dict = std::move(moved);
+    REQUIRE(dict.size() == 1000);
+    REQUIRE(moved.empty());
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/event_loop.hpp"
+#include "redis/persistence.hpp"
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace redis;
+
+namespace {
+    // A key that `shard` of `shards` owns
+    std::string keyOn(size_t shard, size_t shards, size_t skip = 0) {
+        for (size_t i = 0;; i++) {
+            std::string key = "key:" + std::to_string(i);
+            if (EventLoop::shardOf(key, shards) == shard && skip-- == 0) {
+                return key;
+            }
+        }
+    }
+
+    // Event loops that are not running, and a client of the first one.
+    // Commands for other shards wait in their mailboxes.
+    struct Shards {
+        Persistence persistence;
+        std::vector<std::unique_ptr<EventLoop>> loops;
+        int sockets[2];
+        std::unique_ptr<ClientConnection> connection;
+
+        explicit Shards(size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                loops.push_back(EventLoop::create(Backend::EPOLL, i, loops, persistence));
+            }
+            REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+            connection = std::make_unique<ClientConnection>(sockets[0], *loops[0], 0);
+        }
+        ~Shards() {
+            connection.reset();
+            ::close(sockets[1]);
+        }
+
+        std::optional<std::string> execute(std::vector<std::string_view> args) {
+            return loops[0]->execute(*connection, args);
+        }
+    };
+}
+
+TEST_CASE("EventLoop: Forwarding a command does not add to the next one's time", "[event_loop]") {
+    Shards shards(2);
+    EventLoop& loop = *shards.loops[0];
+    std::string local = keyOn(0, 2);
+    std::string remote = keyOn(1, 2);
+
+    // As the commands of one read run
+    CommandClock& clock = loop.database().clock();
+    clock.beginBatch();
+    REQUIRE(shards.execute({"GET", local}).has_value());
+    REQUIRE_FALSE(shards.execute({"SET", remote, "value"}).has_value());
+    // Stands for whatever handing the command over costs
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(shards.execute({"GET", local}).has_value());
+    clock.endBatch();
+
+    size_t index = static_cast<size_t>(Database::command("GET") - Database::commandTable().data());
+    const CommandStats::Entry& stats = loop.database().stats()[index];
+    REQUIRE(stats.calls.load() == 2);
+    REQUIRE(stats.nanos.load() < 10'000'000);
+}
+
+TEST_CASE("EventLoop: MSET and MSETNX keep their keys on one shard", "[event_loop]") {
+    Shards shards(2);
+    std::string local = keyOn(0, 2);
+    std::string other_local = keyOn(0, 2, 1);
+    std::string remote = keyOn(1, 2);
+
+    // Set all at once or refused, never split between shards
+    for (std::string_view name : {"MSET", "MSETNX"}) {
+        auto reply = shards.execute({name, local, "1", remote, "2"});
+        REQUIRE(reply.has_value());
+        REQUIRE(reply->starts_with("-CROSSSLOT"));
+    }
+    REQUIRE(shards.loops[0]->database().storage().size() == 0);
+
+    REQUIRE(shards.execute({"MSET", local, "1", other_local, "2"}) == "+OK\r\n");
+    REQUIRE(shards.loops[0]->database().storage().size() == 2);
+}
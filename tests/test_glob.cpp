@@ -0,0 +1,58 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/glob.hpp"
+#include <string>
+
+using namespace redis;
+
+namespace {
+    bool matches(std::string_view pattern, std::string_view text) {
+        return GlobPattern(pattern).matches(text);
+    }
+}
+
+TEST_CASE("GlobPattern: Wildcards", "[glob]") {
+    REQUIRE(GlobPattern("*").matchesAll());
+    REQUIRE(GlobPattern("**").matchesAll());
+    REQUIRE(matches("*", ""));
+    REQUIRE(matches("user:*", "user:1"));
+    REQUIRE(matches("user:*", "user:"));
+    REQUIRE_FALSE(matches("user:*", "use"));
+    REQUIRE(matches("*:name", "user:1:name"));
+    REQUIRE_FALSE(matches("*:name", "user:1:names"));
+    REQUIRE(matches("h?llo", "hello"));
+    REQUIRE_FALSE(matches("h?llo", "hllo"));
+    REQUIRE(matches("*a*b*c", "xxaxxbxxbxc"));
+    REQUIRE_FALSE(matches("*a*b*c", "xxaxxbxxbx"));
+    // The last star has to take a longer run after a partial match
+    REQUIRE(matches("*aab", "aaab"));
+    REQUIRE(matches("a*?", "ab"));
+    REQUIRE_FALSE(matches("a*?", "a"));
+}
+
+TEST_CASE("GlobPattern: Literals and escapes", "[glob]") {
+    REQUIRE(matches("key", "key"));
+    REQUIRE_FALSE(matches("key", "keys"));
+    REQUIRE(matches("", ""));
+    REQUIRE_FALSE(matches("", "a"));
+    REQUIRE(matches("a\\*b", "a*b"));
+    REQUIRE_FALSE(matches("a\\*b", "axb"));
+    REQUIRE(matches("\\?", "?"));
+    REQUIRE(matches("end\\", "end\\"));
+}
+
+TEST_CASE("GlobPattern: Classes", "[glob]") {
+    REQUIRE(matches("h[ae]llo", "hallo"));
+    REQUIRE(matches("h[ae]llo", "hello"));
+    REQUIRE_FALSE(matches("h[ae]llo", "hillo"));
+    REQUIRE(matches("h[^e]llo", "hallo"));
+    REQUIRE_FALSE(matches("h[^e]llo", "hello"));
+    REQUIRE(matches("key[0-9]", "key7"));
+    REQUIRE(matches("key[9-0]", "key7"));
+    REQUIRE_FALSE(matches("key[0-9]", "keyx"));
+    REQUIRE(matches("[]]", "]"));
+    REQUIRE(matches("[a\\]]", "]"));
+    REQUIRE(matches("[a-]", "-"));
+    // Without a closing bracket `[` is a literal
+    REQUIRE(matches("[abc", "[abc"));
+    REQUIRE(matches("*[0-9]", "user:42"));
+}
@@ -0,0 +1,142 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/hash.hpp"
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+using namespace redis;
+
+namespace {
+    std::map<std::string, std::string> fields(const Hash& hash) {
+        std::map<std::string, std::string> result;
+        hash.forEach([&](std::string_view field, std::string_view value) { result.emplace(field, value); });
+        return result;
+    }
+}
+
+TEST_CASE("Hash: Set, get and erase while packed", "[hash]") {
+    Hash hash;
+    HashLimits limits;
+    REQUIRE(hash.size() == 0);
+    REQUIRE(hash.set("name", "alice", limits));
+    REQUIRE(hash.set("age", "30", limits));
+    REQUIRE(hash.set("", std::string("\0\r\n", 3), limits));
+    REQUIRE(hash.size() == 3);
+    REQUIRE(hash.packed());
+
+    REQUIRE(hash.get("name").value().view() == "alice");
+    REQUIRE(hash.get("").value().view() == std::string("\0\r\n", 3));
+    REQUIRE_FALSE(hash.get("missing").has_value());
+
+    REQUIRE(hash.erase("age"));
+    REQUIRE_FALSE(hash.erase("age"));
+    REQUIRE(fields(hash) == std::map<std::string, std::string>{{"name", "alice"}, {"", std::string("\0\r\n", 3)}});
+}
+
+TEST_CASE("Hash: Overwriting resizes the value in place", "[hash]") {
+    Hash hash;
+    HashLimits limits;
+    hash.set("a", "1", limits);
+    hash.set("b", "2", limits);
+    hash.set("c", "3", limits);
+
+    REQUIRE_FALSE(hash.set("b", std::string(60, 'x'), limits));
+    REQUIRE_FALSE(hash.set("a", "", limits));
+    REQUIRE(hash.get("b").value().view() == std::string(60, 'x'));
+    REQUIRE(hash.get("a").value().view() == "");
+    REQUIRE(hash.get("c").value().view() == "3");
+    REQUIRE(hash.size() == 3);
+    REQUIRE(hash.packed());
+
+    // The field order is kept
+    std::string order;
+    hash.forEach([&](std::string_view field, std::string_view) { order += field; });
+    REQUIRE(order == "abc");
+}
+
+TEST_CASE("Hash: Converts to a table past its limits", "[hash]") {
+    HashLimits limits{.max_packed_entries = 4, .max_packed_value = 8};
+
+    SECTION("Too many fields") {
+        Hash hash;
+        for (int i = 0; i < 4; i++) {
+            hash.set(std::to_string(i), "v", limits);
+        }
+        REQUIRE(hash.packed());
+        // Overwriting a field does not count as a new one
+        hash.set("0", "w", limits);
+        REQUIRE(hash.packed());
+        hash.set("4", "v", limits);
+        REQUIRE_FALSE(hash.packed());
+        REQUIRE(hash.size() == 5);
+        REQUIRE(hash.get("0").value().view() == "w");
+        REQUIRE(hash.get("4").value().view() == "v");
+    }
+
+    SECTION("Long value") {
+        Hash hash;
+        hash.set("short", "12345678", limits);
+        REQUIRE(hash.packed());
+        hash.set("short", "123456789", limits);
+        REQUIRE_FALSE(hash.packed());
+        REQUIRE(hash.get("short").value().view() == "123456789");
+    }
+
+    SECTION("Long field") {
+        Hash hash;
+        hash.set("a", "1", limits);
+        hash.set("a-long-field", "1", limits);
+        REQUIRE_FALSE(hash.packed());
+        REQUIRE(fields(hash) == std::map<std::string, std::string>{{"a", "1"}, {"a-long-field", "1"}});
+    }
+
+    SECTION("Tables stay tables") {
+        Hash hash;
+        hash.set("a-long-field", "1", limits);
+        REQUIRE(hash.erase("a-long-field"));
+        hash.set("a", "1", limits);
+        REQUIRE_FALSE(hash.packed());
+    }
+}
+
+TEST_CASE("Hash: Matches an unordered_map under random operations", "[hash]") {
+    HashLimits limits{.max_packed_entries = 16, .max_packed_value = 16};
+    std::mt19937 rng(42);
+    for (int round = 0; round < 20; round++) {
+        Hash hash;
+        std::unordered_map<std::string, std::string> expected;
+        for (int i = 0; i < 2000; i++) {
+            std::string field = "f" + std::to_string(rng() % (round % 2 == 0 ? 12 : 200));
+            if (rng() % 4 == 0) {
+                REQUIRE(hash.erase(field) == (expected.erase(field) == 1));
+            } else {
+                // Mostly short values, with the odd one too long to pack
+                std::string value(rng() % 10 == 0 ? 20 : rng() % 8, static_cast<char>('a' + i % 26));
+                REQUIRE(hash.set(field, value, limits) == !expected.contains(field));
+                expected[field] = value;
+            }
+        }
+        REQUIRE(hash.size() == expected.size());
+        for (const auto& [field, value] : expected) {
+            REQUIRE(hash.get(field).value().view() == value);
+        }
+        REQUIRE(fields(hash) == std::map<std::string, std::string>(expected.begin(), expected.end()));
+    }
+}
+
+TEST_CASE("Hash: Small hashes are packed", "[hash]") {
+    Hash packed;
+    Hash table;
+    HashLimits limits;
+    HashLimits no_packing{.max_packed_entries = 0, .max_packed_value = 0};
+    for (int i = 0; i < 10; i++) {
+        packed.set("field" + std::to_string(i), "value" + std::to_string(i), limits);
+        table.set("field" + std::to_string(i), "value" + std::to_string(i), no_packing);
+    }
+    // 140 bytes of fields and values with their lengths, in one allocation
+    REQUIRE(packed.packed());
+    REQUIRE(packed.memoryUsage() < 300);
+    REQUIRE_FALSE(table.packed());
+    REQUIRE(packed.memoryUsage() * 2 < table.memoryUsage());
+}
@@ -0,0 +1,27 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/io_uring.hpp"
+#include <cstdint>
+
+using namespace redis;
+
+TEST_CASE("IoUring: Queues more requests than the rings hold", "[io_uring]") {
+    // 4 submission and 8 completion entries
+    IoUring ring(4);
+    const uint64_t requests = 100;
+    for (uint64_t i = 0; i < requests; i++) {
+        io_uring_sqe* sqe = ring.getSqe();
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = i;
+    }
+
+    uint64_t next = 0;
+    for (int wait = 0; wait < 100 && next < requests; wait++) {
+        ring.submitAndWait(10);
+        ring.forEachCompletion([&next](const io_uring_cqe& cqe) {
+            REQUIRE(cqe.user_data == next);
+            REQUIRE(cqe.res == 0);
+            next++;
+        });
+    }
+    REQUIRE(next == requests);
+}
@@ -0,0 +1,64 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/lazy_free.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    // Records the thread it is destroyed on
+    struct Tracked {
+        std::atomic<int>* freed;
+        std::thread::id* freed_on;
+
+        ~Tracked() {
+            *freed_on = std::this_thread::get_id();
+            (*freed)++;
+        }
+    };
+}
+
+TEST_CASE("LazyFree: Frees on its own thread", "[lazy_free]") {
+    std::atomic<int> freed{0};
+    std::thread::id freed_on;
+    LazyFree lazy_free;
+
+    lazy_free.free(std::make_unique<Tracked>(&freed, &freed_on));
+    lazy_free.drain();
+    REQUIRE(freed == 1);
+    REQUIRE(freed_on != std::this_thread::get_id());
+    REQUIRE(lazy_free.pending() == 0);
+}
+
+TEST_CASE("LazyFree: Frees what is pending on destruction", "[lazy_free]") {
+    std::atomic<int> freed{0};
+    std::thread::id freed_on;
+    {
+        LazyFree lazy_free;
+        for (int i = 0; i < 1000; i++) {
+            lazy_free.free(std::make_unique<Tracked>(&freed, &freed_on));
+        }
+    }
+    REQUIRE(freed == 1000);
+}
+
+TEST_CASE("LazyFree: Concurrent producers", "[lazy_free]") {
+    std::atomic<int> freed{0};
+    std::thread::id freed_on;
+    LazyFree lazy_free;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 4; p++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; i++) {
+                lazy_free.free(std::make_unique<Tracked>(&freed, &freed_on));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    lazy_free.drain();
+    REQUIRE(freed == 4000);
+}
@@ -0,0 +1,35 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/log.hpp"
+
+using namespace redis;
+
+TEST_CASE("Log: Level names", "[log]") {
+    REQUIRE(log::parseLevel("debug") == spdlog::level::debug);
+    REQUIRE(log::parseLevel("verbose") == spdlog::level::debug);
+    REQUIRE(log::parseLevel("notice") == spdlog::level::info);
+    REQUIRE(log::parseLevel("warning") == spdlog::level::warn);
+    REQUIRE(log::parseLevel("nothing") == spdlog::level::off);
+    REQUIRE(log::parseLevel("off") == spdlog::level::off);
+    REQUIRE_FALSE(log::parseLevel("loud"));
+}
+
+TEST_CASE("Log: Disabled statements do not evaluate their arguments", "[log]") {
+    int evaluated = 0;
+    auto argument = [&evaluated] {
+        return ++evaluated;
+    };
+    log::setLevel(spdlog::level::warn);
+    REQUIRE_FALSE(log::enabled(spdlog::level::info));
+    REQUIRE(log::enabled(spdlog::level::err));
+    REDIS_INFO("{}", argument());
+    REQUIRE(evaluated == 0);
+#if REDIS_LOG_ACTIVE_LEVEL > SPDLOG_LEVEL_TRACE
+    // Below the compile-time level whatever the run-time one
+    log::setLevel(spdlog::level::trace);
+    REDIS_TRACE("{}", argument());
+    REQUIRE(evaluated == 0);
+#endif
+    log::setLevel(spdlog::level::off);
+    REQUIRE(spdlog::get_level() == spdlog::level::off);
+    log::setLevel(spdlog::level::info);
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/mailbox.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace redis;
+
+TEST_CASE("Mailbox: Runs tasks in push order", "[mailbox]") {
+    Mailbox mailbox;
+    std::vector<int> order;
+
+    for (int i = 0; i < 5; ++i) {
+        mailbox.push([&order, i]() { order.push_back(i); });
+    }
+    REQUIRE(mailbox.drain() == 5);
+    REQUIRE(order == std::vector<int>{0, 1, 2, 3, 4});
+    REQUIRE(mailbox.drain() == 0);
+}
+
+TEST_CASE("Mailbox: Concurrent producers", "[mailbox]") {
+    Mailbox mailbox;
+    const int producers = 4;
+    const int tasks_per_producer = 10000;
+    std::vector<int> last_seen(producers, -1);
+    bool in_order = true;
+    std::atomic<int> finished{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < tasks_per_producer; ++i) {
+                mailbox.push([&, p, i]() {
+                    // Tasks of one producer keep their relative order
+                    in_order = in_order && last_seen[p] == i - 1;
+                    last_seen[p] = i;
+                });
+            }
+            finished++;
+        });
+    }
+
+    size_t executed = 0;
+    while (finished < producers) {
+        executed += mailbox.drain();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    executed += mailbox.drain();
+
+    REQUIRE(executed == producers * tasks_per_producer);
+    REQUIRE(in_order);
+}
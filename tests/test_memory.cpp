@@ -0,0 +1,123 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/memory.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace redis;
+
+TEST_CASE("Memory: Counts allocations", "[memory]") {
+    size_t before = memory::used();
+    void* block = memory::allocate(1000);
+    REQUIRE(memory::used() >= before + 1000);
+    block = memory::reallocate(block, 100000);
+    REQUIRE(memory::used() >= before + 100000);
+    memory::release(block);
+    REQUIRE(memory::used() == before);
+
+    block = memory::allocateZeroed(64);
+    REQUIRE(static_cast<char*>(block)[63] == 0);
+    memory::release(block);
+    memory::release(nullptr);
+    REQUIRE(memory::used() == before);
+}
+
+TEST_CASE("Memory: Counts across threads", "[memory]") {
+    size_t before = memory::used();
+    std::vector<void*> blocks(1000);
+    std::thread allocator([&] {
+        for (void*& block : blocks) {
+            block = memory::allocate(100);
+        }
+    });
+    allocator.join();
+    REQUIRE(memory::used() >= before + 100 * blocks.size());
+    // Released by another thread than the one that allocated
+    for (void* block : blocks) {
+        memory::release(block);
+    }
+    REQUIRE(memory::used() == before);
+}
+
+TEST_CASE("Memory: Small sizes share size classes", "[memory]") {
+    void* tiny = memory::allocate(1);
+    void* small = memory::allocate(100);
+    void* largest = memory::allocate(memory::MAX_SMALL);
+    void* large = memory::allocate(memory::MAX_SMALL + 1);
+    REQUIRE(memory::usableSize(tiny) == 16);
+    REQUIRE(memory::usableSize(small) == 112);
+    REQUIRE(memory::usableSize(largest) == memory::MAX_SMALL);
+    REQUIRE(memory::usableSize(large) > memory::MAX_SMALL);
+
+    // Growing within the class stays in place; past it the bytes move
+    std::memset(small, 'x', 100);
+    REQUIRE(memory::reallocate(small, 110) == small);
+    small = memory::reallocate(small, 500);
+    REQUIRE(memory::usableSize(small) == 512);
+    REQUIRE(std::string_view(static_cast<char*>(small), 100) == std::string(100, 'x'));
+    // Shrinking into the slabs
+    std::memset(large, 'y', memory::MAX_SMALL + 1);
+    large = memory::reallocate(large, 40);
+    REQUIRE(memory::usableSize(large) == 48);
+    REQUIRE(std::string_view(static_cast<char*>(large), 40) == std::string(40, 'y'));
+
+    for (void* block : {tiny, small, largest, large}) {
+        memory::release(block);
+    }
+}
+
+TEST_CASE("Memory: Emptied runs are returned", "[memory]") {
+    size_t before = memory::active();
+    std::vector<void*> blocks(20000);
+    for (void*& block : blocks) {
+        block = memory::allocate(200);
+    }
+    REQUIRE(memory::active() >= before + 200 * blocks.size());
+    for (void* block : blocks) {
+        memory::release(block);
+    }
+    // Only what the thread cache holds and the class's last run remain
+    REQUIRE(memory::active() <= before + 2 * (64 << 10));
+}
+
+TEST_CASE("Memory: Defragment packs sparse runs", "[memory]") {
+    std::vector<uint64_t*> blocks(40000);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i] = static_cast<uint64_t*>(memory::allocate(150));
+        std::fill_n(blocks[i], 150 / sizeof(uint64_t), i);
+    }
+    // Keep one in eight, scattered over every run
+    std::vector<uint64_t*> kept;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (i % 8 == 0) {
+            kept.push_back(blocks[i]);
+        } else {
+            memory::release(blocks[i]);
+        }
+    }
+    size_t sparse = memory::active() - memory::used();
+    uint64_t hits = memory::stats().defrag_hits;
+
+    for (int pass = 0; pass < 4; pass++) {
+        for (uint64_t*& block : kept) {
+            if (void* moved = memory::defragment(block)) {
+                block = static_cast<uint64_t*>(moved);
+            }
+        }
+    }
+    REQUIRE(memory::stats().defrag_hits > hits);
+    REQUIRE(memory::active() - memory::used() < sparse / 4);
+    for (size_t i = 0; i < kept.size(); i++) {
+        REQUIRE(std::all_of(kept[i], kept[i] + 150 / sizeof(uint64_t), [&](uint64_t word) { return word == i * 8; }));
+        memory::release(kept[i]);
+    }
+
+    // Large allocations are never moved
+    void* large = memory::allocate(memory::MAX_SMALL * 4);
+    REQUIRE(memory::defragment(large) == nullptr);
+    memory::release(large);
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/object.hpp"
+#include <span>
+#include <string>
+
+using namespace redis;
+
+TEST_CASE("Object: String encodings", "[object]") {
+    SECTION("Canonical integers are stored as integers") {
+        for (std::string value : {"0", "42", "9999", "10000", "-1", "9223372036854775807", "-9223372036854775808"}) {
+            auto object = Object::createString("key", value);
+            REQUIRE(object->encoding() == Encoding::INT);
+            REQUIRE(object->string() == value);
+            REQUIRE(object->key() == "key");
+        }
+    }
+
+    SECTION("Other numbers stay strings") {
+        for (std::string value : {"+1", "01", "-0", "1.5", "9223372036854775808", " 1"}) {
+            auto object = Object::createString("key", value);
+            REQUIRE(object->encoding() == Encoding::EMBSTR);
+            REQUIRE(object->string() == value);
+        }
+    }
+
+    SECTION("Short strings are embedded") {
+        auto object = Object::createString("key", "value");
+        REQUIRE(object->encoding() == Encoding::EMBSTR);
+        REQUIRE(object->type() == ValueType::STRING);
+        REQUIRE(object->string() == "value");
+        REQUIRE(object->key() == "key");
+
+        auto empty = Object::createString("", "");
+        REQUIRE(empty->string() == "");
+        REQUIRE(empty->key() == "");
+    }
+
+    SECTION("Large strings go to their own buffer") {
+        std::string value(Object::EMBED_LIMIT + 1, 'x');
+        auto object = Object::createString("key", value);
+        REQUIRE(object->encoding() == Encoding::RAW);
+        REQUIRE(object->string() == value);
+        REQUIRE(object->key() == "key");
+        REQUIRE(object->memoryUsage() > value.size());
+    }
+
+    SECTION("Binary keys and values") {
+        std::string key("k\0y", 3);
+        std::string value("v\0\r\n", 4);
+        auto object = Object::createString(key, value);
+        REQUIRE(object->key() == key);
+        REQUIRE(object->string() == value);
+    }
+}
+
+TEST_CASE("Object: In-place edits", "[object]") {
+    SECTION("Integers") {
+        auto object = Object::createInteger("key", 41);
+        object->setInteger(-7);
+        REQUIRE(object->string() == "-7");
+        REQUIRE(object->key() == "key");
+    }
+
+    SECTION("Raw buffers grow geometrically") {
+        std::string value(Object::EMBED_LIMIT + 1, 'x');
+        auto object = Object::createString("key", value);
+        std::span<char> bytes = object->resizeRaw(value.size() + 1);
+        bytes.back() = 'y';
+        const char* data = bytes.data();
+        // The first growth doubled the buffer, so the next appends fit
+        for (size_t size = value.size() + 2; size <= 2 * value.size(); size++) {
+            REQUIRE(object->resizeRaw(size).data() == data);
+        }
+        REQUIRE(object->string().view().size() == 2 * value.size());
+        REQUIRE(object->string().view().substr(value.size() - 1, 3) == std::string_view("xy\0", 3));
+        REQUIRE(object->key() == "key");
+        object->resizeRaw(3);
+        REQUIRE(object->string() == "xxx");
+    }
+}
+
+TEST_CASE("Object: StringValue of integers", "[object]") {
+    SECTION("Shared small integers") {
+        StringValue a(int64_t{123});
+        StringValue b(int64_t{123});
+        REQUIRE(a == "123");
+        REQUIRE(a.view().data() == b.view().data());
+    }
+
+    SECTION("Copies of large integers own their digits") {
+        std::optional<StringValue> copy;
+        {
+            StringValue value(int64_t{-123456789012});
+            copy = value;
+        }
+        REQUIRE(*copy == "-123456789012");
+    }
+}
+
+TEST_CASE("Object: Memory usage", "[object]") {
+    auto small = Object::createString("key:00000001", "value");
+    // Header, payload and key share one allocation
+    REQUIRE(small->memoryUsage() >= sizeof(Object) + 4 + 5 + 12);
+    REQUIRE(small->memoryUsage() <= 64);
+}
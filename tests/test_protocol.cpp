@@ -229,3 +229,135 @@ TEST_CASE("Protocol: Parse Command - Multiple Commands", "[protocol]") {
     REQUIRE(args2[2] == "value");
 }
 
+
+TEST_CASE("RequestParser: Command split across reads", "[protocol]") {
+    const std::string command = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n";
+    RequestParser parser;
+    std::string received;
+
+    // Feed one byte at a time; only the final byte completes the frame
+    for (size_t i = 0; i < command.size(); ++i) {
+        received += command[i];
+        std::string_view pending(received);
+        auto result = parser.next(pending);
+        REQUIRE(result.has_value());
+        if (i + 1 < command.size()) {
+            REQUIRE_FALSE(result->has_value());
+            REQUIRE(pending.size() == received.size());
+        } else {
+            REQUIRE(result->has_value());
+            REQUIRE(pending.empty());
+            const auto& args = result->value();
+            REQUIRE(args.size() == 3);
+            REQUIRE(args[0] == "SET");
+            REQUIRE(args[1] == "key");
+            REQUIRE(args[2] == "value");
+        }
+    }
+}
+
+TEST_CASE("RequestParser: Pipeline with a partial trailing command", "[protocol]") {
+    std::string received = "*1\r\n$4\r\nPING\r\n*2\r\n$3\r\nGET\r\n$3\r\nk";
+    RequestParser parser;
+    std::string_view pending(received);
+
+    auto first = parser.next(pending);
+    REQUIRE(first.has_value());
+    REQUIRE(first->has_value());
+    REQUIRE(first->value()[0] == "PING");
+
+    auto second = parser.next(pending);
+    REQUIRE(second.has_value());
+    REQUIRE_FALSE(second->has_value());
+    REQUIRE(pending == "*2\r\n$3\r\nGET\r\n$3\r\nk");
+
+    // The remainder arrives with the next read
+    received.erase(0, received.size() - pending.size());
+    received += "ey\r\n";
+    pending = received;
+    second = parser.next(pending);
+    REQUIRE(second.has_value());
+    REQUIRE(second->has_value());
+    REQUIRE(second->value()[0] == "GET");
+    REQUIRE(second->value()[1] == "key");
+    REQUIRE(pending.empty());
+}
+
+TEST_CASE("RequestParser: Large bulk string in small chunks", "[protocol]") {
+    const std::string value(1 << 20, 'x');
+    const std::string command = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+    RequestParser parser;
+    std::string received;
+
+    size_t calls = 0;
+    for (size_t offset = 0; offset < command.size(); offset += 1024) {
+        received.append(command, offset, 1024);
+        std::string_view pending(received);
+        auto result = parser.next(pending);
+        REQUIRE(result.has_value());
+        ++calls;
+        if (result->has_value()) {
+            REQUIRE(pending.empty());
+            REQUIRE(result->value()[2] == value);
+            break;
+        }
+    }
+    REQUIRE(calls == (command.size() + 1023) / 1024);
+}
+
+TEST_CASE("RequestParser: Reports protocol errors", "[protocol]") {
+    RequestParser parser;
+
+    std::string_view invalid_length("*x\r\n");
+    auto result1 = parser.next(invalid_length);
+    REQUIRE_FALSE(result1.has_value());
+    REQUIRE(result1.error().find("invalid array length") != std::string::npos);
+
+    parser.reset();
+    std::string_view negative_bulk("*1\r\n$-5\r\n");
+    auto result2 = parser.next(negative_bulk);
+    REQUIRE_FALSE(result2.has_value());
+    REQUIRE(result2.error().find("invalid bulk string length") != std::string::npos);
+}
+
+TEST_CASE("RequestParser: Rejects oversized lengths before the body arrives", "[protocol]") {
+    RequestParser parser;
+
+    std::string_view huge_bulk("*2\r\n$3\r\nGET\r\n$900000000000000\r\n");
+    auto result1 = parser.next(huge_bulk);
+    REQUIRE_FALSE(result1.has_value());
+    REQUIRE(result1.error().find("invalid bulk string length") != std::string::npos);
+
+    parser.reset();
+    const std::string over_limit = "*1\r\n$" + std::to_string(RequestParser::MAX_BULK_LENGTH + 1) + "\r\n";
+    std::string_view over_limit_view(over_limit);
+    auto result2 = parser.next(over_limit_view);
+    REQUIRE_FALSE(result2.has_value());
+    REQUIRE(parser.frameSizeHint() == 0);
+
+    parser.reset();
+    const std::string at_limit = "*1\r\n$" + std::to_string(RequestParser::MAX_BULK_LENGTH) + "\r\n";
+    std::string_view at_limit_view(at_limit);
+    auto result3 = parser.next(at_limit_view);
+    REQUIRE(result3.has_value());
+    REQUIRE_FALSE(result3->has_value());
+
+    parser.reset();
+    std::string_view huge_array("*900000000000000\r\n");
+    auto result4 = parser.next(huge_array);
+    REQUIRE_FALSE(result4.has_value());
+    REQUIRE(result4.error().find("invalid array length") != std::string::npos);
+}
+
+TEST_CASE("RequestParser: Arguments view into the input buffer", "[protocol]") {
+    const std::string received = "*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n";
+    RequestParser parser;
+    std::string_view pending(received);
+
+    auto result = parser.next(pending);
+    REQUIRE(result.has_value());
+    REQUIRE(result->has_value());
+    const auto& args = result->value();
+    REQUIRE(args[0].data() == received.data() + 8);
+    REQUIRE(args[1].data() == received.data() + 17);
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/quicklist.hpp"
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    std::vector<std::string> elements(const QuickList& list) {
+        std::vector<std::string> result;
+        list.forEach([&](std::string_view value) { result.emplace_back(value); });
+        return result;
+    }
+}
+
+TEST_CASE("QuickList: Push and pop at both ends", "[quicklist]") {
+    QuickList list;
+    REQUIRE(list.empty());
+
+    list.push(ListEnd::TAIL, "b");
+    list.push(ListEnd::TAIL, "c");
+    list.push(ListEnd::HEAD, "a");
+    REQUIRE(list.size() == 3);
+    REQUIRE(elements(list) == std::vector<std::string>{"a", "b", "c"});
+
+    REQUIRE(list.pop(ListEnd::HEAD) == "a");
+    REQUIRE(list.pop(ListEnd::TAIL) == "c");
+    REQUIRE(list.pop(ListEnd::TAIL) == "b");
+    REQUIRE(list.empty());
+    REQUIRE(list.memoryUsage() == 0);
+}
+
+TEST_CASE("QuickList: Elements of any size", "[quicklist]") {
+    QuickList list;
+    std::vector<std::string> values = {
+        "",
+        std::string(127, 'a'),
+        std::string(128, 'b'),
+        std::string(QuickList::NODE_MAX_BYTES, 'c'),
+        std::string("\0\r\n", 3),
+        std::string(20000, 'd'),
+    };
+    for (const auto& value : values) {
+        list.push(ListEnd::TAIL, value);
+    }
+    REQUIRE(elements(list) == values);
+    for (size_t i = 0; i < values.size(); i++) {
+        REQUIRE(list.index(static_cast<int64_t>(i)).value() == values[i]);
+    }
+    for (auto it = values.rbegin(); it != values.rend(); ++it) {
+        REQUIRE(list.pop(ListEnd::TAIL) == *it);
+    }
+}
+
+TEST_CASE("QuickList: Index and range", "[quicklist]") {
+    QuickList list;
+    for (int i = 0; i < 5000; i++) {
+        list.push(ListEnd::TAIL, std::to_string(i));
+    }
+    REQUIRE(list.index(0).value() == "0");
+    REQUIRE(list.index(2500).value() == "2500");
+    REQUIRE(list.index(-1).value() == "4999");
+    REQUIRE(list.index(-5000).value() == "0");
+    REQUIRE_FALSE(list.index(5000).has_value());
+    REQUIRE_FALSE(list.index(-5001).has_value());
+
+    REQUIRE(list.range(0, -1) == std::pair<size_t, size_t>{0, 4999});
+    REQUIRE(list.range(-3, 100000) == std::pair<size_t, size_t>{4997, 4999});
+    REQUIRE(list.range(-100000, 1) == std::pair<size_t, size_t>{0, 1});
+    REQUIRE_FALSE(list.range(3, 2).has_value());
+    REQUIRE_FALSE(list.range(5000, 6000).has_value());
+
+    std::vector<std::string> middle;
+    list.forRange(1998, 2002, [&](std::string_view value) { middle.emplace_back(value); });
+    REQUIRE(middle == std::vector<std::string>{"1998", "1999", "2000", "2001", "2002"});
+}
+
+TEST_CASE("QuickList: Remove from either end", "[quicklist]") {
+    QuickList list;
+    for (int i = 0; i < 3000; i++) {
+        list.push(ListEnd::TAIL, std::to_string(i));
+    }
+    list.remove(ListEnd::HEAD, 1000);
+    list.remove(ListEnd::TAIL, 999);
+    REQUIRE(list.size() == 1001);
+    REQUIRE(list.index(0).value() == "1000");
+    REQUIRE(list.index(-1).value() == "2000");
+    list.remove(ListEnd::HEAD, 5000);
+    REQUIRE(list.empty());
+}
+
+TEST_CASE("QuickList: Matches a deque under random operations", "[quicklist]") {
+    QuickList list;
+    std::deque<std::string> expected;
+    std::mt19937 rng(42);
+    for (int i = 0; i < 100000; i++) {
+        auto end = rng() % 2 == 0 ? ListEnd::HEAD : ListEnd::TAIL;
+        if (rng() % 3 != 0 || expected.empty()) {
+            std::string value(rng() % 40, static_cast<char>('a' + i % 26));
+            list.push(end, value);
+            end == ListEnd::HEAD ? expected.push_front(value) : expected.push_back(value);
+        } else {
+            std::string value = end == ListEnd::HEAD ? expected.front() : expected.back();
+            end == ListEnd::HEAD ? expected.pop_front() : expected.pop_back();
+            REQUIRE(list.pop(end) == value);
+        }
+    }
+    REQUIRE(list.size() == expected.size());
+    REQUIRE(elements(list) == std::vector<std::string>(expected.begin(), expected.end()));
+}
+
+TEST_CASE("QuickList: Small elements are packed", "[quicklist]") {
+    QuickList list;
+    const size_t count = 100000;
+    for (size_t i = 0; i < count; i++) {
+        list.push(ListEnd::TAIL, "12345678");
+    }
+    // 8 bytes of data, 2 of entry header and the node headers spread over
+    // hundreds of entries
+    REQUIRE(list.memoryUsage() < count * 12);
+}
@@ -0,0 +1,225 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/rdb.hpp"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    // A snapshot path in the temporary directory, removed afterwards
+    struct TempFile {
+        std::string path;
+
+        TempFile() : path((std::filesystem::temp_directory_path() / "test_rdb.rdb").string()) {
+            std::filesystem::remove(path);
+        }
+        ~TempFile() {
+            std::filesystem::remove(path);
+        }
+    };
+
+    size_t load(const std::string& path, std::vector<Storage*> shards) {
+        return Rdb::load(path, shards, [&](std::string_view key) {
+            return std::hash<std::string_view>{}(key) % shards.size();
+        });
+    }
+
+    std::string readFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    }
+
+    void writeFile(const std::string& path, const std::string& data) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << data;
+    }
+}
+
+TEST_CASE("Rdb: Save and load round trip", "[rdb]") {
+    TempFile file;
+    Storage source;
+    source.set("string", "value");
+    source.set("empty", "");
+    source.set("integer", "12345");
+    source.set("negative", "-9223372036854775808");
+    source.set("large", std::string(1000, 'x'));
+    source.set("binary", std::string("a\0b\r\n", 5));
+    source.set("expiring", "soon", Storage::now() + 60000);
+    Rdb::save(file.path, {&source});
+
+    Storage loaded;
+    REQUIRE(load(file.path, {&loaded}) == 7);
+    REQUIRE(loaded.size() == 7);
+    REQUIRE(loaded.get("string").value().value() == "value");
+    REQUIRE(loaded.get("empty").value().value() == "");
+    REQUIRE(loaded.get("integer").value().value() == "12345");
+    REQUIRE(loaded.get("negative").value().value() == "-9223372036854775808");
+    REQUIRE(loaded.get("large").value().value() == std::string(1000, 'x'));
+    REQUIRE(loaded.get("binary").value().value() == std::string("a\0b\r\n", 5));
+    REQUIRE(loaded.ttl("expiring") > 50000);
+    REQUIRE(loaded.ttl("string") == -1);
+}
+
+TEST_CASE("Rdb: Lists round trip", "[rdb]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string_view> values;
+    std::vector<std::string> strings;
+    for (int i = 0; i < 2000; i++) {
+        strings.push_back(std::to_string(i) + std::string(i % 50, 'x'));
+    }
+    values.assign(strings.begin(), strings.end());
+    source.push("list", ListEnd::TAIL, values);
+    source.set("string", "value");
+    Rdb::save(file.path, {&source});
+
+    Storage loaded;
+    REQUIRE(load(file.path, {&loaded}) == 2);
+    const QuickList* list = loaded.list("list").value();
+    REQUIRE(list->size() == strings.size());
+    size_t i = 0;
+    list->forEach([&](std::string_view value) { REQUIRE(value == strings[i++]); });
+    REQUIRE(loaded.get("string").value().value() == "value");
+}
+
+TEST_CASE("Rdb: Hashes round trip", "[rdb]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string_view> small = {"name", "alice", "age", "30"};
+    source.hashSet("small", small);
+    std::vector<std::string> strings;
+    for (int i = 0; i < 500; i++) {
+        strings.push_back("field" + std::to_string(i));
+        strings.push_back(std::to_string(i));
+    }
+    std::vector<std::string_view> large(strings.begin(), strings.end());
+    source.hashSet("large", large);
+    Rdb::save(file.path, {&source});
+
+    // The loading storage's limits decide the encoding
+    Storage loaded;
+    loaded.setHashLimits({.max_packed_entries = 1000, .max_packed_value = 64});
+    REQUIRE(load(file.path, {&loaded}) == 2);
+    const Hash* hash = loaded.hash("small").value();
+    REQUIRE(hash->size() == 2);
+    REQUIRE(hash->get("name").value().view() == "alice");
+    hash = loaded.hash("large").value();
+    REQUIRE(hash->size() == 500);
+    REQUIRE(hash->packed());
+    REQUIRE(hash->get("field499").value().view() == "499");
+}
+
+TEST_CASE("Rdb: Sets round trip", "[rdb]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::string_view> integers = {"-70000", "1", "2", "9223372036854775807"};
+    source.setAdd("integers", integers);
+    std::vector<std::string_view> strings = {"red", "green", "1"};
+    source.setAdd("strings", strings);
+    Rdb::save(file.path, {&source});
+
+    Storage loaded;
+    REQUIRE(load(file.path, {&loaded}) == 2);
+    const Set* set = loaded.getSet("integers").value();
+    REQUIRE(set->intset());
+    REQUIRE(set->size() == 4);
+    REQUIRE(set->contains("9223372036854775807"));
+    set = loaded.getSet("strings").value();
+    REQUIRE_FALSE(set->intset());
+    REQUIRE(set->size() == 3);
+    REQUIRE(set->contains("green"));
+}
+
+TEST_CASE("Rdb: Sorted sets round trip", "[rdb]") {
+    TempFile file;
+    Storage source;
+    std::vector<std::pair<double, std::string_view>> entries = {{1.5, "a"}, {-INFINITY, "b"}, {0.1, "c"}};
+    source.zsetAdd("small", entries, Storage::ZAddCondition::ALWAYS);
+    std::vector<std::string> members;
+    for (int i = 0; i < 500; i++) {
+        members.push_back("member" + std::to_string(i));
+    }
+    for (int i = 0; i < 500; i++) {
+        source.zsetIncrement("large", members[i], 500 - i);
+    }
+    Rdb::save(file.path, {&source});
+
+    Storage loaded;
+    REQUIRE(load(file.path, {&loaded}) == 2);
+    const ZSet* zset = loaded.zset("small").value();
+    REQUIRE(zset->packed());
+    REQUIRE(zset->size() == 3);
+    REQUIRE(zset->score("b") == -INFINITY);
+    REQUIRE(zset->score("c") == 0.1);
+    REQUIRE(zset->rank("a") == 2);
+    zset = loaded.zset("large").value();
+    REQUIRE_FALSE(zset->packed());
+    REQUIRE(zset->size() == 500);
+    REQUIRE(zset->rank("member499") == 0);
+    REQUIRE(zset->score("member0") == 500);
+}
+
+TEST_CASE("Rdb: Keys are routed to their shards", "[rdb]") {
+    TempFile file;
+    Storage a;
+    Storage b;
+    for (int i = 0; i < 1000; i++) {
+        (i % 2 == 0 ? a : b).set("key:" + std::to_string(i), std::to_string(i));
+    }
+    Rdb::save(file.path, {&a, &b});
+
+    Storage shards[3];
+    REQUIRE(load(file.path, {&shards[0], &shards[1], &shards[2]}) == 1000);
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "key:" + std::to_string(i);
+        REQUIRE(shards[std::hash<std::string_view>{}(key) % 3].get(key).value().value() == std::to_string(i));
+    }
+}
+
+TEST_CASE("Rdb: Expired keys are not loaded", "[rdb]") {
+    TempFile file;
+    Storage source;
+    source.set("live", "value");
+    source.set("doomed", "value", Storage::now() + 1);
+    Rdb::save(file.path, {&source});
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    Storage loaded;
+    REQUIRE(load(file.path, {&loaded}) == 1);
+    REQUIRE(loaded.exists("live"));
+    REQUIRE(loaded.expiresSize() == 0);
+}
+
+TEST_CASE("Rdb: Missing and corrupt files", "[rdb]") {
+    TempFile file;
+    Storage storage;
+
+    SECTION("A missing file loads nothing") {
+        REQUIRE(load(file.path, {&storage}) == 0);
+    }
+
+    SECTION("Corruption is detected by the checksum") {
+        storage.set("key", "value");
+        Rdb::save(file.path, {&storage});
+        std::string data = readFile(file.path);
+        data[data.size() / 2] ^= 0x01;
+        writeFile(file.path, data);
+        Storage loaded;
+        REQUIRE_THROWS_AS(load(file.path, {&loaded}), std::runtime_error);
+    }
+
+    SECTION("A truncated file is rejected") {
+        storage.set("key", "value");
+        Rdb::save(file.path, {&storage});
+        writeFile(file.path, readFile(file.path).substr(0, 6));
+        Storage loaded;
+        REQUIRE_THROWS_AS(load(file.path, {&loaded}), std::runtime_error);
+    }
+}
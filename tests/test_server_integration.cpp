@@ -1,4 +1,5 @@
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 #include "redis/server.hpp"
 #include <thread>
 #include <chrono>
@@ -6,6 +7,10 @@
 #include <sw/redis++/redis++.h>
 #include <string>
 #include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 using namespace redis;
 using namespace sw::redis;
@@ -15,9 +20,10 @@ TEST_CASE("Server Integration: Basic commands", "[integration]") {
     // Use a random port to avoid conflicts
     const int test_port = 6380;
     const std::string test_host = "127.0.0.1";
+    const auto backend = GENERATE(Backend::EPOLL, Backend::IO_URING);
     
     // Start server in a separate thread
-    Server server(test_host, test_port);
+    Server server(test_host, test_port, 1, backend);
     std::atomic<bool> server_started{false};
     std::exception_ptr server_exception = nullptr;
     
@@ -70,6 +76,50 @@ TEST_CASE("Server Integration: Basic commands", "[integration]") {
             REQUIRE(redis.get("key1") == "value1");
         }
         
+        SECTION("Key expiration") {
+            REQUIRE(redis.set("expiring", "value", 10000ms));
+            auto ttl = redis.ttl("expiring");
+            REQUIRE(ttl > 0);
+            REQUIRE(ttl <= 10);
+            REQUIRE_FALSE(redis.set("expiring", "other", 0ms, UpdateType::NOT_EXIST));
+            REQUIRE(redis.persist("expiring"));
+            REQUIRE(redis.ttl("expiring") == -1);
+
+            REQUIRE(redis.pexpire("expiring", 50ms));
+            std::this_thread::sleep_for(100ms);
+            REQUIRE_FALSE(redis.get("expiring").has_value());
+            REQUIRE(redis.pttl("expiring") == -2);
+        }
+
+        SECTION("INFO memory") {
+            std::string info = redis.info("memory");
+            REQUIRE(info.find("# Memory") != std::string::npos);
+            REQUIRE(info.find("allocator_frag_ratio:") != std::string::npos);
+            REQUIRE(redis.info("nosuchsection").empty());
+        }
+
+        SECTION("INFO commandstats and LATENCY HISTOGRAM") {
+            REQUIRE(redis.set("counted", "1"));
+            std::string info = redis.info("commandstats");
+            REQUIRE(info.find("cmdstat_set:calls=") != std::string::npos);
+            REQUIRE(redis.info().find("total_commands_processed:") != std::string::npos);
+            auto histogram = redis.command("LATENCY", "HISTOGRAM", "set");
+            REQUIRE(histogram->type == REDIS_REPLY_ARRAY);
+            REQUIRE(histogram->elements == 2);
+            REQUIRE(std::string(histogram->element[0]->str, histogram->element[0]->len) == "set");
+            REQUIRE(redis.command<std::string>("CONFIG", "RESETSTAT") == "OK");
+        }
+
+        SECTION("SLOWLOG and LATENCY LATEST") {
+            REQUIRE(redis.command<std::string>("SLOWLOG", "RESET") == "OK");
+            REQUIRE(redis.command<long long>("SLOWLOG", "LEN") == 0);
+            auto entries = redis.command("SLOWLOG", "GET");
+            REQUIRE(entries->type == REDIS_REPLY_ARRAY);
+            REQUIRE(entries->elements == 0);
+            auto events = redis.command("LATENCY", "LATEST");
+            REQUIRE(events->type == REDIS_REPLY_ARRAY);
+        }
+
         SECTION("Connection remains active after multiple commands") {
             for (int i = 0; i < 5; ++i) {
                 REQUIRE(redis.ping() == "PONG");
@@ -99,8 +149,9 @@ TEST_CASE("Server Integration: Basic commands", "[integration]") {
 TEST_CASE("Server Integration: Basic connection test", "[integration]") {
     const int test_port = 6381;
     const std::string test_host = "127.0.0.1";
+    const auto backend = GENERATE(Backend::EPOLL, Backend::IO_URING);
     
-    Server server(test_host, test_port);
+    Server server(test_host, test_port, 1, backend);
     std::atomic<bool> server_started{false};
     std::exception_ptr server_exception = nullptr;
     
@@ -147,3 +198,163 @@ TEST_CASE("Server Integration: Basic connection test", "[integration]") {
     }
 }
 
+
+TEST_CASE("Server Integration: Multi-threaded sharded keyspace", "[integration]") {
+    const int test_port = 6382;
+    const std::string test_host = "127.0.0.1";
+    const auto backend = GENERATE(Backend::EPOLL, Backend::IO_URING);
+    
+    Server server(test_host, test_port, 4, backend);
+    std::atomic<bool> server_started{false};
+    std::exception_ptr server_exception = nullptr;
+    
+    std::thread server_thread([&]() {
+        try {
+            server_started = true;
+            server.start();
+        } catch (...) {
+            server_exception = std::current_exception();
+        }
+    });
+    
+    // Wait for server to start
+    std::this_thread::sleep_for(400ms);
+    REQUIRE(server_started);
+    
+    try {
+        ConnectionOptions opts;
+        opts.host = test_host;
+        opts.port = test_port;
+        opts.socket_timeout = std::chrono::milliseconds(2000);
+        opts.connect_timeout = std::chrono::milliseconds(2000);
+        
+        Redis redis(opts);
+        
+        SECTION("Keys on every shard") {
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(redis.set("key" + std::to_string(i), "value" + std::to_string(i)));
+            }
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(redis.get("key" + std::to_string(i)) == "value" + std::to_string(i));
+            }
+        }
+        
+        SECTION("Multi-key commands spanning shards") {
+            std::vector<std::string> keys;
+            for (int i = 0; i < 20; ++i) {
+                keys.push_back("multi" + std::to_string(i));
+                redis.set(keys.back(), "x");
+            }
+            REQUIRE(redis.exists(keys.begin(), keys.end()) == 20);
+            REQUIRE(redis.del(keys.begin(), keys.begin() + 10) == 10);
+            REQUIRE(redis.exists(keys.begin(), keys.end()) == 10);
+        }
+        
+        SECTION("Pipelined replies keep their order") {
+            auto pipe = redis.pipeline();
+            for (int i = 0; i < 50; ++i) {
+                pipe.set("pipe" + std::to_string(i), std::to_string(i));
+                pipe.get("pipe" + std::to_string(i));
+            }
+            auto replies = pipe.exec();
+            for (int i = 0; i < 50; ++i) {
+                REQUIRE(replies.get<OptionalString>(2 * i + 1) == std::to_string(i));
+            }
+        }
+        
+    } catch (const std::exception& e) {
+        FAIL("Failed to connect to server: " + std::string(e.what()));
+    }
+    
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+    
+    if (server_exception) {
+        std::rethrow_exception(server_exception);
+    }
+}
+
+TEST_CASE("Server Integration: A client that does not read its replies", "[integration]") {
+    const int test_port = 6383;
+    const std::string test_host = "127.0.0.1";
+    const auto backend = Backend::IO_URING;
+
+    Server server(test_host, test_port, 1, backend);
+    std::atomic<bool> server_started{false};
+    std::exception_ptr server_exception = nullptr;
+
+    std::thread server_thread([&]() {
+        try {
+            server_started = true;
+            server.start();
+        } catch (...) {
+            server_exception = std::current_exception();
+        }
+    });
+
+    // Wait for server to start
+    std::this_thread::sleep_for(400ms);
+    REQUIRE(server_started);
+
+    try {
+        ConnectionOptions opts;
+        opts.host = test_host;
+        opts.port = test_port;
+        opts.socket_timeout = std::chrono::milliseconds(2000);
+        opts.connect_timeout = std::chrono::milliseconds(2000);
+
+        Redis redis(opts);
+        const std::string value(1024 * 1024, 'x');
+        REQUIRE(redis.set("big", value));
+
+        // 500MB of replies, asked for in one go
+        const int requests = 500;
+        int client = ::socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(client != -1);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(test_port);
+        inet_pton(AF_INET, test_host.c_str(), &address.sin_addr);
+        REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        std::string pipeline;
+        for (int i = 0; i < requests; ++i) {
+            pipeline += "*2\r\n$3\r\nGET\r\n$3\r\nbig\r\n";
+        }
+        REQUIRE(::send(client, pipeline.data(), pipeline.size(), 0) == static_cast<ssize_t>(pipeline.size()));
+
+        // The server stops reading once the replies pile up instead of
+        // running every command
+        std::this_thread::sleep_for(500ms);
+        auto info = redis.info("memory");
+        auto rss_at = info.find("used_memory_rss:") + std::string("used_memory_rss:").size();
+        REQUIRE(std::stoull(info.substr(rss_at)) < 100 * 1024 * 1024);
+
+        // And catches up as the client reads
+        const size_t reply_size = value.size() + std::to_string(value.size()).size() + 5;
+        size_t expected = requests * reply_size;
+        size_t received = 0;
+        std::string buffer(1024 * 1024, '\0');
+        while (received < expected) {
+            ssize_t bytes = ::recv(client, buffer.data(), buffer.size(), 0);
+            REQUIRE(bytes > 0);
+            received += static_cast<size_t>(bytes);
+        }
+        REQUIRE(received == expected);
+        ::close(client);
+        REQUIRE(redis.ping() == "PONG");
+
+    } catch (const std::exception& e) {
+        FAIL("Failed to connect to server: " + std::string(e.what()));
+    }
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+
+    if (server_exception) {
+        std::rethrow_exception(server_exception);
+    }
+}
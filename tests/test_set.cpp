@@ -0,0 +1,229 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/set.hpp"
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    std::vector<int64_t> elements(const IntSet& set) {
+        std::vector<int64_t> result;
+        set.forEach([&](int64_t value) { result.push_back(value); });
+        return result;
+    }
+
+    std::set<std::string> members(const Set& set) {
+        std::set<std::string> result;
+        set.forEach([&](std::string_view member) { result.emplace(member); });
+        return result;
+    }
+
+    std::set<std::string> combine(void (*fn)(std::span<const Set* const>, const Set::MemberFn&),
+                                  std::vector<const Set*> sets) {
+        std::set<std::string> result;
+        fn(sets, [&](std::string_view member) { REQUIRE(result.emplace(member).second); });
+        return result;
+    }
+
+    // `count` distinct values below `range`, each offset by `base`
+    std::vector<int64_t> randomValues(std::mt19937_64& rng, size_t count, int64_t range, int64_t base) {
+        std::set<int64_t> values;
+        while (values.size() < count) {
+            values.insert(base + static_cast<int64_t>(rng() % static_cast<uint64_t>(range)));
+        }
+        return std::vector<int64_t>(values.begin(), values.end());
+    }
+}
+
+TEST_CASE("IntSet: Insert, erase and contains", "[intset]") {
+    IntSet set;
+    REQUIRE(set.insert(5));
+    REQUIRE(set.insert(-3));
+    REQUIRE(set.insert(100));
+    REQUIRE_FALSE(set.insert(5));
+    REQUIRE(set.size() == 3);
+    REQUIRE(set.width() == 2);
+    REQUIRE(elements(set) == std::vector<int64_t>{-3, 5, 100});
+
+    REQUIRE(set.contains(-3));
+    REQUIRE_FALSE(set.contains(4));
+    REQUIRE_FALSE(set.contains(int64_t(1) << 40));
+
+    REQUIRE(set.erase(5));
+    REQUIRE_FALSE(set.erase(5));
+    REQUIRE(elements(set) == std::vector<int64_t>{-3, 100});
+}
+
+TEST_CASE("IntSet: Widens for larger values", "[intset]") {
+    IntSet set;
+    set.insert(1);
+    set.insert(2);
+    set.insert(70000);
+    REQUIRE(set.width() == 4);
+    set.insert(INT64_MIN);
+    REQUIRE(set.width() == 8);
+    set.insert(INT64_MAX);
+    set.insert(-70000);
+    REQUIRE(elements(set) == std::vector<int64_t>{INT64_MIN, -70000, 1, 2, 70000, INT64_MAX});
+
+    // Erasing the wide values keeps the width
+    set.erase(INT64_MIN);
+    set.erase(INT64_MAX);
+    REQUIRE(set.width() == 8);
+    REQUIRE(set.contains(70000));
+}
+
+TEST_CASE("IntSet: Elements take their width", "[intset]") {
+    IntSet set;
+    for (int64_t i = 0; i < 10000; i++) {
+        set.insert(i * 3);
+    }
+    REQUIRE(set.width() == 2);
+    // Less than the same elements at 4 bytes, even with room to grow
+    REQUIRE(set.memoryUsage() < 10000 * sizeof(int32_t));
+}
+
+TEST_CASE("IntSet: Intersections match std::set_intersection", "[intset]") {
+    std::mt19937_64 rng(7);
+    // Every pair of widths, balanced sizes for the block merge and skewed
+    // ones for the galloping search
+    const std::vector<int64_t> bases = {0, 1 << 20, int64_t(1) << 40};
+    const std::vector<std::pair<size_t, size_t>> sizes = {
+        {0, 10}, {1, 1}, {7, 9}, {100, 120}, {1000, 1000}, {10, 5000}, {3, 20000}, {64, 64},
+    };
+    for (int64_t a_base : bases) {
+        for (int64_t b_base : bases) {
+            for (auto [a_size, b_size] : sizes) {
+                // A range narrow enough for many common elements, with both
+                // sets still of their base's width
+                int64_t range = static_cast<int64_t>(std::max(a_size, b_size) * 2 + 10);
+                auto a_values = randomValues(rng, a_size, range, a_base);
+                auto b_values = randomValues(rng, b_size, range, b_base);
+                IntSet a;
+                IntSet b;
+                for (int64_t value : a_values) {
+                    a.insert(value);
+                }
+                for (int64_t value : b_values) {
+                    b.insert(value);
+                }
+
+                std::vector<int64_t> expected;
+                std::set_intersection(a_values.begin(), a_values.end(), b_values.begin(), b_values.end(),
+                                      std::back_inserter(expected));
+                std::vector<int64_t> result;
+                a.intersect(b, result);
+                REQUIRE(result == expected);
+                result.clear();
+                b.intersect(a, result);
+                REQUIRE(result == expected);
+                result.clear();
+                b.intersect(a_values, result);
+                REQUIRE(result == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("Set: Integers stay an intset", "[set]") {
+    Set set;
+    REQUIRE(set.add("3", 4));
+    REQUIRE(set.add("-1", 4));
+    REQUIRE(set.add("2", 4));
+    REQUIRE_FALSE(set.add("3", 4));
+    REQUIRE(set.intset());
+    REQUIRE(set.contains("-1"));
+    // Not canonical, so not the integer 2
+    REQUIRE_FALSE(set.contains("02"));
+
+    // In ascending order
+    std::vector<std::string> order;
+    set.forEach([&](std::string_view member) { order.emplace_back(member); });
+    REQUIRE(order == std::vector<std::string>{"-1", "2", "3"});
+
+    REQUIRE(set.remove("2"));
+    REQUIRE_FALSE(set.remove("2"));
+    REQUIRE_FALSE(set.remove("x"));
+    REQUIRE(set.size() == 2);
+}
+
+TEST_CASE("Set: Converts to a table", "[set]") {
+    SECTION("Past the intset limit") {
+        Set set;
+        for (int i = 0; i < 4; i++) {
+            set.add(std::to_string(i), 4);
+        }
+        REQUIRE(set.intset());
+        set.add("4", 4);
+        REQUIRE_FALSE(set.intset());
+        REQUIRE(members(set) == std::set<std::string>{"0", "1", "2", "3", "4"});
+    }
+
+    SECTION("On a string member") {
+        Set set;
+        set.add("1", 512);
+        set.add("01", 512);
+        REQUIRE_FALSE(set.intset());
+        REQUIRE(set.contains("1"));
+        REQUIRE(set.contains("01"));
+        REQUIRE_FALSE(set.add("1", 512));
+        REQUIRE(set.size() == 2);
+    }
+}
+
+TEST_CASE("Set: Intersection, union and difference", "[set]") {
+    Set odd;
+    Set small;
+    Set tags;
+    for (int i = 1; i < 20; i += 2) {
+        odd.add(std::to_string(i), 512);
+    }
+    for (int i = 0; i < 6; i++) {
+        small.add(std::to_string(i), 512);
+    }
+    for (const char* member : {"1", "3", "red", "blue"}) {
+        tags.add(member, 512);
+    }
+    REQUIRE(odd.intset());
+    REQUIRE_FALSE(tags.intset());
+
+    REQUIRE(combine(Set::intersect, {&odd, &small}) == std::set<std::string>{"1", "3", "5"});
+    REQUIRE(combine(Set::intersect, {&odd, &small, &tags}) == std::set<std::string>{"1", "3"});
+    REQUIRE(combine(Set::intersect, {&odd}) == members(odd));
+    REQUIRE(combine(Set::intersect, {&odd, nullptr}).empty());
+
+    REQUIRE(combine(Set::unite, {&small, nullptr}) == members(small));
+    REQUIRE(combine(Set::unite, {&small, &tags}) ==
+            std::set<std::string>{"0", "1", "2", "3", "4", "5", "red", "blue"});
+    REQUIRE(combine(Set::unite, {&odd, &small}).size() == 13);
+
+    REQUIRE(combine(Set::difference, {&small, &odd}) == std::set<std::string>{"0", "2", "4"});
+    REQUIRE(combine(Set::difference, {&tags, &small, nullptr}) == std::set<std::string>{"red", "blue"});
+    REQUIRE(combine(Set::difference, {nullptr, &small}).empty());
+}
+
+TEST_CASE("Set: Matches std::set under random operations", "[set]") {
+    std::mt19937 rng(42);
+    for (int round = 0; round < 10; round++) {
+        Set set;
+        std::set<std::string> expected;
+        for (int i = 0; i < 3000; i++) {
+            // Integers, with the odd string in later rounds
+            std::string member = std::to_string(static_cast<int>(rng() % 400) - 200);
+            if (round >= 5 && rng() % 50 == 0) {
+                member = "m" + member;
+            }
+            if (rng() % 3 == 0) {
+                REQUIRE(set.remove(member) == (expected.erase(member) == 1));
+            } else {
+                REQUIRE(set.add(member, 128) == expected.insert(member).second);
+            }
+        }
+        REQUIRE(set.size() == expected.size());
+        REQUIRE(members(set) == expected);
+    }
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/latency_monitor.hpp"
+#include "redis/slow_log.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace redis;
+
+TEST_CASE("SlowLog: Keeps the newest entries", "[slow_log]") {
+    SlowLog log(3);
+    REQUIRE(log.length() == 0);
+    for (uint64_t i = 0; i < 5; i++) {
+        std::string value = std::to_string(i);
+        std::vector<std::string_view> args = {"SET", "key", value};
+        log.add(args, i);
+    }
+    REQUIRE(log.length() == 3);
+    REQUIRE(log[0].micros == 4);
+    REQUIRE(log[2].micros == 2);
+    REQUIRE(log[0].id > log[1].id);
+    REQUIRE(log[0].bytes == "SETkey4");
+
+    log.setMaxLength(2);
+    REQUIRE(log.length() == 2);
+    REQUIRE(log[0].micros == 4);
+    REQUIRE(log[1].micros == 3);
+    log.setMaxLength(4);
+    std::vector<std::string_view> args = {"GET", "key"};
+    log.add(args, 5);
+    REQUIRE(log.length() == 3);
+    REQUIRE(log[0].micros == 5);
+    REQUIRE(log[2].micros == 3);
+
+    log.reset();
+    REQUIRE(log.length() == 0);
+    SlowLog disabled(0);
+    disabled.add(args, 1);
+    REQUIRE(disabled.length() == 0);
+}
+
+TEST_CASE("SlowLog: Cuts long commands as Redis does", "[slow_log]") {
+    SlowLog log;
+    std::string big(200, 'x');
+    std::vector<std::string_view> args = {"SET", "key", big};
+    log.add(args, 7);
+    std::string reply;
+    SlowLog::appendReply(reply, log[0]);
+    REQUIRE(reply.find("*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n") != std::string::npos);
+    REQUIRE(reply.find(std::string(128, 'x') + "... (72 more bytes)\r\n") != std::string::npos);
+    REQUIRE(reply.ends_with("$0\r\n\r\n$0\r\n\r\n"));
+
+    std::vector<std::string> names(40, "k");
+    std::vector<std::string_view> many = {"DEL"};
+    many.insert(many.end(), names.begin(), names.end());
+    log.add(many, 8);
+    REQUIRE(log[0].kept == SlowLog::MAX_ARGS - 1);
+    reply.clear();
+    SlowLog::appendReply(reply, log[0]);
+    REQUIRE(reply.find("*32\r\n$3\r\nDEL\r\n") != std::string::npos);
+    REQUIRE(reply.find("... (10 more arguments)") != std::string::npos);
+}
+
+TEST_CASE("LatencyMonitor: Records events over the threshold", "[slow_log]") {
+    using namespace std::chrono_literals;
+    LatencyMonitor monitor;
+    monitor.record("command", 1s);
+    REQUIRE(monitor.events().empty());
+
+    monitor.setThreshold(10ms);
+    REQUIRE(monitor.exceeds(10ms));
+    REQUIRE_FALSE(monitor.exceeds(9ms));
+    monitor.record("command", 5ms);
+    monitor.record("command", 20ms);
+    monitor.record("command", 30ms);
+    monitor.record("event-loop", 15ms);
+    auto events = monitor.events();
+    REQUIRE(events.size() == 2);
+    REQUIRE(events[0].name == "command");
+    REQUIRE(events[0].max == 30);
+    // Samples of the same second are merged
+    REQUIRE(events[0].length == 1);
+    REQUIRE(events[0].latest().millis == 30);
+
+    std::vector<std::string_view> names = {"event-loop", "nosuchevent"};
+    REQUIRE(monitor.reset(names) == 1);
+    REQUIRE(monitor.events().size() == 1);
+    REQUIRE(monitor.reset() == 1);
+    REQUIRE(monitor.events().empty());
+}
@@ -1,6 +1,14 @@
 #include <catch2/catch_test_macros.hpp>
 #include "redis/storage.hpp"
+#include "redis/lazy_free.hpp"
+#include "redis/memory.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <set>
 #include <string>
+#include <vector>
 
 using namespace redis;
 
@@ -110,3 +118,624 @@ TEST_CASE("Storage: DEL operation", "[storage]") {
         REQUIRE(result.value().value() == "new_value");
     }
 }
+
+TEST_CASE("Storage: Lazy free", "[storage]") {
+    LazyFree lazy_free;
+    Storage storage;
+    storage.setLazyFree(&lazy_free);
+    std::vector<std::string> members;
+    for (size_t i = 0; i <= Storage::LAZY_FREE_THRESHOLD; i++) {
+        members.push_back("member" + std::to_string(i));
+    }
+    std::vector<std::string_view> views(members.begin(), members.end());
+    REQUIRE(storage.setAdd("big", views).value() == members.size());
+    REQUIRE(storage.setAdd("small", std::vector<std::string_view>{"a"}).value() == 1);
+    storage.set("string", "value", Storage::now() + 60000);
+
+    SECTION("DEL leaves big values to the lazy free thread") {
+        uint64_t changes = storage.changes();
+        REQUIRE(storage.delMany(std::vector<std::string_view>{"big", "small", "string", "missing"}) == 3);
+        REQUIRE(storage.changes() == changes + 3);
+        REQUIRE(storage.size() == 0);
+        REQUIRE(storage.expiresSize() == 0);
+        lazy_free.drain();
+        REQUIRE(lazy_free.pending() == 0);
+    }
+
+    SECTION("clearAsync() empties the keyspace at once") {
+        uint64_t changes = storage.changes();
+        storage.clearAsync();
+        REQUIRE(storage.changes() == changes + 1);
+        REQUIRE(storage.size() == 0);
+        REQUIRE(storage.expiresSize() == 0);
+        REQUIRE_FALSE(storage.exists("string"));
+        // The emptied storage is still usable
+        storage.set("string", "again");
+        REQUIRE(storage.get("string").value().value() == "again");
+        lazy_free.drain();
+    }
+}
+
+namespace {
+    // Evict one key at a time, `count` times, and return the indexes of
+    // the evicted keys
+    std::vector<int> evictKeys(Storage& storage, EvictionPolicy policy, size_t count) {
+        std::vector<int> evicted;
+        for (size_t i = 0; i < count; i++) {
+            storage.setMemoryLimits({memory::used() - 1, policy, 10});
+            REQUIRE(storage.evict([&](std::string_view key) { evicted.push_back(std::stoi(std::string(key))); }));
+        }
+        storage.setMemoryLimits({0, policy, 10});
+        return evicted;
+    }
+}
+
+TEST_CASE("Storage: Eviction", "[storage]") {
+    Storage storage;
+    const int64_t start = Storage::now();
+
+    SECTION("Without a limit nothing is evicted") {
+        storage.set("0", "value");
+        REQUIRE(storage.evict([](std::string_view) { FAIL(); }));
+        storage.setMemoryLimits({1, EvictionPolicy::NOEVICTION});
+        REQUIRE_FALSE(storage.evict([](std::string_view) { FAIL(); }));
+        REQUIRE(storage.exists("0"));
+    }
+
+    SECTION("allkeys-lru evicts the keys idle the longest") {
+        storage.setMemoryLimits({0, EvictionPolicy::ALLKEYS_LRU, 10});
+        storage.refreshClock(start);
+        for (int i = 0; i < 200; i++) {
+            storage.set(std::to_string(i), "value");
+        }
+        storage.refreshClock(start + 60000);
+        for (int i = 100; i < 200; i++) {
+            REQUIRE(storage.exists(std::to_string(i)));
+        }
+        uint64_t changes = storage.changes();
+        auto evicted = evictKeys(storage, EvictionPolicy::ALLKEYS_LRU, 50);
+        REQUIRE(evicted.size() == 50);
+        REQUIRE(storage.size() == 150);
+        REQUIRE(storage.changes() == changes + 50);
+        REQUIRE(std::ranges::count_if(evicted, [](int i) { return i < 100; }) >= 45);
+    }
+
+    SECTION("allkeys-lfu evicts the keys accessed the least") {
+        storage.setMemoryLimits({0, EvictionPolicy::ALLKEYS_LFU, 10});
+        storage.refreshClock(start);
+        for (int i = 0; i < 200; i++) {
+            storage.set(std::to_string(i), "value");
+        }
+        for (int access = 0; access < 100; access++) {
+            for (int i = 100; i < 200; i++) {
+                storage.exists(std::to_string(i));
+            }
+        }
+        auto evicted = evictKeys(storage, EvictionPolicy::ALLKEYS_LFU, 50);
+        REQUIRE(std::ranges::count_if(evicted, [](int i) { return i < 100; }) >= 45);
+    }
+
+    SECTION("volatile-ttl evicts the keys expiring the soonest, and only those") {
+        storage.setMemoryLimits({0, EvictionPolicy::VOLATILE_TTL, 10});
+        for (int i = 0; i < 200; i++) {
+            storage.set(std::to_string(i), "value", start + 1000000 + i * 1000);
+        }
+        for (int i = 200; i < 300; i++) {
+            storage.set(std::to_string(i), "value");
+        }
+        auto evicted = evictKeys(storage, EvictionPolicy::VOLATILE_TTL, 20);
+        REQUIRE(std::ranges::all_of(evicted, [](int i) { return i < 200; }));
+        REQUIRE(std::ranges::count_if(evicted, [](int i) { return i < 100; }) >= 18);
+
+        // Nothing left to evict once no key has an expire time
+        for (int i = 0; i < 200; i++) {
+            storage.persist(std::to_string(i));
+        }
+        storage.setMemoryLimits({memory::used() - 1, EvictionPolicy::VOLATILE_TTL});
+        REQUIRE_FALSE(storage.evict([](std::string_view) {}));
+    }
+}
+
+TEST_CASE("Storage: Eviction across shards", "[storage]") {
+    // Two shards, each filled by its own thread as the event loops do
+    Storage small;
+    Storage big;
+    auto fill = [](Storage& shard, int keys) {
+        memory::AccountScope account(&shard.account());
+        for (int i = 0; i < keys; i++) {
+            shard.set(std::to_string(i), std::string(100, 'v'));
+        }
+    };
+    fill(small, 100);
+    fill(big, 2000);
+    REQUIRE(big.account().used() > 10 * small.account().used());
+
+    // Over in all, but only the big shard is over its half
+    size_t max_memory = 4 * small.account().used();
+    for (Storage* shard : {&small, &big}) {
+        shard->setMemoryLimits({max_memory, EvictionPolicy::ALLKEYS_LRU, 5, 2});
+    }
+    auto evict = [](Storage& shard) {
+        memory::AccountScope account(&shard.account());
+        return shard.evict([](std::string_view) {});
+    };
+    REQUIRE(evict(small));
+    REQUIRE(small.size() == 100);
+
+    REQUIRE(evict(big));
+    REQUIRE(big.account().used() <= max_memory / 2);
+    REQUIRE(big.size() > 0);
+    REQUIRE(big.size() < 2000);
+    REQUIRE(small.size() == 100);
+}
+
+TEST_CASE("Storage: Active defrag", "[storage]") {
+    Storage storage;
+    const std::string long_value(100, 'v');
+    for (int i = 0; i < 20000; i++) {
+        std::string key = std::to_string(i);
+        storage.set(key, i % 2 == 0 ? key : long_value + key, i % 3 == 0 ? std::optional(Storage::now() + 3600000) : std::nullopt);
+    }
+    for (int i = 0; i < 20000; i++) {
+        if (i % 8 != 0) {
+            storage.del(std::to_string(i));
+        }
+    }
+    const std::chrono::seconds interval(1);
+    // Disabled, then below the thresholds
+    REQUIRE(storage.activeDefragCycle(interval) == 0);
+    storage.setDefragSettings({true, size_t(1) << 40});
+    REQUIRE(storage.activeDefragCycle(interval) == 0);
+
+    storage.setDefragSettings({true, 0, 0});
+    size_t wasted = memory::active() - memory::used();
+    size_t moved = 0;
+    for (int pass = 0; pass < 4; pass++) {
+        moved += storage.activeDefragCycle(interval);
+    }
+    REQUIRE(moved > 0);
+    REQUIRE(memory::active() - memory::used() < wasted);
+    for (int i = 0; i < 20000; i += 8) {
+        std::string key = std::to_string(i);
+        REQUIRE(storage.get(key).value().value() == (i % 2 == 0 ? key : long_value + key));
+        REQUIRE((storage.ttl(key) > 0) == (i % 3 == 0));
+    }
+    REQUIRE(storage.size() == 2500);
+    REQUIRE(storage.expiresSize() == 834);
+}
+
+TEST_CASE("Storage: Batch operations", "[storage]") {
+    Storage storage;
+    // More keys than a prefetch window, so that batches span several
+    std::vector<std::string> owned;
+    for (int i = 0; i < 40; i++) {
+        owned.push_back("key" + std::to_string(i));
+        owned.push_back("value" + std::to_string(i));
+    }
+    std::vector<std::string_view> key_values(owned.begin(), owned.end());
+    REQUIRE(storage.setMany(key_values));
+    REQUIRE(storage.size() == 40);
+    REQUIRE(storage.get("key39").value().value() == "value39");
+
+    storage.push("list", ListEnd::TAIL, std::vector<std::string_view>{"a"});
+    storage.set("expired", "value", Storage::now() - 1);
+    std::vector<std::string_view> keys{"key0", "missing", "list", "expired", "key39", "key0"};
+    std::vector<std::optional<std::string>> values;
+    storage.getMany(keys, [&](const std::optional<StringValue>& value) {
+        values.push_back(value.has_value() ? std::optional<std::string>(value->view()) : std::nullopt);
+    });
+    REQUIRE(values == std::vector<std::optional<std::string>>{"value0", std::nullopt, std::nullopt, std::nullopt,
+                                                              "value39", "value0"});
+    REQUIRE(storage.existsMany(keys) == 4);
+
+    SECTION("setMany only if none exist") {
+        uint64_t changes = storage.changes();
+        REQUIRE_FALSE(storage.setMany(std::vector<std::string_view>{"new", "1", "key5", "2"}, true));
+        REQUIRE_FALSE(storage.exists("new"));
+        REQUIRE(storage.changes() == changes);
+        REQUIRE(storage.setMany(std::vector<std::string_view>{"new", "1", "other", "2"}, true));
+        REQUIRE(storage.get("other").value().value() == "2");
+    }
+
+    SECTION("delMany") {
+        REQUIRE(storage.delMany(keys) == 3);
+        REQUIRE(storage.size() == 38);
+        REQUIRE_FALSE(storage.exists("key0"));
+        REQUIRE(storage.delMany(std::vector<std::string_view>(keys.begin(), keys.begin() + 2)) == 0);
+    }
+}
+
+TEST_CASE("Storage: Counters", "[storage]") {
+    Storage storage;
+    REQUIRE(storage.increment("counter", 5) == 5);
+    REQUIRE(storage.increment("counter", -7) == -2);
+    REQUIRE(storage.get("counter").value().value() == "-2");
+
+    // An existing key keeps its expire time
+    storage.expireAt("counter", Storage::now() + 100000);
+    REQUIRE(storage.increment("counter", 1) == -1);
+    REQUIRE(storage.ttl("counter") > 0);
+
+    storage.set("max", "9223372036854775807");
+    REQUIRE(storage.increment("max", 1).error() == "ERR increment or decrement would overflow");
+    storage.set("text", "01");
+    REQUIRE(storage.increment("text", 1).error() == "ERR value is not an integer or out of range");
+    storage.push("list", ListEnd::TAIL, std::vector<std::string_view>{"a"});
+    REQUIRE(storage.increment("list", 1).error() == Storage::WRONGTYPE);
+
+    REQUIRE(storage.incrementFloat("float", 10.5L) == "10.5");
+    REQUIRE(storage.incrementFloat("float", 0.1L) == "10.6");
+    REQUIRE(storage.incrementFloat("float", -0.6L) == "10");
+    // The result is a canonical integer again
+    REQUIRE(storage.increment("float", 1) == 11);
+    REQUIRE(storage.incrementFloat("text", 1).value() == "2");
+    REQUIRE(storage.incrementFloat("float", INFINITY).error() == "ERR increment would produce NaN or Infinity");
+    storage.set("word", "abc");
+    REQUIRE(storage.incrementFloat("word", 1).error() == "ERR value is not a valid float");
+}
+
+TEST_CASE("Storage: APPEND and SETRANGE", "[storage]") {
+    Storage storage;
+    REQUIRE(storage.append("s", "12") == 2);
+    REQUIRE(storage.append("s", "3") == 3);
+    REQUIRE(storage.increment("s", 1) == 124);
+
+    // Past the embedding limit the string grows in place
+    std::string expected = "124";
+    for (int i = 0; i < 200; i++) {
+        std::string part = "part" + std::to_string(i);
+        expected += part;
+        REQUIRE(storage.append("s", part) == expected.size());
+    }
+    REQUIRE(storage.get("s").value().value() == expected);
+
+    REQUIRE(storage.setRange("s", 1, "XY") == expected.size());
+    expected.replace(1, 2, "XY");
+    REQUIRE(storage.get("s").value().value() == expected);
+    REQUIRE(storage.setRange("s", expected.size() + 2, "end") == expected.size() + 5);
+    expected += std::string(2, '\0') + "end";
+    REQUIRE(storage.get("s").value().value() == expected);
+
+    uint64_t changes = storage.changes();
+    REQUIRE(storage.setRange("missing", 5, "") == 0);
+    REQUIRE_FALSE(storage.exists("missing"));
+    REQUIRE(storage.changes() == changes);
+    REQUIRE(storage.setRange("padded", 2, "ab") == 4);
+    REQUIRE(storage.get("padded").value().value() == std::string("\0\0ab", 4));
+    REQUIRE(storage.setRange("padded", 512 * 1024 * 1024, "x").error() ==
+            "ERR string exceeds maximum allowed size (proto-max-bulk-len)");
+}
+
+TEST_CASE("Storage: Scan and random keys", "[storage]") {
+    Storage storage;
+    REQUIRE_FALSE(storage.randomKey().has_value());
+    for (int i = 0; i < 500; i++) {
+        storage.set("key" + std::to_string(i), "value");
+    }
+    storage.push("list", ListEnd::TAIL, std::vector<std::string_view>{"a"});
+    storage.set("expired", "value", Storage::now() - 1);
+
+    std::set<std::string> seen;
+    size_t list_type = 0;
+    size_t cursor = 0;
+    size_t calls = 0;
+    do {
+        cursor = storage.scan(cursor, 10, [&](std::string_view key, ValueType type) {
+            seen.emplace(key);
+            list_type += type == ValueType::LIST ? 1 : 0;
+        });
+        calls++;
+    } while (cursor != 0);
+    REQUIRE(seen.size() == 501);
+    REQUIRE_FALSE(seen.contains("expired"));
+    REQUIRE(list_type == 1);
+    // Batches of about ten keys
+    REQUIRE(calls > 20);
+
+    for (int i = 0; i < 20; i++) {
+        auto key = storage.randomKey();
+        REQUIRE(key.has_value());
+        REQUIRE(storage.exists(*key));
+    }
+}
+
+TEST_CASE("Storage: Key expiration", "[storage]") {
+    Storage storage;
+    int64_t now = Storage::now();
+
+    SECTION("Keys have no expire time by default") {
+        storage.set("key1", "value1");
+        REQUIRE(storage.ttl("key1") == -1);
+        REQUIRE(storage.ttl("missing") == -2);
+        REQUIRE(storage.expiresSize() == 0);
+    }
+
+    SECTION("Expire time in the future") {
+        storage.set("key1", "value1");
+        REQUIRE(storage.expireAt("key1", now + 10000));
+        int64_t ttl = storage.ttl("key1");
+        REQUIRE(ttl > 9000);
+        REQUIRE(ttl <= 10000);
+        REQUIRE(storage.get("key1").value().value() == "value1");
+        REQUIRE_FALSE(storage.expireAt("missing", now + 10000));
+    }
+
+    SECTION("Expire time in the past deletes the key") {
+        storage.set("key1", "value1");
+        REQUIRE(storage.expireAt("key1", now - 1));
+        REQUIRE_FALSE(storage.exists("key1"));
+        REQUIRE(storage.expiresSize() == 0);
+    }
+
+    SECTION("Expired keys are removed on access") {
+        storage.set("key1", "value1", now - 1);
+        storage.set("key2", "value2", now - 1);
+        REQUIRE(storage.size() == 2);
+
+        REQUIRE_FALSE(storage.get("key1").value().has_value());
+        REQUIRE_FALSE(storage.exists("key2"));
+        REQUIRE(storage.size() == 0);
+        REQUIRE(storage.expiresSize() == 0);
+    }
+
+    SECTION("SET without an expire time clears it") {
+        storage.set("key1", "value1", now + 10000);
+        storage.set("key1", "value2");
+        REQUIRE(storage.ttl("key1") == -1);
+        REQUIRE(storage.expiresSize() == 0);
+    }
+
+    SECTION("PERSIST removes the expire time") {
+        storage.set("key1", "value1", now + 10000);
+        REQUIRE(storage.persist("key1"));
+        REQUIRE_FALSE(storage.persist("key1"));
+        REQUIRE(storage.ttl("key1") == -1);
+    }
+
+    SECTION("DEL removes the expire time") {
+        storage.set("key1", "value1", now + 10000);
+        REQUIRE(storage.del("key1"));
+        REQUIRE(storage.expiresSize() == 0);
+        storage.set("key1", "value1");
+        REQUIRE(storage.ttl("key1") == -1);
+    }
+}
+
+TEST_CASE("Storage: Active expire cycle", "[storage]") {
+    Storage storage;
+    int64_t now = Storage::now();
+
+    for (int i = 0; i < 1000; i++) {
+        storage.set("expired:" + std::to_string(i), "value", now - 1);
+        storage.set("live:" + std::to_string(i), "value", now + 100000);
+        storage.set("plain:" + std::to_string(i), "value");
+    }
+    REQUIRE(storage.expiresSize() == 2000);
+
+    SECTION("Removes expired keys only") {
+        size_t removed = 0;
+        for (int round = 0; round < 1000 && storage.expiresSize() > 1000; round++) {
+            removed += storage.activeExpireCycle(std::chrono::milliseconds(10));
+        }
+        REQUIRE(removed == 1000);
+        REQUIRE(storage.size() == 2000);
+        REQUIRE(storage.expiresSize() == 1000);
+        REQUIRE(storage.exists("live:0"));
+        REQUIRE(storage.exists("plain:0"));
+    }
+
+    SECTION("Stops once the budget is used up") {
+        size_t removed = storage.activeExpireCycle(std::chrono::microseconds(0));
+        REQUIRE(removed > 0);
+        REQUIRE(removed < 1000);
+    }
+}
+
+TEST_CASE("Storage: Active expire cycle with fewer keys than a sample", "[storage]") {
+    Storage storage;
+    storage.set("key1", "value1", Storage::now() - 1);
+    storage.set("key2", "value2", Storage::now() + 100000);
+
+    REQUIRE(storage.activeExpireCycle(std::chrono::milliseconds(10)) == 1);
+    REQUIRE(storage.size() == 1);
+    REQUIRE(storage.expiresSize() == 1);
+}
+
+TEST_CASE("Storage: Overwriting a key with an expire time", "[storage]") {
+    Storage storage;
+    int64_t now = Storage::now();
+    storage.set("key1", "value1", now + 10000);
+    storage.set("key1", std::string(200, 'x'), now + 20000);
+
+    REQUIRE(storage.ttl("key1") > 10000);
+    REQUIRE(storage.get("key1").value().value() == std::string(200, 'x'));
+    REQUIRE(storage.persist("key1"));
+    REQUIRE(storage.expiresSize() == 0);
+}
+
+TEST_CASE("Storage: Integer values", "[storage]") {
+    Storage storage;
+    storage.set("small", "42");
+    storage.set("large", "-9223372036854775808");
+    storage.set("padded", "007");
+
+    REQUIRE(storage.get("small").value().value() == "42");
+    REQUIRE(storage.get("large").value().value() == "-9223372036854775808");
+    REQUIRE(storage.get("padded").value().value() == "007");
+}
+
+TEST_CASE("Storage: Memory usage", "[storage]") {
+    Storage storage;
+    REQUIRE_FALSE(storage.memoryUsage("missing").has_value());
+
+    storage.set("key1", "value1");
+    auto small = storage.memoryUsage("key1");
+    REQUIRE(small.has_value());
+
+    storage.set("key2", std::string(1000, 'x'));
+    REQUIRE(storage.memoryUsage("key2").value() > 1000);
+    REQUIRE(storage.memoryUsage("key2").value() > *small);
+}
+
+TEST_CASE("Storage: List operations", "[storage]") {
+    Storage storage;
+    std::vector<std::string_view> values = {"a", "b", "c"};
+    REQUIRE(storage.push("list", ListEnd::TAIL, values).value() == 3);
+    std::vector<std::string_view> front = {"z"};
+    REQUIRE(storage.push("list", ListEnd::HEAD, front).value() == 4);
+    REQUIRE(storage.list("list").value()->index(0).value() == "z");
+    REQUIRE(storage.list("missing").value() == nullptr);
+
+    REQUIRE(storage.pop("list", ListEnd::TAIL, 2).value() == std::vector<std::string>{"c", "b"});
+    REQUIRE(storage.pop("missing", ListEnd::HEAD, 1).value().empty());
+
+    REQUIRE(storage.trim("list", 1, -1).has_value());
+    REQUIRE(storage.list("list").value()->size() == 1);
+    // A list is deleted with its last element
+    REQUIRE(storage.pop("list", ListEnd::HEAD, 10).value() == std::vector<std::string>{"a"});
+    REQUIRE_FALSE(storage.exists("list"));
+}
+
+TEST_CASE("Storage: Hash operations", "[storage]") {
+    Storage storage;
+    std::vector<std::string_view> pairs = {"name", "alice", "age", "30"};
+    REQUIRE(storage.hashSet("user", pairs).value() == 2);
+    std::vector<std::string_view> update = {"age", "31", "city", "paris"};
+    REQUIRE(storage.hashSet("user", update).value() == 1);
+    REQUIRE(storage.hash("user").value()->get("age").value().view() == "31");
+    REQUIRE(storage.hash("missing").value() == nullptr);
+
+    REQUIRE(storage.hashIncrement("user", "age", 2).value() == 33);
+    REQUIRE(storage.hashIncrement("user", "visits", -1).value() == -1);
+    REQUIRE(storage.hashIncrement("user", "name", 1).error() == "ERR hash value is not an integer");
+    std::vector<std::string_view> max = {"max", "9223372036854775807"};
+    storage.hashSet("user", max);
+    REQUIRE(storage.hashIncrement("user", "max", 1).error() == "ERR increment or decrement would overflow");
+
+    std::vector<std::string_view> fields = {"name", "missing"};
+    REQUIRE(storage.hashDelete("user", fields).value() == 1);
+    // A hash is deleted with its last field
+    std::vector<std::string_view> rest = {"age", "city", "visits", "max"};
+    REQUIRE(storage.hashDelete("user", rest).value() == 4);
+    REQUIRE_FALSE(storage.exists("user"));
+}
+
+TEST_CASE("Storage: Hash limits", "[storage]") {
+    Storage storage;
+    storage.setHashLimits({.max_packed_entries = 2, .max_packed_value = 64});
+    std::vector<std::string_view> pairs = {"a", "1", "b", "2"};
+    storage.hashSet("hash", pairs);
+    REQUIRE(storage.hash("hash").value()->packed());
+    std::vector<std::string_view> more = {"c", "3"};
+    storage.hashSet("hash", more);
+    REQUIRE_FALSE(storage.hash("hash").value()->packed());
+}
+
+TEST_CASE("Storage: Set operations", "[storage]") {
+    Storage storage;
+    std::vector<std::string_view> members = {"1", "2", "3", "2"};
+    REQUIRE(storage.setAdd("set", members).value() == 3);
+    std::vector<std::string_view> more = {"3", "four"};
+    REQUIRE(storage.setAdd("set", more).value() == 1);
+    REQUIRE(storage.getSet("set").value()->contains("four"));
+    REQUIRE(storage.getSet("missing").value() == nullptr);
+
+    // Adding only existing members is not a change
+    uint64_t changes = storage.changes();
+    REQUIRE(storage.setAdd("set", more).value() == 0);
+    REQUIRE(storage.changes() == changes);
+
+    std::vector<std::string_view> remove = {"1", "missing"};
+    REQUIRE(storage.setRemove("set", remove).value() == 1);
+    // A set is deleted with its last member
+    std::vector<std::string_view> rest = {"2", "3", "four"};
+    REQUIRE(storage.setRemove("set", rest).value() == 3);
+    REQUIRE_FALSE(storage.exists("set"));
+}
+
+TEST_CASE("Storage: Intset limit", "[storage]") {
+    Storage storage;
+    storage.setMaxIntsetEntries(2);
+    std::vector<std::string_view> members = {"1", "2"};
+    storage.setAdd("set", members);
+    REQUIRE(storage.getSet("set").value()->intset());
+    std::vector<std::string_view> more = {"3"};
+    storage.setAdd("set", more);
+    REQUIRE_FALSE(storage.getSet("set").value()->intset());
+}
+
+TEST_CASE("Storage: Sorted set operations", "[storage]") {
+    using Condition = Storage::ZAddCondition;
+    using Entry = std::pair<double, std::string_view>;
+    Storage storage;
+    std::vector<Entry> entries = {{1, "a"}, {2, "b"}};
+    auto added = storage.zsetAdd("zset", entries, Condition::ALWAYS).value();
+    REQUIRE(added.added == 2);
+    REQUIRE(added.changed == 2);
+
+    // NX skips existing members, XX new ones
+    std::vector<Entry> more = {{5, "a"}, {3, "c"}};
+    added = storage.zsetAdd("zset", more, Condition::NX).value();
+    REQUIRE(added.added == 1);
+    REQUIRE(storage.zset("zset").value()->score("a") == 1);
+    std::vector<Entry> update = {{5, "a"}, {4, "d"}};
+    added = storage.zsetAdd("zset", update, Condition::XX).value();
+    REQUIRE(added.added == 0);
+    REQUIRE(added.changed == 1);
+    REQUIRE(storage.zset("zset").value()->score("a") == 5);
+    REQUIRE_FALSE(storage.zset("zset").value()->score("d").has_value());
+
+    // Same scores are not a change, and XX does not create a key
+    uint64_t changes = storage.changes();
+    REQUIRE(storage.zsetAdd("zset", update, Condition::XX).value().changed == 0);
+    REQUIRE(storage.zsetAdd("missing", entries, Condition::XX).value().changed == 0);
+    REQUIRE(storage.changes() == changes);
+    REQUIRE_FALSE(storage.exists("missing"));
+
+    REQUIRE(storage.zsetIncrement("zset", "b", 2.5).value() == 4.5);
+    REQUIRE(storage.zsetIncrement("new", "x", -1).value() == -1);
+    REQUIRE(storage.zsetIncrement("zset", "a", -INFINITY).value() == -INFINITY);
+    REQUIRE(storage.zsetIncrement("zset", "a", INFINITY).error() == "ERR resulting score is not a number (NaN)");
+    REQUIRE(storage.zset("zset").value()->rank("a") == 0);
+
+    // A sorted set is deleted with its last member
+    std::vector<std::string_view> remove = {"a", "b", "c", "missing"};
+    REQUIRE(storage.zsetRemove("zset", remove).value() == 3);
+    REQUIRE_FALSE(storage.exists("zset"));
+}
+
+TEST_CASE("Storage: Sorted set limits", "[storage]") {
+    Storage storage;
+    storage.setZSetLimits({.max_packed_entries = 2, .max_packed_value = 64});
+    std::vector<std::pair<double, std::string_view>> entries = {{1, "a"}, {2, "b"}};
+    storage.zsetAdd("zset", entries, Storage::ZAddCondition::ALWAYS);
+    REQUIRE(storage.zset("zset").value()->packed());
+    storage.zsetIncrement("zset", "c", 3);
+    REQUIRE_FALSE(storage.zset("zset").value()->packed());
+}
+
+TEST_CASE("Storage: Wrong type", "[storage]") {
+    Storage storage;
+    storage.set("string", "value");
+    std::vector<std::string_view> values = {"a"};
+    storage.push("list", ListEnd::TAIL, values);
+
+    REQUIRE(storage.push("string", ListEnd::TAIL, values).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.pop("string", ListEnd::TAIL, 1).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.list("string").error() == Storage::WRONGTYPE);
+    REQUIRE(storage.get("list").error() == Storage::WRONGTYPE);
+    std::vector<std::string_view> pairs = {"field", "value"};
+    REQUIRE(storage.hashSet("list", pairs).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.hashIncrement("string", "field", 1).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.hash("string").error() == Storage::WRONGTYPE);
+    REQUIRE(storage.setAdd("list", values).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.getSet("string").error() == Storage::WRONGTYPE);
+    std::vector<std::pair<double, std::string_view>> entries = {{1, "a"}};
+    REQUIRE(storage.zsetAdd("list", entries, Storage::ZAddCondition::ALWAYS).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.zsetIncrement("string", "a", 1).error() == Storage::WRONGTYPE);
+    REQUIRE(storage.zset("string").error() == Storage::WRONGTYPE);
+
+    // SET replaces a value of any type
+    storage.set("list", "now a string");
+    REQUIRE(storage.get("list").value().value() == "now a string");
+}
@@ -0,0 +1,204 @@
+#include <catch2/catch_test_macros.hpp>
+#include "redis/zset.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace redis;
+
+namespace {
+    using Entries = std::vector<std::pair<std::string, double>>;
+
+    Entries entries(const ZSet& zset) {
+        Entries result;
+        zset.forEach([&](std::string_view member, double score) { result.emplace_back(member, score); });
+        return result;
+    }
+
+    Entries range(const ZSet& zset, int64_t start, int64_t stop) {
+        Entries result;
+        if (auto positions = zset.range(start, stop)) {
+            zset.forRange(positions->first, positions->second,
+                          [&](std::string_view member, double score) { result.emplace_back(member, score); });
+        }
+        return result;
+    }
+
+    Entries scoreRange(const ZSet& zset, const ScoreRange& range, size_t offset = 0, size_t count = SIZE_MAX) {
+        Entries result;
+        zset.forScoreRange(range, offset, count,
+                           [&](std::string_view member, double score) { result.emplace_back(member, score); });
+        return result;
+    }
+
+    const ZSetLimits SMALL_LIMITS{4, 8};
+}
+
+TEST_CASE("ZSet: Orders by score, then member", "[zset]") {
+    ZSet zset;
+    REQUIRE(zset.add("carol", 3, SMALL_LIMITS));
+    REQUIRE(zset.add("alice", 1, SMALL_LIMITS));
+    REQUIRE(zset.add("bob", 3, SMALL_LIMITS));
+    REQUIRE(zset.packed());
+    REQUIRE(entries(zset) == Entries{{"alice", 1}, {"bob", 3}, {"carol", 3}});
+
+    // A new score moves the member
+    REQUIRE_FALSE(zset.add("alice", 5, SMALL_LIMITS));
+    REQUIRE(entries(zset) == Entries{{"bob", 3}, {"carol", 3}, {"alice", 5}});
+    REQUIRE(zset.score("alice") == 5);
+    REQUIRE_FALSE(zset.score("dave").has_value());
+    REQUIRE(zset.rank("carol") == 1);
+    REQUIRE_FALSE(zset.rank("dave").has_value());
+
+    REQUIRE(zset.remove("bob"));
+    REQUIRE_FALSE(zset.remove("bob"));
+    REQUIRE(zset.size() == 2);
+    REQUIRE(zset.rank("alice") == 1);
+}
+
+TEST_CASE("ZSet: Converts to a skiplist", "[zset]") {
+    SECTION("Past the entry limit") {
+        ZSet zset;
+        for (int i = 0; i < 4; i++) {
+            zset.add(std::to_string(i), -i, SMALL_LIMITS);
+        }
+        REQUIRE(zset.packed());
+        zset.add("4", -4, SMALL_LIMITS);
+        REQUIRE_FALSE(zset.packed());
+        REQUIRE(entries(zset) == Entries{{"4", -4}, {"3", -3}, {"2", -2}, {"1", -1}, {"0", 0}});
+        REQUIRE(zset.rank("0") == 4);
+        REQUIRE(zset.score("2") == -2);
+    }
+
+    SECTION("On a long member") {
+        ZSet zset;
+        zset.add("short", 1, SMALL_LIMITS);
+        zset.add("a much longer member", 2, SMALL_LIMITS);
+        REQUIRE_FALSE(zset.packed());
+        REQUIRE(entries(zset) == Entries{{"short", 1}, {"a much longer member", 2}});
+        // It stays a skiplist once small again
+        zset.remove("a much longer member");
+        REQUIRE_FALSE(zset.packed());
+        REQUIRE(zset.size() == 1);
+    }
+}
+
+TEST_CASE("ZSet: Rank ranges", "[zset]") {
+    for (bool packed : {true, false}) {
+        ZSet zset;
+        ZSetLimits limits = packed ? ZSetLimits{} : ZSetLimits{0, 0};
+        for (int i = 0; i < 10; i++) {
+            zset.add("m" + std::to_string(i), i * 1.5, limits);
+        }
+        REQUIRE(zset.packed() == packed);
+
+        REQUIRE(range(zset, 0, 2) == Entries{{"m0", 0}, {"m1", 1.5}, {"m2", 3}});
+        REQUIRE(range(zset, -2, -1) == Entries{{"m8", 12}, {"m9", 13.5}});
+        REQUIRE(range(zset, 8, 100) == Entries{{"m8", 12}, {"m9", 13.5}});
+        REQUIRE(range(zset, -100, 0) == Entries{{"m0", 0}});
+        REQUIRE(range(zset, 5, 4).empty());
+        REQUIRE(range(zset, 10, 20).empty());
+        REQUIRE(range(zset, 0, -1).size() == 10);
+    }
+}
+
+TEST_CASE("ZSet: Score ranges", "[zset]") {
+    for (bool packed : {true, false}) {
+        ZSet zset;
+        ZSetLimits limits = packed ? ZSetLimits{} : ZSetLimits{0, 0};
+        for (int i = 0; i < 10; i++) {
+            zset.add("m" + std::to_string(i), i, limits);
+        }
+        const double inf = INFINITY;
+
+        REQUIRE(scoreRange(zset, {2, 4}) == Entries{{"m2", 2}, {"m3", 3}, {"m4", 4}});
+        REQUIRE(scoreRange(zset, {2, 4, true, true}) == Entries{{"m3", 3}});
+        REQUIRE(scoreRange(zset, {-inf, 1}) == Entries{{"m0", 0}, {"m1", 1}});
+        REQUIRE(scoreRange(zset, {8.5, inf}) == Entries{{"m9", 9}});
+        REQUIRE(scoreRange(zset, {4, 2}).empty());
+        REQUIRE(scoreRange(zset, {20, inf}).empty());
+
+        // LIMIT offset count
+        REQUIRE(scoreRange(zset, {-inf, inf}, 3, 2) == Entries{{"m3", 3}, {"m4", 4}});
+        REQUIRE(scoreRange(zset, {5, inf}, 3, 10) == Entries{{"m8", 8}, {"m9", 9}});
+        REQUIRE(scoreRange(zset, {5, 6}, 2, 10).empty());
+        REQUIRE(scoreRange(zset, {-inf, inf}, 0, 0).empty());
+    }
+}
+
+TEST_CASE("ZSet: Scores format as their shortest text", "[zset]") {
+    std::array<char, 32> buffer;
+    REQUIRE(formatScore(3, buffer) == "3");
+    REQUIRE(formatScore(-1.5, buffer) == "-1.5");
+    REQUIRE(formatScore(0.1, buffer) == "0.1");
+    REQUIRE(formatScore(INFINITY, buffer) == "inf");
+    REQUIRE(formatScore(-INFINITY, buffer) == "-inf");
+    REQUIRE(formatScore(1e300, buffer) == "1e+300");
+}
+
+TEST_CASE("ZSet: Matches std::set under random operations", "[zset]") {
+    std::mt19937 rng(42);
+    for (ZSetLimits limits : {ZSetLimits{}, ZSetLimits{0, 0}, ZSetLimits{16, 64}}) {
+        ZSet zset;
+        std::set<std::pair<double, std::string>> expected;
+        std::unordered_map<std::string, double> scores;
+        for (int i = 0; i < 20000; i++) {
+            std::string member = "m" + std::to_string(rng() % 300);
+            // Few distinct scores, so that ties are ordered by member
+            double score = static_cast<double>(rng() % 50) / 2;
+            auto current = scores.find(member);
+            if (rng() % 4 == 0) {
+                bool present = current != scores.end();
+                REQUIRE(zset.remove(member) == present);
+                if (present) {
+                    expected.erase({current->second, member});
+                    scores.erase(current);
+                }
+            } else {
+                REQUIRE(zset.add(member, score, limits) == (current == scores.end()));
+                if (current != scores.end()) {
+                    expected.erase({current->second, member});
+                }
+                expected.emplace(score, member);
+                scores[member] = score;
+            }
+
+            if (i % 500 == 0) {
+                REQUIRE(zset.size() == expected.size());
+                Entries ordered;
+                for (const auto& [s, m] : expected) {
+                    ordered.emplace_back(m, s);
+                }
+                REQUIRE(entries(zset) == ordered);
+                size_t rank = 0;
+                for (const auto& [s, m] : expected) {
+                    REQUIRE(zset.rank(m) == rank++);
+                    REQUIRE(zset.score(m) == s);
+                }
+                if (!ordered.empty()) {
+                    REQUIRE(range(zset, 5, 9) == Entries(ordered.begin() + std::min<size_t>(5, ordered.size()),
+                                                          ordered.begin() + std::min<size_t>(10, ordered.size())));
+                }
+                Entries between;
+                for (const auto& [m, s] : ordered) {
+                    if (s > 5 && s <= 12) {
+                        between.emplace_back(m, s);
+                    }
+                }
+                REQUIRE(scoreRange(zset, {5, 12, true, false}) == between);
+                if (between.size() > 3) {
+                    REQUIRE(scoreRange(zset, {5, 12, true, false}, 3, 2) ==
+                            Entries(between.begin() + 3, between.begin() + std::min<size_t>(5, between.size())));
+                }
+            }
+        }
+    }
+}